@@ -0,0 +1,45 @@
+declare namespace createAssembler {
+    export interface LineEncoding {
+        line: number;
+        address: number;
+        code: number;
+    }
+
+    export interface AssemblerDiagnostic {
+        line: number;
+        message: string;
+    }
+
+    export interface EditResult {
+        refreshed: { first: number, count: number }[];
+        updated: LineEncoding[];
+        diagnostics: AssemblerDiagnostic[];
+        lexedLines: number;
+        parsedLines: number;
+    }
+
+    export interface IncrementalAssembler {
+        setSource(text: string): EditResult;
+        applyEdit(firstLine: number, removedLines: number, insertedLines: string[]): EditResult | null;
+        getLineEncodings(line: number): LineEncoding[];
+        getDiagnostics(): AssemblerDiagnostic[];
+        getLineCount(): number;
+    }
+
+    export interface AssemblerModuleInstance {
+        IncrementalAssembler: {
+            new(): IncrementalAssembler;
+        };
+    }
+}
+
+declare global {
+    type LineEncoding = createAssembler.LineEncoding;
+    type AssemblerDiagnostic = createAssembler.AssemblerDiagnostic;
+    type EditResult = createAssembler.EditResult;
+    type IncrementalAssembler = createAssembler.IncrementalAssembler;
+    type AssemblerModuleInstance = createAssembler.AssemblerModuleInstance;
+}
+
+declare function createAssembler(): Promise<createAssembler.AssemblerModuleInstance>;
+export = createAssembler;
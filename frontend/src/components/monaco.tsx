@@ -4,6 +4,7 @@ import { useEffect, useRef, useState } from 'react';
 import MonacoEditor from '@monaco-editor/react';
 import { editor } from 'monaco-editor';
 import { useCurrentTheme } from '@/hooks/use-current-theme';
+import { useIncrementalAssembler } from '@/hooks/use-incremental-assembler';
 import { Skeleton } from './ui/skeleton';
 
 interface EditorProps {
@@ -13,8 +14,56 @@ interface EditorProps {
 
 export const Editor = ({ text, setText }: EditorProps) => {
     const editorRef = useRef<editor.IStandaloneCodeEditor | null>(null);
+    const monacoRef = useRef<typeof import('monaco-editor') | null>(null);
+    const assemblerRef = useRef<IncrementalAssembler | null>(null);
     const [isEditorReady, setIsEditorReady] = useState(false);
     const currentTheme = useCurrentTheme();
+    const { assembler } = useIncrementalAssembler();
+
+    useEffect(() => {
+        const codeEditor = editorRef.current;
+        const monaco = monacoRef.current;
+        const model = codeEditor?.getModel();
+        if (!codeEditor || !monaco || !model || !assembler || !isEditorReady) return;
+
+        const showDiagnostics = (diagnostics: AssemblerDiagnostic[]) => {
+            const lineCount = model.getLineCount();
+            monaco.editor.setModelMarkers(model, 'riscv-assembler', diagnostics.map((diagnostic) => {
+                const line = Math.min(Math.max(diagnostic.line, 1), lineCount);
+                return {
+                    severity: monaco.MarkerSeverity.Error,
+                    message: diagnostic.message,
+                    startLineNumber: line,
+                    startColumn: 1,
+                    endLineNumber: line,
+                    endColumn: model.getLineMaxColumn(line),
+                };
+            }));
+        };
+
+        assemblerRef.current = assembler;
+        showDiagnostics(assembler.setSource(model.getLinesContent().join('\n')).diagnostics);
+
+        // A single change is sent as a line edit; anything else, or an edit
+        // the assembler cannot place, reloads the whole source.
+        const subscription = codeEditor.onDidChangeModelContent((event) => {
+            let result: EditResult | null = null;
+            if (!event.isFlush && event.changes.length === 1) {
+                const { range, text } = event.changes[0];
+                const insertedLines = text.split(/\r\n|\r|\n/).map((_, i) => model.getLineContent(range.startLineNumber + i));
+                result = assembler.applyEdit(range.startLineNumber, range.endLineNumber - range.startLineNumber + 1, insertedLines);
+            }
+            if (!result) {
+                result = assembler.setSource(model.getLinesContent().join('\n'));
+            }
+            showDiagnostics(result.diagnostics);
+        });
+        return () => {
+            subscription.dispose();
+            monaco.editor.setModelMarkers(model, 'riscv-assembler', []);
+            assemblerRef.current = null;
+        };
+    }, [assembler, isEditorReady]);
 
     useEffect(() => {
         if (editorRef.current && isEditorReady) {
@@ -92,6 +141,7 @@ export const Editor = ({ text, setText }: EditorProps) => {
 
     const handleEditorDidMount = async (editor: editor.IStandaloneCodeEditor, monaco: typeof import('monaco-editor')) => {
         editorRef.current = editor;
+        monacoRef.current = monaco;
 
         monaco.languages.register({ id: 'riscv-assembly' });
         monaco.languages.setMonarchTokensProvider('riscv-assembly', {
@@ -118,6 +168,18 @@ export const Editor = ({ text, setText }: EditorProps) => {
             },
         });
 
+        monaco.languages.registerHoverProvider('riscv-assembly', {
+            provideHover: (model, position) => {
+                const encodings = assemblerRef.current?.getLineEncodings(position.lineNumber) ?? [];
+                if (encodings.length === 0) return null;
+                const hex = (value: number) => `0x${(value >>> 0).toString(16).toUpperCase().padStart(8, '0')}`;
+                return {
+                    range: new monaco.Range(position.lineNumber, 1, position.lineNumber, model.getLineMaxColumn(position.lineNumber)),
+                    contents: encodings.map((encoding) => ({ value: `\`${hex(encoding.address)}\` \`${hex(encoding.code)}\`` })),
+                };
+            },
+        });
+
         defineThemes(monaco);
 
         monaco.editor.setModelLanguage(editor.getModel()!, 'riscv-assembly');
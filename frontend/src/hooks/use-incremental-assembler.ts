@@ -0,0 +1,48 @@
+import { useState, useEffect } from 'react';
+
+interface WindowWithAssembler extends Window {
+  createAssembler?: () => Promise<AssemblerModuleInstance>;
+}
+
+export const useIncrementalAssembler = () => {
+  const [assembler, setAssembler] = useState<IncrementalAssembler | null>(null);
+  const [loading, setLoading] = useState(true);
+  const [error, setError] = useState<string | null>(null);
+
+  useEffect(() => {
+    async function initAssembler() {
+      try {
+        const script = document.createElement('script');
+        script.src = '/wasm/assembler.js';
+        script.async = true;
+        document.body.appendChild(script);
+        await new Promise<void>((resolve, reject) => {
+          script.onload = () => resolve();
+          script.onerror = () => reject(new Error('Failed to load /wasm/assembler.js'));
+        });
+
+        const windowWithAssembler = window as WindowWithAssembler;
+        const createAssemblerFn = windowWithAssembler.createAssembler;
+
+        if (!createAssemblerFn) {
+          throw new Error('createAssembler function not found on window');
+        }
+
+        const moduleInstance = await createAssemblerFn();
+        setAssembler(new moduleInstance.IncrementalAssembler());
+        setLoading(false);
+      } catch (err) {
+        console.error('Assembler initialization error:', err);
+        setError(err instanceof Error ? err.message : 'Failed to load assembler');
+        setLoading(false);
+      }
+    }
+    initAssembler();
+    return () => {
+      const script = document.querySelector('script[src="/wasm/assembler.js"]');
+      if (script) document.body.removeChild(script);
+    };
+  }, []);
+
+  return { assembler, loading, error };
+};
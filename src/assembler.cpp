@@ -1,215 +1,437 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
 #include <unordered_map>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <iomanip>
 #include "types.hpp"
+#include "source.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "assembler.hpp"
+#include "stream.hpp"
+#include "parallel.hpp"
+#include "writer.hpp"
+#include "object.hpp"
+#include "linker.hpp"
+#include "incremental.hpp"
+
+constexpr size_t PARALLEL_THRESHOLD = 4 << 20;
 
 void printUsage(const std::string& programName) {
-    std::cout << "Usage: " << programName << " <input_file.asm> [output_file.mc]" << std::endl;
-    std::cout << "If output file is not specified, the output will be written to <input_file>.mc" << std::endl;
+    std::cout << "Usage: " << programName << " [--stream] [--image] [-j <threads>] <input_file.asm> [output_file.mc]" << std::endl;
+    std::cout << "       " << programName << " --object <input_file.asm> [output_file.rvo]" << std::endl;
+    std::cout << "       " << programName << " --link [--image] [-o <output_file>] <input_file.asm|input_file.rvo>..." << std::endl;
+    std::cout << "       " << programName << " --edits <edit_script> <input_file.asm> [output_file.mc]" << std::endl;
+    std::cout << "If output file is not specified, the output will be written to <input_file>.mc (<input_file>.rvi with --image)" << std::endl;
+    std::cout << "Use --image to write a binary program image that the simulator loads without assembling" << std::endl;
+    std::cout << "Use - as the input file to read from stdin and - as the output file to write to stdout (both imply --stream)" << std::endl;
+    std::cout << "Use --object to write a relocatable object; labels marked .globl can be referenced from other files" << std::endl;
+    std::cout << "Use --link to assemble and link several sources or objects into one program starting at _start if it is defined" << std::endl;
+    std::cout << "Use --edits to replay '@@ <first_line> <removed_lines> <inserted_lines>' edits, each followed by its inserted lines, through the incremental assembler and check every result against a full assembly" << std::endl;
+    std::cout << "Use -j to assemble with a thread pool; inputs of " << (PARALLEL_THRESHOLD >> 20) << " MiB or more use all hardware threads by default" << std::endl;
 }
 
-std::string readFile(const std::string& filename) {
-    std::ifstream file(filename);
+std::shared_ptr<const riscv::SourceBuffer> readFile(const std::string& filename) {
+    return riscv::SourceBuffer::fromFile(filename);
+}
+
+void writeMachineCode(const std::string& filename, const riscv::MemoryImage& image) {
+    std::ofstream file(filename, std::ios::binary);
     if (!file.is_open()) {
-        throw std::runtime_error("Could not open file: " + filename);
+        throw std::runtime_error("Could not open output file for writing: " + filename);
+    }
+
+    uint32_t textEnd = 0;
+    size_t textInstructions = 0;
+    {
+        MachineCodeWriter writer(file);
+        writer.writeTextHeader();
+        for (const riscv::TextSection& section : image.text) {
+            uint32_t address = section.base;
+            for (uint32_t code : section.words) {
+                if (address < riscv::DATA_SEGMENT_START) {
+                    writer.writeText(address, code);
+                    textEnd = std::max(textEnd, address + riscv::encodedLength(code));
+                    textInstructions++;
+                }
+                address += riscv::encodedLength(code);
+            }
+        }
+
+        writer.writeDataHeader(textInstructions, textEnd);
+        for (const riscv::DataSection& section : image.data) {
+            writer.writeData(section);
+        }
     }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
+
     file.close();
-    return buffer.str();
+    std::cout << "Machine code written to " << filename << " (" << textInstructions << " instructions, " << image.dataByteCount() << " data entries)" << std::endl;
 }
 
-std::string decryptInstruction(uint32_t instruction) {
-    uint32_t opcode = instruction & 0x7F;
-    uint32_t rd = (instruction >> 7) & 0x1F;
-    uint32_t funct3 = (instruction >> 12) & 0x7;
-    uint32_t rs1 = (instruction >> 15) & 0x1F;
-    uint32_t rs2 = (instruction >> 20) & 0x1F;
-    uint32_t funct7 = (instruction >> 25) & 0x7F;
-    std::stringstream ss;
-    if (opcode == 0b0110011) {
-        if (funct3 == 0b000 && funct7 == 0b0000000)
-            ss << "add";
-        else if (funct3 == 0b000 && funct7 == 0b0100000)
-            ss << "sub";
-        else if (funct3 == 0b001 && funct7 == 0b0000000)
-            ss << "sll";
-        else if (funct3 == 0b010 && funct7 == 0b0000000)
-            ss << "slt";
-        else if (funct3 == 0b011 && funct7 == 0b0000000)
-            ss << "sltu";
-        else if (funct3 == 0b100 && funct7 == 0b0000000)
-            ss << "xor";
-        else if (funct3 == 0b101 && funct7 == 0b0000000)
-            ss << "srl";
-        else if (funct3 == 0b101 && funct7 == 0b0100000)
-            ss << "sra";
-        else if (funct3 == 0b110 && funct7 == 0b0000000)
-            ss << "or";
-        else if (funct3 == 0b111 && funct7 == 0b0000000)
-            ss << "and";
-        else if (funct3 == 0b000 && funct7 == 0b0000001)
-            ss << "mul";
-        else if (funct3 == 0b100 && funct7 == 0b0000001)
-            ss << "div";
-        else if (funct3 == 0b110 && funct7 == 0b0000001)
-            ss << "rem";
-        else
-            return "UNKNOWN";
-        ss << " x" << rd << ",x" << rs1 << ",x" << rs2;
-    }
-    else if (opcode == 0b0010011 || opcode == 0b0000011) {
-        int32_t imm = instruction >> 20;
-        if (opcode == 0b0010011) {
-            if (funct3 == 0b000)
-                ss << "addi";
-            else if (funct3 == 0b001)
-                ss << "slli";
-            else if (funct3 == 0b010)
-                ss << "slti";
-            else if (funct3 == 0b011)
-                ss << "sltiu";
-            else if (funct3 == 0b100)
-                ss << "xori";
-            else if (funct3 == 0b101)
-                ss << ((imm >> 5) & 0x7F ? "srai" : "srli");
-            else if (funct3 == 0b110)
-                ss << "ori";
-            else if (funct3 == 0b111)
-                ss << "andi";
-            else
-                return "UNKNOWN";
-            ss << " x" << rd << ",x" << rs1 << "," << (funct3 == 0b001 || funct3 == 0b101 ? imm & 0x1F : imm);
-        }
-        else {
-            if (funct3 == 0b000)
-                ss << "lb";
-            else if (funct3 == 0b001)
-                ss << "lh";
-            else if (funct3 == 0b010)
-                ss << "lw";
-            else if (funct3 == 0b011)
-                ss << "ld";
-            else if (funct3 == 0b100)
-                ss << "lbu";
-            else if (funct3 == 0b101)
-                ss << "lhu";
-            else
-                return "UNKNOWN";
-            ss << " x" << rd << "," << imm << "(x" << rs1 << ")";
-        }
-    }
-    else if (opcode == 0b0100011) {
-        int32_t imm = ((instruction >> 25) & 0x7F) << 5 | ((instruction >> 7) & 0x1F);
-        if (funct3 == 0b000)
-            ss << "sb";
-        else if (funct3 == 0b001)
-            ss << "sh";
-        else if (funct3 == 0b010)
-            ss << "sw";
-        else if (funct3 == 0b011)
-            ss << "sd";
-        else
-            return "UNKNOWN";
-        ss << " x" << rs2 << "," << imm << "(x" << rs1 << ")";
-    }
-    else if (opcode == 0b1100011) {
-        int32_t imm = ((instruction >> 31) & 0x1) << 12 | ((instruction >> 7) & 0x1) << 11 |
-                      ((instruction >> 25) & 0x3F) << 5 | ((instruction >> 8) & 0xF) << 1;
-        if (funct3 == 0b000)
-            ss << "beq";
-        else if (funct3 == 0b001)
-            ss << "bne";
-        else if (funct3 == 0b100)
-            ss << "blt";
-        else if (funct3 == 0b101)
-            ss << "bge";
-        else if (funct3 == 0b110)
-            ss << "bltu";
-        else if (funct3 == 0b111)
-            ss << "bgeu";
-        else
-            return "UNKNOWN";
-        ss << " x" << rs1 << ",x" << rs2 << "," << imm;
-    }
-    else if (opcode == 0b0110111 || opcode == 0b0010111) {
-        int32_t imm = instruction & 0xFFFFF000;
-        ss << (opcode == 0b0110111 ? "lui" : "auipc") << " x" << rd << "," << (imm >> 12);
-    }
-    else if (opcode == 0b1101111) {
-        int32_t imm = ((instruction >> 31) & 0x1) << 20 | ((instruction >> 12) & 0xFF) << 12 |
-                      ((instruction >> 20) & 0x1) << 11 | ((instruction >> 21) & 0x3FF) << 1;
-        ss << "jal x" << rd << "," << imm;
-    }
-    else if (opcode == 0b1100111) {
-        int32_t imm = instruction >> 20;
-        if (funct3 == 0b000)
-            ss << "jalr x" << rd << ",x" << rs1 << "," << imm;
-        else
-            return "UNKNOWN";
-    }
-    else ss << "UNKNOWN" << std::hex << opcode;
-    return ss.str();
+void writeImageFile(const std::string& filename, const riscv::ProgramImage& program) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open output file for writing: " + filename);
+    }
+    riscv::writeProgramImage(file, program);
+    file.close();
+    std::cout << "Program image written to " << filename << " (" << program.memory.textWordCount() << " instructions, " << program.memory.dataByteCount() << " data bytes, "
+              << program.symbols.size() << " symbols)" << std::endl;
 }
 
-void writeMachineCode(const std::string& filename, const std::vector<std::pair<uint32_t, uint32_t>>& machineCode, size_t instructionCount, const std::string& inputFile) {
-    std::ofstream file(filename);
+std::string replaceExtension(const std::string& filename, const std::string& extension) {
+    const size_t dot = filename.find_last_of('.');
+    return (dot != std::string::npos ? filename.substr(0, dot) : filename) + extension;
+}
+
+riscv::ObjectFile readObject(const std::string& filename) {
+    std::shared_ptr<const riscv::SourceBuffer> contents = readFile(filename);
+    if (riscv::isObjectFile(contents->view())) {
+        return riscv::loadObjectFile(contents->view());
+    }
+    return ObjectAssembler().assemble(contents);
+}
+
+int writeObject(const std::string& inputFile, const std::string& outputFile) {
+    const riscv::ObjectFile object = readObject(inputFile);
+    std::ofstream file(outputFile, std::ios::binary);
     if (!file.is_open()) {
-        throw std::runtime_error("Could not open output file for writing: " + filename);
+        throw std::runtime_error("Could not open output file for writing: " + outputFile);
     }
+    riscv::writeObjectFile(file, object);
+    file.close();
+    std::cout << "Object written to " << outputFile << " (" << object.memory.textWordCount() << " instructions, " << object.memory.dataByteCount() << " data bytes, "
+              << object.symbols.size() << " symbols, " << object.relocations.size() << " relocations)" << std::endl;
+    return 0;
+}
 
-    file << "# ---------------- TEXT SEGMENT ---------------- #\n";
-    uint32_t lastTextAddress = 0;
+int linkObjects(const std::vector<std::string>& inputFiles, const std::string& outputFile, bool emitImage) {
+    Linker linker;
+    for (const std::string& inputFile : inputFiles) {
+        linker.addObject(readObject(inputFile), inputFile);
+    }
+    linker.link();
+    std::cout << "Linked " << linker.getObjectCount() << " objects (" << linker.getRelocationCount() << " relocations)" << std::endl;
+
+    if (emitImage) {
+        writeImageFile(outputFile, linker.getImage());
+    } else {
+        writeMachineCode(outputFile, linker.getImage().memory);
+    }
+    return 0;
+}
+
+int assembleStream(const std::string& inputFile, const std::string& outputFile) {
+    std::ifstream inputStream;
+    if (inputFile != "-") {
+        inputStream.open(inputFile, std::ios::binary);
+        if (!inputStream.is_open()) {
+            throw std::runtime_error("Could not open file: " + inputFile);
+        }
+    }
+    std::istream& input = (inputFile == "-") ? std::cin : inputStream;
+
+    std::ofstream outputStream;
+    if (outputFile != "-") {
+        outputStream.open(outputFile, std::ios::binary);
+        if (!outputStream.is_open()) {
+            throw std::runtime_error("Could not open output file for writing: " + outputFile);
+        }
+    }
+    std::ostream& output = (outputFile == "-") ? std::cout : outputStream;
+    std::ostream& log = (outputFile == "-") ? std::cerr : std::cout;
+
+    // The data segment is listed after the text, so data entries are spilled
+    // to a temporary file as they are resolved and copied out at the end.
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> spill(std::tmpfile(), &std::fclose);
+    if (!spill) {
+        throw std::runtime_error("Could not create a temporary file for the data segment");
+    }
+
+    uint32_t textEnd = 0;
     size_t textInstructions = 0;
-    
-    for (const auto& [address, code] : machineCode) {
-        if (address < riscv::DATA_SEGMENT_START) {
-            file << "0x" << std::hex << std::setw(8) << std::setfill('0') << address 
-                 << " 0x" << std::setw(8) << std::setfill('0') << code 
-                 << " , " << decryptInstruction(code) << "\n";
-            lastTextAddress = address;
-            textInstructions++;
+    StreamingAssembler assembler;
+    {
+        MachineCodeWriter writer(output);
+        writer.writeTextHeader();
+
+        bool assembled = assembler.assemble(input, [&](uint32_t address, uint32_t code) {
+            if (address < riscv::DATA_SEGMENT_START) {
+                writer.writeText(address, code);
+                textEnd = std::max(textEnd, address + riscv::encodedLength(code));
+                textInstructions++;
+            }
+        }, [&](uint32_t address, const uint8_t* bytes, size_t size) {
+            const uint32_t header[2] = {address, static_cast<uint32_t>(size)};
+            if (std::fwrite(header, sizeof(header), 1, spill.get()) != 1 || std::fwrite(bytes, 1, size, spill.get()) != size) {
+                throw std::runtime_error("Could not write the data segment to a temporary file");
+            }
+        });
+        if (!assembled) {
+            std::cerr << "Error: Streaming assembly failed" << std::endl;
+            return 1;
+        }
+
+        writer.writeDataHeader(textInstructions, textEnd);
+        std::rewind(spill.get());
+        uint32_t header[2];
+        std::vector<uint8_t> bytes;
+        while (std::fread(header, sizeof(header), 1, spill.get()) == 1) {
+            bytes.resize(header[1]);
+            if (std::fread(bytes.data(), 1, bytes.size(), spill.get()) != bytes.size()) {
+                throw std::runtime_error("Could not read the data segment back from a temporary file");
+            }
+            writer.writeData(header[0], bytes.data(), bytes.size());
         }
     }
+    output.flush();
 
-    file << "\n# ---------------- DATA SEGMENT ---------------- #\n";
-    if (textInstructions > 0) {
-        file << "0x" << std::hex << std::setw(8) << std::setfill('0') << (lastTextAddress + 4) << " 0x00000000 , <END_OF_TEXT>\n";
+    log << "Streamed " << std::dec << assembler.getLineCount() << " lines (peak " << assembler.getPeakPendingFixups() << " pending fixups)" << std::endl;
+    log << "Machine code written to " << (outputFile == "-" ? "stdout" : outputFile) << " (" << textInstructions << " instructions, " << assembler.getDataByteCount() << " data entries)" << std::endl;
+    return 0;
+}
+
+// Assembles the text from scratch; an empty image stands for a program that
+// does not assemble.
+bool assembleFully(const std::vector<std::string>& lines, riscv::MemoryImage& image) {
+    std::string text;
+    for (const std::string& line : lines) {
+        text += line;
+        text += '\n';
+    }
+    riscv::TokenArena tokenizedLines = Lexer::tokenizeArena(riscv::SourceBuffer::fromString(std::move(text)));
+    if (tokenizedLines.empty()) return true;
+    try {
+        Parser parser(tokenizedLines);
+        if (!parser.parse()) return false;
+        Assembler assembler(parser.getSymbolTable(), parser.getParsedInstructions());
+        if (!assembler.assemble()) return false;
+        image = assembler.takeImage();
+        return true;
+    } catch (const std::exception&) {
+        return false;
     }
+}
 
-    for (const auto& [address, code] : machineCode) {
-        if (address >= riscv::DATA_SEGMENT_START) {
-            file << "0x" << std::hex << std::setw(8) << std::setfill('0') << address << " 0x" << std::setw(2) << std::setfill('0') << (code & 0xFF) << "\n";
+bool sameImage(const riscv::MemoryImage& a, const riscv::MemoryImage& b) {
+    if (a.text.size() != b.text.size() || a.data.size() != b.data.size()) return false;
+    for (size_t i = 0; i < a.text.size(); ++i) {
+        if (a.text[i].base != b.text[i].base || a.text[i].words != b.text[i].words) return false;
+    }
+    for (size_t i = 0; i < a.data.size(); ++i) {
+        if (a.data[i].base != b.data[i].base || a.data[i].bytes != b.data[i].bytes) return false;
+    }
+    return true;
+}
+
+int replayEdits(const std::string& editFile, const std::string& inputFile, const std::string& outputFile) {
+    std::shared_ptr<const riscv::SourceBuffer> programCode = readFile(inputFile);
+    std::ifstream edits(editFile);
+    if (!edits.is_open()) {
+        throw std::runtime_error("Could not open file: " + editFile);
+    }
+
+    std::vector<std::string> lines;
+    std::string_view text = programCode->view();
+    while (!text.empty()) {
+        const size_t end = std::min(text.find('\n'), text.size());
+        lines.emplace_back(text.substr(0, end));
+        text.remove_prefix(std::min(end + 1, text.size()));
+    }
+
+    IncrementalAssembler incremental;
+    EditResult result = incremental.setSource(programCode->view());
+    size_t editCount = 0;
+    double editMilliseconds = 0;
+    double totalMilliseconds = 0;
+    double worstMilliseconds = 0;
+    std::string header;
+    while (true) {
+        riscv::MemoryImage expected;
+        const bool assembles = assembleFully(lines, expected);
+        if (assembles != result.diagnostics.empty() || (assembles && !sameImage(expected, incremental.buildImage()))) {
+            std::cerr << "Error: Incremental assembly differs from a full assembly after edit " << editCount << std::endl;
+            return 1;
+        }
+        if (editCount > 0) {
+            size_t refreshedLines = 0;
+            for (const LineRange& range : result.refreshed) refreshedLines += range.count;
+            std::cout << "Edit " << editCount << ": " << result.lexedLines << " lines lexed, " << result.parsedLines << " parsed, " << refreshedLines << " refreshed, "
+                      << result.diagnostics.size() << " diagnostics in " << std::fixed << std::setprecision(3) << editMilliseconds << " ms" << std::endl;
+        }
+
+        while (std::getline(edits, header) && header.empty()) {}
+        if (!edits) break;
+        size_t firstLine = 0, removedLines = 0, insertedCount = 0;
+        char marker[3] = {};
+        if (std::sscanf(header.c_str(), "%2s %zu %zu %zu", marker, &firstLine, &removedLines, &insertedCount) != 4 || std::string(marker) != "@@") {
+            throw std::runtime_error("Malformed edit header: " + header);
+        }
+        std::vector<std::string> inserted(insertedCount);
+        for (std::string& line : inserted) {
+            if (!std::getline(edits, line)) {
+                throw std::runtime_error("Edit script ends inside an edit: " + header);
+            }
         }
+
+        const auto started = std::chrono::steady_clock::now();
+        result = incremental.applyEdit(firstLine, removedLines, inserted);
+        editMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        totalMilliseconds += editMilliseconds;
+        worstMilliseconds = std::max(worstMilliseconds, editMilliseconds);
+        lines.erase(lines.begin() + static_cast<long>(firstLine - 1), lines.begin() + static_cast<long>(firstLine - 1 + removedLines));
+        lines.insert(lines.begin() + static_cast<long>(firstLine - 1), inserted.begin(), inserted.end());
+        editCount++;
     }
 
-    file.close();
-    std::cout << "Machine code written to " << filename << " (" << textInstructions << " instructions, " << (machineCode.size() - textInstructions) << " data entries)" << std::endl;
+    std::cout << "Replayed " << editCount << " edits on " << incremental.getLineCount() << " lines in " << incremental.getBlockCount() << " blocks" << std::endl;
+    if (editCount > 0) {
+        std::cout << "Edit time: " << std::fixed << std::setprecision(3) << totalMilliseconds / static_cast<double>(editCount) << " ms average, " << worstMilliseconds << " ms worst" << std::endl;
+    }
+    if (!result.diagnostics.empty()) {
+        for (const Diagnostic& diagnostic : result.diagnostics) {
+            std::cerr << "Line " << diagnostic.line << ": " << diagnostic.message << std::endl;
+        }
+        return 1;
+    }
+    writeMachineCode(outputFile, incremental.buildImage());
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2 || argc > 3) {
+    bool streaming = false;
+    bool emitImage = false;
+    bool emitObject = false;
+    bool linking = false;
+    long jobs = 0;
+    std::string linkOutput;
+    std::string editFile;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--stream") {
+            streaming = true;
+        } else if (argument == "--image") {
+            emitImage = true;
+        } else if (argument == "--object") {
+            emitObject = true;
+        } else if (argument == "--link") {
+            linking = true;
+        } else if (argument == "--edits" && i + 1 < argc) {
+            editFile = argv[++i];
+        } else if (argument == "-o" && i + 1 < argc) {
+            linkOutput = argv[++i];
+        } else if ((argument == "-j" || argument == "--jobs") && i + 1 < argc) {
+            jobs = std::strtol(argv[++i], nullptr, 10);
+            if (jobs < 1) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+
+    if (linking) {
+        if (arguments.empty() || emitObject || streaming) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        try {
+            return linkObjects(arguments, linkOutput.empty() ? replaceExtension(arguments[0], emitImage ? ".rvi" : ".mc") : linkOutput, emitImage);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (arguments.empty() || arguments.size() > 2 || !linkOutput.empty()) {
         printUsage(argv[0]);
         return 1;
     }
+
+    if (!editFile.empty()) {
+        if (streaming || emitImage || emitObject || arguments[0] == "-") {
+            std::cerr << "Error: Edits are replayed on an input file and written as machine code" << std::endl;
+            return 1;
+        }
+        try {
+            return replayEdits(editFile, arguments[0], arguments.size() == 2 ? arguments[1] : replaceExtension(arguments[0], ".mc"));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (emitObject) {
+        if (streaming || emitImage || arguments[0] == "-") {
+            std::cerr << "Error: Objects cannot be streamed or written as images; give an input file" << std::endl;
+            return 1;
+        }
+        try {
+            return writeObject(arguments[0], arguments.size() == 2 ? arguments[1] : replaceExtension(arguments[0], ".rvo"));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
     
-    std::string inputFile = argv[1];
-    std::string outputFile = (argc == 3) ? argv[2] : (inputFile.find_last_of('.') != std::string::npos ? inputFile.substr(0, inputFile.find_last_of('.')) + ".mc" : inputFile + ".mc");
+    std::string inputFile = arguments[0];
+    const std::string extension = emitImage ? ".rvi" : ".mc";
+    std::string outputFile = (arguments.size() == 2) ? arguments[1] : (inputFile == "-" ? "-" : replaceExtension(inputFile, extension));
+
+    if (emitImage && (streaming || inputFile == "-" || outputFile == "-")) {
+        std::cerr << "Error: Binary images cannot be streamed; give input and output files" << std::endl;
+        return 1;
+    }
+
+    if (streaming || inputFile == "-" || outputFile == "-") {
+        try {
+            return assembleStream(inputFile, outputFile);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
     
     try {
-        std::string programCode = readFile(inputFile);
-        if (programCode.empty()) {
+        std::shared_ptr<const riscv::SourceBuffer> programCode = readFile(inputFile);
+        if (programCode->empty()) {
             throw std::runtime_error("Input file is empty");
         }
-        std::cout << "Read " << programCode.size() << " bytes from " << inputFile << std::endl;
+        std::cout << "Read " << programCode->size() << " bytes from " << inputFile << std::endl;
+
+        size_t threads = static_cast<size_t>(jobs);
+        if (jobs == 0 && programCode->size() >= PARALLEL_THRESHOLD) {
+            threads = std::thread::hardware_concurrency();
+        }
+        if (threads > 1) {
+            ParallelAssembler assembler(threads);
+            if (!assembler.assemble(programCode)) {
+                std::cerr << "Error: Parallel assembly failed" << std::endl;
+                return 1;
+            }
+            std::cout << "Parallel assembly complete: " << assembler.getLineCount() << " lines in " << assembler.getChunkCount()
+                      << " chunks on " << assembler.getThreadCount() << " threads, " << assembler.getInstructionCount() << " instructions found" << std::endl;
+            if (emitImage) {
+                riscv::ProgramImage program;
+                program.memory = assembler.getImage();
+                program.addSymbols(assembler.getSymbolTable());
+                assembler.collectLines(program);
+                writeImageFile(outputFile, program);
+            } else {
+                writeMachineCode(outputFile, assembler.getImage());
+            }
+            return 0;
+        }
 
-        std::vector<std::vector<riscv::Token>> tokenizedLines = Lexer::tokenize(programCode);
+        riscv::TokenArena tokenizedLines = Lexer::tokenizeArena(programCode);
         if (tokenizedLines.empty()) {
             throw std::runtime_error("No valid tokens found in the input file");
         }
@@ -228,9 +450,18 @@ int main(int argc, char* argv[]) {
             std::cerr << "Error: Assembly failed with " << assembler.getErrorCount() << " errors" << std::endl;
             return 1;
         }
-        std::cout << "Assembly complete: " << assembler.getMachineCode().size() << " machine code entries generated" << std::endl;
+        const riscv::MemoryImage& image = assembler.getImage();
+        std::cout << "Assembly complete: " << image.textWordCount() + image.dataByteCount() << " machine code entries generated" << std::endl;
 
-        writeMachineCode(outputFile, assembler.getMachineCode(), instructionCount, inputFile);
+        if (emitImage) {
+            riscv::ProgramImage program;
+            program.memory = assembler.takeImage();
+            program.addSymbols(parser.getSymbolTable());
+            program.addLines(parser.getParsedInstructions());
+            writeImageFile(outputFile, program);
+        } else {
+            writeMachineCode(outputFile, image);
+        }
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
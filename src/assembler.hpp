@@ -5,308 +5,278 @@
 #include <cstdint>
 #include <stdexcept>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 #include "types.hpp"
+#include "symbols.hpp"
+#include "image.hpp"
+#include "compressed.hpp"
 
 using namespace riscv;
 
 class Assembler {
 public:
-    explicit Assembler(std::unordered_map<std::string, SymbolEntry> symbolTable, 
-        std::vector<ParsedInstruction> parsedInstructions) 
+    Assembler() 
+        : errorCount(0), symbols(nullptr), parseInstructions(nullptr) {}
+
+    explicit Assembler(const SymbolTable &symbolTable) 
+        : errorCount(0), symbols(&symbolTable), parseInstructions(nullptr) {}
+
+    Assembler(const SymbolTable &symbolTable, const std::vector<ParsedInstruction> &parsedInstructions) 
         : errorCount(0), 
-        symTable(std::move(symbolTable)), 
-        parseInstructions(std::move(parsedInstructions)) {}
+        symbols(&symbolTable), 
+        parseInstructions(&parsedInstructions) {}
 
     inline bool assemble();
+    inline uint32_t encode(const ParsedInstruction& inst) const;
+
+    inline const MemoryImage& getImage() const { return image; }
+    inline MemoryImage takeImage() { return std::move(image); }
 
-    inline const std::vector<std::pair<uint32_t, uint32_t>>& getMachineCode() const { return machineCode; }
-    
     inline size_t getErrorCount() const { return errorCount; }
 
 private:
     mutable size_t errorCount;
 
-    std::unordered_map<std::string, SymbolEntry> symTable;
+    const SymbolTable *symbols;
+    const std::vector<ParsedInstruction> *parseInstructions;
 
-    std::vector<std::pair<uint32_t, uint32_t>> machineCode;
-    std::vector<ParsedInstruction> parseInstructions;
+    MemoryImage image;
 
-    inline bool generateIType(const std::string& opcode, const std::vector<std::string>& operands, uint32_t currentAddress);
-    inline bool generateUType(const std::string& opcode, const std::vector<std::string>& operands, uint32_t currentAddress);
+    inline uint32_t generateRType(const InstructionDescriptor& descriptor, const ParsedInstruction& inst) const;
+    inline uint32_t generateR4Type(const InstructionDescriptor& descriptor, const ParsedInstruction& inst) const;
+    inline uint32_t generateIType(const InstructionDescriptor& descriptor, const ParsedInstruction& inst) const;
+    inline uint32_t generateSType(const InstructionDescriptor& descriptor, const ParsedInstruction& inst) const;
+    inline uint32_t generateSBType(const InstructionDescriptor& descriptor, const ParsedInstruction& inst) const;
+    inline uint32_t generateUType(const InstructionDescriptor& descriptor, const ParsedInstruction& inst) const;
+    inline uint32_t generateUJType(const InstructionDescriptor& descriptor, const ParsedInstruction& inst) const;
+    inline uint32_t generateVType(const InstructionDescriptor& descriptor, const ParsedInstruction& inst) const;
 
-    inline uint32_t generateRType(const std::string& opcode, const std::vector<std::string>& operands);
-    inline uint32_t generateSType(const std::string& opcode, const std::vector<std::string>& operands);
-    inline uint32_t generateSBType(const std::string& opcode, const std::vector<std::string>& operands, uint32_t currentAddress);
-    inline uint32_t generateUJType(const std::string& opcode, const std::vector<std::string>& operands, uint32_t currentAddress);
-    inline uint32_t calculateRelativeOffset(uint32_t currentAddress, uint32_t targetAddress) const;
+    inline int32_t registerOperand(const ParsedInstruction& inst, size_t index) const;
+    inline int32_t valueOperand(const ParsedInstruction& inst, size_t index) const;
     
-    inline void reportError(const std::string& message) const;
+    inline void reportError(const std::string& message, int lineNumber = 0) const;
     inline void processTextSegment();
     inline void processDataSegment();
 };
 
 inline bool Assembler::assemble() {
-    machineCode.clear();
+    image.clear();
     processTextSegment();
     processDataSegment();
+    image.finalize();
     return errorCount == 0;
 }
 
 inline void Assembler::processTextSegment() {
-    uint32_t currentAddress = TEXT_SEGMENT_START;
+    if (parseInstructions == nullptr) return;
+    for (const auto &inst : *parseInstructions) {
+        image.appendText(inst.address, encode(inst));
+    }
+}
 
-    for (const auto &inst : parseInstructions) {
-        if (RTypeInstructions::getEncoding().opcodeMap.count(inst.opcode)) {
-            machineCode.push_back({currentAddress, generateRType(inst.opcode, inst.operands)});
-        }
-        else if (ITypeInstructions::getEncoding().opcodeMap.count(inst.opcode)) {
-            generateIType(inst.opcode, inst.operands, currentAddress);
-        }
-        else if (STypeInstructions::getEncoding().opcodeMap.count(inst.opcode)) {
-            machineCode.push_back({currentAddress, generateSType(inst.opcode, inst.operands)});
-        }
-        else if (SBTypeInstructions::getEncoding().opcodeMap.count(inst.opcode)) {
-            machineCode.push_back({currentAddress, generateSBType(inst.opcode, inst.operands, currentAddress)});
-        }
-        else if (UTypeInstructions::getEncoding().opcodeMap.count(inst.opcode)) {
-            generateUType(inst.opcode, inst.operands, currentAddress);
-        }
-        else if (UJTypeInstructions::getEncoding().opcodeMap.count(inst.opcode)) {
-            machineCode.push_back({currentAddress, generateUJType(inst.opcode, inst.operands, currentAddress)});
-        }
-        else {
-            reportError("Unknown instruction type for opcode: " + inst.opcode);
-            continue;
-        }
-        currentAddress += 4;
+inline uint32_t Assembler::encode(const ParsedInstruction &inst) const {
+    if (inst.instruction == Instructions::INVALID) {
+        reportError("Unknown instruction type", inst.lineNumber);
+    }
+    const InstructionDescriptor& descriptor = describe(inst.instruction);
+    uint32_t word = 0;
+    switch (descriptor.format) {
+        case InstructionType::R: word = generateRType(descriptor, inst); break;
+        case InstructionType::R4: word = generateR4Type(descriptor, inst); break;
+        case InstructionType::I: word = generateIType(descriptor, inst); break;
+        case InstructionType::S: word = generateSType(descriptor, inst); break;
+        case InstructionType::SB: word = generateSBType(descriptor, inst); break;
+        case InstructionType::U: word = generateUType(descriptor, inst); break;
+        case InstructionType::UJ: word = generateUJType(descriptor, inst); break;
+        case InstructionType::V: word = generateVType(descriptor, inst); break;
+    }
+    if (descriptor.hasRounding()) {
+        word |= static_cast<uint32_t>(inst.roundingMode) << 12;
     }
+    if (!inst.compressed) return word;
+
+    const uint16_t parcel = compressInstruction(word);
+    if (parcel == 0) {
+        reportError("Operands of '" + std::string(descriptor.mnemonic) + "' do not fit a compressed form", inst.lineNumber);
+    }
+    return parcel;
 }
 
 inline void Assembler::processDataSegment() {
-    for (const auto &pair : symTable) {
-        const auto &entry = pair.second;
-        if (entry.address >= DATA_SEGMENT_START) {
-            uint32_t addr = entry.address;
-
-            if (entry.isString) {
-                for (size_t i = 0; i < entry.stringValue.length(); i++) {
-                    machineCode.push_back({addr + i, static_cast<uint8_t>(entry.stringValue[i])});
-                }
-                if (entry.stringValue.empty() || entry.stringValue.back() != '\0') {
-                    machineCode.push_back({addr + entry.stringValue.length(), 0});
-                }
-            }
-            else {
-                for (const auto &value : entry.numericValues) {
-                    const auto directiveSize = getDirectiveSize(entry.directive);
-                    if (directiveSize == 1) {
-                        machineCode.push_back({addr, value & 0xFF});
-                        addr += 1;
-                    } else if (directiveSize == 2) {
-                        machineCode.push_back({addr, value & 0xFF});
-                        machineCode.push_back({addr + 1, (value >> 8) & 0xFF});
-                        addr += 2;
-                    } else if (directiveSize == 4) {
-                        machineCode.push_back({addr, value & 0xFF});
-                        machineCode.push_back({addr + 1, (value >> 8) & 0xFF});
-                        machineCode.push_back({addr + 2, (value >> 16) & 0xFF});
-                        machineCode.push_back({addr + 3, (value >> 24) & 0xFF});
-                        addr += 4;
-                    } else if (directiveSize == 8) {
-                        machineCode.push_back({addr, value & 0xFF});
-                        machineCode.push_back({addr + 1, (value >> 8) & 0xFF});
-                        machineCode.push_back({addr + 2, (value >> 16) & 0xFF});
-                        machineCode.push_back({addr + 3, (value >> 24) & 0xFF});
-                        machineCode.push_back({addr + 4, (value >> 32) & 0xFF});
-                        machineCode.push_back({addr + 5, (value >> 40) & 0xFF});
-                        machineCode.push_back({addr + 6, (value >> 48) & 0xFF});
-                        machineCode.push_back({addr + 7, (value >> 56) & 0xFF});
-                        addr += 8;
-                    }
-                }
-            }
+    if (symbols == nullptr) return;
+
+    std::vector<const Symbol*> entries;
+    for (SymbolId id = 0; id < symbols->size(); ++id) {
+        const Symbol &symbol = (*symbols)[id];
+        if (symbol.kind == SymbolKind::DATA && symbol.address >= DATA_SEGMENT_START) {
+            entries.push_back(&symbol);
         }
     }
-    std::sort(machineCode.begin(), machineCode.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    std::stable_sort(entries.begin(), entries.end(), [](const Symbol *a, const Symbol *b) { return a->address < b->address; });
+
+    for (const Symbol *entry : entries) {
+        if (entry->payloadSize == 0) continue;
+        const uint8_t* payload = symbols->payload(*entry);
+        std::vector<uint8_t> &bytes = image.dataAt(entry->address);
+        bytes.insert(bytes.end(), payload, payload + entry->payloadSize);
+    }
 }
 
-inline uint32_t Assembler::generateRType(const std::string &opcode, const std::vector<std::string> &operands) {
-    const auto& encoding = RTypeInstructions::getEncoding();
-    uint32_t opcodeVal = encoding.opcodeMap.at(opcode);
-    uint32_t funct3 = encoding.func3Map.at(opcode);
-    uint32_t funct7 = encoding.func7Map.at(opcode);
-    
-    int32_t rd = getRegisterNumber(operands[0]);
-    int32_t rs1 = getRegisterNumber(operands[1]);
-    int32_t rs2 = getRegisterNumber(operands[2]);
+inline int32_t Assembler::registerOperand(const ParsedInstruction &inst, size_t index) const {
+    if (index >= inst.size() || !inst[index].isRegister()) {
+        return -1;
+    }
+    return inst[index].reg;
+}
+
+inline int32_t Assembler::valueOperand(const ParsedInstruction &inst, size_t index) const {
+    if (index >= inst.size() || !inst[index].hasValue()) {
+        reportError("Expected an immediate or label operand", inst.lineNumber);
+    }
+    if (!inst[index].resolved) {
+        reportError("Undefined label '" + std::string(inst[index].symbol) + "'", inst.lineNumber);
+    }
+    return inst[index].value;
+}
+
+inline uint32_t Assembler::generateRType(const InstructionDescriptor &descriptor, const ParsedInstruction &inst) const {
+    int32_t rd = registerOperand(inst, 0);
+    int32_t rs1 = registerOperand(inst, 1);
+    // Unary forms (fsqrt.s, fcvt.*) keep a fixed selector in rs2 as part of the match.
+    int32_t rs2 = descriptor.operands == OperandFormat::REG_REG ? 0 : registerOperand(inst, 2);
     
     if (rd < 0 || rs1 < 0 || rs2 < 0 || rd > 31 || rs1 > 31 || rs2 > 31) {
-        throw std::runtime_error(std::string(RED) + "Invalid register in R-type instruction" + RESET);
+        reportError("Invalid register in R-type instruction", inst.lineNumber);
     }
     
-    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcodeVal;
+    return encodeInstruction(descriptor, rd, rs1, rs2, 0);
 }
 
-inline bool Assembler::generateIType(const std::string &opcode, const std::vector<std::string> &operands, uint32_t currentAddress) {
-    if (operands.size() != 3) {
-        throw std::runtime_error(std::string(RED) + "I-type instruction requires 3 operands" + RESET);
+inline uint32_t Assembler::generateR4Type(const InstructionDescriptor &descriptor, const ParsedInstruction &inst) const {
+    int32_t rd = registerOperand(inst, 0);
+    int32_t rs1 = registerOperand(inst, 1);
+    int32_t rs2 = registerOperand(inst, 2);
+    int32_t rs3 = registerOperand(inst, 3);
+
+    if (rd < 0 || rs1 < 0 || rs2 < 0 || rs3 < 0 || rd > 31 || rs1 > 31 || rs2 > 31 || rs3 > 31) {
+        reportError("Invalid register in R4-type instruction", inst.lineNumber);
+    }
+
+    return encodeInstruction(descriptor, rd, rs1, rs2, 0, rs3);
+}
+
+inline uint32_t Assembler::generateIType(const InstructionDescriptor &descriptor, const ParsedInstruction &inst) const {
+    if (inst.size() != 3) {
+        reportError("I-type instruction requires 3 operands", inst.lineNumber);
     }
     
-    const auto& encoding = ITypeInstructions::getEncoding();
-    uint32_t opcodeVal = encoding.opcodeMap.at(opcode);
-    uint32_t funct3 = encoding.func3Map.at(opcode);
-    
-    int32_t rd = getRegisterNumber(operands[0]);
+    int32_t rd = registerOperand(inst, 0);
     int32_t rs1;
     int32_t imm;
     
-    if (opcode == "lb" || opcode == "lh" || opcode == "lw" || opcode == "lbu" || opcode == "lhu" || opcode == "ld") {
-        std::string offset, baseReg;
-        if (isMemory(operands[1], offset, baseReg)) {
-            rs1 = getRegisterNumber(baseReg);
-            imm = parseImmediate(offset);
-        }
-        else {
-            imm = parseImmediate(operands[1]);
-            rs1 = getRegisterNumber(operands[2]);
-        }
+    if (descriptor.operands == OperandFormat::REG_MEM || descriptor.operands == OperandFormat::CSR) {
+        imm = valueOperand(inst, 1);
+        rs1 = registerOperand(inst, 2);
+    }
+    else if (descriptor.operands == OperandFormat::CSR_IMM) {
+        imm = valueOperand(inst, 1);
+        rs1 = valueOperand(inst, 2);
     }
     else {
-        rs1 = getRegisterNumber(operands[1]);
-        imm = parseImmediate(operands[2]);
+        rs1 = registerOperand(inst, 1);
+        imm = valueOperand(inst, 2);
     }
     
     if (rd < 0 || rs1 < 0) {
-        throw std::runtime_error(std::string(RED) + "Invalid register in I-type instruction" + RESET);
+        reportError("Invalid register in I-type instruction", inst.lineNumber);
     }
     
-    if ((opcode == "slli" || opcode == "srli" || opcode == "srai") && (imm < 0 || imm > 31)) {
-        throw std::runtime_error(std::string(RED) + "Shift amount must be between 0 and 31" + RESET);
+    if (imm < descriptor.immMin || imm > descriptor.immMax) {
+        reportError("Immediate value out of range for I-type instruction (" + std::to_string(descriptor.immMin) + " to " + std::to_string(descriptor.immMax) + ")", inst.lineNumber);
     }
     
-    if (imm < -2048 || imm > 2047) {
-        throw std::runtime_error(std::string(RED) + "Immediate value out of range for I-type instruction (-2048 to 2047)" + RESET);
-    }
-    
-    uint32_t funct7 = (opcode == "srai") ? 0b0100000 : 0;
-    if (encoding.func7Map.count(opcode)) {
-        funct7 = encoding.func7Map.at(opcode);
-    }
-    
-    uint32_t instruction = (funct7 << 25) | ((imm & 0xFFF) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcodeVal;
-    machineCode.push_back({currentAddress, instruction});
-    return true;
+    return encodeInstruction(descriptor, rd, rs1, 0, imm);
 }
 
-inline uint32_t Assembler::generateSType(const std::string &opcode, const std::vector<std::string> &operands) {
-    const auto& encoding = STypeInstructions::getEncoding();
-    uint32_t opcodeVal = encoding.opcodeMap.at(opcode);
-    uint32_t funct3 = encoding.func3Map.at(opcode);
-    
-    int32_t rs2 = getRegisterNumber(operands[0]);
-    int32_t rs1, imm;
-    
-    if (operands.size() == 2) {
-        std::string offset, reg;
-        if (!isMemory(operands[1], offset, reg)) {
-            throw std::runtime_error(std::string(RED) + "Invalid memory operand format" + RESET);
-        }
-        imm = parseImmediate(offset);
-        rs1 = getRegisterNumber(reg);
-    }
-    else if (operands.size() == 3) {
-        imm = parseImmediate(operands[1]);
-        rs1 = getRegisterNumber(operands[2]);
-    }
-    else {
-        throw std::runtime_error(std::string(RED) + "Invalid number of operands for S-type instruction" + RESET);
+inline uint32_t Assembler::generateSType(const InstructionDescriptor &descriptor, const ParsedInstruction &inst) const {
+    if (inst.size() != 3) {
+        reportError("Invalid number of operands for S-type instruction", inst.lineNumber);
     }
+
+    int32_t rs2 = registerOperand(inst, 0);
+    int32_t imm = valueOperand(inst, 1);
+    int32_t rs1 = registerOperand(inst, 2);
     
-    if (rs1 < 0 || rs2 < 0 || rs1 > 31 || rs2 > 31 || imm < -2048 || imm > 2047) {
-        throw std::runtime_error(std::string(RED) + "Invalid parameter in S-type instruction" + RESET);
+    if (rs1 < 0 || rs2 < 0 || rs1 > 31 || rs2 > 31 || imm < descriptor.immMin || imm > descriptor.immMax) {
+        reportError("Invalid parameter in S-type instruction", inst.lineNumber);
     }
     
-    uint32_t imm_11_5 = ((imm >> 5) & 0x7F) << 25;
-    uint32_t imm_4_0 = (imm & 0x1F) << 7;
-    
-    return imm_11_5 | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | imm_4_0 | opcodeVal;
+    return encodeInstruction(descriptor, 0, rs1, rs2, imm);
 }
 
-inline uint32_t Assembler::generateSBType(const std::string &opcode, const std::vector<std::string> &operands, uint32_t currentAddress) {
-    const auto& encoding = SBTypeInstructions::getEncoding();
-    uint32_t opcodeVal = encoding.opcodeMap.at(opcode);
-    uint32_t funct3 = encoding.func3Map.at(opcode);
+inline uint32_t Assembler::generateSBType(const InstructionDescriptor &descriptor, const ParsedInstruction &inst) const {
+    int32_t rs1 = registerOperand(inst, 0);
+    int32_t rs2 = registerOperand(inst, 1);
+    int32_t offset = valueOperand(inst, 2);
     
-    int32_t rs1 = getRegisterNumber(operands[0]);
-    int32_t rs2 = getRegisterNumber(operands[1]);
-    int32_t offset = (operands[2].find("0x") == 0 || operands[2].find("0b") == 0 ||
-                    std::all_of(operands[2].begin(), operands[2].end(), ::isdigit) ||
-                    operands[2][0] == '-')
-                        ? parseImmediate(operands[2])
-                        : calculateRelativeOffset(currentAddress, std::stoul(operands[2], nullptr, 0));
-    
-    if (rs1 < 0 || rs2 < 0 || rs1 > 31 || rs2 > 31 || offset < -4096 || offset > 4095 || offset & 1) {
-        throw std::runtime_error(std::string(RED) + "Invalid parameter in SB-type instruction" + RESET);
+    if (rs1 < 0 || rs2 < 0 || rs1 > 31 || rs2 > 31 || offset < descriptor.immMin || offset > descriptor.immMax || offset & 1) {
+        reportError("Invalid parameter in SB-type instruction", inst.lineNumber);
     }
     
-    return ((offset < 0 ? 1 : (offset >> 12) & 0x1) << 31) | ((offset >> 11 & 0x1) << 7) | 
-           ((offset >> 5 & 0x3F) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | 
-           ((offset >> 1 & 0xF) << 8) | opcodeVal;
+    return encodeInstruction(descriptor, 0, rs1, rs2, offset);
 }
 
-inline bool Assembler::generateUType(const std::string &opcode, const std::vector<std::string> &operands, uint32_t currentAddress) {
-    if (operands.size() != 2) {
-        throw std::runtime_error(std::string(RED) + "U-type instruction requires 2 operands" + RESET);
+inline uint32_t Assembler::generateUType(const InstructionDescriptor &descriptor, const ParsedInstruction &inst) const {
+    if (inst.size() != 2) {
+        reportError("U-type instruction requires 2 operands", inst.lineNumber);
     }
     
-    const auto& encoding = UTypeInstructions::getEncoding();
-    uint32_t opcodeVal = encoding.opcodeMap.at(opcode);
-    
-    int32_t rd = getRegisterNumber(operands[0]);
-    int32_t imm = parseImmediate(operands[1]);
+    int32_t rd = registerOperand(inst, 0);
+    int32_t imm = valueOperand(inst, 1);
     
-    if (rd < 0 || imm < 0 || imm > 0xFFFFF) {
-        throw std::runtime_error(std::string(RED) + "Invalid parameter in U-type instruction" + RESET);
+    if (rd < 0 || imm < descriptor.immMin || imm > descriptor.immMax) {
+        reportError("Invalid parameter in U-type instruction", inst.lineNumber);
     }
     
-    uint32_t instruction = ((imm & 0xFFFFF) << 12) | (rd << 7) | opcodeVal;
-    machineCode.push_back({currentAddress, instruction});
-    return true;
+    return encodeInstruction(descriptor, rd, 0, 0, imm);
 }
 
-inline uint32_t Assembler::generateUJType(const std::string &opcode, const std::vector<std::string> &operands, uint32_t currentAddress) {
-    const auto& encoding = UJTypeInstructions::getEncoding();
-    uint32_t opcodeVal = encoding.opcodeMap.at(opcode);
+inline uint32_t Assembler::generateUJType(const InstructionDescriptor &descriptor, const ParsedInstruction &inst) const {
+    int32_t rd = registerOperand(inst, 0);
+    int32_t offset = valueOperand(inst, 1);
     
-    int32_t rd = getRegisterNumber(operands[0]);
-    int32_t offset = (operands[1].find("0x") == 0 || operands[1].find("0b") == 0 ||
-                    std::all_of(operands[1].begin(), operands[1].end(), ::isdigit) ||
-                    operands[1][0] == '-')
-                        ? parseImmediate(operands[1])
-                        : calculateRelativeOffset(currentAddress, std::stoul(operands[1], nullptr, 0));
-    
-    if (rd < 0 || rd > 31 || offset < -1048576 || offset > 1048575 || offset & 1) {
-        throw std::runtime_error(std::string(RED) + "Invalid parameter in UJ-type instruction" + RESET);
+    if (rd < 0 || rd > 31 || offset < descriptor.immMin || offset > descriptor.immMax || offset & 1) {
+        reportError("Invalid parameter in UJ-type instruction", inst.lineNumber);
     }
     
-    return (((offset >> 20) & 0x1) << 31) | (((offset >> 1) & 0x3FF) << 21) | (((offset >> 11) & 0x1) << 20) |
-           (((offset >> 12) & 0xFF) << 12) | (rd << 7) | opcodeVal;
+    return encodeInstruction(descriptor, rd, 0, 0, offset);
 }
 
-inline void Assembler::reportError(const std::string &message) const {
-    throw std::runtime_error(std::string(RED) + "Assembler Error: " + message + RESET);
-    ++errorCount;
+// V operands are stored by field (rd, rs1, rs2, vm); rs1 and rs2 may hold an
+// immediate or a vtype instead of a register.
+inline uint32_t Assembler::generateVType(const InstructionDescriptor &descriptor, const ParsedInstruction &inst) const {
+    if (inst.size() != 4) {
+        reportError("V-type instruction requires 4 operands", inst.lineNumber);
+    }
+    auto field = [&](size_t index) {
+        return inst[index].isRegister() ? static_cast<uint32_t>(inst[index].reg) : static_cast<uint32_t>(valueOperand(inst, index));
+    };
+    const uint32_t rd = field(0), rs1 = field(1), rs2 = field(2), vm = field(3);
+
+    if (rd > 31 || rs2 > static_cast<uint32_t>(std::max(descriptor.immMax, 31)) || vm > 1) {
+        reportError("Invalid parameter in V-type instruction", inst.lineNumber);
+    }
+
+    return encodeInstruction(descriptor, rd, rs1, rs2, static_cast<int32_t>(vm));
 }
 
-inline uint32_t Assembler::calculateRelativeOffset(uint32_t currentAddress, uint32_t targetAddress) const {
-    int32_t offset = static_cast<int32_t>(targetAddress - currentAddress);
-    if (currentAddress == 0 || targetAddress == 0 || offset < -4096 || offset > 4095) {
-        throw std::runtime_error(std::string(RED) + "Invalid offset calculation" + RESET);
+inline void Assembler::reportError(const std::string &message, int lineNumber) const {
+    if (lineNumber > 0) {
+        throw std::runtime_error(std::string(RED) + "Assembler Error on Line " + std::to_string(lineNumber) + ": " + message + RESET);
     }
-    return offset;
+    throw std::runtime_error(std::string(RED) + "Assembler Error: " + message + RESET);
+    ++errorCount;
 }
 
-#endif
\ No newline at end of file
+#endif
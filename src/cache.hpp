@@ -0,0 +1,238 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+#include "hash.hpp"
+#include "source.hpp"
+#include "image.hpp"
+#include "execution.hpp"
+
+using namespace riscv;
+
+// Bump whenever encoding, layout or predecode output changes so stale cache
+// entries (in memory or on disk) stop matching.
+inline constexpr uint32_t ASSEMBLER_VERSION = 7;
+
+struct LoadedProgram {
+    MemoryImage image;
+    TextMap textMap;
+    std::vector<ImageSymbol> symbols;
+
+    static inline std::shared_ptr<const LoadedProgram> predecode(MemoryImage image);
+    static inline std::shared_ptr<const LoadedProgram> predecode(ProgramImage image);
+
+    static std::shared_ptr<const LoadedProgram> empty() {
+        static const std::shared_ptr<const LoadedProgram> program = std::make_shared<LoadedProgram>();
+        return program;
+    }
+};
+
+// Executable segments of an ELF file may carry constants between functions,
+// so words that do not decode are kept with a placeholder disassembly and only
+// fault if they are actually fetched. Compressed instructions are expanded
+// here, so the pipeline only ever sees base instructions.
+inline std::shared_ptr<const LoadedProgram> LoadedProgram::predecode(MemoryImage image) {
+    auto program = std::make_shared<LoadedProgram>();
+    for (const TextSection &section : image.text) {
+        uint32_t address = section.base;
+        for (uint32_t value : section.words) {
+            std::string disassembly;
+            try {
+                disassembly = parseInstructions(value);
+            } catch (const std::exception &) {
+                disassembly = "UNKNOWN";
+            }
+            const uint32_t length = encodedLength(value);
+            const uint32_t word = length == INSTRUCTION_SIZE ? value : expandCompressed(static_cast<uint16_t>(value));
+            program->textMap.insert_or_assign(program->textMap.end(), address, TextEntry{word, length, std::move(disassembly)});
+            address += length;
+        }
+    }
+    program->image = std::move(image);
+    return program;
+}
+
+inline std::shared_ptr<const LoadedProgram> LoadedProgram::predecode(ProgramImage image) {
+    auto program = std::const_pointer_cast<LoadedProgram>(predecode(std::move(image.memory)));
+    program->symbols = std::move(image.symbols);
+    return program;
+}
+
+struct ProgramKey {
+    uint64_t low;
+    uint64_t high;
+
+    bool operator==(const ProgramKey &other) const { return low == other.low && high == other.high; }
+
+    static ProgramKey of(std::string_view source) {
+        uint64_t version = (static_cast<uint64_t>(ASSEMBLER_VERSION) << 32) | IMAGE_VERSION;
+        // Registered custom instructions change what a source assembles to.
+        for (const InstructionDescriptor &descriptor : customInstructionTable()) {
+            version = mixHash64(version ^ hashBytes64(descriptor.mnemonic, (static_cast<uint64_t>(descriptor.mask) << 32) | descriptor.match) ^
+                                static_cast<uint64_t>(descriptor.operands));
+        }
+        return {hashBytes64(source, version), hashBytes64(source, ~version)};
+    }
+
+    std::string toHex() const {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string text(32, '0');
+        for (int i = 0; i < 16; ++i) {
+            text[15 - i] = digits[(high >> (i * 4)) & 0xF];
+            text[31 - i] = digits[(low >> (i * 4)) & 0xF];
+        }
+        return text;
+    }
+};
+
+struct ProgramKeyHash {
+    size_t operator()(const ProgramKey &key) const { return static_cast<size_t>(key.low ^ (key.high * 0x9E3779B97F4A7C15ull)); }
+};
+
+class ProgramCache {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 16;
+
+    explicit ProgramCache(size_t capacity = DEFAULT_CAPACITY) : capacity(capacity), hits(0), misses(0) {}
+
+    static ProgramCache& shared() {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    inline std::shared_ptr<const LoadedProgram> find(const ProgramKey &key);
+    inline void insert(const ProgramKey &key, std::shared_ptr<const LoadedProgram> program);
+
+    inline void setCapacity(size_t limit);
+    inline void setDirectory(std::string path);
+    inline void clear();
+
+    inline size_t size() const { std::lock_guard<std::mutex> lock(mutex); return entries.size(); }
+    inline size_t getHits() const { return hits; }
+    inline size_t getMisses() const { return misses; }
+
+private:
+    using Entry = std::pair<ProgramKey, std::shared_ptr<const LoadedProgram>>;
+
+    mutable std::mutex mutex;
+    std::list<Entry> entries;
+    std::unordered_map<ProgramKey, std::list<Entry>::iterator, ProgramKeyHash> index;
+    std::string directory;
+    size_t capacity;
+    size_t hits;
+    size_t misses;
+
+    inline void remember(const ProgramKey &key, std::shared_ptr<const LoadedProgram> program);
+    inline std::string pathOf(const ProgramKey &key) const { return directory + "/" + key.toHex() + ".rvi"; }
+};
+
+inline std::shared_ptr<const LoadedProgram> ProgramCache::find(const ProgramKey &key) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.splice(entries.begin(), entries, it->second);
+            ++hits;
+            return it->second->second;
+        }
+        if (directory.empty()) {
+            ++misses;
+            return nullptr;
+        }
+        path = pathOf(key);
+    }
+
+    std::shared_ptr<const LoadedProgram> program;
+    try {
+        if (std::ifstream(path).good()) {
+            program = LoadedProgram::predecode(loadProgramImage(SourceBuffer::fromFile(path)->view()));
+        }
+    } catch (const std::exception &) {
+        program = nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (program == nullptr) {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    remember(key, program);
+    return program;
+}
+
+inline void ProgramCache::insert(const ProgramKey &key, std::shared_ptr<const LoadedProgram> program) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        remember(key, program);
+        if (directory.empty()) return;
+        path = pathOf(key);
+    }
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        if (!file.is_open()) return;
+        ProgramImage image;
+        image.memory = program->image;
+        image.symbols = program->symbols;
+        writeProgramImage(file, image);
+        if (!file.good()) return;
+    }
+    std::rename(temporary.c_str(), path.c_str());
+}
+
+inline void ProgramCache::remember(const ProgramKey &key, std::shared_ptr<const LoadedProgram> program) {
+    if (capacity == 0) return;
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it->second->second = std::move(program);
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    entries.emplace_front(key, std::move(program));
+    index.emplace(key, entries.begin());
+    while (entries.size() > capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+inline void ProgramCache::setCapacity(size_t limit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = limit;
+    while (entries.size() > capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+inline void ProgramCache::setDirectory(std::string path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (path.size() > 1 && path.back() == '/') path.pop_back();
+    directory = std::move(path);
+}
+
+inline void ProgramCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+    hits = 0;
+    misses = 0;
+}
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef COMPRESSED_HPP
+#define COMPRESSED_HPP
+
+#include <cstdint>
+#include <string_view>
+#include "types.hpp"
+
+namespace riscv {
+    // RV32C with the single-precision (RV32FC) loads and stores. Every compressed instruction is
+    // an alias of one base instruction: expandCompressed gives that word and
+    // compressInstruction the parcel for a word, or 0 when none exists (0 is
+    // the defined illegal parcel, so it never stands for an instruction).
+    namespace rvc {
+        inline constexpr uint32_t bits(uint32_t value, int high, int low) {
+            return (value >> low) & ((1u << (high - low + 1)) - 1);
+        }
+
+        inline constexpr int32_t signExtend(uint32_t value, int width) {
+            const uint32_t sign = 1u << (width - 1);
+            return static_cast<int32_t>((value ^ sign) - sign);
+        }
+
+        inline constexpr bool isPrime(uint32_t reg) { return reg >= 8 && reg <= 15; }
+        inline constexpr bool fitsSigned(int32_t value, int width) { return value >= -(1 << (width - 1)) && value < (1 << (width - 1)); }
+
+        inline constexpr uint32_t jumpOffset(uint32_t parcel) {
+            return bits(parcel, 12, 12) << 11 | bits(parcel, 11, 11) << 4 | bits(parcel, 10, 9) << 8 | bits(parcel, 8, 8) << 10 |
+                   bits(parcel, 7, 7) << 6 | bits(parcel, 6, 6) << 7 | bits(parcel, 5, 3) << 1 | bits(parcel, 2, 2) << 5;
+        }
+
+        inline constexpr uint32_t packJumpOffset(uint32_t offset) {
+            return bits(offset, 11, 11) << 12 | bits(offset, 4, 4) << 11 | bits(offset, 9, 8) << 9 | bits(offset, 10, 10) << 8 |
+                   bits(offset, 6, 6) << 7 | bits(offset, 7, 7) << 6 | bits(offset, 3, 1) << 3 | bits(offset, 5, 5) << 2;
+        }
+
+        inline constexpr uint32_t branchOffset(uint32_t parcel) {
+            return bits(parcel, 12, 12) << 8 | bits(parcel, 11, 10) << 3 | bits(parcel, 6, 5) << 6 | bits(parcel, 4, 3) << 1 | bits(parcel, 2, 2) << 5;
+        }
+
+        inline constexpr uint32_t packBranchOffset(uint32_t offset) {
+            return bits(offset, 8, 8) << 12 | bits(offset, 4, 3) << 10 | bits(offset, 7, 6) << 5 | bits(offset, 2, 1) << 3 | bits(offset, 5, 5) << 2;
+        }
+
+        inline constexpr uint32_t wordOffset(uint32_t parcel) {
+            return bits(parcel, 12, 10) << 3 | bits(parcel, 6, 6) << 2 | bits(parcel, 5, 5) << 6;
+        }
+
+        inline constexpr uint32_t packWordOffset(uint32_t offset) {
+            return bits(offset, 5, 3) << 10 | bits(offset, 2, 2) << 6 | bits(offset, 6, 6) << 5;
+        }
+
+        inline constexpr uint32_t encode(Instructions instruction, uint32_t rd, uint32_t rs1, uint32_t rs2, int32_t imm) {
+            return encodeInstruction(describe(instruction), rd, rs1, rs2, imm);
+        }
+
+        inline constexpr uint32_t ciImmediate(uint32_t parcel) { return bits(parcel, 12, 12) << 5 | bits(parcel, 6, 2); }
+        inline constexpr uint32_t packCi(uint32_t imm) { return bits(imm, 5, 5) << 12 | bits(imm, 4, 0) << 2; }
+    }
+
+    inline constexpr uint32_t expandCompressed(uint16_t parcel) {
+        using namespace rvc;
+        const uint32_t p = parcel;
+        const uint32_t funct3 = bits(p, 15, 13);
+        const uint32_t rd = bits(p, 11, 7);
+        const uint32_t rs2 = bits(p, 6, 2);
+        const uint32_t rdPrime = bits(p, 4, 2) + 8;
+        const uint32_t rs1Prime = bits(p, 9, 7) + 8;
+        const int32_t ci = signExtend(ciImmediate(p), 6);
+
+        switch (bits(p, 1, 0)) {
+            case 0b00:
+                if (funct3 == 0b000) {
+                    const uint32_t imm = bits(p, 12, 11) << 4 | bits(p, 10, 7) << 6 | bits(p, 6, 6) << 2 | bits(p, 5, 5) << 3;
+                    return imm == 0 ? 0 : encode(Instructions::ADDI, rdPrime, 2, 0, static_cast<int32_t>(imm));
+                }
+                if (funct3 == 0b010) return encode(Instructions::LW, rdPrime, rs1Prime, 0, static_cast<int32_t>(wordOffset(p)));
+                if (funct3 == 0b011) return encode(Instructions::FLW, rdPrime, rs1Prime, 0, static_cast<int32_t>(wordOffset(p)));
+                if (funct3 == 0b110) return encode(Instructions::SW, 0, rs1Prime, rdPrime, static_cast<int32_t>(wordOffset(p)));
+                if (funct3 == 0b111) return encode(Instructions::FSW, 0, rs1Prime, rdPrime, static_cast<int32_t>(wordOffset(p)));
+                return 0;
+            case 0b01:
+                switch (funct3) {
+                    case 0b000: return encode(Instructions::ADDI, rd, rd, 0, ci);
+                    case 0b001: return encode(Instructions::JAL, 1, 0, 0, signExtend(jumpOffset(p), 12));
+                    case 0b010: return encode(Instructions::ADDI, rd, 0, 0, ci);
+                    case 0b011:
+                        if (rd == 2) {
+                            const uint32_t imm = bits(p, 12, 12) << 9 | bits(p, 6, 6) << 4 | bits(p, 5, 5) << 6 | bits(p, 4, 3) << 7 | bits(p, 2, 2) << 5;
+                            return imm == 0 ? 0 : encode(Instructions::ADDI, 2, 2, 0, signExtend(imm, 10));
+                        }
+                        return (rd == 0 || ci == 0) ? 0 : encode(Instructions::LUI, rd, 0, 0, ci & 0xFFFFF);
+                    case 0b100: {
+                        const uint32_t rdp = rs1Prime;
+                        switch (bits(p, 11, 10)) {
+                            case 0b00: return bits(p, 12, 12) ? 0 : encode(Instructions::SRLI, rdp, rdp, 0, static_cast<int32_t>(rs2));
+                            case 0b01: return bits(p, 12, 12) ? 0 : encode(Instructions::SRAI, rdp, rdp, 0, static_cast<int32_t>(rs2));
+                            case 0b10: return encode(Instructions::ANDI, rdp, rdp, 0, ci);
+                            default: {
+                                if (bits(p, 12, 12)) return 0;
+                                constexpr Instructions ops[] = {Instructions::SUB, Instructions::XOR, Instructions::OR, Instructions::AND};
+                                return encode(ops[bits(p, 6, 5)], rdp, rdp, rdPrime, 0);
+                            }
+                        }
+                    }
+                    case 0b101: return encode(Instructions::JAL, 0, 0, 0, signExtend(jumpOffset(p), 12));
+                    case 0b110: return encode(Instructions::BEQ, 0, rs1Prime, 0, signExtend(branchOffset(p), 9));
+                    default: return encode(Instructions::BNE, 0, rs1Prime, 0, signExtend(branchOffset(p), 9));
+                }
+            case 0b10:
+                switch (funct3) {
+                    case 0b000: return bits(p, 12, 12) ? 0 : encode(Instructions::SLLI, rd, rd, 0, static_cast<int32_t>(rs2));
+                    case 0b010: {
+                        const uint32_t imm = bits(p, 12, 12) << 5 | bits(p, 6, 4) << 2 | bits(p, 3, 2) << 6;
+                        return rd == 0 ? 0 : encode(Instructions::LW, rd, 2, 0, static_cast<int32_t>(imm));
+                    }
+                    case 0b011: {
+                        const uint32_t imm = bits(p, 12, 12) << 5 | bits(p, 6, 4) << 2 | bits(p, 3, 2) << 6;
+                        return encode(Instructions::FLW, rd, 2, 0, static_cast<int32_t>(imm));
+                    }
+                    case 0b100:
+                        if (!bits(p, 12, 12)) {
+                            if (rs2 == 0) return rd == 0 ? 0 : encode(Instructions::JALR, 0, rd, 0, 0);
+                            return encode(Instructions::ADD, rd, 0, rs2, 0);
+                        }
+                        if (rs2 == 0) return rd == 0 ? describe(Instructions::EBREAK).match : encode(Instructions::JALR, 1, rd, 0, 0);
+                        return encode(Instructions::ADD, rd, rd, rs2, 0);
+                    case 0b110: {
+                        const uint32_t imm = bits(p, 12, 9) << 2 | bits(p, 8, 7) << 6;
+                        return encode(Instructions::SW, 0, 2, rs2, static_cast<int32_t>(imm));
+                    }
+                    case 0b111: {
+                        const uint32_t imm = bits(p, 12, 9) << 2 | bits(p, 8, 7) << 6;
+                        return encode(Instructions::FSW, 0, 2, rs2, static_cast<int32_t>(imm));
+                    }
+                    default: return 0;
+                }
+            default:
+                return 0;
+        }
+    }
+
+    inline constexpr uint16_t compressInstruction(uint32_t word) {
+        using namespace rvc;
+        const Instructions instruction = decodeInstructionWord(word);
+        if (instruction == Instructions::INVALID) return 0;
+        const InstructionDescriptor &descriptor = describe(instruction);
+        const uint32_t rd = bits(word, 11, 7);
+        const uint32_t rs1 = bits(word, 19, 15);
+        const uint32_t rs2 = bits(word, 24, 20);
+        const int32_t imm = decodeImmediate(descriptor.format, word);
+        const uint32_t u = static_cast<uint32_t>(imm);
+        uint32_t parcel = 0;
+
+        switch (instruction) {
+            case Instructions::ADDI:
+                if (rd == 0 && rs1 == 0 && imm == 0) parcel = 0x0001;
+                else if (rd != 0 && rd == rs1 && imm != 0 && fitsSigned(imm, 6)) parcel = 0b000u << 13 | packCi(u) | rd << 7 | 0b01;
+                else if (rd == 2 && rs1 == 2 && imm != 0 && (imm & 0xF) == 0 && fitsSigned(imm, 10))
+                    parcel = 0b011u << 13 | bits(u, 9, 9) << 12 | 2u << 7 | bits(u, 4, 4) << 6 | bits(u, 6, 6) << 5 | bits(u, 8, 7) << 3 | bits(u, 5, 5) << 2 | 0b01;
+                else if (rd != 0 && rs1 == 0 && fitsSigned(imm, 6)) parcel = 0b010u << 13 | packCi(u) | rd << 7 | 0b01;
+                else if (rs1 == 2 && isPrime(rd) && imm > 0 && imm < 1024 && (imm & 3) == 0)
+                    parcel = bits(u, 5, 4) << 11 | bits(u, 9, 6) << 7 | bits(u, 2, 2) << 6 | bits(u, 3, 3) << 5 | (rd - 8) << 2;
+                else if (rd != 0 && rs1 != 0 && imm == 0) parcel = 0b100u << 13 | rd << 7 | rs1 << 2 | 0b10;
+                break;
+            case Instructions::ADD:
+                if (rd != 0 && rs1 == 0 && rs2 != 0) parcel = 0b100u << 13 | rd << 7 | rs2 << 2 | 0b10;
+                else if (rd != 0 && rd == rs1 && rs2 != 0) parcel = 0b100u << 13 | 1u << 12 | rd << 7 | rs2 << 2 | 0b10;
+                break;
+            case Instructions::SUB:
+            case Instructions::XOR:
+            case Instructions::OR:
+            case Instructions::AND: {
+                const uint32_t op = instruction == Instructions::SUB ? 0 : instruction == Instructions::XOR ? 1 : instruction == Instructions::OR ? 2 : 3;
+                if (rd == rs1 && isPrime(rd) && isPrime(rs2)) parcel = 0b100011u << 10 | (rd - 8) << 7 | op << 5 | (rs2 - 8) << 2 | 0b01;
+                break;
+            }
+            case Instructions::ANDI:
+                if (rd == rs1 && isPrime(rd) && fitsSigned(imm, 6)) parcel = 0b100u << 13 | packCi(u) | 0b10u << 10 | (rd - 8) << 7 | 0b01;
+                break;
+            case Instructions::SLLI:
+                if (rd != 0 && rd == rs1 && bits(u, 4, 0) != 0) parcel = bits(u, 4, 0) << 2 | rd << 7 | 0b10;
+                break;
+            case Instructions::SRLI:
+            case Instructions::SRAI:
+                if (rd == rs1 && isPrime(rd) && bits(u, 4, 0) != 0)
+                    parcel = 0b100u << 13 | (instruction == Instructions::SRAI ? 0b01u : 0b00u) << 10 | (rd - 8) << 7 | bits(u, 4, 0) << 2 | 0b01;
+                break;
+            case Instructions::LUI: {
+                const uint32_t field = bits(word, 31, 12);
+                const int32_t upper = signExtend(field, 20);
+                if (rd != 0 && rd != 2 && upper != 0 && fitsSigned(upper, 6)) parcel = 0b011u << 13 | packCi(field) | rd << 7 | 0b01;
+                break;
+            }
+            case Instructions::LW:
+                if (rs1 == 2 && rd != 0 && imm >= 0 && imm < 256 && (imm & 3) == 0)
+                    parcel = 0b010u << 13 | bits(u, 5, 5) << 12 | rd << 7 | bits(u, 4, 2) << 4 | bits(u, 7, 6) << 2 | 0b10;
+                else if (isPrime(rd) && isPrime(rs1) && imm >= 0 && imm < 128 && (imm & 3) == 0)
+                    parcel = 0b010u << 13 | packWordOffset(u) | (rs1 - 8) << 7 | (rd - 8) << 2;
+                break;
+            case Instructions::SW:
+                if (rs1 == 2 && imm >= 0 && imm < 256 && (imm & 3) == 0)
+                    parcel = 0b110u << 13 | bits(u, 5, 2) << 9 | bits(u, 7, 6) << 7 | rs2 << 2 | 0b10;
+                else if (isPrime(rs2) && isPrime(rs1) && imm >= 0 && imm < 128 && (imm & 3) == 0)
+                    parcel = 0b110u << 13 | packWordOffset(u) | (rs1 - 8) << 7 | (rs2 - 8) << 2;
+                break;
+            case Instructions::FLW:
+                if (rs1 == 2 && imm >= 0 && imm < 256 && (imm & 3) == 0)
+                    parcel = 0b011u << 13 | bits(u, 5, 5) << 12 | rd << 7 | bits(u, 4, 2) << 4 | bits(u, 7, 6) << 2 | 0b10;
+                else if (isPrime(rd) && isPrime(rs1) && imm >= 0 && imm < 128 && (imm & 3) == 0)
+                    parcel = 0b011u << 13 | packWordOffset(u) | (rs1 - 8) << 7 | (rd - 8) << 2;
+                break;
+            case Instructions::FSW:
+                if (rs1 == 2 && imm >= 0 && imm < 256 && (imm & 3) == 0)
+                    parcel = 0b111u << 13 | bits(u, 5, 2) << 9 | bits(u, 7, 6) << 7 | rs2 << 2 | 0b10;
+                else if (isPrime(rs2) && isPrime(rs1) && imm >= 0 && imm < 128 && (imm & 3) == 0)
+                    parcel = 0b111u << 13 | packWordOffset(u) | (rs1 - 8) << 7 | (rs2 - 8) << 2;
+                break;
+            case Instructions::JALR:
+                if (rs1 != 0 && imm == 0 && rd <= 1) parcel = 0b100u << 13 | rd << 12 | rs1 << 7 | 0b10;
+                break;
+            case Instructions::EBREAK:
+                parcel = 0x9002;
+                break;
+            case Instructions::JAL:
+                if (rd <= 1 && fitsSigned(imm, 12)) parcel = (rd == 1 ? 0b001u : 0b101u) << 13 | packJumpOffset(u) | 0b01;
+                break;
+            case Instructions::BEQ:
+            case Instructions::BNE:
+                if (rs2 == 0 && isPrime(rs1) && fitsSigned(imm, 9))
+                    parcel = (instruction == Instructions::BEQ ? 0b110u : 0b111u) << 13 | packBranchOffset(u) | (rs1 - 8) << 7 | 0b01;
+                break;
+            default:
+                break;
+        }
+        return static_cast<uint16_t>(parcel);
+    }
+
+    // The name of the compressed form a parcel is written with, or an empty
+    // view for an illegal or reserved parcel.
+    inline constexpr std::string_view compressedMnemonic(uint16_t parcel) {
+        using namespace rvc;
+        if (expandCompressed(parcel) == 0) return {};
+        const uint32_t p = parcel;
+        const uint32_t rd = bits(p, 11, 7);
+        const uint32_t rs2 = bits(p, 6, 2);
+        switch (bits(p, 1, 0) << 3 | bits(p, 15, 13)) {
+            case 0b00000: return "c.addi4spn";
+            case 0b00010: return "c.lw";
+            case 0b00011: return "c.flw";
+            case 0b00110: return "c.sw";
+            case 0b00111: return "c.fsw";
+            case 0b01000: return rd == 0 ? "c.nop" : "c.addi";
+            case 0b01001: return "c.jal";
+            case 0b01010: return "c.li";
+            case 0b01011: return rd == 2 ? "c.addi16sp" : "c.lui";
+            case 0b01100: {
+                constexpr std::string_view arithmetic[] = {"c.sub", "c.xor", "c.or", "c.and"};
+                switch (bits(p, 11, 10)) {
+                    case 0b00: return "c.srli";
+                    case 0b01: return "c.srai";
+                    case 0b10: return "c.andi";
+                    default: return arithmetic[bits(p, 6, 5)];
+                }
+            }
+            case 0b01101: return "c.j";
+            case 0b01110: return "c.beqz";
+            case 0b01111: return "c.bnez";
+            case 0b10000: return "c.slli";
+            case 0b10010: return "c.lwsp";
+            case 0b10011: return "c.flwsp";
+            case 0b10100:
+                if (!bits(p, 12, 12)) return rs2 == 0 ? "c.jr" : "c.mv";
+                return rs2 != 0 ? "c.add" : rd == 0 ? "c.ebreak" : "c.jalr";
+            case 0b10110: return "c.swsp";
+            case 0b10111: return "c.fswsp";
+            default: return {};
+        }
+    }
+}
+
+#endif
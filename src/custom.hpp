@@ -0,0 +1,213 @@
+#ifndef CUSTOM_HPP
+#define CUSTOM_HPP
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+
+// Instructions added at start-up in the custom-0..custom-3 major opcodes. A
+// registration carries everything the tools need: mnemonic and operand
+// format for the lexer, parser and assembler, the encoding for the decoder
+// and disassembler, a semantic function for EXECUTE, and a latency,
+// pipelining flag and functional-unit class for the timing model. Registered
+// instructions are numbered after Instructions::INVALID and described through
+// customInstructionTable(), so the switches over built-in instructions never
+// see them.
+//
+//     static const riscv::custom::Registration mac16({
+//         "mac16", riscv::OperandFormat::REG_REG_REG_REG, riscv::custom::Space::CUSTOM_0, 0b000, 0,
+//         [](const riscv::custom::Operands &in) { return in.rs3 + int16_t(in.rs1) * int16_t(in.rs2); },
+//         3, true, "dsp"});
+namespace riscv::custom {
+    enum class Space : uint8_t { CUSTOM_0, CUSTOM_1, CUSTOM_2, CUSTOM_3 };
+
+    inline constexpr uint8_t opcodes[] = {0b0001011, 0b0101011, 0b1011011, 0b1111011};
+
+    // Source values for a semantic function. Fields the operand format does
+    // not have are zero; imm is the sign-extended I immediate.
+    struct Operands {
+        uint32_t rs1;
+        uint32_t rs2;
+        uint32_t rs3;
+        int32_t imm;
+    };
+
+    using Semantics = std::function<uint32_t(const Operands &)>;
+
+    // operands is REG_REG_REG (rd, rs1, rs2), REG_REG_REG_REG (rd, rs1, rs2,
+    // rs3), REG_REG_IMM (rd, rs1, imm) or REG_REG (rd, rs1). funct7 selects
+    // within the opcode and funct3 for the register forms; the four-register
+    // form only has room for its low two bits. Instructions naming the same
+    // unit share one functional unit.
+    struct Definition {
+        std::string mnemonic;
+        OperandFormat operands = OperandFormat::REG_REG_REG;
+        Space space = Space::CUSTOM_0;
+        uint8_t funct3 = 0;
+        uint8_t funct7 = 0;
+        Semantics semantics;
+        uint32_t latency = 1;
+        bool pipelined = true;
+        std::string unit = "custom";
+    };
+
+    struct Entry {
+        Definition definition;
+        size_t unit;
+    };
+
+    class Registry {
+    public:
+        static Registry &shared() {
+            static Registry registry;
+            return registry;
+        }
+
+        inline Instructions add(Definition definition);
+
+        const Entry &at(Instructions instruction) const { return entries[customIndexOf(instruction)]; }
+        size_t size() const { return entries.size(); }
+        size_t unitCount() const { return units.size(); }
+        const std::string &unitName(size_t unit) const { return units[unit]; }
+
+    private:
+        std::deque<Entry> entries;
+        std::vector<std::string> units;
+
+        [[noreturn]] static void reportError(const std::string &mnemonic, const std::string &message) {
+            throw std::runtime_error(std::string(RED) + "Custom instruction '" + mnemonic + "': " + message + RESET);
+        }
+    };
+
+    inline Instructions Registry::add(Definition definition) {
+        const std::string &mnemonic = definition.mnemonic;
+        const bool wellFormed = !mnemonic.empty() && std::isalpha(static_cast<unsigned char>(mnemonic[0])) &&
+                                std::all_of(mnemonic.begin(), mnemonic.end(), [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '_'; });
+        if (!wellFormed) {
+            reportError(mnemonic, "mnemonic must start with a letter and use only letters, digits, '.' and '_'");
+        }
+        if (findKeyword(mnemonic) != nullptr || lookupCustomInstruction(mnemonic) != Instructions::INVALID) {
+            reportError(mnemonic, "mnemonic is already in use");
+        }
+        if (static_cast<size_t>(definition.space) > 3 || definition.funct3 > 0b111 || definition.funct7 > 0b1111111) {
+            reportError(mnemonic, "opcode space, funct3 or funct7 out of range");
+        }
+        if (!definition.semantics) {
+            reportError(mnemonic, "no semantic function given");
+        }
+        if (definition.latency == 0) {
+            reportError(mnemonic, "latency must be at least one cycle");
+        }
+
+        const uint8_t opcode = opcodes[static_cast<size_t>(definition.space)];
+        const uint32_t base = opcode | (uint32_t(definition.funct3) << 12);
+        const Instructions instruction = static_cast<Instructions>(static_cast<size_t>(Instructions::INVALID) + 1 + entries.size());
+        InstructionDescriptor descriptor{};
+        switch (definition.operands) {
+            case OperandFormat::REG_REG_REG:
+                descriptor = {instruction, {}, InstructionType::R, definition.operands, opcode, definition.funct3, definition.funct7, 0, 0, FLAG_NONE,
+                              base | (uint32_t(definition.funct7) << 25), 0xFE00707Fu};
+                break;
+            case OperandFormat::REG_REG:
+                descriptor = {instruction, {}, InstructionType::R, definition.operands, opcode, definition.funct3, definition.funct7, 0, 0, FLAG_NONE,
+                              base | (uint32_t(definition.funct7) << 25), 0xFFF0707Fu};
+                break;
+            case OperandFormat::REG_REG_REG_REG:
+                if (definition.funct7 > 0b11) reportError(mnemonic, "the four-register form only has a two-bit funct7");
+                descriptor = {instruction, {}, InstructionType::R4, definition.operands, opcode, definition.funct3, definition.funct7, 0, 0, FLAG_NONE,
+                              base | (uint32_t(definition.funct7) << 25), 0x0600707Fu};
+                break;
+            case OperandFormat::REG_REG_IMM:
+                descriptor = {instruction, {}, InstructionType::I, definition.operands, opcode, definition.funct3, 0, -2048, 2047, FLAG_NONE, base, 0x707Fu};
+                break;
+            default:
+                reportError(mnemonic, "unsupported operand format");
+        }
+        for (const InstructionDescriptor &other : customInstructionTable()) {
+            if (((descriptor.match ^ other.match) & descriptor.mask & other.mask) == 0) {
+                reportError(mnemonic, "encoding overlaps '" + std::string(other.mnemonic) + "'");
+            }
+        }
+
+        auto unit = std::find(units.begin(), units.end(), definition.unit);
+        if (unit == units.end()) unit = units.insert(units.end(), definition.unit);
+        const size_t unitIndex = static_cast<size_t>(unit - units.begin());
+
+        entries.push_back({std::move(definition), unitIndex});
+        descriptor.mnemonic = entries.back().definition.mnemonic;
+        customInstructionTable().push_back(descriptor);
+        return instruction;
+    }
+
+    // Registers a definition during static initialisation, before main runs.
+    struct Registration {
+        explicit Registration(Definition definition) : instruction(Registry::shared().add(std::move(definition))) {}
+        const Instructions instruction;
+    };
+
+    inline uint32_t execute(Instructions instruction, const Operands &operands) {
+        return Registry::shared().at(instruction).definition.semantics(operands);
+    }
+
+    // Each functional-unit class is a single unit. A pipelined unit takes a
+    // new instruction every cycle and a non-pipelined one only after the last
+    // result is out; either way the result is usable `latency` cycles after
+    // issue. A non-pipelined instruction holds EXECUTE until its result is
+    // out, like the FP units. A pipelined one leaves at once, and a later
+    // instruction that reads its result waits in EXECUTE until it is ready.
+    class Units {
+    public:
+        Units() { reset(); }
+
+        void reset() {
+            free.assign(Registry::shared().unitCount(), 0);
+            ready.fill(0);
+            complete = 0;
+        }
+
+        // Cycles the instruction holds EXECUTE beyond its first. Register 0
+        // in `sources` stands for an operand the instruction does not read.
+        uint32_t schedule(Instructions instruction, uint32_t rd, std::initializer_list<uint32_t> sources, uint32_t now, SimulationStats &stats) {
+            uint32_t start = now;
+            for (uint32_t source : sources) {
+                if (source != 0 && source < ready.size()) start = std::max(start, ready[source]);
+            }
+            if (!isCustomInstruction(instruction)) {
+                if (rd != 0 && rd < ready.size()) ready[rd] = 0;
+                stats.customStalls += start - now;
+                return start - now;
+            }
+
+            const Entry &entry = Registry::shared().at(instruction);
+            if (entry.unit >= free.size()) free.resize(entry.unit + 1, 0);
+            uint32_t &unitFree = free[entry.unit];
+            start = std::max(start, unitFree);
+            const uint32_t done = start + entry.definition.latency;
+            unitFree = entry.definition.pipelined ? start + 1 : done;
+            if (rd != 0 && rd < ready.size()) ready[rd] = done;
+            complete = std::max(complete, done - 1);
+
+            stats.customStalls += start - now;
+            return entry.definition.pipelined ? start - now : done - 1 - now;
+        }
+
+        // Cycles after `now` until the last custom result is written.
+        uint32_t drain(uint32_t now) const { return complete > now ? complete - now : 0; }
+
+    private:
+        std::vector<uint32_t> free;
+        std::array<uint32_t, REGISTER_FILE_SIZE> ready;
+        uint32_t complete;
+    };
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef ELF_HPP
+#define ELF_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+#include "symbols.hpp"
+#include "image.hpp"
+
+namespace riscv {
+    inline constexpr char ELF_MAGIC[4] = {'\x7F', 'E', 'L', 'F'};
+    inline constexpr uint32_t ELF_HEADER_SIZE = 52;
+    inline constexpr uint32_t ELF_PROGRAM_HEADER_SIZE = 32;
+    inline constexpr uint32_t ELF_SECTION_HEADER_SIZE = 40;
+    inline constexpr uint32_t ELF_SYMBOL_SIZE = 16;
+
+    inline constexpr uint8_t ELFCLASS32 = 1;
+    inline constexpr uint8_t ELFDATA2LSB = 1;
+    inline constexpr uint16_t ET_EXEC = 2;
+    inline constexpr uint16_t EM_RISCV = 243;
+
+    inline constexpr uint32_t PT_LOAD = 1;
+    inline constexpr uint32_t PT_DYNAMIC = 2;
+    inline constexpr uint32_t PT_INTERP = 3;
+    inline constexpr uint32_t PF_X = 1;
+    inline constexpr uint32_t PF_W = 2;
+
+    inline constexpr uint32_t SHT_SYMTAB = 2;
+    inline constexpr uint8_t STT_OBJECT = 1;
+    inline constexpr uint8_t STT_FUNC = 2;
+
+    inline constexpr uint32_t EF_RISCV_FLOAT_ABI = 0x6;
+    inline constexpr uint32_t EF_RISCV_FLOAT_ABI_SINGLE = 0x2;
+
+    inline bool isElfImage(std::string_view bytes) {
+        return bytes.size() >= sizeof(ELF_MAGIC) && std::memcmp(bytes.data(), ELF_MAGIC, sizeof(ELF_MAGIC)) == 0;
+    }
+
+    class ElfReader {
+    public:
+        explicit ElfReader(std::string_view bytes) : data(reinterpret_cast<const uint8_t*>(bytes.data())), size(bytes.size()) {}
+
+        const uint8_t* at(size_t offset, size_t length) const {
+            if (offset > size || length > size - offset) {
+                throw std::runtime_error(std::string(RED) + "ELF Error: Truncated file" + RESET);
+            }
+            return data + offset;
+        }
+
+        uint8_t read8(size_t offset) const { return *at(offset, 1); }
+
+        uint16_t read16(size_t offset) const {
+            const uint8_t* bytes = at(offset, 2);
+            return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+        }
+
+        uint32_t read32(size_t offset) const {
+            const uint8_t* bytes = at(offset, 4);
+            return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+                   (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+        }
+
+    private:
+        const uint8_t* data;
+        size_t size;
+    };
+
+    inline void importElfSymbols(const ElfReader &reader, ProgramImage &program, uint32_t sectionOffset, uint16_t sectionCount, uint16_t sectionSize) {
+        for (uint16_t i = 0; i < sectionCount; ++i) {
+            const size_t header = sectionOffset + static_cast<size_t>(i) * sectionSize;
+            if (reader.read32(header + 4) != SHT_SYMTAB) continue;
+
+            const uint32_t tableOffset = reader.read32(header + 16);
+            const uint32_t tableSize = reader.read32(header + 20);
+            const uint32_t link = reader.read32(header + 24);
+            if (link >= sectionCount) {
+                throw std::runtime_error(std::string(RED) + "ELF Error: Symbol table has no string table" + RESET);
+            }
+            const size_t stringHeader = sectionOffset + static_cast<size_t>(link) * sectionSize;
+            const uint32_t stringOffset = reader.read32(stringHeader + 16);
+            const uint32_t stringSize = reader.read32(stringHeader + 20);
+            const char* strings = reinterpret_cast<const char*>(reader.at(stringOffset, stringSize));
+
+            for (uint32_t entry = ELF_SYMBOL_SIZE; entry + ELF_SYMBOL_SIZE <= tableSize; entry += ELF_SYMBOL_SIZE) {
+                const size_t symbol = static_cast<size_t>(tableOffset) + entry;
+                const uint32_t name = reader.read32(symbol);
+                const uint8_t type = reader.read8(symbol + 12) & 0xF;
+                const uint16_t section = reader.read16(symbol + 14);
+                if ((type != STT_FUNC && type != STT_OBJECT) || section == 0 || name >= stringSize) continue;
+
+                const char* text = strings + name;
+                const size_t length = strnlen(text, stringSize - name);
+                program.symbols.push_back({std::string(text, length), reader.read32(symbol + 4), type == STT_FUNC ? SymbolKind::TEXT : SymbolKind::DATA});
+            }
+        }
+    }
+
+    // Maps every PT_LOAD segment of a statically linked RV32 executable.
+    // Executable segments become text sections for fetch and are also copied
+    // as data so loads from read-only data sharing the segment still work; the
+    // zero-filled tail of a segment is left to unmapped guest pages, which
+    // already read as zero. Writable segments, .bss included, accept stores
+    // wherever they are linked.
+    inline ProgramImage loadElf(std::string_view bytes) {
+        auto fail = [](const std::string &message) {
+            throw std::runtime_error(std::string(RED) + "ELF Error: " + message + RESET);
+        };
+
+        if (!isElfImage(bytes) || bytes.size() < ELF_HEADER_SIZE) fail("Missing ELF header");
+        const ElfReader reader(bytes);
+        if (reader.read8(4) != ELFCLASS32) fail("Only 32-bit executables are supported");
+        if (reader.read8(5) != ELFDATA2LSB) fail("Only little-endian executables are supported");
+        if (reader.read16(18) != EM_RISCV) fail("Not a RISC-V executable (e_machine " + std::to_string(reader.read16(18)) + ")");
+        if (reader.read16(16) != ET_EXEC) fail("Only statically linked executables are supported");
+
+        const uint32_t flags = reader.read32(36);
+        if ((flags & EF_RISCV_FLOAT_ABI) > EF_RISCV_FLOAT_ABI_SINGLE) fail("Only the soft-float and single-float ABIs are supported");
+
+        const uint32_t entry = reader.read32(24);
+        const uint32_t programOffset = reader.read32(28);
+        const uint32_t sectionOffset = reader.read32(32);
+        const uint16_t programSize = reader.read16(42);
+        const uint16_t programCount = reader.read16(44);
+        const uint16_t sectionSize = reader.read16(46);
+        const uint16_t sectionCount = reader.read16(48);
+        if (programCount > 0 && programSize < ELF_PROGRAM_HEADER_SIZE) fail("Invalid program header size");
+        if (sectionCount > 0 && sectionSize < ELF_SECTION_HEADER_SIZE) fail("Invalid section header size");
+        if (entry & 0x1) fail("Misaligned entry point");
+
+        ProgramImage program;
+        program.memory.entry = entry;
+        for (uint16_t i = 0; i < programCount; ++i) {
+            const size_t header = programOffset + static_cast<size_t>(i) * programSize;
+            const uint32_t type = reader.read32(header);
+            if (type == PT_DYNAMIC || type == PT_INTERP) fail("Dynamically linked executables are not supported");
+            if (type != PT_LOAD) continue;
+
+            const uint32_t offset = reader.read32(header + 4);
+            const uint32_t address = reader.read32(header + 8);
+            const uint32_t fileSize = reader.read32(header + 16);
+            const uint32_t memorySize = reader.read32(header + 20);
+            const uint32_t segmentFlags = reader.read32(header + 24);
+            if (fileSize > memorySize || memorySize > MEMORY_SIZE || address > MEMORY_SIZE - memorySize) {
+                fail("Segment " + std::to_string(i) + " lies outside guest memory");
+            }
+            if ((segmentFlags & PF_W) && memorySize > 0) program.memory.writable.push_back({address, address + memorySize});
+            if (fileSize == 0) continue;
+
+            const uint8_t* contents = reader.at(offset, fileSize);
+            program.memory.data.push_back({address, std::vector<uint8_t>(contents, contents + fileSize)});
+            if (segmentFlags & PF_X) {
+                if (address & 0x1) fail("Executable segment " + std::to_string(i) + " is not halfword aligned");
+                auto halfword = [&](uint32_t at) -> uint32_t {
+                    const uint32_t low = at < fileSize ? contents[at] : 0;
+                    const uint32_t high = at + 1 < fileSize ? contents[at + 1] : 0;
+                    return low | (high << 8);
+                };
+                TextSection section{address, {}};
+                uint32_t at = 0;
+                while (at < fileSize) {
+                    uint32_t value = halfword(at);
+                    if (!isCompressedParcel(value)) value |= halfword(at + 2) << 16;
+                    section.push(value);
+                    at += encodedLength(value);
+                }
+                program.memory.text.push_back(std::move(section));
+            }
+        }
+        if (program.memory.text.empty()) fail("No executable segment");
+
+        if (sectionCount > 0) {
+            importElfSymbols(reader, program, sectionOffset, sectionCount, sectionSize);
+        }
+        program.memory.finalize();
+        return program;
+    }
+}
+
+#endif
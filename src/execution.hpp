@@ -1,6 +1,8 @@
 #ifndef EXECUTION_HPP
 #define EXECUTION_HPP
 
+#include <algorithm>
+#include <array>
 #include <string>
 #include <map>
 #include <cstdint>
@@ -10,11 +12,31 @@
 #include <unordered_map>
 #include <iomanip>
 #include "types.hpp"
+#include "image.hpp"
+#include "compressed.hpp"
+#include "fpu.hpp"
+#include "vector.hpp"
+#include "custom.hpp"
 
 using namespace riscv;
 
-static inline void isValidMemory(uint32_t address) {
-    if(address < DATA_SEGMENT_START) {
+// Predecoded text: compressed instructions are stored expanded, with the
+// length they take in memory.
+struct TextEntry {
+    uint32_t word;
+    uint32_t length;
+    std::string disassembly;
+};
+
+using TextMap = std::map<uint32_t, TextEntry>;
+
+// ecall reads its call number from a7 like any other source register, so the
+// usual hazard checks and forwarding apply. Only exit is provided.
+inline constexpr uint32_t ECALL_NUMBER_REGISTER = 17;
+inline constexpr uint32_t ECALL_EXIT = 93;
+
+static inline void isValidMemory(const GuestMemory& memory, uint32_t address, uint32_t size) {
+    if(!memory.isWritable(address, size)) {
         std::stringstream ss;
         ss << "Memory access error: Address 0x" + std::to_string(address) + " is outside of valid memory range (0x" + std::to_string(DATA_SEGMENT_START) + " - 0x" + std::to_string(MEMORY_SIZE) + ")";
         throw std::runtime_error(std::string(RED) + ss.str() + RESET);
@@ -22,7 +44,7 @@ static inline void isValidMemory(uint32_t address) {
 }
 
 static inline void initialiseRegisters(uint32_t* registers) {
-    std::memset(registers, 0, 32 * sizeof(uint32_t));
+    std::memset(registers, 0, REGISTER_FILE_SIZE * sizeof(uint32_t));
     registers[2] = 0x7FFFFFDC;
     registers[3] = 0x10000000;
     registers[10] = 0x00000001;
@@ -39,58 +61,17 @@ inline bool isValidAddress(uint32_t addr, uint32_t size) {
 }
 
 inline InstructionType classifyInstructions(uint32_t instHex) {
-    uint32_t opcode = instHex & 0x7F;
-    uint32_t func3 = (instHex >> 12) & 0x7;
-    uint32_t func7 = (instHex >> 25) & 0x7F;
-    
-    auto rTypeEncoding = RTypeInstructions::getEncoding();
-    for (const auto &[name, op] : rTypeEncoding.opcodeMap) {
-        if (op == opcode && rTypeEncoding.func3Map.at(name) == func3 && rTypeEncoding.func7Map.at(name) == func7) {
-            return InstructionType::R;
-        }
-    }
-
-    auto iTypeEncoding = ITypeInstructions::getEncoding();
-    for (const auto &[name, op] : iTypeEncoding.opcodeMap) {
-        if (op == opcode && iTypeEncoding.func3Map.at(name) == func3) {
-            return InstructionType::I;
-        }
-    }
-
-    auto sTypeEncoding = STypeInstructions::getEncoding();
-    for (const auto &[name, op] : sTypeEncoding.opcodeMap) {
-        if (op == opcode && sTypeEncoding.func3Map.at(name) == func3) {
-            return InstructionType::S;
-        }
-    }
-
-    auto uTypeEncoding = UTypeInstructions::getEncoding();
-    for (const auto &[name, op] : uTypeEncoding.opcodeMap) {
-        if (op == opcode) {
-            return InstructionType::U;
-        }
-    }
-
-    auto sbTypeEncoding = SBTypeInstructions::getEncoding();
-    for (const auto &[name, op] : sbTypeEncoding.opcodeMap) {
-        if (op == opcode && sbTypeEncoding.func3Map.at(name) == func3) {
-            return InstructionType::SB;
-        }
-    }
-
-    auto ujTypeEncoding = UJTypeInstructions::getEncoding();
-    for (const auto &[name, op] : ujTypeEncoding.opcodeMap) {
-        if (op == opcode) {
-            return InstructionType::UJ;
-        }
+    const Instructions instruction = decodeInstructionWord(instHex);
+    if (instruction != Instructions::INVALID) {
+        return describe(instruction).format;
     }
 
     std::stringstream ss;
-    ss << "Instruction 0x" << std::hex << instHex << " could not be classified: Invalid opcode (0x" << opcode << ")";
+    ss << "Instruction 0x" << std::hex << instHex << " could not be classified: Invalid opcode (0x" << (instHex & 0x7F) << ")";
     throw std::runtime_error(std::string(RED) + ss.str() + RESET);
 }
 
-inline void fetchInstruction(InstructionNode* node, uint32_t& PC, bool& running, std::map<uint32_t, std::pair<uint32_t, std::string>>& textMap) {
+inline void fetchInstruction(InstructionNode* node, uint32_t& PC, bool& running, const TextMap& textMap) {
     if (!isValidAddress(PC, 4)) {
         std::ostringstream oss;
         oss << "Fetch error: Invalid PC address 0x" << std::hex << PC;
@@ -98,10 +79,11 @@ inline void fetchInstruction(InstructionNode* node, uint32_t& PC, bool& running,
     }
     auto it = textMap.find(PC);
     if (it != textMap.end()) {
-        node->instruction = it->second.first;
+        node->instruction = it->second.word;
+        node->length = it->second.length;
         node->instructionType = classifyInstructions(node->instruction);
         node->PC = PC;
-        PC += INSTRUCTION_SIZE;
+        PC += node->length;
     } else {
         node->instruction = 0;
         running = false;
@@ -120,6 +102,14 @@ inline void decodeInstruction(InstructionNode* node, InstructionRegisters& instr
             node->rs2 = (node->instruction >> 20) & 0x1F;
             node->func7 = (node->instruction >> 25) & 0x7F;
             break;
+
+        case InstructionType::R4:
+            node->rd = (node->instruction >> 7) & 0x1F;
+            node->func3 = (node->instruction >> 12) & 0x7;
+            node->rs1 = (node->instruction >> 15) & 0x1F;
+            node->rs2 = (node->instruction >> 20) & 0x1F;
+            node->rs3 = (node->instruction >> 27) & 0x1F;
+            break;
             
         case InstructionType::I:
             node->rd = (node->instruction >> 7) & 0x1F;
@@ -146,127 +136,126 @@ inline void decodeInstruction(InstructionNode* node, InstructionRegisters& instr
         case InstructionType::UJ:
             node->rd = (node->instruction >> 7) & 0x1F;
             break;
+
+        case InstructionType::V:
+            node->rd = (node->instruction >> 7) & 0x1F;
+            node->func3 = (node->instruction >> 12) & 0x7;
+            node->rs1 = (node->instruction >> 15) & 0x1F;
+            node->rs2 = (node->instruction >> 20) & 0x1F;
+            node->func7 = node->instruction >> 26;
+            break;
             
         default:
             ss << "Invalid instruction type in decodeInstruction";
             throw std::runtime_error(std::string(RED) + ss.str() + RESET);
     }
 
+    node->instructionName = decodeInstructionWord(node->instruction);
+    if (node->instructionName == Instructions::ECALL) {
+        node->rs1 = ECALL_NUMBER_REGISTER;
+    }
+
+    // F registers follow the x registers in the one file, so hazards and
+    // forwarding compare register numbers across both without special cases.
+    const InstructionDescriptor& descriptor = describe(node->instructionName);
+    if (descriptor.operands == OperandFormat::REG_REG) node->rs2 = 0;
+    if (descriptor.floatRegisters & FLOAT_RD) node->rd += FLOAT_REGISTER_BASE;
+    if (descriptor.floatRegisters & FLOAT_RS1) node->rs1 += FLOAT_REGISTER_BASE;
+    if (descriptor.floatRegisters & FLOAT_RS2) node->rs2 += FLOAT_REGISTER_BASE;
+    if (descriptor.floatRegisters & FLOAT_RS3) node->rs3 += FLOAT_REGISTER_BASE;
+    // Only the x-register fields of a V instruction take part in hazards;
+    // v registers are tracked by the vector pipeline.
+    if (descriptor.isVector()) {
+        if (!(descriptor.vectorRegisters & SCALAR_RD)) node->rd = 0;
+        if (!(descriptor.vectorRegisters & SCALAR_RS1)) node->rs1 = 0;
+        if (!(descriptor.vectorRegisters & SCALAR_RS2)) node->rs2 = 0;
+    }
+
     instructionRegisters.RA = (node->rs1 != UINT32_MAX) ? registers[node->rs1] : 0;
+    if (descriptor.operands == OperandFormat::CSR_IMM) {
+        instructionRegisters.RA = node->rs1;
+        node->rs1 = 0;
+    }
 
     switch (node->instructionType) {
-        case InstructionType::R: {
-            auto rTypeEncoding = RTypeInstructions::getEncoding();
-            for (const auto &[name, op] : rTypeEncoding.opcodeMap) {
-                if (op == node->opcode && rTypeEncoding.func3Map.at(name) == node->func3 && rTypeEncoding.func7Map.at(name) == node->func7) {
-                    node->instructionName = stringToInstruction.at(name);
-                    instructionRegisters.RB = registers[node->rs2];
-                    break;
-                }
-            }
-            break;
-        }
-        case InstructionType::I: {
-            auto iTypeEncoding = ITypeInstructions::getEncoding();
-            for (const auto &[name, op] : iTypeEncoding.opcodeMap) {
-                if (op == node->opcode && iTypeEncoding.func3Map.at(name) == node->func3) {
-                    node->instructionName = stringToInstruction.at(name);
-                    int32_t imm = (node->instruction >> 20) & 0xFFF;
-                    if (imm & 0x800) imm |= 0xFFFFF000;
-                    instructionRegisters.RB = imm;
-                    break;
-                }
-            }
-            break;
-        }
-        case InstructionType::S: {
-            auto sTypeEncoding = STypeInstructions::getEncoding();
-            for (const auto &[name, op] : sTypeEncoding.opcodeMap) {
-                if (op == node->opcode && sTypeEncoding.func3Map.at(name) == node->func3) {
-                    node->instructionName = stringToInstruction.at(name);
-                    int32_t imm = ((node->instruction >> 25) & 0x7F) << 5 | ((node->instruction >> 7) & 0x1F);
-                    if (imm & 0x800) imm |= 0xFFFFF000;
-                    instructionRegisters.RB = imm;
-                    break;
-                }
-            }
-            break;
-        }
-        case InstructionType::SB: {
-            auto sbTypeEncoding = SBTypeInstructions::getEncoding();
-            for (const auto &[name, op] : sbTypeEncoding.opcodeMap) {
-                if (op == node->opcode && sbTypeEncoding.func3Map.at(name) == node->func3) {
-                    node->instructionName = stringToInstruction.at(name);
-                    int32_t imm = ((node->instruction >> 31) & 0x1) << 12 | 
-                                  ((node->instruction >> 7) & 0x1) << 11 | 
-                                  ((node->instruction >> 25) & 0x3F) << 5 | 
-                                  ((node->instruction >> 8) & 0xF) << 1;
-                    if (imm & 0x1000) imm |= 0xFFFFE000;
-                    instructionRegisters.RB = imm;
-                    break;
-                }
-            }
-            break;
-        }
-        case InstructionType::U: {
-            auto uTypeEncoding = UTypeInstructions::getEncoding();
-            for (const auto &[name, op] : uTypeEncoding.opcodeMap) {
-                if (op == node->opcode) {
-                    node->instructionName = stringToInstruction.at(name);
-                    instructionRegisters.RB = node->instruction & 0xFFFFF000;
-                    break;
-                }
-            }
+        case InstructionType::R:
+        case InstructionType::R4:
+        case InstructionType::V:
+            instructionRegisters.RB = registers[node->rs2];
             break;
-        }
-        case InstructionType::UJ: {
-            auto ujTypeEncoding = UJTypeInstructions::getEncoding();
-            for (const auto &[name, op] : ujTypeEncoding.opcodeMap) {
-                if (op == node->opcode) {
-                    node->instructionName = stringToInstruction.at(name);
-                    int32_t imm = ((node->instruction >> 31) & 0x1) << 20 | 
-                                  ((node->instruction >> 12) & 0xFF) << 12 | 
-                                  ((node->instruction >> 20) & 0x1) << 11 | 
-                                  ((node->instruction >> 21) & 0x3FF) << 1;
-                    if (imm & 0x100000) imm |= 0xFFE00000;
-                    instructionRegisters.RB = imm;
-                    break;
-                }
-            }
+        case InstructionType::I:
+        case InstructionType::S:
+        case InstructionType::SB:
+        case InstructionType::U:
+        case InstructionType::UJ:
+            instructionRegisters.RB = decodeImmediate(node->instructionType, node->instruction);
             break;
-        }
         default:
             ss << "Invalid instruction type in decodeInstruction register setup";
             throw std::runtime_error(std::string(RED) + ss.str() + RESET);
     }
 
-    switch (node->instructionName) {
-        case Instructions::JAL:
-        case Instructions::JALR:
-            node->isJump = true;
-            break;
-        case Instructions::BNE:
-        case Instructions::BEQ:
-        case Instructions::BLT:
-        case Instructions::BGE:
-            node->isBranch = true;
-            break;
-        case Instructions::LB:
-        case Instructions::LH:
-        case Instructions::LW:
-            node->isLoad = true;
-            break;
-        case Instructions::SB:
-        case Instructions::SH:
-        case Instructions::SW:
-            node->isStore = true;
-            break;
+    node->isJump = descriptor.isJump();
+    node->isBranch = descriptor.isBranch();
+    node->isLoad = descriptor.isLoad();
+    node->isStore = descriptor.isStore();
+}
+
+inline bool readsRs2(const InstructionNode& node) {
+    return node.instructionType == InstructionType::R || node.instructionType == InstructionType::R4 ||
+           node.instructionType == InstructionType::S || node.instructionType == InstructionType::SB ||
+           node.instructionType == InstructionType::V;
+}
+
+inline bool readsRs3(const InstructionNode& node) {
+    return node.instructionType == InstructionType::R4;
+}
+
+// Cycles the instruction occupies EXECUTE. Floating-point loads and stores
+// only compute an address there.
+inline uint32_t executeLatency(Instructions instruction, const ExecuteLatencies& latencies) {
+    switch (instruction) {
+        case Instructions::MUL:
+        case Instructions::MULH:
+        case Instructions::MULHSU:
+        case Instructions::MULHU:
+            return latencies.integerMultiply;
+        case Instructions::DIV:
+        case Instructions::DIVU:
+        case Instructions::REM:
+        case Instructions::REMU:
+            return latencies.integerDivide;
         default:
             break;
     }
+    const InstructionDescriptor& descriptor = describe(instruction);
+    return descriptor.isMemory() ? 1 : latencies.of(descriptor.unit);
 }
 
-inline void executeInstruction(InstructionNode* node, InstructionRegisters& instructionRegisters, uint32_t* registers, uint32_t& PC, bool& taken, ForwardingStatus& forwardingStatus) {
+inline uint32_t readCsr(uint32_t csr, uint32_t fcsr) {
+    switch (csr) {
+        case CSR_FFLAGS: return fcsr & 0x1F;
+        case CSR_FRM: return (fcsr >> 5) & 0x7;
+        case CSR_FCSR: return fcsr & 0xFF;
+    }
+    std::stringstream ss;
+    ss << "Unsupported CSR 0x" << std::hex << csr;
+    throw std::runtime_error(std::string(RED) + ss.str() + RESET);
+}
+
+inline void writeCsr(uint32_t csr, uint32_t value, uint32_t& fcsr) {
+    switch (csr) {
+        case CSR_FFLAGS: fcsr = (fcsr & ~0x1Fu) | (value & 0x1F); break;
+        case CSR_FRM: fcsr = (fcsr & ~0xE0u) | ((value & 0x7) << 5); break;
+        case CSR_FCSR: fcsr = value & 0xFF; break;
+    }
+}
+
+inline bool haltsExecution(const InstructionNode* node) {
+    return node->instructionName == Instructions::ECALL || node->instructionName == Instructions::EBREAK;
+}
+
+inline void executeInstruction(InstructionNode* node, InstructionRegisters& instructionRegisters, uint32_t* registers, uint32_t& PC, bool& taken, ForwardingStatus& forwardingStatus, uint32_t& fcsr) {
     uint32_t result = 0;
     taken = false;
     std::stringstream ss;
@@ -275,6 +264,33 @@ inline void executeInstruction(InstructionNode* node, InstructionRegisters& inst
     if ((node->instructionType == InstructionType::S || node->instructionType == InstructionType::SB) && !forwardingStatus.rmForwarded) {
         instructionRegisters.RM = registers[node->rs2];
     }
+    if (node->instructionType == InstructionType::R4 && !forwardingStatus.rmForwarded) {
+        instructionRegisters.RM = registers[node->rs3];
+    }
+
+    if (isCustomInstruction(instr)) {
+        const OperandFormat operands = describe(instr).operands;
+        custom::Operands values = {instructionRegisters.RA, 0, 0, 0};
+        if (operands == OperandFormat::REG_REG_IMM) values.imm = static_cast<int32_t>(instructionRegisters.RB);
+        if (operands == OperandFormat::REG_REG_REG || operands == OperandFormat::REG_REG_REG_REG) values.rs2 = instructionRegisters.RB;
+        if (operands == OperandFormat::REG_REG_REG_REG) values.rs3 = instructionRegisters.RM;
+        instructionRegisters.RY = custom::execute(instr, values);
+        return;
+    }
+
+    uint8_t roundingMode = ROUND_DYNAMIC;
+    if (describe(instr).hasRounding()) {
+        roundingMode = node->func3 == ROUND_DYNAMIC ? (fcsr >> 5) & 0x7 : node->func3;
+        if (roundingMode > ROUND_NEAREST_MAX) {
+            ss << "Invalid rounding mode " << static_cast<uint32_t>(roundingMode) << " at PC 0x" << std::hex << node->PC;
+            throw std::runtime_error(std::string(RED) + ss.str() + RESET);
+        }
+    }
+    auto floatResult = [&](fpu::Result value) {
+        fcsr |= value.flags;
+        instructionRegisters.RY = value.bits;
+    };
+    const uint32_t RA = instructionRegisters.RA, RB = instructionRegisters.RB, RM = instructionRegisters.RM;
 
     switch (instr) {
         case Instructions::ADD:
@@ -289,20 +305,48 @@ inline void executeInstruction(InstructionNode* node, InstructionRegisters& inst
             result = instructionRegisters.RA * instructionRegisters.RB;
             instructionRegisters.RY = result;
             break;
+        case Instructions::MULH:
+            result = static_cast<uint32_t>((static_cast<int64_t>(static_cast<int32_t>(instructionRegisters.RA)) *
+                                            static_cast<int64_t>(static_cast<int32_t>(instructionRegisters.RB))) >> 32);
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::MULHSU:
+            result = static_cast<uint32_t>((static_cast<int64_t>(static_cast<int32_t>(instructionRegisters.RA)) *
+                                            static_cast<int64_t>(instructionRegisters.RB)) >> 32);
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::MULHU:
+            result = static_cast<uint32_t>((static_cast<uint64_t>(instructionRegisters.RA) * instructionRegisters.RB) >> 32);
+            instructionRegisters.RY = result;
+            break;
+        // Division never traps: by zero the quotient is all ones and the
+        // remainder the dividend, and INT32_MIN / -1 gives INT32_MIN rem 0.
         case Instructions::DIV:
             if (instructionRegisters.RB == 0) {
-                ss << "Division by zero at PC 0x" << std::hex << node->PC << "\n";
-                throw std::runtime_error(std::string(RED) + ss.str() + RESET);
+                result = UINT32_MAX;
+            } else if (instructionRegisters.RA == 0x80000000u && instructionRegisters.RB == UINT32_MAX) {
+                result = instructionRegisters.RA;
+            } else {
+                result = static_cast<uint32_t>(static_cast<int32_t>(instructionRegisters.RA) / static_cast<int32_t>(instructionRegisters.RB));
             }
-            result = static_cast<uint32_t>(static_cast<int32_t>(instructionRegisters.RA) / static_cast<int32_t>(instructionRegisters.RB));
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::DIVU:
+            result = instructionRegisters.RB == 0 ? UINT32_MAX : instructionRegisters.RA / instructionRegisters.RB;
             instructionRegisters.RY = result;
             break;
         case Instructions::REM:
             if (instructionRegisters.RB == 0) {
-                ss << "Remainder by zero at PC 0x" << std::hex << node->PC << "\n";
-                throw std::runtime_error(std::string(RED) + ss.str() + RESET);
+                result = instructionRegisters.RA;
+            } else if (instructionRegisters.RA == 0x80000000u && instructionRegisters.RB == UINT32_MAX) {
+                result = 0;
+            } else {
+                result = static_cast<uint32_t>(static_cast<int32_t>(instructionRegisters.RA) % static_cast<int32_t>(instructionRegisters.RB));
             }
-            result = static_cast<uint32_t>(static_cast<int32_t>(instructionRegisters.RA) % static_cast<int32_t>(instructionRegisters.RB));
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::REMU:
+            result = instructionRegisters.RB == 0 ? instructionRegisters.RA : instructionRegisters.RA % instructionRegisters.RB;
             instructionRegisters.RY = result;
             break;
         case Instructions::AND:
@@ -314,25 +358,141 @@ inline void executeInstruction(InstructionNode* node, InstructionRegisters& inst
             instructionRegisters.RY = result;
             break;
         case Instructions::XOR:
+        case Instructions::XORI:
             result = instructionRegisters.RA ^ instructionRegisters.RB;
             instructionRegisters.RY = result;
             break;
         case Instructions::SLL:
+        case Instructions::SLLI:
             result = instructionRegisters.RA << (instructionRegisters.RB & 0x1F);
             instructionRegisters.RY = result;
             break;
         case Instructions::SRL:
+        case Instructions::SRLI:
             result = instructionRegisters.RA >> (instructionRegisters.RB & 0x1F);
             instructionRegisters.RY = result;
             break;
         case Instructions::SRA:
+        case Instructions::SRAI:
             result = static_cast<uint32_t>(static_cast<int32_t>(instructionRegisters.RA) >> (instructionRegisters.RB & 0x1F));
             instructionRegisters.RY = result;
             break;
+        case Instructions::SH1ADD:
+            result = (instructionRegisters.RA << 1) + instructionRegisters.RB;
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::SH2ADD:
+            result = (instructionRegisters.RA << 2) + instructionRegisters.RB;
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::SH3ADD:
+            result = (instructionRegisters.RA << 3) + instructionRegisters.RB;
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::ANDN:
+            result = instructionRegisters.RA & ~instructionRegisters.RB;
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::ORN:
+            result = instructionRegisters.RA | ~instructionRegisters.RB;
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::XNOR:
+            result = ~(instructionRegisters.RA ^ instructionRegisters.RB);
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::CLZ:
+            result = instructionRegisters.RA == 0 ? 32 : __builtin_clz(instructionRegisters.RA);
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::CTZ:
+            result = instructionRegisters.RA == 0 ? 32 : __builtin_ctz(instructionRegisters.RA);
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::CPOP:
+            result = __builtin_popcount(instructionRegisters.RA);
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::MIN:
+            result = std::min(static_cast<int32_t>(instructionRegisters.RA), static_cast<int32_t>(instructionRegisters.RB));
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::MINU:
+            result = std::min(instructionRegisters.RA, instructionRegisters.RB);
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::MAX:
+            result = std::max(static_cast<int32_t>(instructionRegisters.RA), static_cast<int32_t>(instructionRegisters.RB));
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::MAXU:
+            result = std::max(instructionRegisters.RA, instructionRegisters.RB);
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::SEXT_B:
+            result = static_cast<uint32_t>(static_cast<int32_t>(static_cast<int8_t>(instructionRegisters.RA)));
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::SEXT_H:
+            result = static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(instructionRegisters.RA)));
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::ZEXT_H:
+            result = instructionRegisters.RA & 0xFFFF;
+            instructionRegisters.RY = result;
+            break;
+        // The shift amount is masked before the complementary shift so a
+        // rotate by zero never shifts by 32.
+        case Instructions::ROL:
+            result = (instructionRegisters.RA << (instructionRegisters.RB & 0x1F)) | (instructionRegisters.RA >> (-instructionRegisters.RB & 0x1F));
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::ROR:
+        case Instructions::RORI:
+            result = (instructionRegisters.RA >> (instructionRegisters.RB & 0x1F)) | (instructionRegisters.RA << (-instructionRegisters.RB & 0x1F));
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::REV8:
+            result = __builtin_bswap32(instructionRegisters.RA);
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::ORC_B:
+            result = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                if ((instructionRegisters.RA >> shift) & 0xFF) result |= 0xFFu << shift;
+            }
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::BCLR:
+        case Instructions::BCLRI:
+            result = instructionRegisters.RA & ~(1u << (instructionRegisters.RB & 0x1F));
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::BEXT:
+        case Instructions::BEXTI:
+            result = (instructionRegisters.RA >> (instructionRegisters.RB & 0x1F)) & 1;
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::BINV:
+        case Instructions::BINVI:
+            result = instructionRegisters.RA ^ (1u << (instructionRegisters.RB & 0x1F));
+            instructionRegisters.RY = result;
+            break;
+        case Instructions::BSET:
+        case Instructions::BSETI:
+            result = instructionRegisters.RA | (1u << (instructionRegisters.RB & 0x1F));
+            instructionRegisters.RY = result;
+            break;
         case Instructions::SLT:
+        case Instructions::SLTI:
             result = (static_cast<int32_t>(instructionRegisters.RA) < static_cast<int32_t>(instructionRegisters.RB)) ? 1 : 0;
             instructionRegisters.RY = result;
             break;
+        case Instructions::SLTU:
+        case Instructions::SLTIU:
+            result = (instructionRegisters.RA < instructionRegisters.RB) ? 1 : 0;
+            instructionRegisters.RY = result;
+            break;
         case Instructions::ADDI:
             result = instructionRegisters.RA + instructionRegisters.RB;
             instructionRegisters.RY = result;
@@ -348,11 +508,14 @@ inline void executeInstruction(InstructionNode* node, InstructionRegisters& inst
         case Instructions::LB:
         case Instructions::LH:
         case Instructions::LW:
+        case Instructions::LBU:
+        case Instructions::LHU:
+        case Instructions::FLW:
             result = instructionRegisters.RA + instructionRegisters.RB;
             instructionRegisters.RY = result;
             break;
         case Instructions::JALR:
-            result = node->PC + INSTRUCTION_SIZE;
+            result = node->PC + node->length;
             PC = (instructionRegisters.RA + instructionRegisters.RB) & ~1;
             instructionRegisters.RY = result;
             taken = true;
@@ -360,6 +523,7 @@ inline void executeInstruction(InstructionNode* node, InstructionRegisters& inst
         case Instructions::SB:
         case Instructions::SH:
         case Instructions::SW:
+        case Instructions::FSW:
             result = instructionRegisters.RA + instructionRegisters.RB;
             instructionRegisters.RY = result;
             break;
@@ -395,6 +559,31 @@ inline void executeInstruction(InstructionNode* node, InstructionRegisters& inst
                 instructionRegisters.RY = branchTaken;
             }
             break;
+        case Instructions::BLTU:
+            {
+                bool branchTaken = (instructionRegisters.RA < instructionRegisters.RM);
+                PC = branchTaken ? (node->PC + instructionRegisters.RB) : PC;
+                taken = branchTaken;
+                instructionRegisters.RY = branchTaken;
+            }
+            break;
+        case Instructions::BGEU:
+            {
+                bool branchTaken = (instructionRegisters.RA >= instructionRegisters.RM);
+                PC = branchTaken ? (node->PC + instructionRegisters.RB) : PC;
+                taken = branchTaken;
+                instructionRegisters.RY = branchTaken;
+            }
+            break;
+        case Instructions::ECALL:
+            if (instructionRegisters.RA != ECALL_EXIT) {
+                ss << "Unsupported environment call " << std::dec << instructionRegisters.RA << " in a7 at PC 0x" << std::hex << node->PC;
+                throw std::runtime_error(std::string(RED) + ss.str() + RESET);
+            }
+            break;
+        case Instructions::FENCE:
+        case Instructions::EBREAK:
+            break;
         case Instructions::LUI:
             result = instructionRegisters.RB;
             instructionRegisters.RY = result;
@@ -404,17 +593,330 @@ inline void executeInstruction(InstructionNode* node, InstructionRegisters& inst
             instructionRegisters.RY = result;
             break;
         case Instructions::JAL:
-            result = node->PC + INSTRUCTION_SIZE;
+            result = node->PC + node->length;
             PC = node->PC + instructionRegisters.RB;
             taken = true;
             instructionRegisters.RY = result;
             break;
+        case Instructions::CSRRW:
+        case Instructions::CSRRS:
+        case Instructions::CSRRC:
+        case Instructions::CSRRWI:
+        case Instructions::CSRRSI:
+        case Instructions::CSRRCI:
+            {
+                const uint32_t csr = RB & 0xFFF;
+                const uint32_t old = readCsr(csr, fcsr);
+                if (instr == Instructions::CSRRW || instr == Instructions::CSRRWI) {
+                    writeCsr(csr, RA, fcsr);
+                } else if (instr == Instructions::CSRRS || instr == Instructions::CSRRSI) {
+                    writeCsr(csr, old | RA, fcsr);
+                } else {
+                    writeCsr(csr, old & ~RA, fcsr);
+                }
+                instructionRegisters.RY = old;
+            }
+            break;
+        case Instructions::FADD_S: floatResult(fpu::add(RA, RB, roundingMode)); break;
+        case Instructions::FSUB_S: floatResult(fpu::subtract(RA, RB, roundingMode)); break;
+        case Instructions::FMUL_S: floatResult(fpu::multiply(RA, RB, roundingMode)); break;
+        case Instructions::FDIV_S: floatResult(fpu::divide(RA, RB, roundingMode)); break;
+        case Instructions::FSQRT_S: floatResult(fpu::squareRoot(RA, roundingMode)); break;
+        case Instructions::FMADD_S: floatResult(fpu::fusedMultiplyAdd(RA, RB, RM, false, false, roundingMode)); break;
+        case Instructions::FMSUB_S: floatResult(fpu::fusedMultiplyAdd(RA, RB, RM, false, true, roundingMode)); break;
+        case Instructions::FNMSUB_S: floatResult(fpu::fusedMultiplyAdd(RA, RB, RM, true, false, roundingMode)); break;
+        case Instructions::FNMADD_S: floatResult(fpu::fusedMultiplyAdd(RA, RB, RM, true, true, roundingMode)); break;
+        case Instructions::FSGNJ_S: instructionRegisters.RY = (RA & ~fpu::SIGN_BIT) | (RB & fpu::SIGN_BIT); break;
+        case Instructions::FSGNJN_S: instructionRegisters.RY = (RA & ~fpu::SIGN_BIT) | (~RB & fpu::SIGN_BIT); break;
+        case Instructions::FSGNJX_S: instructionRegisters.RY = RA ^ (RB & fpu::SIGN_BIT); break;
+        case Instructions::FMIN_S: floatResult(fpu::minimumOrMaximum(RA, RB, false)); break;
+        case Instructions::FMAX_S: floatResult(fpu::minimumOrMaximum(RA, RB, true)); break;
+        case Instructions::FCVT_W_S: floatResult(fpu::toInteger(RA, false, roundingMode)); break;
+        case Instructions::FCVT_WU_S: floatResult(fpu::toInteger(RA, true, roundingMode)); break;
+        case Instructions::FCVT_S_W: floatResult(fpu::fromInteger(RA, false, roundingMode)); break;
+        case Instructions::FCVT_S_WU: floatResult(fpu::fromInteger(RA, true, roundingMode)); break;
+        case Instructions::FEQ_S: floatResult(fpu::compareEqual(RA, RB)); break;
+        case Instructions::FLT_S: floatResult(fpu::compareLess(RA, RB, false)); break;
+        case Instructions::FLE_S: floatResult(fpu::compareLess(RA, RB, true)); break;
+        case Instructions::FCLASS_S: instructionRegisters.RY = fpu::classify(RA); break;
+        case Instructions::FMV_X_W:
+        case Instructions::FMV_W_X:
+            instructionRegisters.RY = RA;
+            break;
         default:
             break;
     }
 }
 
-inline void memoryAccess(InstructionNode* node, InstructionRegisters& instructionRegisters, uint32_t* registers, std::unordered_map<uint32_t, uint8_t>& dataMap) {
+inline vector::Operation vectorOperationOf(Instructions instruction) {
+    using vector::Operation;
+    switch (instruction) {
+        case Instructions::VADD_VV: case Instructions::VADD_VX: case Instructions::VADD_VI: case Instructions::VREDSUM_VS: return Operation::ADD;
+        case Instructions::VSUB_VV: case Instructions::VSUB_VX: return Operation::SUB;
+        case Instructions::VRSUB_VX: case Instructions::VRSUB_VI: return Operation::RSUB;
+        case Instructions::VMINU_VV: case Instructions::VMINU_VX: case Instructions::VREDMINU_VS: return Operation::MINU;
+        case Instructions::VMIN_VV: case Instructions::VMIN_VX: case Instructions::VREDMIN_VS: return Operation::MIN;
+        case Instructions::VMAXU_VV: case Instructions::VMAXU_VX: case Instructions::VREDMAXU_VS: return Operation::MAXU;
+        case Instructions::VMAX_VV: case Instructions::VMAX_VX: case Instructions::VREDMAX_VS: return Operation::MAX;
+        case Instructions::VAND_VV: case Instructions::VAND_VX: case Instructions::VAND_VI: case Instructions::VREDAND_VS: return Operation::AND;
+        case Instructions::VOR_VV: case Instructions::VOR_VX: case Instructions::VOR_VI: case Instructions::VREDOR_VS: return Operation::OR;
+        case Instructions::VXOR_VV: case Instructions::VXOR_VX: case Instructions::VXOR_VI: case Instructions::VREDXOR_VS: return Operation::XOR;
+        case Instructions::VSLL_VV: case Instructions::VSLL_VX: case Instructions::VSLL_VI: return Operation::SLL;
+        case Instructions::VSRL_VV: case Instructions::VSRL_VX: case Instructions::VSRL_VI: return Operation::SRL;
+        case Instructions::VSRA_VV: case Instructions::VSRA_VX: case Instructions::VSRA_VI: return Operation::SRA;
+        case Instructions::VMUL_VV: case Instructions::VMUL_VX: case Instructions::VMACC_VV: case Instructions::VMACC_VX: return Operation::MUL;
+        case Instructions::VMULH_VV: case Instructions::VMULH_VX: return Operation::MULH;
+        case Instructions::VMULHU_VV: case Instructions::VMULHU_VX: return Operation::MULHU;
+        case Instructions::VMSEQ_VV: case Instructions::VMSEQ_VX: case Instructions::VMSEQ_VI: return Operation::SEQ;
+        case Instructions::VMSNE_VV: case Instructions::VMSNE_VX: case Instructions::VMSNE_VI: return Operation::SNE;
+        case Instructions::VMSLTU_VV: case Instructions::VMSLTU_VX: return Operation::SLTU;
+        case Instructions::VMSLT_VV: case Instructions::VMSLT_VX: return Operation::SLT;
+        case Instructions::VMSLEU_VV: case Instructions::VMSLEU_VX: case Instructions::VMSLEU_VI: return Operation::SLEU;
+        case Instructions::VMSLE_VV: case Instructions::VMSLE_VX: case Instructions::VMSLE_VI: return Operation::SLE;
+        case Instructions::VMSGTU_VX: case Instructions::VMSGTU_VI: return Operation::SGTU;
+        case Instructions::VMSGT_VX: case Instructions::VMSGT_VI: return Operation::SGT;
+        default: return Operation::ADD;
+    }
+}
+
+// V instructions execute here in full, loads and stores included, against
+// the vector state; MEMORY only passes an x-register result through. The
+// returned Issue is the work the vector pipeline model has to time.
+inline vector::Issue executeVectorInstruction(InstructionNode* node, InstructionRegisters& instructionRegisters, vector::State& state, GuestMemory& memory) {
+    using vector::Issue;
+    const uint32_t word = node->instruction;
+    const Instructions instr = node->instructionName;
+    const InstructionDescriptor& descriptor = describe(instr);
+    const uint32_t vd = (word >> 7) & 0x1F, vs1 = (word >> 15) & 0x1F, vs2 = (word >> 20) & 0x1F;
+    const uint32_t RA = instructionRegisters.RA, RB = instructionRegisters.RB;
+    auto illegal = [&](const std::string& reason) {
+        std::stringstream ss;
+        ss << "Illegal vector instruction at PC 0x" << std::hex << node->PC << " (" << descriptor.mnemonic << "): " << reason;
+        throw std::runtime_error(std::string(RED) + ss.str() + RESET);
+    };
+
+    Issue issue;
+    if (descriptor.opcode == OP_V && descriptor.funct3 == OPCFG) {
+        uint32_t vtype = RB, avl = RA;
+        if (instr == Instructions::VSETIVLI) {
+            vtype = (word >> 20) & 0x3FF;
+            avl = vs1;
+        } else {
+            if (instr == Instructions::VSETVLI) vtype = (word >> 20) & 0x7FF;
+            if (vs1 == 0) avl = vd != 0 ? UINT32_MAX : state.vl;
+        }
+        instructionRegisters.RY = state.configure(vtype, avl);
+        return issue;
+    }
+    if (state.vtype & vector::VTYPE_VILL) {
+        illegal("vtype is not set (vill)");
+    }
+
+    const uint32_t sew = vector::sewOf(state.vtype);
+    const uint32_t vl = state.vl;
+    const uint32_t group = vector::groupRegisters(vector::lmulEighthsOf(state.vtype));
+    const bool masked = !(word & VECTOR_VM_FIELD) && !(descriptor.mask & VECTOR_VM_FIELD);
+    auto active = [&](uint32_t i) { return !masked || state.maskBit(0, i); };
+    auto aligned = [&](uint32_t reg, uint32_t count) {
+        if (reg % count != 0) illegal("v" + std::to_string(reg) + " is not aligned to a group of " + std::to_string(count) + " registers");
+        return vector::groupMask(reg, count);
+    };
+    const uint32_t maskSource = masked ? 1u : 0u;
+
+    if (descriptor.isMemory()) {
+        const uint32_t eew = descriptor.funct3 == 0b000 ? 8 : descriptor.funct3 == 0b101 ? 16 : 32;
+        const uint32_t emulEighths = vector::lmulEighthsOf(state.vtype) * eew / sew;
+        if (emulEighths == 0 || emulEighths > 64) illegal("EMUL is out of range");
+        const uint32_t registersUsed = aligned(vd, vector::groupRegisters(emulEighths));
+        const bool strided = descriptor.operands == OperandFormat::VECTOR_STRIDED;
+        const uint32_t bytes = eew / 8, stride = strided ? RB : bytes;
+        uint8_t* data = state.reg(vd);
+        if (descriptor.isLoad() && masked && vd == 0) illegal("a masked load cannot write v0");
+
+        if (!strided && !masked) {
+            if (vl > 0) {
+                isValidAddress(RA, vl * bytes);
+                if (descriptor.isStore()) {
+                    isValidMemory(memory, RA, vl * bytes);
+                    memory.write(RA, data, vl * bytes);
+                } else {
+                    memory.read(RA, data, vl * bytes);
+                }
+            }
+        } else {
+            for (uint32_t i = 0; i < vl; ++i) {
+                if (!active(i)) continue;
+                const uint32_t address = RA + i * stride;
+                isValidAddress(address, bytes);
+                if (descriptor.isStore()) {
+                    isValidMemory(memory, address, bytes);
+                    const uint32_t value = vector::readElement(data, i, eew);
+                    if (eew == 8) memory.write8(address, static_cast<uint8_t>(value));
+                    else if (eew == 16) memory.write16(address, static_cast<uint16_t>(value));
+                    else memory.write32(address, value);
+                } else {
+                    vector::writeElement(data, i, eew, eew == 8 ? memory.read8(address) : eew == 16 ? memory.read16(address) : memory.read32(address));
+                }
+            }
+        }
+        issue.unit = Issue::Unit::MEMORY;
+        issue.latency = vector::MEMORY_LATENCY;
+        issue.elements = vl;
+        issue.width = eew;
+        issue.strided = strided;
+        issue.sources = maskSource | (descriptor.isStore() ? registersUsed : 0);
+        issue.destinations = descriptor.isLoad() ? registersUsed : 0;
+        return issue;
+    }
+
+    const uint8_t category = descriptor.funct3;
+    uint32_t scalar = 0;
+    if (category == OPIVX || category == OPMVX) scalar = RA;
+    if (category == OPIVI) scalar = static_cast<uint32_t>(static_cast<int32_t>(word << 12) >> 27);
+    const bool vectorOperand = category == OPIVV || category == OPMVV;
+    auto operand = [&](uint32_t i) { return vectorOperand ? vector::readElement(state.reg(vs1), i, sew) : scalar; };
+    const vector::Operation op = vectorOperationOf(instr);
+
+    issue.unit = Issue::Unit::ARITHMETIC;
+    issue.latency = vector::ALU_LATENCY;
+    issue.elements = vl;
+    issue.width = sew;
+
+    switch (instr) {
+        case Instructions::VMSEQ_VV: case Instructions::VMSEQ_VX: case Instructions::VMSEQ_VI:
+        case Instructions::VMSNE_VV: case Instructions::VMSNE_VX: case Instructions::VMSNE_VI:
+        case Instructions::VMSLTU_VV: case Instructions::VMSLTU_VX: case Instructions::VMSLT_VV: case Instructions::VMSLT_VX:
+        case Instructions::VMSLEU_VV: case Instructions::VMSLEU_VX: case Instructions::VMSLEU_VI:
+        case Instructions::VMSLE_VV: case Instructions::VMSLE_VX: case Instructions::VMSLE_VI:
+        case Instructions::VMSGTU_VX: case Instructions::VMSGTU_VI: case Instructions::VMSGT_VX: case Instructions::VMSGT_VI: {
+            // Results go to a copy so a destination overlapping the sources
+            // reads every element first.
+            issue.sources = maskSource | aligned(vs2, group) | (vectorOperand ? aligned(vs1, group) : 0);
+            issue.destinations = 1u << vd;
+            std::vector<uint8_t> result(state.reg(vd), state.reg(vd) + state.vlenb());
+            for (uint32_t i = 0; i < vl; ++i) {
+                if (!active(i)) continue;
+                const bool bit = vector::apply(op, vector::readElement(state.reg(vs2), i, sew), operand(i), sew);
+                result[i >> 3] = static_cast<uint8_t>(bit ? result[i >> 3] | (1u << (i & 7)) : result[i >> 3] & ~(1u << (i & 7)));
+            }
+            std::memcpy(state.reg(vd), result.data(), result.size());
+            return issue;
+        }
+        case Instructions::VREDSUM_VS: case Instructions::VREDAND_VS: case Instructions::VREDOR_VS: case Instructions::VREDXOR_VS:
+        case Instructions::VREDMINU_VS: case Instructions::VREDMIN_VS: case Instructions::VREDMAXU_VS: case Instructions::VREDMAX_VS: {
+            issue.sources = maskSource | aligned(vs2, group) | (1u << vs1);
+            issue.destinations = 1u << vd;
+            issue.reduction = true;
+            if (vl == 0) return issue;
+            uint32_t accumulator = vector::readElement(state.reg(vs1), 0, sew);
+            for (uint32_t i = 0; i < vl; ++i) {
+                if (active(i)) accumulator = vector::apply(op, vector::readElement(state.reg(vs2), i, sew), accumulator, sew);
+            }
+            vector::writeElement(state.reg(vd), 0, sew, accumulator);
+            return issue;
+        }
+        case Instructions::VMANDN_MM: case Instructions::VMAND_MM: case Instructions::VMOR_MM: case Instructions::VMXOR_MM:
+        case Instructions::VMORN_MM: case Instructions::VMNAND_MM: case Instructions::VMNOR_MM: case Instructions::VMXNOR_MM: {
+            issue.sources = (1u << vs1) | (1u << vs2);
+            issue.destinations = 1u << vd;
+            issue.width = 1;
+            std::vector<uint8_t> result(state.reg(vd), state.reg(vd) + state.vlenb());
+            for (uint32_t i = 0; i < vl; ++i) {
+                const bool a = state.maskBit(vs2, i), b = state.maskBit(vs1, i);
+                bool bit = false;
+                switch (instr) {
+                    case Instructions::VMANDN_MM: bit = a && !b; break;
+                    case Instructions::VMAND_MM: bit = a && b; break;
+                    case Instructions::VMOR_MM: bit = a || b; break;
+                    case Instructions::VMXOR_MM: bit = a != b; break;
+                    case Instructions::VMORN_MM: bit = a || !b; break;
+                    case Instructions::VMNAND_MM: bit = !(a && b); break;
+                    case Instructions::VMNOR_MM: bit = !(a || b); break;
+                    default: bit = a == b; break;
+                }
+                result[i >> 3] = static_cast<uint8_t>(bit ? result[i >> 3] | (1u << (i & 7)) : result[i >> 3] & ~(1u << (i & 7)));
+            }
+            std::memcpy(state.reg(vd), result.data(), result.size());
+            return issue;
+        }
+        case Instructions::VMV_X_S:
+            issue.sources = 1u << vs2;
+            issue.elements = 1;
+            issue.scalarResult = true;
+            instructionRegisters.RY = vector::signExtend(vector::readElement(state.reg(vs2), 0, sew), sew);
+            return issue;
+        case Instructions::VMV_S_X:
+            issue.destinations = 1u << vd;
+            issue.elements = 1;
+            if (vl > 0) vector::writeElement(state.reg(vd), 0, sew, RA);
+            return issue;
+        case Instructions::VCPOP_M:
+        case Instructions::VFIRST_M: {
+            issue.sources = maskSource | (1u << vs2);
+            issue.width = 1;
+            issue.scalarResult = true;
+            uint32_t count = 0, first = UINT32_MAX;
+            for (uint32_t i = 0; i < vl; ++i) {
+                if (active(i) && state.maskBit(vs2, i)) {
+                    if (count++ == 0) first = i;
+                }
+            }
+            instructionRegisters.RY = instr == Instructions::VCPOP_M ? count : first;
+            return issue;
+        }
+        default:
+            break;
+    }
+
+    // Everything left writes a full SEW-wide destination group.
+    if (masked && vd == 0) illegal("a masked instruction cannot write v0");
+    if (descriptor.operands == OperandFormat::VECTOR_MERGE && vd == 0) illegal("vmerge cannot write v0");
+    issue.destinations = aligned(vd, group);
+    uint8_t* destination = state.reg(vd);
+
+    switch (descriptor.operands) {
+        case OperandFormat::VECTOR_INDEX:
+            issue.sources = maskSource;
+            for (uint32_t i = 0; i < vl; ++i) {
+                if (active(i)) vector::writeElement(destination, i, sew, i);
+            }
+            return issue;
+        case OperandFormat::VECTOR_UNARY:
+            issue.sources = vectorOperand ? aligned(vs1, group) : 0;
+            for (uint32_t i = 0; i < vl; ++i) vector::writeElement(destination, i, sew, operand(i));
+            return issue;
+        case OperandFormat::VECTOR_MERGE:
+            issue.sources = 1u | aligned(vs2, group) | (vectorOperand ? aligned(vs1, group) : 0);
+            for (uint32_t i = 0; i < vl; ++i) {
+                vector::writeElement(destination, i, sew, state.maskBit(0, i) ? operand(i) : vector::readElement(state.reg(vs2), i, sew));
+            }
+            return issue;
+        case OperandFormat::VECTOR_MULTIPLY_ADD:
+            issue.sources = maskSource | issue.destinations | aligned(vs2, group) | (vectorOperand ? aligned(vs1, group) : 0);
+            issue.latency = vector::MULTIPLY_LATENCY;
+            for (uint32_t i = 0; i < vl; ++i) {
+                if (!active(i)) continue;
+                const uint32_t product = vector::apply(vector::Operation::MUL, vector::readElement(state.reg(vs2), i, sew), operand(i), sew);
+                vector::writeElement(destination, i, sew, product + vector::readElement(destination, i, sew));
+            }
+            return issue;
+        default:
+            break;
+    }
+
+    issue.sources = maskSource | aligned(vs2, group) | (vectorOperand ? aligned(vs1, group) : 0);
+    if (op == vector::Operation::MUL || op == vector::Operation::MULH || op == vector::Operation::MULHU) {
+        issue.latency = vector::MULTIPLY_LATENCY;
+    }
+    const uint8_t* source = state.reg(vs2);
+    uint32_t i = masked ? 0 : vector::hostKernel(op, sew, destination, source, vectorOperand ? state.reg(vs1) : nullptr, scalar, vl);
+    for (; i < vl; ++i) {
+        if (active(i)) vector::writeElement(destination, i, sew, vector::apply(op, vector::readElement(source, i, sew), operand(i), sew));
+    }
+    return issue;
+}
+
+inline void memoryAccess(InstructionNode* node, InstructionRegisters& instructionRegisters, uint32_t* registers, GuestMemory& memory) {
     uint32_t address = instructionRegisters.RY;
     instructionRegisters.RZ = instructionRegisters.RY;
     
@@ -423,49 +925,48 @@ inline void memoryAccess(InstructionNode* node, InstructionRegisters& instructio
     switch (instr) {
         case Instructions::LB:
             isValidAddress(address, 1);
-            instructionRegisters.RZ = dataMap.count(address) ? static_cast<int8_t>(dataMap[address]) : 0;
+            instructionRegisters.RZ = static_cast<int8_t>(memory.read8(address));
             break;
         case Instructions::LH:
             isValidAddress(address, 2);
-            instructionRegisters.RZ = static_cast<int16_t>(
-                (dataMap.count(address + 1) ? dataMap[address + 1] : 0) << 8 |
-                (dataMap.count(address) ? dataMap[address] : 0)
-            );
+            instructionRegisters.RZ = static_cast<int16_t>(memory.read16(address));
             break;
         case Instructions::LW:
+        case Instructions::FLW:
             isValidAddress(address, 4);
-            instructionRegisters.RZ = 
-                ((dataMap.count(address + 3) ? dataMap[address + 3] : 0) << 24) |
-                ((dataMap.count(address + 2) ? dataMap[address + 2] : 0) << 16) |
-                ((dataMap.count(address + 1) ? dataMap[address + 1] : 0) << 8)  |
-                (dataMap.count(address) ? dataMap[address] : 0);
+            instructionRegisters.RZ = memory.read32(address);
+            break;
+        case Instructions::LBU:
+            isValidAddress(address, 1);
+            instructionRegisters.RZ = memory.read8(address);
+            break;
+        case Instructions::LHU:
+            isValidAddress(address, 2);
+            instructionRegisters.RZ = memory.read16(address);
             break;
         case Instructions::SB:
             {
-                isValidMemory(address);
+                isValidMemory(memory, address, 1);
                 uint32_t valueToStore = instructionRegisters.RM;
                 isValidAddress(address, 1);
-                dataMap[address] = valueToStore & 0xFF;
+                memory.write8(address, valueToStore & 0xFF);
             }
             break;
         case Instructions::SH:
             {
-                isValidMemory(address);
+                isValidMemory(memory, address, 2);
                 uint32_t valueToStore = instructionRegisters.RM;
                 isValidAddress(address, 2);
-                dataMap[address] = valueToStore & 0xFF;
-                dataMap[address + 1] = (valueToStore >> 8) & 0xFF;
+                memory.write16(address, valueToStore & 0xFFFF);
             }
             break;
         case Instructions::SW:
+        case Instructions::FSW:
             {
-                isValidMemory(address);
+                isValidMemory(memory, address, 4);
                 uint32_t valueToStore = instructionRegisters.RM;
                 isValidAddress(address, 4);
-                dataMap[address] = valueToStore & 0xFF;
-                dataMap[address + 1] = (valueToStore >> 8) & 0xFF;
-                dataMap[address + 2] = (valueToStore >> 16) & 0xFF;
-                dataMap[address + 3] = (valueToStore >> 24) & 0xFF;
+                memory.write32(address, valueToStore);
             }
             break;
         default:
@@ -477,9 +978,11 @@ inline void writeback(InstructionNode* node, InstructionRegisters& instructionRe
     if (node->rd != 0) {
         switch (node->instructionType) {
             case InstructionType::R:
+            case InstructionType::R4:
             case InstructionType::U:
             case InstructionType::UJ:
             case InstructionType::I:
+            case InstructionType::V:
                 registers[node->rd] = instructionRegisters.RZ;
                 break;
             case InstructionType::SB:
@@ -493,82 +996,116 @@ inline void writeback(InstructionNode* node, InstructionRegisters& instructionRe
 }
 
 inline std::string parseInstructions(uint32_t instHex) {
-    uint32_t opcode = instHex & 0x7F;
+    if (isCompressedParcel(instHex)) {
+        const uint16_t parcel = static_cast<uint16_t>(instHex);
+        const uint32_t expanded = expandCompressed(parcel);
+        if (expanded == 0) {
+            std::stringstream ss;
+            ss << "Invalid compressed instruction: 0x" << std::hex << parcel;
+            throw std::runtime_error(std::string(RED) + ss.str() + RESET);
+        }
+        const std::string base = parseInstructions(expanded);
+        return std::string(compressedMnemonic(parcel)) + base.substr(describe(decodeInstructionWord(expanded)).mnemonic.size());
+    }
+    const Instructions instruction = decodeInstructionWord(instHex);
+    if (instruction == Instructions::INVALID) {
+        std::stringstream ss;
+        ss << "Invalid instruction: 0x" << std::hex << instHex;
+        throw std::runtime_error(std::string(RED) + ss.str() + RESET);
+    }
+
+    const InstructionDescriptor& descriptor = describe(instruction);
     uint32_t rd = (instHex >> 7) & 0x1F;
-    uint32_t func3 = (instHex >> 12) & 0x7;
     uint32_t rs1 = (instHex >> 15) & 0x1F;
     uint32_t rs2 = (instHex >> 20) & 0x1F;
-    uint32_t func7 = (instHex >> 25) & 0x7F;
+    int32_t imm = decodeImmediate(descriptor.format, instHex);
 
-    auto rTypeEncoding = RTypeInstructions::getEncoding();
-    for (const auto &[name, op] : rTypeEncoding.opcodeMap) {
-        if (op == opcode && rTypeEncoding.func3Map.at(name) == func3 && rTypeEncoding.func7Map.at(name) == func7) {
-            std::stringstream ss;
-            ss << name << " x" << rd << ", x" << rs1 << ", x" << rs2;
-            return ss.str();
-        }
+    std::stringstream ss;
+    ss << descriptor.mnemonic;
+    if (descriptor.operands == OperandFormat::NONE) {
+        return ss.str();
     }
-
-    auto iTypeEncoding = ITypeInstructions::getEncoding();
-    for (const auto &[name, op] : iTypeEncoding.opcodeMap) {
-        if (op == opcode && iTypeEncoding.func3Map.at(name) == func3) {
-            int32_t imm = (instHex >> 20);
-            if (imm & 0x800) imm |= 0xFFFFF000;
-            std::stringstream ss;
-            if (name == "lb" || name == "lh" || name == "lw") {
-                ss << name << " x" << rd << ", " << imm << "(x" << rs1 << ")";
-            } else {
-                ss << name << " x" << rd << ", x" << rs1 << ", " << imm;
+    if (descriptor.operands == OperandFormat::FENCE) {
+        auto appendSet = [&](uint32_t bits) {
+            for (size_t i = 0; i < fenceSetLetters.size(); ++i) {
+                if (bits & (0x8 >> i)) ss << fenceSetLetters[i];
             }
-            return ss.str();
-        }
+        };
+        ss << " ";
+        appendSet((instHex >> 24) & 0xF);
+        ss << ", ";
+        appendSet((instHex >> 20) & 0xF);
+        return ss.str();
     }
-
-    auto sTypeEncoding = STypeInstructions::getEncoding();
-    for (const auto &[name, op] : sTypeEncoding.opcodeMap) {
-        if (op == opcode && sTypeEncoding.func3Map.at(name) == func3) {
-            int32_t imm = ((instHex >> 25) << 5) | ((instHex >> 7) & 0x1F);
-            if (imm & 0x800) imm |= 0xFFFFF000;
-            std::stringstream ss;
-            ss << name << " x" << rs2 << ", " << imm << "(x" << rs1 << ")";
-            return ss.str();
-        }
+    if (descriptor.opcode == 0b0010011 && (descriptor.funct3 == 0b001 || descriptor.funct3 == 0b101)) {
+        imm &= 0x1F;
     }
-
-    auto sbTypeEncoding = SBTypeInstructions::getEncoding();
-    for (const auto &[name, op] : sbTypeEncoding.opcodeMap) {
-        if (op == opcode && sbTypeEncoding.func3Map.at(name) == func3) {
-            int32_t imm = ((instHex >> 31) << 12) | (((instHex >> 7) & 1) << 11) | (((instHex >> 25) & 0x3F) << 5) | (((instHex >> 8) & 0xF) << 1);
-            if (imm & 0x1000) imm |= 0xFFFFE000;
-            std::stringstream ss;
-            ss << name << " x" << rs1 << ", x" << rs2 << ", " << imm;
-            return ss.str();
-        }
+    auto reg = [&](uint8_t field, uint32_t number) {
+        return std::string(descriptor.floatRegisters & field ? "f" : "x") + std::to_string(number);
+    };
+    if (descriptor.operands == OperandFormat::CSR || descriptor.operands == OperandFormat::CSR_IMM) {
+        const uint32_t csr = static_cast<uint32_t>(imm) & 0xFFF;
+        ss << " x" << rd << ", ";
+        if (csr == CSR_FFLAGS) ss << "fflags";
+        else if (csr == CSR_FRM) ss << "frm";
+        else if (csr == CSR_FCSR) ss << "fcsr";
+        else ss << csr;
+        ss << ", ";
+        if (descriptor.operands == OperandFormat::CSR) ss << "x";
+        ss << rs1;
+        return ss.str();
     }
-
-    auto uTypeEncoding = UTypeInstructions::getEncoding();
-    for (const auto &[name, op] : uTypeEncoding.opcodeMap) {
-        if (op == opcode) {
-            uint32_t imm = instHex & 0xFFFFF000;
-            std::stringstream ss;
-            ss << name << " x" << rd << ", " << (imm >> 12);
-            return ss.str();
+    switch (descriptor.format) {
+        case InstructionType::R:
+            ss << " " << reg(FLOAT_RD, rd) << ", " << reg(FLOAT_RS1, rs1);
+            if (descriptor.operands != OperandFormat::REG_REG) ss << ", " << reg(FLOAT_RS2, rs2);
+            break;
+        case InstructionType::R4:
+            ss << " " << reg(FLOAT_RD, rd) << ", " << reg(FLOAT_RS1, rs1) << ", " << reg(FLOAT_RS2, rs2) << ", " << reg(FLOAT_RS3, (instHex >> 27) & 0x1F);
+            break;
+        case InstructionType::I:
+            if (descriptor.isLoad()) {
+                ss << " " << reg(FLOAT_RD, rd) << ", " << imm << "(x" << rs1 << ")";
+            } else {
+                ss << " x" << rd << ", x" << rs1 << ", " << imm;
+            }
+            break;
+        case InstructionType::S:
+            ss << " " << reg(FLOAT_RS2, rs2) << ", " << imm << "(x" << rs1 << ")";
+            break;
+        case InstructionType::SB:
+            ss << " x" << rs1 << ", x" << rs2 << ", " << imm;
+            break;
+        case InstructionType::U:
+            ss << " x" << rd << ", " << (static_cast<uint32_t>(imm) >> 12);
+            break;
+        case InstructionType::UJ:
+            ss << " x" << rd << ", " << imm;
+            break;
+        case InstructionType::V: {
+            std::array<VectorOperand, 5> operands{};
+            const size_t count = vectorOperandsOf(descriptor, instHex, operands);
+            for (size_t i = 0; i < count; ++i) {
+                ss << (i == 0 ? " " : ", ");
+                const uint32_t value = operands[i].value;
+                switch (operands[i].kind) {
+                    case VectorOperandKind::VECTOR: ss << "v" << value; break;
+                    case VectorOperandKind::SCALAR: ss << "x" << value; break;
+                    case VectorOperandKind::IMMEDIATE: ss << static_cast<int32_t>(value); break;
+                    case VectorOperandKind::TYPE: ss << vectorTypeName(value, ", "); break;
+                    case VectorOperandKind::BASE: ss << "(x" << value << ")"; break;
+                    case VectorOperandKind::MASK: ss << "v0.t"; break;
+                    case VectorOperandKind::CARRY: ss << "v0"; break;
+                }
+            }
+            break;
         }
     }
-
-    auto ujTypeEncoding = UJTypeInstructions::getEncoding();
-    for (const auto &[name, op] : ujTypeEncoding.opcodeMap) {
-        if (op == opcode) {
-            int32_t imm = ((instHex >> 31) << 20) | (((instHex >> 12) & 0xFF) << 12) | (((instHex >> 20) & 1) << 11) | (((instHex >> 21) & 0x3FF) << 1);
-            if (imm & 0x100000) imm |= 0xFFE00000;
-            std::stringstream ss;
-            ss << name << " x" << rd << ", " << imm;
-            return ss.str();
-        }
+    const uint32_t roundingMode = (instHex >> 12) & 0x7;
+    if (descriptor.hasRounding() && roundingMode != ROUND_DYNAMIC) {
+        ss << ", " << roundingModeNames[roundingMode];
     }
-    std::stringstream ss;
-    ss << "Invalid instruction: 0x" << std::hex << instHex;
-    throw std::runtime_error(std::string(RED) + ss.str() + RESET);
+    return ss.str();
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,232 @@
+#ifndef FPU_HPP
+#define FPU_HPP
+
+#include <cfenv>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "types.hpp"
+
+// Single-precision arithmetic for the F extension, bit-exact in every RISC-V
+// rounding mode. Each operation is first evaluated in double precision
+// rounded to odd (truncate, then set the last bit if anything was lost), which
+// keeps enough information for a correctly rounded float in any mode; the
+// host then narrows it under the requested mode. The host has no
+// round-to-nearest-max-magnitude, so rmm is resolved from the same value.
+namespace riscv::fpu {
+    inline constexpr uint32_t CANONICAL_NAN = 0x7FC00000;
+    inline constexpr uint32_t SIGN_BIT = 0x80000000;
+
+    // fflags bits.
+    inline constexpr uint32_t INEXACT = 1 << 0;
+    inline constexpr uint32_t UNDERFLOW = 1 << 1;
+    inline constexpr uint32_t OVERFLOW = 1 << 2;
+    inline constexpr uint32_t DIVIDE_BY_ZERO = 1 << 3;
+    inline constexpr uint32_t INVALID = 1 << 4;
+
+    struct Result {
+        uint32_t bits;
+        uint32_t flags;
+    };
+
+    inline float toFloat(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t toBits(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    inline bool isNaN(uint32_t bits) { return (bits & 0x7F800000) == 0x7F800000 && (bits & 0x007FFFFF) != 0; }
+    inline bool isSignalingNaN(uint32_t bits) { return isNaN(bits) && !(bits & 0x00400000); }
+
+    inline uint32_t hostFlags(int raised) {
+        return ((raised & FE_INEXACT) ? INEXACT : 0) | ((raised & FE_UNDERFLOW) ? UNDERFLOW : 0) | ((raised & FE_OVERFLOW) ? OVERFLOW : 0) |
+               ((raised & FE_DIVBYZERO) ? DIVIDE_BY_ZERO : 0) | ((raised & FE_INVALID) ? INVALID : 0);
+    }
+
+    // Read through a volatile so the float-to-double conversion, which
+    // signals on a signaling NaN, happens inside the caller's flag window.
+    inline double widen(uint32_t bits) {
+        volatile float value = toFloat(bits);
+        return value;
+    }
+
+    struct Wide {
+        double value;
+        uint32_t flags;
+    };
+
+    // An exact zero is negative under round-down (x - x = -0), which
+    // truncation alone would not give.
+    template <typename Operation>
+    inline Wide roundToOdd(Operation operation, uint8_t mode) {
+        std::fenv_t environment;
+        std::fegetenv(&environment);
+        std::fesetround(FE_TOWARDZERO);
+        std::feclearexcept(FE_ALL_EXCEPT);
+        volatile double value = operation();
+        const int raised = std::fetestexcept(FE_ALL_EXCEPT);
+        if (value == 0 && mode == ROUND_DOWN) {
+            std::fesetround(FE_DOWNWARD);
+            value = operation();
+        }
+        std::fesetenv(&environment);
+
+        double result = value;
+        if ((raised & FE_INEXACT) && std::isfinite(result)) {
+            uint64_t bits;
+            std::memcpy(&bits, &result, sizeof(bits));
+            bits |= 1;
+            std::memcpy(&result, &bits, sizeof(result));
+        }
+        return {result, hostFlags(raised) & (INVALID | DIVIDE_BY_ZERO)};
+    }
+
+    inline Result narrowOnHost(double value, int hostMode) {
+        std::fenv_t environment;
+        std::fegetenv(&environment);
+        std::fesetround(hostMode);
+        std::feclearexcept(FE_ALL_EXCEPT);
+        volatile double wide = value;
+        volatile float narrow = static_cast<float>(wide);
+        const int raised = std::fetestexcept(FE_ALL_EXCEPT);
+        std::fesetenv(&environment);
+        return {toBits(narrow), hostFlags(raised)};
+    }
+
+    // Only an exact tie rounds differently from round-to-nearest-even. A tie
+    // needs 25 significant bits, so the rounded-to-odd value is the tie itself.
+    inline Result narrowAway(double value) {
+        const Result nearest = narrowOnHost(value, FE_TONEAREST);
+        const Result truncated = narrowOnHost(value, FE_TOWARDZERO);
+        const double low = toFloat(truncated.bits);
+        if (low == value) return nearest;
+        const double high = std::nextafter(static_cast<float>(low), value > 0 ? HUGE_VALF : -HUGE_VALF);
+        if (std::isinf(high) || value != low + (high - low) / 2) return nearest;
+        return {toBits(static_cast<float>(high)), INEXACT | (std::fabs(value) < FLT_MIN ? UNDERFLOW : 0)};
+    }
+
+    inline Result narrow(const Wide &wide, uint8_t mode) {
+        if (std::isnan(wide.value)) return {CANONICAL_NAN, wide.flags};
+        Result result;
+        switch (mode) {
+            case ROUND_NEAREST_EVEN: result = narrowOnHost(wide.value, FE_TONEAREST); break;
+            case ROUND_TOWARD_ZERO: result = narrowOnHost(wide.value, FE_TOWARDZERO); break;
+            case ROUND_DOWN: result = narrowOnHost(wide.value, FE_DOWNWARD); break;
+            case ROUND_UP: result = narrowOnHost(wide.value, FE_UPWARD); break;
+            default: result = narrowAway(wide.value); break;
+        }
+        result.flags |= wide.flags;
+        return result;
+    }
+
+    inline Result add(uint32_t a, uint32_t b, uint8_t mode) {
+        return narrow(roundToOdd([&] { return widen(a) + widen(b); }, mode), mode);
+    }
+
+    inline Result subtract(uint32_t a, uint32_t b, uint8_t mode) {
+        return narrow(roundToOdd([&] { return widen(a) - widen(b); }, mode), mode);
+    }
+
+    inline Result multiply(uint32_t a, uint32_t b, uint8_t mode) {
+        return narrow(roundToOdd([&] { return widen(a) * widen(b); }, mode), mode);
+    }
+
+    inline Result divide(uint32_t a, uint32_t b, uint8_t mode) {
+        return narrow(roundToOdd([&] { return widen(a) / widen(b); }, mode), mode);
+    }
+
+    inline Result squareRoot(uint32_t a, uint8_t mode) {
+        return narrow(roundToOdd([&] { return std::sqrt(widen(a)); }, mode), mode);
+    }
+
+    // (a * b) + c with the product and addend negated as the fused variants
+    // require. 0 * inf is invalid even when c is a quiet NaN.
+    inline Result fusedMultiplyAdd(uint32_t a, uint32_t b, uint32_t c, bool negateProduct, bool negateAddend, uint8_t mode) {
+        Wide wide = roundToOdd([&] {
+            const double product = negateProduct ? -widen(a) : widen(a);
+            const double addend = negateAddend ? -widen(c) : widen(c);
+            return std::fma(product, widen(b), addend);
+        }, mode);
+        const bool zeroA = (a & ~SIGN_BIT) == 0, zeroB = (b & ~SIGN_BIT) == 0;
+        const bool infiniteA = (a & ~SIGN_BIT) == 0x7F800000, infiniteB = (b & ~SIGN_BIT) == 0x7F800000;
+        if ((zeroA && infiniteB) || (infiniteA && zeroB)) wide.flags |= INVALID;
+        return narrow(wide, mode);
+    }
+
+    inline Result fromInteger(uint32_t value, bool isUnsigned, uint8_t mode) {
+        const double wide = isUnsigned ? static_cast<double>(value) : static_cast<double>(static_cast<int32_t>(value));
+        return narrow({wide, 0}, mode);
+    }
+
+    // Out-of-range inputs, infinities and NaNs saturate and raise invalid;
+    // NaN converts to the largest value.
+    inline Result toInteger(uint32_t a, bool isUnsigned, uint8_t mode) {
+        const double maximum = isUnsigned ? 4294967295.0 : 2147483647.0;
+        const double minimum = isUnsigned ? 0.0 : -2147483648.0;
+        if (isNaN(a)) return {static_cast<uint32_t>(static_cast<int64_t>(maximum)), INVALID};
+
+        const double value = toFloat(a);
+        double rounded;
+        switch (mode) {
+            case ROUND_TOWARD_ZERO: rounded = std::trunc(value); break;
+            case ROUND_DOWN: rounded = std::floor(value); break;
+            case ROUND_UP: rounded = std::ceil(value); break;
+            case ROUND_NEAREST_MAX: rounded = std::round(value); break;
+            default:
+                rounded = std::round(value);
+                if (std::fabs(value - std::trunc(value)) == 0.5) rounded = 2.0 * std::round(value / 2.0);
+                break;
+        }
+        if (rounded > maximum) return {static_cast<uint32_t>(static_cast<int64_t>(maximum)), INVALID};
+        if (rounded < minimum) return {static_cast<uint32_t>(static_cast<int64_t>(minimum)), INVALID};
+        return {static_cast<uint32_t>(static_cast<int64_t>(rounded)), rounded != value ? INEXACT : 0};
+    }
+
+    // fmin/fmax return the other operand when one is NaN and order -0 below +0.
+    inline Result minimumOrMaximum(uint32_t a, uint32_t b, bool maximum) {
+        const uint32_t flags = (isSignalingNaN(a) || isSignalingNaN(b)) ? INVALID : 0;
+        if (isNaN(a) && isNaN(b)) return {CANONICAL_NAN, flags};
+        if (isNaN(a)) return {b, flags};
+        if (isNaN(b)) return {a, flags};
+        const float x = toFloat(a), y = toFloat(b);
+        if (x == y) return {maximum ? (a & b) : (a | b), flags};
+        return {(maximum ? x > y : x < y) ? a : b, flags};
+    }
+
+    // feq is quiet and only signals on signaling NaNs; flt and fle signal on
+    // any NaN.
+    inline Result compareEqual(uint32_t a, uint32_t b) {
+        if (isNaN(a) || isNaN(b)) return {0, (isSignalingNaN(a) || isSignalingNaN(b)) ? INVALID : 0};
+        return {toFloat(a) == toFloat(b) ? 1u : 0u, 0};
+    }
+
+    inline Result compareLess(uint32_t a, uint32_t b, bool orEqual) {
+        if (isNaN(a) || isNaN(b)) return {0, INVALID};
+        const float x = toFloat(a), y = toFloat(b);
+        return {(orEqual ? x <= y : x < y) ? 1u : 0u, 0};
+    }
+
+    inline uint32_t classify(uint32_t a) {
+        const bool negative = a & SIGN_BIT;
+        const uint32_t exponent = (a >> 23) & 0xFF, fraction = a & 0x007FFFFF;
+        if (exponent == 0xFF) {
+            if (fraction == 0) return negative ? 1u << 0 : 1u << 7;
+            return isSignalingNaN(a) ? 1u << 8 : 1u << 9;
+        }
+        if (exponent == 0) {
+            if (fraction == 0) return negative ? 1u << 3 : 1u << 4;
+            return negative ? 1u << 2 : 1u << 5;
+        }
+        return negative ? 1u << 1 : 1u << 6;
+    }
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace riscv {
+    inline constexpr size_t nextPowerOfTwo(size_t value) {
+        size_t power = 1;
+        while (power < value) power <<= 1;
+        return power;
+    }
+
+    inline constexpr uint32_t hashString(std::string_view text, uint32_t seed) {
+        uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+        for (char c : text) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 16777619u;
+        }
+        hash ^= hash >> 16;
+        hash *= 0x85EBCA6Bu;
+        hash ^= hash >> 13;
+        return hash;
+    }
+
+    inline constexpr uint64_t mixHash64(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDull;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53ull;
+        value ^= value >> 33;
+        return value;
+    }
+
+    inline uint64_t hashBytes64(std::string_view bytes, uint64_t seed) {
+        uint64_t hash = mixHash64(seed ^ (bytes.size() * 0x9E3779B97F4A7C15ull));
+        const char* cursor = bytes.data();
+        size_t remaining = bytes.size();
+        for (; remaining >= 8; cursor += 8, remaining -= 8) {
+            uint64_t block;
+            std::memcpy(&block, cursor, 8);
+            hash = mixHash64(hash ^ block) + 0x9E3779B97F4A7C15ull;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, cursor, remaining);
+        return mixHash64(hash ^ tail ^ (static_cast<uint64_t>(remaining) << 56));
+    }
+
+    template <size_t BucketCount, size_t SlotCount>
+    struct PerfectHashIndex {
+        static_assert((BucketCount & (BucketCount - 1)) == 0, "bucket count must be a power of two");
+        static_assert((SlotCount & (SlotCount - 1)) == 0, "slot count must be a power of two");
+
+        std::array<uint16_t, BucketCount> displacement;
+        std::array<uint16_t, SlotCount> slots;
+
+        constexpr int find(std::string_view key) const {
+            uint32_t seed = displacement[hashString(key, 0) & (BucketCount - 1)];
+            uint16_t entry = slots[hashString(key, seed) & (SlotCount - 1)];
+            return static_cast<int>(entry) - 1;
+        }
+    };
+
+    template <size_t BucketCount, size_t SlotCount, typename Entry, size_t KeyCount>
+    constexpr PerfectHashIndex<BucketCount, SlotCount> buildPerfectHash(const std::array<Entry, KeyCount>& entries) {
+        static_assert(KeyCount < SlotCount, "perfect hash needs more slots than keys");
+        constexpr size_t maxBucketSize = 16;
+
+        PerfectHashIndex<BucketCount, SlotCount> index{};
+        std::array<uint16_t, KeyCount> keyBucket{};
+        std::array<uint16_t, BucketCount> bucketSize{};
+        std::array<bool, BucketCount> placed{};
+
+        for (size_t key = 0; key < KeyCount; ++key) {
+            keyBucket[key] = static_cast<uint16_t>(hashString(entries[key].name, 0) & (BucketCount - 1));
+            ++bucketSize[keyBucket[key]];
+        }
+
+        for (size_t round = 0; round < BucketCount; ++round) {
+            size_t bucket = BucketCount;
+            for (size_t candidate = 0; candidate < BucketCount; ++candidate) {
+                if (!placed[candidate] && (bucket == BucketCount || bucketSize[candidate] > bucketSize[bucket])) {
+                    bucket = candidate;
+                }
+            }
+            placed[bucket] = true;
+            if (bucketSize[bucket] == 0) break;
+            if (bucketSize[bucket] > maxBucketSize) throw "perfect hash bucket overflow";
+
+            std::array<size_t, maxBucketSize> members{};
+            size_t memberCount = 0;
+            for (size_t key = 0; key < KeyCount; ++key) {
+                if (keyBucket[key] == bucket) members[memberCount++] = key;
+            }
+
+            for (uint32_t seed = 1;; ++seed) {
+                if (seed > 0xFFFF) throw "perfect hash construction failed (duplicate key?)";
+                std::array<size_t, maxBucketSize> targets{};
+                bool fits = true;
+                for (size_t i = 0; i < memberCount && fits; ++i) {
+                    targets[i] = hashString(entries[members[i]].name, seed) & (SlotCount - 1);
+                    if (index.slots[targets[i]] != 0) fits = false;
+                    for (size_t j = 0; j < i && fits; ++j) {
+                        if (targets[j] == targets[i]) fits = false;
+                    }
+                }
+                if (!fits) continue;
+                for (size_t i = 0; i < memberCount; ++i) {
+                    index.slots[targets[i]] = static_cast<uint16_t>(members[i] + 1);
+                }
+                index.displacement[bucket] = static_cast<uint16_t>(seed);
+                break;
+            }
+        }
+        return index;
+    }
+}
+
+#endif
@@ -0,0 +1,496 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "types.hpp"
+#include "symbols.hpp"
+
+namespace riscv {
+    // One entry per instruction; a compressed instruction keeps its 16-bit
+    // parcel in the low half of the entry and takes two bytes of text.
+    struct TextSection {
+        uint32_t base;
+        std::vector<uint32_t> words;
+        uint32_t size = 0;
+
+        uint32_t end() const { return base + size; }
+
+        void push(uint32_t word) {
+            words.push_back(word);
+            size += encodedLength(word);
+        }
+    };
+
+    struct DataSection {
+        uint32_t base;
+        std::vector<uint8_t> bytes;
+
+        uint32_t end() const { return base + static_cast<uint32_t>(bytes.size()); }
+    };
+
+    struct AddressRange {
+        uint32_t base;
+        uint32_t end;
+    };
+
+    [[noreturn]] inline void overlappingText(uint32_t address) {
+        char hex[11];
+        std::snprintf(hex, sizeof(hex), "0x%08X", address);
+        throw std::runtime_error(std::string(RED) + "Image Error: Overlapping text at " + hex + RESET);
+    }
+
+    struct MemoryImage {
+        std::vector<TextSection> text;
+        std::vector<DataSection> data;
+        // Stores are allowed from DATA_SEGMENT_START up and in these ranges,
+        // which an ELF executable may link below it.
+        std::vector<AddressRange> writable;
+        uint32_t entry = TEXT_SEGMENT_START;
+
+        void clear() {
+            text.clear();
+            data.clear();
+            writable.clear();
+            entry = TEXT_SEGMENT_START;
+        }
+
+        void appendText(uint32_t address, uint32_t word) {
+            if (text.empty() || text.back().end() != address) {
+                if (!text.empty() && address >= text.back().base && address < text.back().end()) overlappingText(address);
+                text.push_back({address, {}});
+            }
+            text.back().push(word);
+        }
+
+        std::vector<uint8_t>& dataAt(uint32_t address) {
+            if (data.empty() || data.back().end() != address) {
+                data.push_back({address, {}});
+            }
+            return data.back().bytes;
+        }
+
+        // Text from different places in the source must never share an
+        // address; a later instruction would silently replace an earlier one.
+        void finalize() {
+            std::stable_sort(text.begin(), text.end(), [](const TextSection &a, const TextSection &b) { return a.base < b.base; });
+            std::stable_sort(data.begin(), data.end(), [](const DataSection &a, const DataSection &b) { return a.base < b.base; });
+            for (size_t i = 1; i < text.size(); ++i) {
+                if (text[i].base < text[i - 1].end()) overlappingText(text[i].base);
+            }
+        }
+
+        size_t textWordCount() const {
+            size_t count = 0;
+            for (const TextSection &section : text) count += section.words.size();
+            return count;
+        }
+
+        size_t dataByteCount() const {
+            size_t count = 0;
+            for (const DataSection &section : data) count += section.bytes.size();
+            return count;
+        }
+    };
+
+    struct ImageSymbol {
+        std::string name;
+        uint32_t address;
+        SymbolKind kind;
+    };
+
+    struct LineEntry {
+        uint32_t address;
+        int32_t line;
+    };
+
+    struct ProgramImage {
+        MemoryImage memory;
+        std::vector<ImageSymbol> symbols;
+        std::vector<LineEntry> lines;
+
+        // Interning order depends on how the source was split between
+        // threads, so symbols are written sorted by address and name.
+        void addSymbols(const SymbolTable &table) {
+            const size_t first = symbols.size();
+            for (SymbolId id = 0; id < table.size(); ++id) {
+                if (table[id].isDefined()) {
+                    symbols.push_back({std::string(table.name(id)), table[id].address, table[id].kind});
+                }
+            }
+            std::sort(symbols.begin() + first, symbols.end(), [](const ImageSymbol &a, const ImageSymbol &b) {
+                return a.address != b.address ? a.address < b.address : a.name < b.name;
+            });
+        }
+
+        void addLines(const std::vector<ParsedInstruction> &instructions) {
+            lines.reserve(lines.size() + instructions.size());
+            for (const ParsedInstruction &inst : instructions) {
+                lines.push_back({inst.address, inst.lineNumber});
+            }
+        }
+    };
+
+    // Binary image layout, all fields little-endian 32-bit words:
+    //   header   magic "RVIM", version | headerSize << 16, text/data section, symbol
+    //            and line counts, string table size, entry point, writable
+    //            range count
+    //   text     per section: base, word count, words
+    //   data     per section: base, byte count, bytes padded to a word
+    //   writable per range: base, end
+    //   symbols  per symbol: name offset, name length, address, kind
+    //   lines    per entry: address, source line
+    //   strings  symbol names, back to back
+    inline constexpr char IMAGE_MAGIC[4] = {'R', 'V', 'I', 'M'};
+    inline constexpr uint32_t IMAGE_VERSION = 2;
+    inline constexpr uint32_t IMAGE_HEADER_SIZE = 36;
+
+    inline bool isBinaryImage(std::string_view bytes) {
+        return bytes.size() >= IMAGE_HEADER_SIZE && std::memcmp(bytes.data(), IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) == 0;
+    }
+
+    inline bool isListing(std::string_view text) {
+        return text.substr(0, 2) == "# " && text.find("TEXT SEGMENT") < text.find('\n');
+    }
+
+    inline void writeProgramImage(std::ostream &out, const ProgramImage &program) {
+        std::vector<uint8_t> bytes;
+        auto put32 = [&](uint32_t value) {
+            for (int i = 0; i < 4; ++i) bytes.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        };
+
+        std::string strings;
+        for (const ImageSymbol &symbol : program.symbols) strings += symbol.name;
+
+        bytes.insert(bytes.end(), IMAGE_MAGIC, IMAGE_MAGIC + sizeof(IMAGE_MAGIC));
+        put32(IMAGE_VERSION | (IMAGE_HEADER_SIZE << 16));
+        put32(static_cast<uint32_t>(program.memory.text.size()));
+        put32(static_cast<uint32_t>(program.memory.data.size()));
+        put32(static_cast<uint32_t>(program.symbols.size()));
+        put32(static_cast<uint32_t>(program.lines.size()));
+        put32(static_cast<uint32_t>(strings.size()));
+        put32(program.memory.entry);
+        put32(static_cast<uint32_t>(program.memory.writable.size()));
+
+        for (const TextSection &section : program.memory.text) {
+            put32(section.base);
+            put32(static_cast<uint32_t>(section.words.size()));
+            for (uint32_t word : section.words) put32(word);
+        }
+        for (const DataSection &section : program.memory.data) {
+            put32(section.base);
+            put32(static_cast<uint32_t>(section.bytes.size()));
+            bytes.insert(bytes.end(), section.bytes.begin(), section.bytes.end());
+            bytes.resize((bytes.size() + 3) & ~static_cast<size_t>(3), 0);
+        }
+        for (const AddressRange &range : program.memory.writable) {
+            put32(range.base);
+            put32(range.end);
+        }
+        uint32_t nameOffset = 0;
+        for (const ImageSymbol &symbol : program.symbols) {
+            put32(nameOffset);
+            put32(static_cast<uint32_t>(symbol.name.size()));
+            put32(symbol.address);
+            put32(static_cast<uint32_t>(symbol.kind));
+            nameOffset += static_cast<uint32_t>(symbol.name.size());
+        }
+        for (const LineEntry &entry : program.lines) {
+            put32(entry.address);
+            put32(static_cast<uint32_t>(entry.line));
+        }
+        bytes.insert(bytes.end(), strings.begin(), strings.end());
+
+        out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    class ImageReader {
+    public:
+        explicit ImageReader(std::string_view bytes)
+            : cursor(reinterpret_cast<const uint8_t*>(bytes.data())), end(cursor + bytes.size()) {}
+
+        const uint8_t* take(size_t size) {
+            if (static_cast<size_t>(end - cursor) < size) {
+                throw std::runtime_error(std::string(RED) + "Image Error: Truncated image" + RESET);
+            }
+            const uint8_t* data = cursor;
+            cursor += size;
+            return data;
+        }
+
+        uint32_t read32() {
+            const uint8_t* data = take(4);
+            return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+                   (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+        }
+
+        size_t remaining() const { return static_cast<size_t>(end - cursor); }
+
+    private:
+        const uint8_t* cursor;
+        const uint8_t* end;
+    };
+
+    inline ProgramImage loadProgramImage(std::string_view bytes) {
+        if (!isBinaryImage(bytes)) {
+            throw std::runtime_error(std::string(RED) + "Image Error: Missing image header" + RESET);
+        }
+        ImageReader reader(bytes);
+        reader.take(sizeof(IMAGE_MAGIC));
+        const uint32_t version = reader.read32();
+        if ((version & 0xFFFF) != IMAGE_VERSION || (version >> 16) != IMAGE_HEADER_SIZE) {
+            throw std::runtime_error(std::string(RED) + "Image Error: Unsupported image version " + std::to_string(version & 0xFFFF) + RESET);
+        }
+        const uint32_t textCount = reader.read32();
+        const uint32_t dataCount = reader.read32();
+        const uint32_t symbolCount = reader.read32();
+        const uint32_t lineCount = reader.read32();
+        const uint32_t stringSize = reader.read32();
+
+        ProgramImage program;
+        program.memory.entry = reader.read32();
+        const uint32_t writableCount = reader.read32();
+        program.memory.text.resize(textCount);
+        for (TextSection &section : program.memory.text) {
+            section.base = reader.read32();
+            const uint32_t count = reader.read32();
+            if (count > reader.remaining() / INSTRUCTION_SIZE) {
+                throw std::runtime_error(std::string(RED) + "Image Error: Truncated image" + RESET);
+            }
+            section.words.reserve(count);
+            for (uint32_t i = 0; i < count; ++i) section.push(reader.read32());
+        }
+        program.memory.data.resize(dataCount);
+        for (DataSection &section : program.memory.data) {
+            section.base = reader.read32();
+            const uint32_t count = reader.read32();
+            const uint8_t* data = reader.take((static_cast<size_t>(count) + 3) & ~static_cast<size_t>(3));
+            section.bytes.assign(data, data + count);
+        }
+        if (writableCount > reader.remaining() / 8) {
+            throw std::runtime_error(std::string(RED) + "Image Error: Truncated image" + RESET);
+        }
+        program.memory.writable.resize(writableCount);
+        for (AddressRange &range : program.memory.writable) {
+            range.base = reader.read32();
+            range.end = reader.read32();
+        }
+
+        struct NameRef { uint32_t offset, length; };
+        std::vector<NameRef> names(symbolCount);
+        program.symbols.resize(symbolCount);
+        for (uint32_t i = 0; i < symbolCount; ++i) {
+            names[i].offset = reader.read32();
+            names[i].length = reader.read32();
+            program.symbols[i].address = reader.read32();
+            const uint32_t kind = reader.read32();
+            if (kind > static_cast<uint32_t>(SymbolKind::DATA)) {
+                throw std::runtime_error(std::string(RED) + "Image Error: Invalid symbol kind" + RESET);
+            }
+            program.symbols[i].kind = static_cast<SymbolKind>(kind);
+        }
+        program.lines.resize(lineCount);
+        for (LineEntry &entry : program.lines) {
+            entry.address = reader.read32();
+            entry.line = static_cast<int32_t>(reader.read32());
+        }
+        const char* strings = reinterpret_cast<const char*>(reader.take(stringSize));
+        for (uint32_t i = 0; i < symbolCount; ++i) {
+            if (names[i].offset > stringSize || names[i].length > stringSize - names[i].offset) {
+                throw std::runtime_error(std::string(RED) + "Image Error: Symbol name out of bounds" + RESET);
+            }
+            program.symbols[i].name.assign(strings + names[i].offset, names[i].length);
+        }
+        return program;
+    }
+
+    // Reads back the .mc listing written by the assembler: text lines carry an
+    // address and an instruction word, data lines an address and one byte.
+    inline ProgramImage loadListing(std::string_view text) {
+        ProgramImage program;
+        bool inData = false;
+        int lineNumber = 0;
+
+        auto fail = [&](const std::string &message) {
+            throw std::runtime_error(std::string(RED) + "Listing Error on Line " + std::to_string(lineNumber) + ": " + message + RESET);
+        };
+        auto parseHex = [&](std::string_view &rest) {
+            if (rest.size() < 3 || rest[0] != '0' || (rest[1] != 'x' && rest[1] != 'X')) fail("Expected a hexadecimal field");
+            uint32_t value = 0;
+            size_t i = 2;
+            for (; i < rest.size(); ++i) {
+                const char c = rest[i];
+                uint32_t digit;
+                if (c >= '0' && c <= '9') digit = c - '0';
+                else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+                else break;
+                if (i > 9) fail("Hexadecimal field too long");
+                value = (value << 4) | digit;
+            }
+            if (i == 2) fail("Expected a hexadecimal field");
+            rest.remove_prefix(i);
+            while (!rest.empty() && rest[0] == ' ') rest.remove_prefix(1);
+            return value;
+        };
+
+        while (!text.empty()) {
+            const size_t newline = text.find('\n');
+            std::string_view line = text.substr(0, newline);
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+            ++lineNumber;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (line.empty()) continue;
+
+            if (line[0] == '#') {
+                if (line.find("DATA SEGMENT") != std::string_view::npos) inData = true;
+                else if (line.find("TEXT SEGMENT") != std::string_view::npos) inData = false;
+                continue;
+            }
+
+            const uint32_t address = parseHex(line);
+            const uint32_t value = parseHex(line);
+            if (!inData) {
+                program.memory.appendText(address, value);
+            } else if (line.find("<END_OF_TEXT>") == std::string_view::npos) {
+                if (value > 0xFF) fail("Data value does not fit in a byte");
+                program.memory.dataAt(address).push_back(static_cast<uint8_t>(value));
+            }
+        }
+        program.memory.finalize();
+        return program;
+    }
+
+    class GuestMemory {
+    public:
+        static constexpr uint32_t PAGE_BITS = 12;
+        static constexpr uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+        static constexpr uint32_t PAGE_MASK = PAGE_SIZE - 1;
+
+        void clear() {
+            pages.clear();
+            writable.clear();
+            lastIndex = UINT32_MAX;
+            lastPage = nullptr;
+        }
+
+        uint8_t read8(uint32_t address) const {
+            const Page* page = findPage(address >> PAGE_BITS);
+            return page ? (*page)[address & PAGE_MASK] : 0;
+        }
+
+        uint16_t read16(uint32_t address) const {
+            return static_cast<uint16_t>(read8(address) | (read8(address + 1) << 8));
+        }
+
+        uint32_t read32(uint32_t address) const {
+            return static_cast<uint32_t>(read8(address)) | (static_cast<uint32_t>(read8(address + 1)) << 8) |
+                   (static_cast<uint32_t>(read8(address + 2)) << 16) | (static_cast<uint32_t>(read8(address + 3)) << 24);
+        }
+
+        void write8(uint32_t address, uint8_t value) {
+            getPage(address >> PAGE_BITS)[address & PAGE_MASK] = value;
+        }
+
+        void write16(uint32_t address, uint16_t value) {
+            write8(address, value & 0xFF);
+            write8(address + 1, (value >> 8) & 0xFF);
+        }
+
+        void write32(uint32_t address, uint32_t value) {
+            write8(address, value & 0xFF);
+            write8(address + 1, (value >> 8) & 0xFF);
+            write8(address + 2, (value >> 16) & 0xFF);
+            write8(address + 3, (value >> 24) & 0xFF);
+        }
+
+        void write(uint32_t address, const uint8_t* bytes, size_t size) {
+            while (size > 0) {
+                const uint32_t offset = address & PAGE_MASK;
+                const size_t count = std::min<size_t>(size, PAGE_SIZE - offset);
+                std::memcpy(getPage(address >> PAGE_BITS).data() + offset, bytes, count);
+                address += static_cast<uint32_t>(count);
+                bytes += count;
+                size -= count;
+            }
+        }
+
+        void read(uint32_t address, uint8_t* bytes, size_t size) const {
+            while (size > 0) {
+                const uint32_t offset = address & PAGE_MASK;
+                const size_t count = std::min<size_t>(size, PAGE_SIZE - offset);
+                const Page* page = findPage(address >> PAGE_BITS);
+                if (page) {
+                    std::memcpy(bytes, page->data() + offset, count);
+                } else {
+                    std::memset(bytes, 0, count);
+                }
+                address += static_cast<uint32_t>(count);
+                bytes += count;
+                size -= count;
+            }
+        }
+
+        void load(const MemoryImage &image) {
+            for (const DataSection &section : image.data) {
+                write(section.base, section.bytes.data(), section.bytes.size());
+            }
+            writable = image.writable;
+        }
+
+        // Every byte of [address, address + size) must be writable; the
+        // range may span adjacent writable segments.
+        bool isWritable(uint32_t address, uint32_t size = 1) const {
+            uint64_t begin = address;
+            const uint64_t end = begin + size;
+            while (begin < end) {
+                if (begin >= DATA_SEGMENT_START) return true;
+                auto range = std::find_if(writable.begin(), writable.end(), [&](const AddressRange &candidate) { return begin >= candidate.base && begin < candidate.end; });
+                if (range == writable.end()) return false;
+                begin = range->end;
+            }
+            return true;
+        }
+
+    private:
+        using Page = std::array<uint8_t, PAGE_SIZE>;
+
+        std::unordered_map<uint32_t, std::unique_ptr<Page>> pages;
+        std::vector<AddressRange> writable;
+        mutable uint32_t lastIndex = UINT32_MAX;
+        mutable Page* lastPage = nullptr;
+
+        const Page* findPage(uint32_t index) const {
+            if (index == lastIndex) return lastPage;
+            auto it = pages.find(index);
+            if (it == pages.end()) return nullptr;
+            lastIndex = index;
+            lastPage = it->second.get();
+            return lastPage;
+        }
+
+        Page& getPage(uint32_t index) {
+            if (index == lastIndex) return *lastPage;
+            auto& page = pages[index];
+            if (!page) {
+                page = std::make_unique<Page>();
+                page->fill(0);
+            }
+            lastIndex = index;
+            lastPage = page.get();
+            return *page;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,906 @@
+#ifndef INCREMENTAL_HPP
+#define INCREMENTAL_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "symbols.hpp"
+#include "assembler.hpp"
+#include "relax.hpp"
+#include "image.hpp"
+
+using namespace riscv;
+
+struct Diagnostic {
+    int line;
+    std::string message;
+};
+
+struct LineEncoding {
+    int line;
+    uint32_t address;
+    uint32_t code;
+};
+
+struct LineRange {
+    int first;
+    size_t count;
+};
+
+// Everything an editor needs after an edit: the line ranges that were edited
+// or whose machine code changed, their new encodings, and the full current
+// diagnostic list. Other lines keep their code, though relaxation may have
+// moved their addresses; getLineEncodings has the current ones.
+struct EditResult {
+    std::vector<LineRange> refreshed;
+    std::vector<LineEncoding> updated;
+    std::vector<Diagnostic> diagnostics;
+    size_t lexedLines = 0;
+    size_t parsedLines = 0;
+};
+
+// Keeps a program as per-line tokens grouped into fixed-size blocks, each
+// parsed once by its own Parser from the address, section and .option rvc
+// state it starts in. An edit re-lexes only the lines it touches and re-parses
+// only the blocks holding them; a block that merely moved keeps its parse and
+// is only rebased, since its addresses are kept relative to where it was
+// parsed. Label operands are resolved per block against a global table, and
+// only those whose value changed are encoded again.
+//
+// Once the program has no errors its instructions are relaxed as parse()
+// would, so encodings and addresses match a full assembly. Each block keeps
+// its part of the relaxed program relative to its own start, and an edit
+// relaxes only the blocks from the first to the last re-parsed one, widened
+// to any block whose lengthened branches or calls reach across them.
+// Line numbers are 1-based, as in diagnostics.
+class IncrementalAssembler {
+public:
+    static constexpr size_t BLOCK_LINES = 64;
+
+    inline EditResult setSource(std::string_view text);
+    inline EditResult applyEdit(size_t firstLine, size_t removedLines, const std::vector<std::string> &insertedLines);
+
+    inline std::vector<LineEncoding> getEncodings() const;
+    inline std::vector<LineEncoding> getLineEncodings(int line) const;
+    inline std::vector<Diagnostic> getDiagnostics() const;
+    inline MemoryImage buildImage() const;
+
+    inline const SymbolTable& getSymbolTable() const { return symbolTable; }
+    inline size_t getLineCount() const { return lines.size(); }
+    inline size_t getBlockCount() const { return blocks.size(); }
+
+private:
+    struct Line {
+        std::string text;
+        TokenArena tokens;
+        std::string error;
+        int number = 0;
+    };
+
+    // A label operand: where it sits, the label in the global table, and the
+    // address of its instruction and the value it was last given, so a block
+    // that moved is checked without going through its instructions.
+    struct LabelSite {
+        uint32_t instruction;
+        uint32_t operand;
+        SymbolId target;
+        uint32_t address;
+        int32_t value;
+        Instructions opcode;
+        OperandModifier modifier;
+        bool compressed;
+        bool resolved;
+    };
+
+    struct Block {
+        size_t firstLine = 0;
+        size_t lineCount = 0;
+        bool dirty = true;
+        bool linked = false;
+        // Its encodings may differ from the ones in shown.
+        bool touched = true;
+        // Re-parsed since the program was last relaxed.
+        bool relaxStale = true;
+        uint32_t startText = TEXT_SEGMENT_START;
+        uint32_t startData = DATA_SEGMENT_START;
+        bool startsInData = false;
+        bool startsCompressing = false;
+        // The parse laid the block out from parsedText and parsedData and
+        // ended at endText and endData; it has moved by the difference to
+        // startText and startData since.
+        uint32_t parsedText = TEXT_SEGMENT_START;
+        uint32_t parsedData = DATA_SEGMENT_START;
+        uint32_t endText = TEXT_SEGMENT_START;
+        uint32_t endData = DATA_SEGMENT_START;
+        bool endsInData = false;
+        bool endsCompressing = false;
+        int parsedFirst = 0;
+        // The parser owns the label names the instructions refer to.
+        std::unique_ptr<Parser> parser;
+        std::vector<ParsedInstruction> instructions;
+        std::vector<LabelSite> sites;
+        std::vector<SymbolId> definitions;
+        std::vector<SymbolId> globalDefinitions;
+        std::vector<Diagnostic> diagnostics;
+        std::vector<Diagnostic> linkDiagnostics;
+        // Encodings of the parsed layout, one per instruction; an instruction
+        // with an undefined or out-of-range label has none.
+        std::vector<uint32_t> codes;
+        std::vector<bool> encoded;
+        // The block's part of the relaxed program, with addresses from
+        // relaxedBase and lines from the block's first line.
+        uint32_t relaxedBase = TEXT_SEGMENT_START;
+        uint32_t relaxedSize = 0;
+        std::vector<ParsedInstruction> relaxed;
+        std::vector<uint32_t> relaxedCodes;
+        std::vector<LabelSite> relaxedSites;
+        std::vector<SymbolId> grownTargets;
+        // The encodings the editor was last given, with lines from the
+        // block's first line and addresses from relaxedBase once relaxed or
+        // from startText otherwise.
+        std::vector<LineEncoding> shown;
+
+        int32_t textShift() const { return static_cast<int32_t>(startText - parsedText); }
+        int32_t dataShift() const { return static_cast<int32_t>(startData - parsedData); }
+    };
+
+    // One relaxation of the blocks [first, end): the relaxed instructions and
+    // their encodings, where each block starts in them, every block's new
+    // relaxed start and every label's final address, and the operands of the
+    // other blocks that change with it.
+    struct Relaxation {
+        struct Patch {
+            size_t block;
+            uint32_t instruction;
+            uint32_t firstSite;
+            ParsedInstruction inst;
+            uint32_t code;
+        };
+        std::vector<ParsedInstruction> program;
+        std::vector<uint32_t> codes;
+        std::vector<size_t> blockStarts;
+        std::vector<uint32_t> bases;
+        std::vector<uint32_t> finalAddresses;
+        std::vector<std::pair<size_t, SymbolId>> grown;
+        std::vector<Patch> patches;
+    };
+
+    static constexpr size_t NO_BLOCK = SIZE_MAX;
+
+    std::vector<std::unique_ptr<Line>> lines;
+    std::vector<Block> blocks;
+    // Names are interned for the life of a source, so blocks keep the labels
+    // they use as global ids.
+    SymbolTable symbolTable;
+    std::vector<size_t> owners;
+    // Final addresses of text labels, from the relaxed start of their block.
+    std::vector<uint32_t> labelOffsets;
+    std::vector<Diagnostic> symbolDiagnostics;
+    std::vector<Diagnostic> layoutDiagnostics;
+    bool clean = false;
+    // Reused by refreshBlock, which swaps it with a block's shown encodings.
+    std::vector<LineEncoding> refreshScratch;
+
+    inline void lexLine(Line &line, int number);
+    inline void splitBlocks(size_t index);
+    inline void parseBlock(Block &block);
+    inline void encodeParsed(Block &block, size_t index, const Assembler &encoder) const;
+    inline void linkBlock(Block &block);
+    inline void mergeSymbols();
+    inline uint32_t relaxedAddress(SymbolId id) const;
+    inline bool relaxBlocks(size_t first, size_t end, Relaxation &relaxation);
+    inline bool patchBlock(size_t index, Relaxation &relaxation) const;
+    inline void commitRelaxation(size_t first, size_t end, Relaxation &relaxation);
+    inline bool relaxProgram();
+    inline void showBlock(const Block &block, std::vector<LineEncoding> &output) const;
+    inline void refreshBlock(Block &block, std::vector<int> &refreshedLines);
+    inline EditResult update(size_t first, size_t insertedLines);
+    inline int definitionLine(const Block &block, std::string_view label) const;
+
+    static inline Diagnostic diagnose(const std::exception &error, int fallbackLine);
+};
+
+// Turns "<Stage> Error on Line N: message" into line N and
+// "<Stage> Error: message", dropping the terminal colour codes.
+inline Diagnostic IncrementalAssembler::diagnose(const std::exception &error, int fallbackLine) {
+    std::string_view text = error.what();
+    const std::string_view red = RED;
+    const std::string_view reset = RESET;
+    if (text.substr(0, red.size()) == red) text.remove_prefix(red.size());
+    if (text.size() >= reset.size() && text.substr(text.size() - reset.size()) == reset) text.remove_suffix(reset.size());
+
+    const std::string_view marker = " on Line ";
+    const size_t at = text.find(marker);
+    if (at != std::string_view::npos) {
+        size_t cursor = at + marker.size();
+        int line = 0;
+        while (cursor < text.size() && text[cursor] >= '0' && text[cursor] <= '9') {
+            line = line * 10 + (text[cursor++] - '0');
+        }
+        if (line > 0 && text.substr(cursor, 1) == ":") {
+            return {line, std::string(text.substr(0, at)) + std::string(text.substr(cursor))};
+        }
+    }
+    return {fallbackLine, std::string(text)};
+}
+
+inline void IncrementalAssembler::lexLine(Line &line, int number) {
+    line.tokens.clear();
+    line.error.clear();
+    line.number = number;
+    try {
+        Lexer::appendLine(line.text, number, line.tokens);
+    } catch (const std::exception &error) {
+        line.tokens.clear();
+        line.error = diagnose(error, number).message;
+    }
+}
+
+inline void IncrementalAssembler::splitBlocks(size_t index) {
+    Block &block = blocks[index];
+    if (block.lineCount <= 2 * BLOCK_LINES) return;
+
+    std::vector<Block> pieces;
+    for (size_t offset = 0; offset < block.lineCount; offset += BLOCK_LINES) {
+        Block piece;
+        piece.firstLine = block.firstLine + offset;
+        piece.lineCount = std::min(BLOCK_LINES, block.lineCount - offset);
+        for (const LineEncoding &encoding : block.shown) {
+            const size_t line = static_cast<size_t>(encoding.line);
+            if (line >= offset && line < offset + piece.lineCount) piece.shown.push_back({encoding.line - static_cast<int>(offset), encoding.address, encoding.code});
+        }
+        pieces.push_back(std::move(piece));
+    }
+    blocks.erase(blocks.begin() + index);
+    blocks.insert(blocks.begin() + index, std::make_move_iterator(pieces.begin()), std::make_move_iterator(pieces.end()));
+}
+
+inline EditResult IncrementalAssembler::setSource(std::string_view text) {
+    lines.clear();
+    blocks.clear();
+    symbolTable.clear();
+    owners.clear();
+    labelOffsets.clear();
+    clean = false;
+    const char* cursor = text.data();
+    const char* const end = cursor + text.size();
+    while (cursor < end) {
+        const char* lineEnd = scanByte(cursor, end, '\n');
+        auto line = std::make_unique<Line>();
+        line->text.assign(cursor, lineEnd - cursor);
+        lexLine(*line, static_cast<int>(lines.size()) + 1);
+        lines.push_back(std::move(line));
+        cursor = lineEnd < end ? lineEnd + 1 : end;
+    }
+
+    if (!lines.empty()) {
+        Block block;
+        block.lineCount = lines.size();
+        blocks.push_back(std::move(block));
+        splitBlocks(0);
+    }
+    return update(0, lines.size());
+}
+
+inline EditResult IncrementalAssembler::applyEdit(size_t firstLine, size_t removedLines, const std::vector<std::string> &insertedLines) {
+    if (firstLine < 1 || firstLine - 1 > lines.size() || removedLines > lines.size() - (firstLine - 1)) {
+        throw std::runtime_error(std::string(RED) + "Edit Error: Line range out of bounds" + RESET);
+    }
+    const size_t first = firstLine - 1;
+    const size_t last = first + removedLines;
+
+    std::vector<std::unique_ptr<Line>> replacement;
+    replacement.reserve(insertedLines.size());
+    for (size_t i = 0; i < insertedLines.size(); ++i) {
+        auto line = std::make_unique<Line>();
+        line->text = insertedLines[i];
+        lexLine(*line, static_cast<int>(first + i) + 1);
+        replacement.push_back(std::move(line));
+    }
+    lines.erase(lines.begin() + first, lines.begin() + last);
+    lines.insert(lines.begin() + first, std::make_move_iterator(replacement.begin()), std::make_move_iterator(replacement.end()));
+
+    // Blocks touching the edited range collapse into one dirty block; an
+    // insertion on a boundary joins the block that starts there.
+    size_t begin = 0;
+    while (begin < blocks.size() && blocks[begin].firstLine + blocks[begin].lineCount <= first) ++begin;
+    if (begin == blocks.size() && begin > 0) --begin;
+    size_t stop = begin;
+    while (stop < blocks.size() && (stop == begin || blocks[stop].firstLine < last)) ++stop;
+
+    Block merged;
+    merged.firstLine = stop > begin ? blocks[begin].firstLine : first;
+    const size_t mergedEnd = stop > begin ? std::max(last, blocks[stop - 1].firstLine + blocks[stop - 1].lineCount) : last;
+    const long delta = static_cast<long>(insertedLines.size()) - static_cast<long>(removedLines);
+    merged.lineCount = static_cast<size_t>(static_cast<long>(mergedEnd - merged.firstLine) + delta);
+
+    // The merged block starts out with what its lines showed before the
+    // edit, so the update can tell which of them changed.
+    for (size_t i = begin; i < stop; ++i) {
+        for (const LineEncoding &encoding : blocks[i].shown) {
+            const long line = static_cast<long>(blocks[i].firstLine) + encoding.line;
+            if (line >= static_cast<long>(first) && line < static_cast<long>(last)) continue;
+            const long moved = line < static_cast<long>(first) ? line : line + delta;
+            merged.shown.push_back({static_cast<int>(moved - static_cast<long>(merged.firstLine)), encoding.address, encoding.code});
+        }
+    }
+    blocks.erase(blocks.begin() + begin, blocks.begin() + stop);
+    for (size_t i = begin; i < blocks.size(); ++i) {
+        blocks[i].firstLine = static_cast<size_t>(static_cast<long>(blocks[i].firstLine) + delta);
+    }
+    if (merged.lineCount > 0) {
+        blocks.insert(blocks.begin() + begin, std::move(merged));
+        splitBlocks(begin);
+    }
+    // Relaxation starts at the edit even when it only removed whole blocks.
+    if (begin < blocks.size()) blocks[begin].relaxStale = true;
+    return update(first, insertedLines.size());
+}
+
+inline void IncrementalAssembler::parseBlock(Block &block) {
+    block.parser = std::make_unique<Parser>();
+    block.parser->beginStream(block.startText, block.startData, block.startsInData, true);
+    block.parser->setCompression(block.startsCompressing);
+    block.parsedText = block.startText;
+    block.parsedData = block.startData;
+    block.parsedFirst = static_cast<int>(block.firstLine) + 1;
+    block.diagnostics.clear();
+    block.linkDiagnostics.clear();
+    block.definitions.clear();
+    block.globalDefinitions.clear();
+    block.sites.clear();
+    block.relaxed.clear();
+    block.relaxedCodes.clear();
+    block.relaxedSites.clear();
+    block.grownTargets.clear();
+    block.linked = false;
+    block.touched = true;
+    block.relaxStale = true;
+
+    for (size_t i = 0; i < block.lineCount; ++i) {
+        Line &line = *lines[block.firstLine + i];
+        const int number = block.parsedFirst + static_cast<int>(i);
+        if (!line.error.empty()) {
+            block.diagnostics.push_back({static_cast<int>(i), line.error});
+            continue;
+        }
+        if (line.tokens.empty()) continue;
+        if (line.number != number) {
+            line.tokens.renumber(number);
+            line.number = number;
+        }
+        try {
+            block.parser->parseLine(line.tokens[0]);
+        } catch (const std::exception &error) {
+            Diagnostic diagnostic = diagnose(error, number);
+            diagnostic.line -= block.parsedFirst;
+            block.diagnostics.push_back(std::move(diagnostic));
+        }
+    }
+
+    block.endText = block.parser->getTextAddress();
+    block.endData = block.parser->getDataAddress();
+    block.endsInData = block.parser->isInDataSection();
+    block.endsCompressing = block.parser->isCompressing();
+
+    // Labels the block uses but does not define stay undefined in its own
+    // table; linkBlock resolves every label operand from the global one.
+    const SymbolTable &local = block.parser->getSymbolTable();
+    for (SymbolId id = 0; id < local.size(); ++id) {
+        if (!local[id].isDefined()) continue;
+        block.definitions.push_back(id);
+        block.globalDefinitions.push_back(symbolTable.intern(local.name(id)));
+    }
+    block.instructions = block.parser->takeParsedInstructions();
+    for (size_t i = 0; i < block.instructions.size(); ++i) {
+        const ParsedInstruction &inst = block.instructions[i];
+        for (size_t j = 0; j < inst.size(); ++j) {
+            if (inst[j].kind != OperandKind::LABEL) continue;
+            block.sites.push_back({static_cast<uint32_t>(i), static_cast<uint32_t>(j), symbolTable.intern(inst[j].symbol),
+                                   inst.address, 0, inst.instruction, inst[j].modifier, inst.compressed, false});
+        }
+    }
+    block.dirty = false;
+}
+
+// Range checks are left to relaxation, which may turn an out-of-range branch
+// into a longer form; until then the instruction has no encoding.
+inline void IncrementalAssembler::encodeParsed(Block &block, size_t index, const Assembler &encoder) const {
+    const ParsedInstruction &inst = block.instructions[index];
+    const InstructionDescriptor &descriptor = describe(inst.instruction);
+    bool resolved = true;
+    for (size_t i = 0; i < inst.size(); ++i) {
+        resolved = resolved && inst[i].resolved &&
+                   !(inst[i].kind == OperandKind::LABEL && isRelativeLabel(descriptor, inst[i].modifier) && !fitsOffset(descriptor, inst[i].value));
+    }
+    block.encoded[index] = false;
+    if (!resolved) return;
+    block.codes[index] = encoder.encode(inst);
+    block.encoded[index] = true;
+}
+
+// Resolves the block's label operands against the global table at the
+// block's current address. While every label stays defined or undefined,
+// only the instructions whose operands changed are encoded again; otherwise,
+// or when the block has link errors to revisit, the whole block is.
+inline void IncrementalAssembler::linkBlock(Block &block) {
+    const int32_t shift = block.textShift();
+    const Assembler encoder;
+    bool relink = !block.linked;
+    std::vector<uint32_t> changed;
+    for (size_t i = 0; !relink && i < block.sites.size(); ++i) {
+        LabelSite &site = block.sites[i];
+        const Symbol &target = symbolTable[site.target];
+        relink = target.isDefined() != site.resolved;
+        if (relink || !site.resolved) continue;
+        const int32_t value = labelOperandValue(describe(site.opcode), site.modifier, target.address, site.address + shift);
+        if (value == site.value) continue;
+        site.value = value;
+        block.instructions[site.instruction].operands[site.operand].value = value;
+        if (changed.empty() || changed.back() != site.instruction) changed.push_back(site.instruction);
+    }
+    if (!relink && (changed.empty() || block.linkDiagnostics.empty())) {
+        try {
+            for (uint32_t index : changed) encodeParsed(block, index, encoder);
+            block.touched = block.touched || !changed.empty();
+            return;
+        } catch (const std::exception &) {
+        }
+    }
+
+    block.linkDiagnostics.clear();
+    block.codes.assign(block.instructions.size(), 0);
+    block.encoded.assign(block.instructions.size(), false);
+    for (LabelSite &site : block.sites) {
+        ParsedInstruction &inst = block.instructions[site.instruction];
+        Operand &operand = inst.operands[site.operand];
+        const Symbol &target = symbolTable[site.target];
+        site.resolved = operand.resolved = target.isDefined();
+        if (site.resolved) {
+            site.value = operand.value = labelOperandValue(describe(site.opcode), site.modifier, target.address, site.address + shift);
+        } else {
+            block.linkDiagnostics.push_back({inst.lineNumber - block.parsedFirst, "Parser Error: Undefined label '" + std::string(operand.symbol) + "'"});
+        }
+    }
+    for (size_t i = 0; i < block.instructions.size(); ++i) {
+        try {
+            encodeParsed(block, i, encoder);
+        } catch (const std::exception &error) {
+            Diagnostic diagnostic = diagnose(error, block.instructions[i].lineNumber);
+            diagnostic.line -= block.parsedFirst;
+            block.linkDiagnostics.push_back(std::move(diagnostic));
+        }
+    }
+    block.linked = true;
+    block.touched = true;
+}
+
+inline int IncrementalAssembler::definitionLine(const Block &block, std::string_view label) const {
+    for (size_t i = 0; i < block.lineCount; ++i) {
+        const TokenArena &tokens = lines[block.firstLine + i]->tokens;
+        if (tokens.empty()) continue;
+        for (const TokenView &token : tokens[0]) {
+            if (token.type == TokenType::LABEL && token.value == label) return static_cast<int>(i);
+        }
+    }
+    return 0;
+}
+
+// Rebuilds the definitions of the global table from every block at its
+// current address and notes which block owns each label.
+inline void IncrementalAssembler::mergeSymbols() {
+    symbolTable.resetDefinitions();
+    symbolDiagnostics.clear();
+    owners.assign(symbolTable.size(), NO_BLOCK);
+    for (size_t index = 0; index < blocks.size(); ++index) {
+        const Block &block = blocks[index];
+        const SymbolTable &local = block.parser->getSymbolTable();
+        for (size_t i = 0; i < block.definitions.size(); ++i) {
+            const Symbol &symbol = local[block.definitions[i]];
+            const SymbolId global = block.globalDefinitions[i];
+            if (symbolTable[global].isDefined() && symbol.kind == SymbolKind::TEXT) {
+                symbolDiagnostics.push_back({static_cast<int>(block.firstLine) + 1 + definitionLine(block, local.name(block.definitions[i])),
+                                             "Parser Error: Duplicate label '" + std::string(local.name(block.definitions[i])) + "'"});
+                continue;
+            }
+            symbolTable.import(global, local, symbol);
+            symbolTable[global].address += symbol.kind == SymbolKind::TEXT ? block.textShift() : block.dataShift();
+            owners[global] = index;
+        }
+    }
+}
+
+inline uint32_t IncrementalAssembler::relaxedAddress(SymbolId id) const {
+    const Symbol &symbol = symbolTable[id];
+    return symbol.kind == SymbolKind::TEXT ? blocks[owners[id]].relaxedBase + labelOffsets[id] : symbol.address;
+}
+
+// Relaxes the blocks [first, end) after the relaxed layout of the blocks
+// before them, with the labels of the blocks after them moving with their
+// end, and works out where every block and label ends up.
+inline bool IncrementalAssembler::relaxBlocks(size_t first, size_t end, Relaxation &relaxation) {
+    relaxation.program.clear();
+    relaxation.codes.clear();
+    relaxation.blockStarts.clear();
+    relaxation.grown.clear();
+    relaxation.patches.clear();
+
+    const uint32_t base = first == 0 ? TEXT_SEGMENT_START : blocks[first - 1].relaxedBase + blocks[first - 1].relaxedSize;
+    const uint32_t shift = first < end ? base - blocks[first].startText : 0;
+    const uint32_t parsedEnd = first < end ? blocks[end - 1].startText + (blocks[end - 1].endText - blocks[end - 1].parsedText) + shift : base;
+    const uint32_t suffixBase = end < blocks.size() ? blocks[end].relaxedBase : 0;
+
+    // The table keeps the parsed layout for the next edit.
+    std::vector<uint32_t> parsedAddresses(symbolTable.size());
+    for (SymbolId id = 0; id < symbolTable.size(); ++id) {
+        Symbol &symbol = symbolTable[id];
+        parsedAddresses[id] = symbol.address;
+        if (symbol.kind != SymbolKind::TEXT) continue;
+        if (owners[id] < first) {
+            symbol.address = relaxedAddress(id);
+        } else if (owners[id] < end) {
+            symbol.address += shift;
+        } else {
+            symbol.address = parsedEnd + (relaxedAddress(id) - suffixBase);
+        }
+    }
+
+    for (size_t index = first; index < end; ++index) {
+        const Block &block = blocks[index];
+        const uint32_t move = block.textShift() + shift;
+        const int lineShift = static_cast<int>(block.firstLine) + 1 - block.parsedFirst;
+        relaxation.blockStarts.push_back(relaxation.program.size());
+        for (const ParsedInstruction &inst : block.instructions) {
+            relaxation.program.push_back(inst);
+            relaxation.program.back().address += move;
+            relaxation.program.back().lineNumber += lineShift;
+        }
+    }
+
+    bool relaxed = true;
+    Relaxer relaxer;
+    try {
+        relaxer.relax(relaxation.program, symbolTable);
+        const Assembler encoder;
+        relaxation.codes.reserve(relaxation.program.size());
+        for (const ParsedInstruction &inst : relaxation.program) {
+            relaxation.codes.push_back(encoder.encode(inst));
+        }
+    } catch (const std::exception &error) {
+        if (first == 0 && end == blocks.size()) layoutDiagnostics.push_back(diagnose(error, 1));
+        relaxed = false;
+    }
+
+    if (relaxed) {
+        relaxation.bases.resize(blocks.size());
+        for (size_t index = 0; index < first; ++index) relaxation.bases[index] = blocks[index].relaxedBase;
+        uint32_t running = base;
+        size_t cursor = 0;
+        for (size_t index = first; index < end; ++index) {
+            relaxation.bases[index] = running;
+            const int lastLine = static_cast<int>(blocks[index].firstLine + blocks[index].lineCount);
+            for (; cursor < relaxation.program.size() && relaxation.program[cursor].lineNumber <= lastLine; ++cursor) {
+                const ParsedInstruction &inst = relaxation.program[cursor];
+                running = inst.address + (inst.compressed ? COMPRESSED_INSTRUCTION_SIZE : INSTRUCTION_SIZE);
+            }
+        }
+        for (size_t index = end; index < blocks.size(); ++index) {
+            relaxation.bases[index] = running;
+            running += blocks[index].relaxedSize;
+        }
+
+        relaxation.finalAddresses.resize(symbolTable.size());
+        for (SymbolId id = 0; id < symbolTable.size(); ++id) {
+            const Symbol &symbol = symbolTable[id];
+            uint32_t address = parsedAddresses[id];
+            if (symbol.kind == SymbolKind::TEXT) {
+                address = owners[id] < end ? symbol.address : relaxation.bases[owners[id]] + labelOffsets[id];
+            }
+            relaxation.finalAddresses[id] = address;
+        }
+        for (size_t index : relaxer.getGrown()) {
+            const auto block = std::upper_bound(relaxation.blockStarts.begin(), relaxation.blockStarts.end(), index) - 1;
+            relaxation.grown.emplace_back(first + static_cast<size_t>(block - relaxation.blockStarts.begin()), relaxer.getTarget(index));
+        }
+    }
+
+    for (SymbolId id = 0; id < symbolTable.size(); ++id) symbolTable[id].address = parsedAddresses[id];
+    return relaxed;
+}
+
+// Resolves the relaxed operands of a block outside the relaxed range again
+// at the block's new start; false when one no longer fits its form.
+inline bool IncrementalAssembler::patchBlock(size_t index, Relaxation &relaxation) const {
+    const Block &block = blocks[index];
+    const uint32_t base = relaxation.bases[index];
+    const size_t firstPatch = relaxation.patches.size();
+    for (size_t i = 0; i < block.relaxedSites.size(); ++i) {
+        const LabelSite &site = block.relaxedSites[i];
+        const InstructionDescriptor &descriptor = describe(site.opcode);
+        const int32_t value = labelOperandValue(descriptor, site.modifier, relaxation.finalAddresses[site.target], base + site.address);
+        if (value == site.value) continue;
+        if (isRelativeLabel(descriptor, site.modifier) &&
+            !(site.compressed ? (value & 1) == 0 && rvc::fitsSigned(value, descriptor.isBranch() ? 9 : 12) : fitsOffset(descriptor, value))) {
+            return false;
+        }
+        if (relaxation.patches.size() == firstPatch || relaxation.patches.back().instruction != site.instruction) {
+            relaxation.patches.push_back({index, site.instruction, static_cast<uint32_t>(i), block.relaxed[site.instruction], 0});
+        }
+        relaxation.patches.back().inst.operands[site.operand].value = value;
+    }
+
+    const Assembler encoder;
+    try {
+        for (size_t i = firstPatch; i < relaxation.patches.size(); ++i) {
+            relaxation.patches[i].code = encoder.encode(relaxation.patches[i].inst);
+        }
+    } catch (const std::exception &) {
+        return false;
+    }
+    return true;
+}
+
+inline void IncrementalAssembler::commitRelaxation(size_t first, size_t end, Relaxation &relaxation) {
+    size_t cursor = 0;
+    for (size_t index = first; index < end; ++index) {
+        Block &block = blocks[index];
+        const int firstLine = static_cast<int>(block.firstLine) + 1;
+        const int lastLine = static_cast<int>(block.firstLine + block.lineCount);
+        const size_t begin = cursor;
+        while (cursor < relaxation.program.size() && relaxation.program[cursor].lineNumber <= lastLine) ++cursor;
+
+        block.relaxedBase = relaxation.bases[index];
+        block.relaxedSize = 0;
+        block.relaxed.assign(std::make_move_iterator(relaxation.program.begin() + begin), std::make_move_iterator(relaxation.program.begin() + cursor));
+        block.relaxedCodes.assign(relaxation.codes.begin() + begin, relaxation.codes.begin() + cursor);
+        block.relaxedSites.clear();
+        block.grownTargets.clear();
+        block.touched = true;
+        for (size_t i = 0; i < block.relaxed.size(); ++i) {
+            ParsedInstruction &inst = block.relaxed[i];
+            block.relaxedSize = inst.address + (inst.compressed ? COMPRESSED_INSTRUCTION_SIZE : INSTRUCTION_SIZE) - block.relaxedBase;
+            inst.address -= block.relaxedBase;
+            inst.lineNumber -= firstLine;
+            for (size_t j = 0; j < inst.size(); ++j) {
+                if (inst[j].kind != OperandKind::LABEL) continue;
+                block.relaxedSites.push_back({static_cast<uint32_t>(i), static_cast<uint32_t>(j), symbolTable.find(inst[j].symbol),
+                                              inst.address, inst[j].value, inst.instruction, inst[j].modifier, inst.compressed, true});
+            }
+        }
+    }
+    for (const auto &[index, target] : relaxation.grown) blocks[index].grownTargets.push_back(target);
+    for (size_t index = end; index < blocks.size(); ++index) blocks[index].relaxedBase = relaxation.bases[index];
+    for (Relaxation::Patch &patch : relaxation.patches) {
+        Block &block = blocks[patch.block];
+        for (size_t i = patch.firstSite; i < block.relaxedSites.size() && block.relaxedSites[i].instruction == patch.instruction; ++i) {
+            block.relaxedSites[i].value = patch.inst.operands[block.relaxedSites[i].operand].value;
+        }
+        block.relaxed[patch.instruction] = std::move(patch.inst);
+        block.relaxedCodes[patch.instruction] = patch.code;
+        block.touched = true;
+    }
+
+    for (SymbolId id = 0; id < symbolTable.size(); ++id) {
+        if (symbolTable[id].kind == SymbolKind::TEXT && owners[id] >= first && owners[id] < end) {
+            labelOffsets[id] = relaxation.finalAddresses[id] - relaxation.bases[owners[id]];
+        }
+    }
+    for (Block &block : blocks) block.relaxStale = false;
+}
+
+// Relaxes from the first to the last re-parsed block: the blocks before them
+// keep their layout and the blocks after them move as a whole. The range
+// grows to any block with a lengthened branch or call whose distance to its
+// target could change, since it might be shorter now, and to any block with
+// an operand that no longer fits once the others have moved. A relaxation
+// error is only reported when relaxing the whole program fails too.
+inline bool IncrementalAssembler::relaxProgram() {
+    labelOffsets.resize(symbolTable.size());
+    size_t first = blocks.size(), end = 0;
+    for (size_t index = 0; index < blocks.size(); ++index) {
+        if (!blocks[index].relaxStale) continue;
+        first = std::min(first, index);
+        end = index + 1;
+    }
+    end = std::max(first, end);
+
+    Relaxation relaxation;
+    while (true) {
+        for (size_t index = first; index-- > 0;) {
+            const std::vector<SymbolId> &targets = blocks[index].grownTargets;
+            if (std::any_of(targets.begin(), targets.end(), [&](SymbolId id) { return symbolTable[id].kind == SymbolKind::TEXT && owners[id] >= first; })) {
+                first = index;
+            }
+        }
+        for (size_t index = end; index < blocks.size(); ++index) {
+            const std::vector<SymbolId> &targets = blocks[index].grownTargets;
+            if (std::any_of(targets.begin(), targets.end(), [&](SymbolId id) { return symbolTable[id].kind != SymbolKind::TEXT || owners[id] < end; })) {
+                end = index + 1;
+            }
+        }
+
+        if (!relaxBlocks(first, end, relaxation)) {
+            if (first == 0 && end == blocks.size()) return false;
+            first = 0;
+            end = blocks.size();
+            continue;
+        }
+        size_t lowest = first, highest = end;
+        for (size_t index = 0; index < first; ++index) {
+            if (!patchBlock(index, relaxation)) lowest = std::min(lowest, index);
+        }
+        for (size_t index = end; index < blocks.size(); ++index) {
+            if (!patchBlock(index, relaxation)) highest = index + 1;
+        }
+        if (lowest == first && highest == end) break;
+        first = lowest;
+        end = highest;
+    }
+    commitRelaxation(first, end, relaxation);
+    return true;
+}
+
+inline void IncrementalAssembler::showBlock(const Block &block, std::vector<LineEncoding> &output) const {
+    output.clear();
+    if (clean) {
+        for (size_t i = 0; i < block.relaxed.size(); ++i) {
+            output.push_back({block.relaxed[i].lineNumber, block.relaxed[i].address, block.relaxedCodes[i]});
+        }
+        return;
+    }
+    for (size_t i = 0; i < block.instructions.size(); ++i) {
+        if (!block.encoded[i]) continue;
+        output.push_back({block.instructions[i].lineNumber - block.parsedFirst, block.instructions[i].address - block.parsedText, block.codes[i]});
+    }
+}
+
+// Shows the block's current encodings and notes the lines whose machine code
+// differs from what they showed before.
+inline void IncrementalAssembler::refreshBlock(Block &block, std::vector<int> &refreshedLines) {
+    std::vector<LineEncoding> &current = refreshScratch;
+    showBlock(block, current);
+    const std::vector<LineEncoding> &before = block.shown;
+    const int firstLine = static_cast<int>(block.firstLine) + 1;
+    size_t old = 0, now = 0;
+    while (old < before.size() || now < current.size()) {
+        const int line = std::min(old < before.size() ? before[old].line : INT32_MAX, now < current.size() ? current[now].line : INT32_MAX);
+        size_t oldEnd = old, nowEnd = now;
+        while (oldEnd < before.size() && before[oldEnd].line == line) ++oldEnd;
+        while (nowEnd < current.size() && current[nowEnd].line == line) ++nowEnd;
+        bool same = oldEnd - old == nowEnd - now;
+        for (size_t i = 0; same && i < oldEnd - old; ++i) {
+            same = before[old + i].code == current[now + i].code;
+        }
+        if (!same) refreshedLines.push_back(firstLine + line);
+        old = oldEnd;
+        now = nowEnd;
+    }
+    block.shown.swap(current);
+    block.touched = false;
+}
+
+inline EditResult IncrementalAssembler::update(size_t first, size_t insertedLines) {
+    EditResult result;
+    result.lexedLines = insertedLines;
+
+    uint32_t textAddress = TEXT_SEGMENT_START;
+    uint32_t dataAddress = DATA_SEGMENT_START;
+    bool inData = false;
+    bool compressing = false;
+    for (Block &block : blocks) {
+        block.startText = textAddress;
+        block.startData = dataAddress;
+        if (block.dirty || block.parser == nullptr || block.startsInData != inData || block.startsCompressing != compressing) {
+            block.startsInData = inData;
+            block.startsCompressing = compressing;
+            parseBlock(block);
+            result.parsedLines += block.lineCount;
+        }
+        textAddress = block.startText + (block.endText - block.parsedText);
+        dataAddress = block.startData + (block.endData - block.parsedData);
+        inData = block.endsInData;
+        compressing = block.endsCompressing;
+    }
+
+    mergeSymbols();
+    for (Block &block : blocks) linkBlock(block);
+
+    // While any block has errors parse() would not relax either, and each
+    // block shows the encodings of its own parsed layout instead.
+    layoutDiagnostics.clear();
+    bool relaxable = symbolDiagnostics.empty();
+    for (const Block &block : blocks) {
+        relaxable = relaxable && block.diagnostics.empty() && block.linkDiagnostics.empty();
+    }
+    const bool wasClean = clean;
+    clean = relaxable && relaxProgram();
+
+    // A line is refreshed when it was edited or when its machine code differs
+    // from the code it had before the edit moved it.
+    std::vector<int> refreshedLines;
+    for (size_t line = first + 1; line <= first + insertedLines; ++line) refreshedLines.push_back(static_cast<int>(line));
+    for (Block &block : blocks) {
+        if (block.touched || clean != wasClean) refreshBlock(block, refreshedLines);
+    }
+    std::sort(refreshedLines.begin(), refreshedLines.end());
+    refreshedLines.erase(std::unique(refreshedLines.begin(), refreshedLines.end()), refreshedLines.end());
+
+    for (int line : refreshedLines) {
+        if (!result.refreshed.empty() && result.refreshed.back().first + static_cast<int>(result.refreshed.back().count) == line) {
+            ++result.refreshed.back().count;
+        } else {
+            result.refreshed.push_back({line, 1});
+        }
+        const std::vector<LineEncoding> current = getLineEncodings(line);
+        result.updated.insert(result.updated.end(), current.begin(), current.end());
+    }
+
+    result.diagnostics = getDiagnostics();
+    return result;
+}
+
+inline std::vector<LineEncoding> IncrementalAssembler::getEncodings() const {
+    std::vector<LineEncoding> encodings;
+    for (const Block &block : blocks) {
+        const int firstLine = static_cast<int>(block.firstLine) + 1;
+        const uint32_t base = clean ? block.relaxedBase : block.startText;
+        for (const LineEncoding &encoding : block.shown) {
+            encodings.push_back({firstLine + encoding.line, base + encoding.address, encoding.code});
+        }
+    }
+    return encodings;
+}
+
+inline std::vector<LineEncoding> IncrementalAssembler::getLineEncodings(int line) const {
+    std::vector<LineEncoding> found;
+    auto block = std::upper_bound(blocks.begin(), blocks.end(), line, [](int value, const Block &candidate) { return value <= static_cast<int>(candidate.firstLine); });
+    if (block == blocks.begin()) return found;
+    --block;
+    const int offset = line - static_cast<int>(block->firstLine) - 1;
+    const uint32_t base = clean ? block->relaxedBase : block->startText;
+    for (const LineEncoding &encoding : block->shown) {
+        if (encoding.line == offset) found.push_back({line, base + encoding.address, encoding.code});
+    }
+    return found;
+}
+
+inline std::vector<Diagnostic> IncrementalAssembler::getDiagnostics() const {
+    std::vector<Diagnostic> diagnostics = symbolDiagnostics;
+    diagnostics.insert(diagnostics.end(), layoutDiagnostics.begin(), layoutDiagnostics.end());
+    for (const Block &block : blocks) {
+        const int first = static_cast<int>(block.firstLine) + 1;
+        for (const Diagnostic &diagnostic : block.diagnostics) {
+            diagnostics.push_back({first + diagnostic.line, diagnostic.message});
+        }
+        for (const Diagnostic &diagnostic : block.linkDiagnostics) {
+            diagnostics.push_back({first + diagnostic.line, diagnostic.message});
+        }
+    }
+    std::stable_sort(diagnostics.begin(), diagnostics.end(), [](const Diagnostic &a, const Diagnostic &b) { return a.line < b.line; });
+    return diagnostics;
+}
+
+inline MemoryImage IncrementalAssembler::buildImage() const {
+    Assembler dataAssembler(symbolTable);
+    dataAssembler.assemble();
+
+    MemoryImage image;
+    for (const LineEncoding &encoding : getEncodings()) {
+        image.appendText(encoding.address, encoding.code);
+    }
+    image.data = dataAssembler.takeImage().data;
+    image.finalize();
+    return image;
+}
+
+#endif
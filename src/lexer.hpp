@@ -4,33 +4,45 @@
 #include <sstream>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <memory>
+#include <cstring>
 #include <cctype>
 #include <algorithm>
 #include <stdexcept>
 #include "types.hpp"
+#include "source.hpp"
 
 using namespace riscv;
 
 class Lexer {
 public:
     static std::vector<std::vector<Token>> tokenize(const std::string& input);
+    static TokenArena tokenizeArena(std::string input);
+    static TokenArena tokenizeArena(std::shared_ptr<const std::string> input);
+    static TokenArena tokenizeArena(std::shared_ptr<const SourceBuffer> input);
+    static TokenArena tokenizeRange(std::shared_ptr<const void> owner, std::string_view text, int firstLine);
+    static void appendLine(std::string_view line, int lineNumber, TokenArena& arena);
 
 private:
     static std::vector<Token> tokenizeLine(const std::string& line, int lineNumber);
+    static void tokenizeLine(std::string_view line, int lineNumber, TokenArena& arena);
+    static TokenArena tokenizeSource(TokenArena arena, int firstLine = 1);
 
     static Token classifyToken(const std::string& token, int lineNumber);
+    static TokenType classifyToken(std::string_view& token, int lineNumber);
 
-    static bool isDirective(const std::string& token);
-    static bool isLabel(const std::string& token);
+    static bool isDirective(std::string_view token);
+    static bool isLabel(std::string_view token);
 
     static void reportError(const std::string& message, int lineNumber);
 };
 
-inline bool Lexer::isDirective(const std::string& token) {
-    return directives.count(token) > 0;
+inline bool Lexer::isDirective(std::string_view token) {
+    return isKeyword(token, KeywordKind::DIRECTIVE);
 }
 
-inline bool Lexer::isLabel(const std::string& token) {
+inline bool Lexer::isLabel(std::string_view token) {
     return !token.empty() && token.back() == ':' && std::all_of(token.begin(), token.end() - 1, [](char c) { return std::isalnum(c) || c == '_' || c == '.'; });
 }
 
@@ -40,10 +52,11 @@ inline Token Lexer::classifyToken(const std::string& token, int lineNumber) {
         throw std::runtime_error(std::string(RED) + "Empty token found on line " + std::to_string(lineNumber) + RESET);
         return {TokenType::UNKNOWN, "", lineNumber};
     }
-    if (isRegister(trimmed)) {
+    if (isRegister(trimmed) || isFloatRegister(trimmed) || isVectorRegister(trimmed)) {
         return {TokenType::REGISTER, trimmed, lineNumber};
     }
-    if (opcodes.count(trimmed)) {
+    if (isKeyword(trimmed, KeywordKind::OPCODE) || isKeyword(trimmed, KeywordKind::PSEUDO) || isKeyword(trimmed, KeywordKind::COMPRESSED) ||
+        lookupCustomInstruction(trimmed) != Instructions::INVALID) {
         return {TokenType::OPCODE, trimmed, lineNumber};
     }
     if (isDirective(trimmed)) {
@@ -58,6 +71,37 @@ inline Token Lexer::classifyToken(const std::string& token, int lineNumber) {
     return {TokenType::UNKNOWN, trimmed, lineNumber};
 }
 
+inline TokenType Lexer::classifyToken(std::string_view& token, int lineNumber) {
+    token = trimView(token);
+    if (token.empty()) {
+        throw std::runtime_error(std::string(RED) + "Empty token found on line " + std::to_string(lineNumber) + RESET);
+    }
+    if (const Keyword* keyword = findKeyword(token)) {
+        switch (keyword->kind) {
+            case KeywordKind::REGISTER:
+            case KeywordKind::FLOAT_REGISTER:
+            case KeywordKind::VECTOR_REGISTER: return TokenType::REGISTER;
+            case KeywordKind::OPCODE:
+            case KeywordKind::PSEUDO:
+            case KeywordKind::COMPRESSED: return TokenType::OPCODE;
+            case KeywordKind::DIRECTIVE: return TokenType::DIRECTIVE;
+            case KeywordKind::CSR:
+            case KeywordKind::ROUNDING_MODE:
+            case KeywordKind::VECTOR_TYPE: break;
+        }
+    } else if (lookupCustomInstruction(token) != Instructions::INVALID) {
+        return TokenType::OPCODE;
+    }
+    if (isImmediate(token)) {
+        return TokenType::IMMEDIATE;
+    }
+    if (isLabel(token) && token.length() > 1) {
+        token.remove_suffix(1);
+        return TokenType::LABEL;
+    }
+    return TokenType::UNKNOWN;
+}
+
 inline void Lexer::reportError(const std::string& message, int lineNumber) {
     throw std::runtime_error(std::string(RED) + "Lexer Error on Line " + std::to_string(lineNumber) + ": " + message + RESET);
 }
@@ -108,9 +152,16 @@ inline std::vector<Token> Lexer::tokenizeLine(const std::string& line, int lineN
             if (parenthesesCount == 0) {
                 inMemory = false;
                 std::string offset, reg;
+                std::string_view relocation, base;
+                OperandModifier modifier;
                 if (isMemory(currentToken, offset, reg)) {
                     tokens.push_back({TokenType::IMMEDIATE, offset, lineNumber});
                     tokens.push_back({TokenType::REGISTER, reg, lineNumber});
+                } else if (isRelocatedMemory(currentToken, relocation, base)) {
+                    tokens.push_back({TokenType::UNKNOWN, std::string(relocation), lineNumber});
+                    tokens.push_back({TokenType::REGISTER, std::string(base), lineNumber});
+                } else if (parseRelocationOperator(currentToken, modifier, relocation)) {
+                    continue;
                 } else {
                     throw std::runtime_error(std::string(RED) + "Invalid memory reference: " + currentToken + RESET);
                 }
@@ -162,4 +213,137 @@ inline std::vector<std::vector<Token>> Lexer::tokenize(const std::string& input)
     return tokenizedLines;
 }
 
+inline void Lexer::tokenizeLine(std::string_view line, int lineNumber, TokenArena& arena) {
+    const std::string_view trimmedLine = trimView(line);
+    if (trimmedLine.empty()) return;
+
+    const size_t length = trimmedLine.length();
+    const char* const data = trimmedLine.data();
+    size_t tokenStart = std::string_view::npos;
+    bool inString = false;
+    bool inMemory = false;
+    int parenthesesCount = 0;
+
+    auto flush = [&](size_t tokenEnd) {
+        if (tokenStart == std::string_view::npos) return;
+        std::string_view token = trimmedLine.substr(tokenStart, tokenEnd - tokenStart);
+        TokenType type = classifyToken(token, lineNumber);
+        arena.push(type, token, lineNumber);
+        tokenStart = std::string_view::npos;
+    };
+
+    for (size_t i = 0; i < length; ++i) {
+        char c = trimmedLine[i];
+        if (!inString && !inMemory && (c == '#' || (c == '/' && i + 1 < length && trimmedLine[i + 1] == '/'))) {
+            flush(i);
+            break;
+        }
+        if (c == '"' && !inMemory) {
+            if (inString) {
+                arena.push(TokenType::STRING, trimmedLine.substr(tokenStart, i - tokenStart), lineNumber);
+                tokenStart = std::string_view::npos;
+                inString = false;
+            } else {
+                flush(i);
+                tokenStart = i + 1;
+                inString = true;
+                i = scanByte(data + i + 1, data + length, '"') - data - 1;
+            }
+            continue;
+        }
+        if (inString) {
+            continue;
+        }
+        if (c == '(' && !inMemory) {
+            inMemory = true;
+            parenthesesCount = 1;
+            if (tokenStart == std::string_view::npos) tokenStart = i;
+            continue;
+        }
+        if (inMemory) {
+            if (c == '(') ++parenthesesCount;
+            if (c == ')') --parenthesesCount;
+            if (parenthesesCount == 0) {
+                inMemory = false;
+                std::string_view memoryToken = trimmedLine.substr(tokenStart, i + 1 - tokenStart);
+                std::string_view offset, reg;
+                OperandModifier modifier;
+                if (isMemory(memoryToken, offset, reg)) {
+                    arena.push(TokenType::IMMEDIATE, offset, lineNumber);
+                    arena.push(TokenType::REGISTER, reg, lineNumber);
+                } else if (isRelocatedMemory(memoryToken, offset, reg)) {
+                    arena.push(TokenType::UNKNOWN, offset, lineNumber);
+                    arena.push(TokenType::REGISTER, reg, lineNumber);
+                } else if (parseRelocationOperator(memoryToken, modifier, offset)) {
+                    // %hi(sym) stays one token; a (reg) right after it
+                    // makes it a memory operand.
+                    continue;
+                } else {
+                    throw std::runtime_error(std::string(RED) + "Invalid memory reference: " + std::string(memoryToken) + RESET);
+                }
+                tokenStart = std::string_view::npos;
+            }
+            continue;
+        }
+        if (std::isspace(static_cast<unsigned char>(c)) || c == ',') {
+            flush(i);
+            continue;
+        }
+        if (tokenStart == std::string_view::npos) tokenStart = i;
+        i = scanDelimiter(data + i + 1, data + length) - data - 1;
+    }
+    if (inString) {
+        reportError("Unterminated string", lineNumber);
+    }
+    if (inMemory) {
+        reportError("Unterminated memory reference", lineNumber);
+    }
+    flush(length);
+}
+
+inline TokenArena Lexer::tokenizeArena(std::string input) {
+    return tokenizeArena(std::make_shared<const std::string>(std::move(input)));
+}
+
+inline TokenArena Lexer::tokenizeArena(std::shared_ptr<const std::string> input) {
+    if (!input || input->empty()) {
+        reportError("Empty input provided", 0);
+    }
+    std::string_view text(*input);
+    return tokenizeSource(TokenArena(std::move(input), text));
+}
+
+inline TokenArena Lexer::tokenizeArena(std::shared_ptr<const SourceBuffer> input) {
+    if (!input || input->empty()) {
+        reportError("Empty input provided", 0);
+    }
+    std::string_view text = input->view();
+    return tokenizeSource(TokenArena(std::move(input), text));
+}
+
+inline void Lexer::appendLine(std::string_view line, int lineNumber, TokenArena& arena) {
+    size_t start = arena.mark();
+    tokenizeLine(line, lineNumber, arena);
+    arena.closeLine(start);
+}
+
+inline TokenArena Lexer::tokenizeRange(std::shared_ptr<const void> owner, std::string_view text, int firstLine) {
+    return tokenizeSource(TokenArena(std::move(owner), text), firstLine);
+}
+
+inline TokenArena Lexer::tokenizeSource(TokenArena arena, int firstLine) {
+    const std::string_view source = arena.getSource();
+    const char* cursor = source.data();
+    const char* const end = cursor + source.size();
+    arena.reserve(source.size() / 6, source.size() / 20);
+    int lineNumber = firstLine - 1;
+
+    while (cursor < end) {
+        const char* lineEnd = scanByte(cursor, end, '\n');
+        appendLine(std::string_view(cursor, lineEnd - cursor), ++lineNumber, arena);
+        cursor = lineEnd < end ? lineEnd + 1 : end;
+    }
+    return arena;
+}
+
 #endif
\ No newline at end of file
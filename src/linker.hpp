@@ -0,0 +1,271 @@
+#ifndef LINKER_HPP
+#define LINKER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "symbols.hpp"
+#include "assembler.hpp"
+#include "image.hpp"
+#include "object.hpp"
+#include "compressed.hpp"
+
+using namespace riscv;
+
+// Assembles one source file without requiring every label to be defined.
+// Every label operand, local or not, becomes a relocation and is encoded with
+// a zero immediate, so the object can be placed anywhere by the linker.
+class ObjectAssembler {
+public:
+    inline ObjectFile assemble(std::shared_ptr<const SourceBuffer> source) const;
+};
+
+inline ObjectFile ObjectAssembler::assemble(std::shared_ptr<const SourceBuffer> source) const {
+    const TokenArena tokens = Lexer::tokenizeArena(std::move(source));
+    Parser parser;
+    parser.beginStream();
+    for (const TokenLine line : tokens) {
+        parser.parseLine(line);
+    }
+
+    const SymbolTable &table = parser.getSymbolTable();
+    std::vector<bool> isGlobal(table.size(), false);
+    for (SymbolId id : parser.getGlobals()) isGlobal[id] = true;
+
+    ObjectFile object;
+    std::vector<uint32_t> indexOf(table.size(), UINT32_MAX);
+    auto symbolIndex = [&](SymbolId id) {
+        if (indexOf[id] == UINT32_MAX) {
+            const Symbol &symbol = table[id];
+            const uint32_t base = symbol.kind == SymbolKind::DATA ? DATA_SEGMENT_START : TEXT_SEGMENT_START;
+            indexOf[id] = static_cast<uint32_t>(object.symbols.size());
+            object.symbols.push_back({std::string(table.name(id)), symbol.kind,
+                                      (isGlobal[id] || !symbol.isDefined()) ? SymbolBinding::GLOBAL : SymbolBinding::LOCAL,
+                                      symbol.isDefined() ? symbol.address - base : 0});
+        }
+        return indexOf[id];
+    };
+    for (SymbolId id = 0; id < table.size(); ++id) {
+        if (table[id].isDefined() || isGlobal[id]) symbolIndex(id);
+    }
+
+    const Assembler encoder;
+    for (const ParsedInstruction &inst : parser.getParsedInstructions()) {
+        ParsedInstruction placed = inst;
+        for (size_t i = 0; i < placed.size(); ++i) {
+            Operand &operand = placed.operands[i];
+            if (operand.kind != OperandKind::LABEL) continue;
+            object.relocations.push_back({inst.address - TEXT_SEGMENT_START, symbolIndex(table.find(operand.symbol)), relocationTypeOf(describe(inst.instruction), operand.modifier), 0});
+            operand.value = 0;
+            operand.resolved = true;
+        }
+        object.memory.appendText(inst.address - TEXT_SEGMENT_START, encoder.encode(placed));
+    }
+
+    Assembler dataAssembler(table);
+    dataAssembler.assemble();
+    for (DataSection &section : dataAssembler.takeImage().data) {
+        section.base -= DATA_SEGMENT_START;
+        object.memory.data.push_back(std::move(section));
+    }
+    object.memory.finalize();
+    return object;
+}
+
+// Places objects one after another from TEXT_SEGMENT_START and
+// DATA_SEGMENT_START in the order they were added, resolves undefined
+// symbols against the global symbols of all objects and patches every
+// relocation. Execution starts at a global _start if one is defined.
+class Linker {
+public:
+    static constexpr uint32_t SECTION_ALIGNMENT = 4;
+
+    inline void addObject(ObjectFile object, std::string name);
+    inline void link();
+
+    inline const ProgramImage& getImage() const { return image; }
+    inline size_t getObjectCount() const { return inputs.size(); }
+    inline size_t getRelocationCount() const { return relocationCount; }
+
+private:
+    struct Input {
+        std::string name;
+        ObjectFile object;
+        uint32_t textBase = TEXT_SEGMENT_START;
+        uint32_t dataBase = DATA_SEGMENT_START;
+    };
+
+    struct GlobalSymbol {
+        uint32_t address;
+        size_t input;
+    };
+
+    std::vector<Input> inputs;
+    std::unordered_map<std::string, GlobalSymbol> globals;
+    ProgramImage image;
+    size_t relocationCount = 0;
+
+    inline void layout();
+    inline void collectGlobals();
+    inline void relocate(Input &input);
+    inline uint32_t patch(uint32_t word, RelocationType type, int32_t value, const std::string &symbol, const Input &input) const;
+
+    static inline uint32_t align(uint32_t value) { return (value + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1); }
+    static inline uint32_t addressOf(const Input &input, const ObjectSymbol &symbol) {
+        return (symbol.kind == SymbolKind::DATA ? input.dataBase : input.textBase) + symbol.offset;
+    }
+    [[noreturn]] static inline void reportError(const std::string &message) {
+        throw std::runtime_error(std::string(RED) + "Linker Error: " + message + RESET);
+    }
+};
+
+inline void Linker::addObject(ObjectFile object, std::string name) {
+    Input input;
+    input.name = std::move(name);
+    input.object = std::move(object);
+    inputs.push_back(std::move(input));
+}
+
+inline void Linker::layout() {
+    uint64_t text = TEXT_SEGMENT_START;
+    uint64_t data = DATA_SEGMENT_START;
+    for (Input &input : inputs) {
+        input.textBase = static_cast<uint32_t>(text);
+        input.dataBase = static_cast<uint32_t>(data);
+        text += align(input.object.textSize());
+        data += align(input.object.dataSize());
+    }
+    if (text > DATA_SEGMENT_START) reportError("Text does not fit below the data segment");
+    if (data > MEMORY_SIZE) reportError("Data does not fit in guest memory");
+}
+
+inline void Linker::collectGlobals() {
+    globals.clear();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        for (const ObjectSymbol &symbol : inputs[i].object.symbols) {
+            if (symbol.binding != SymbolBinding::GLOBAL || !symbol.isDefined()) continue;
+            auto [it, inserted] = globals.emplace(symbol.name, GlobalSymbol{addressOf(inputs[i], symbol), i});
+            if (!inserted) {
+                reportError("Duplicate symbol '" + symbol.name + "' in " + inputs[it->second.input].name + " and " + inputs[i].name);
+            }
+        }
+    }
+}
+
+// A compressed instruction is patched through the word it expands to and must
+// still fit its parcel afterwards.
+inline uint32_t Linker::patch(uint32_t word, RelocationType type, int32_t value, const std::string &symbol, const Input &input) const {
+    if (isCompressedParcel(word)) {
+        const uint32_t expanded = expandCompressed(static_cast<uint16_t>(word));
+        if (expanded == 0) {
+            reportError("Relocation for '" + symbol + "' in " + input.name + " does not point at an instruction");
+        }
+        const uint16_t parcel = compressInstruction(patch(expanded, type, value, symbol, input));
+        if (parcel == 0) {
+            reportError("Target '" + symbol + "' in " + input.name + " is out of range for " + std::string(compressedMnemonic(static_cast<uint16_t>(word))));
+        }
+        return parcel;
+    }
+    const Instructions instruction = decodeInstructionWord(word);
+    if (instruction == Instructions::INVALID) {
+        reportError("Relocation for '" + symbol + "' in " + input.name + " does not point at an instruction");
+    }
+    const InstructionDescriptor &descriptor = describe(instruction);
+    const bool relative = type == RelocationType::BRANCH || type == RelocationType::JUMP;
+    if (value < descriptor.immMin || value > descriptor.immMax || (relative && (value & 1))) {
+        reportError(std::string(relative ? "Branch or jump" : "Address") + " to '" + symbol + "' in " + input.name + " is out of range for " + std::string(descriptor.mnemonic));
+    }
+    return encodeInstruction(descriptor, (word >> 7) & 0x1F, (word >> 15) & 0x1F, (word >> 20) & 0x1F, value);
+}
+
+inline void Linker::relocate(Input &input) {
+    std::vector<TextSection> &sections = input.object.memory.text;
+    // Entry offsets of sections holding compressed instructions, built the
+    // first time a relocation lands in one.
+    std::vector<std::vector<uint32_t>> starts(sections.size());
+    auto entryAt = [&](size_t index, uint32_t offset) -> uint32_t* {
+        TextSection &section = sections[index];
+        if (section.size == section.words.size() * INSTRUCTION_SIZE) {
+            return (offset - section.base) % INSTRUCTION_SIZE == 0 ? &section.words[(offset - section.base) / INSTRUCTION_SIZE] : nullptr;
+        }
+        std::vector<uint32_t> &offsets = starts[index];
+        if (offsets.empty()) {
+            uint32_t at = section.base;
+            for (uint32_t word : section.words) {
+                offsets.push_back(at);
+                at += encodedLength(word);
+            }
+        }
+        auto it = std::lower_bound(offsets.begin(), offsets.end(), offset);
+        return (it != offsets.end() && *it == offset) ? &section.words[it - offsets.begin()] : nullptr;
+    };
+    for (const Relocation &relocation : input.object.relocations) {
+        const ObjectSymbol &symbol = input.object.symbols[relocation.symbol];
+        uint32_t target = 0;
+        if (symbol.isDefined()) {
+            target = addressOf(input, symbol);
+        } else {
+            auto it = globals.find(symbol.name);
+            if (it == globals.end()) reportError("Undefined symbol '" + symbol.name + "' referenced in " + input.name);
+            target = it->second.address;
+        }
+
+        auto section = std::find_if(sections.begin(), sections.end(), [&](const TextSection &candidate) {
+            return relocation.offset >= candidate.base && relocation.offset < candidate.end();
+        });
+        uint32_t* word = section == sections.end() ? nullptr : entryAt(section - sections.begin(), relocation.offset);
+        if (word == nullptr) {
+            reportError("Relocation offset 0x" + std::to_string(relocation.offset) + " outside the text of " + input.name);
+        }
+
+        const uint32_t address = input.textBase + relocation.offset;
+        const uint32_t symbolAddress = target + static_cast<uint32_t>(relocation.addend);
+        int32_t value = static_cast<int32_t>(symbolAddress);
+        switch (relocation.type) {
+            case RelocationType::BRANCH:
+            case RelocationType::JUMP: value = static_cast<int32_t>(symbolAddress - address); break;
+            case RelocationType::PCREL_HI: value = upperImmediate(static_cast<int32_t>(symbolAddress - address)); break;
+            case RelocationType::PCREL_LO: value = lowerImmediate(static_cast<int32_t>(symbolAddress - (address - INSTRUCTION_SIZE))); break;
+            case RelocationType::ABSOLUTE_HI: value = upperImmediate(static_cast<int32_t>(symbolAddress)); break;
+            case RelocationType::ABSOLUTE_LO: value = lowerImmediate(static_cast<int32_t>(symbolAddress)); break;
+            default: break;
+        }
+        *word = patch(*word, relocation.type, value, symbol.name, input);
+        ++relocationCount;
+    }
+}
+
+inline void Linker::link() {
+    image = ProgramImage();
+    relocationCount = 0;
+    layout();
+    collectGlobals();
+
+    for (Input &input : inputs) {
+        relocate(input);
+        for (const TextSection &section : input.object.memory.text) {
+            image.memory.text.push_back({input.textBase + section.base, section.words, section.size});
+        }
+        for (const DataSection &section : input.object.memory.data) {
+            image.memory.data.push_back({input.dataBase + section.base, section.bytes});
+        }
+        for (const ObjectSymbol &symbol : input.object.symbols) {
+            if (symbol.isDefined()) image.symbols.push_back({symbol.name, addressOf(input, symbol), symbol.kind});
+        }
+    }
+
+    auto start = globals.find("_start");
+    image.memory.entry = start != globals.end() ? start->second.address : TEXT_SEGMENT_START;
+    image.memory.finalize();
+}
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef OBJECT_HPP
+#define OBJECT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+#include "symbols.hpp"
+#include "image.hpp"
+
+namespace riscv {
+    // How the linker rewrites the immediate of a relocated instruction: branch
+    // and jal offsets are relative to the instruction, the PCREL pair splits
+    // the offset from an auipc (for la, call, tail and %pcrel_hi/%pcrel_lo),
+    // the ABSOLUTE_HI/LO pair splits the symbol's address (%hi/%lo), and the
+    // rest take the symbol's absolute address, exactly as a label operand does
+    // in a single source file.
+    enum class RelocationType : uint8_t { BRANCH, JUMP, ABSOLUTE_I, ABSOLUTE_S, ABSOLUTE_U, PCREL_HI, PCREL_LO, ABSOLUTE_HI, ABSOLUTE_LO };
+
+    enum class SymbolBinding : uint8_t { LOCAL, GLOBAL };
+
+    inline constexpr RelocationType relocationTypeOf(const InstructionDescriptor &descriptor, OperandModifier modifier = OperandModifier::NONE) {
+        if (modifier == OperandModifier::PCREL_HI) return RelocationType::PCREL_HI;
+        if (modifier == OperandModifier::PCREL_LO) return RelocationType::PCREL_LO;
+        if (modifier == OperandModifier::HI) return RelocationType::ABSOLUTE_HI;
+        if (modifier == OperandModifier::LO) return RelocationType::ABSOLUTE_LO;
+        if (descriptor.isBranch()) return RelocationType::BRANCH;
+        switch (descriptor.format) {
+            case InstructionType::UJ: return RelocationType::JUMP;
+            case InstructionType::U: return RelocationType::ABSOLUTE_U;
+            case InstructionType::S: return RelocationType::ABSOLUTE_S;
+            default: return RelocationType::ABSOLUTE_I;
+        }
+    }
+
+    // Offsets are relative to the start of the object's own section, which is
+    // TEXT_SEGMENT_START or DATA_SEGMENT_START before linking.
+    struct ObjectSymbol {
+        std::string name;
+        SymbolKind kind;
+        SymbolBinding binding;
+        uint32_t offset;
+
+        bool isDefined() const { return kind != SymbolKind::UNDEFINED; }
+    };
+
+    struct Relocation {
+        uint32_t offset;
+        uint32_t symbol;
+        RelocationType type;
+        int32_t addend;
+    };
+
+    struct ObjectFile {
+        MemoryImage memory;
+        std::vector<ObjectSymbol> symbols;
+        std::vector<Relocation> relocations;
+
+        uint32_t textSize() const {
+            uint32_t size = 0;
+            for (const TextSection &section : memory.text) size = std::max(size, section.end());
+            for (const ObjectSymbol &symbol : symbols) {
+                if (symbol.kind == SymbolKind::TEXT) size = std::max(size, symbol.offset);
+            }
+            return size;
+        }
+
+        uint32_t dataSize() const {
+            uint32_t size = 0;
+            for (const DataSection &section : memory.data) size = std::max(size, section.end());
+            for (const ObjectSymbol &symbol : symbols) {
+                if (symbol.kind == SymbolKind::DATA) size = std::max(size, symbol.offset);
+            }
+            return size;
+        }
+    };
+
+    // Object layout, all fields little-endian 32-bit words:
+    //   header       magic "RVOB", version | headerSize << 16, text/data section,
+    //                symbol and relocation counts, string table size, reserved
+    //   text, data   as in the program image, with section-relative bases
+    //   symbols      per symbol: name offset, name length, offset, kind | binding << 8
+    //   relocations  per entry: text offset, symbol index, type, addend
+    //   strings      symbol names, back to back
+    inline constexpr char OBJECT_MAGIC[4] = {'R', 'V', 'O', 'B'};
+    inline constexpr uint32_t OBJECT_VERSION = 1;
+    inline constexpr uint32_t OBJECT_HEADER_SIZE = 32;
+
+    inline bool isObjectFile(std::string_view bytes) {
+        return bytes.size() >= OBJECT_HEADER_SIZE && std::memcmp(bytes.data(), OBJECT_MAGIC, sizeof(OBJECT_MAGIC)) == 0;
+    }
+
+    inline void writeObjectFile(std::ostream &out, const ObjectFile &object) {
+        std::vector<uint8_t> bytes;
+        auto put32 = [&](uint32_t value) {
+            for (int i = 0; i < 4; ++i) bytes.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        };
+
+        std::string strings;
+        for (const ObjectSymbol &symbol : object.symbols) strings += symbol.name;
+
+        bytes.insert(bytes.end(), OBJECT_MAGIC, OBJECT_MAGIC + sizeof(OBJECT_MAGIC));
+        put32(OBJECT_VERSION | (OBJECT_HEADER_SIZE << 16));
+        put32(static_cast<uint32_t>(object.memory.text.size()));
+        put32(static_cast<uint32_t>(object.memory.data.size()));
+        put32(static_cast<uint32_t>(object.symbols.size()));
+        put32(static_cast<uint32_t>(object.relocations.size()));
+        put32(static_cast<uint32_t>(strings.size()));
+        put32(0);
+
+        for (const TextSection &section : object.memory.text) {
+            put32(section.base);
+            put32(static_cast<uint32_t>(section.words.size()));
+            for (uint32_t word : section.words) put32(word);
+        }
+        for (const DataSection &section : object.memory.data) {
+            put32(section.base);
+            put32(static_cast<uint32_t>(section.bytes.size()));
+            bytes.insert(bytes.end(), section.bytes.begin(), section.bytes.end());
+            bytes.resize((bytes.size() + 3) & ~static_cast<size_t>(3), 0);
+        }
+        uint32_t nameOffset = 0;
+        for (const ObjectSymbol &symbol : object.symbols) {
+            put32(nameOffset);
+            put32(static_cast<uint32_t>(symbol.name.size()));
+            put32(symbol.offset);
+            put32(static_cast<uint32_t>(symbol.kind) | (static_cast<uint32_t>(symbol.binding) << 8));
+            nameOffset += static_cast<uint32_t>(symbol.name.size());
+        }
+        for (const Relocation &relocation : object.relocations) {
+            put32(relocation.offset);
+            put32(relocation.symbol);
+            put32(static_cast<uint32_t>(relocation.type));
+            put32(static_cast<uint32_t>(relocation.addend));
+        }
+        bytes.insert(bytes.end(), strings.begin(), strings.end());
+
+        out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    inline ObjectFile loadObjectFile(std::string_view bytes) {
+        auto fail = [](const std::string &message) {
+            throw std::runtime_error(std::string(RED) + "Object Error: " + message + RESET);
+        };
+        if (!isObjectFile(bytes)) fail("Missing object header");
+
+        ImageReader reader(bytes);
+        reader.take(sizeof(OBJECT_MAGIC));
+        const uint32_t version = reader.read32();
+        if ((version & 0xFFFF) != OBJECT_VERSION || (version >> 16) != OBJECT_HEADER_SIZE) {
+            fail("Unsupported object version " + std::to_string(version & 0xFFFF));
+        }
+        const uint32_t textCount = reader.read32();
+        const uint32_t dataCount = reader.read32();
+        const uint32_t symbolCount = reader.read32();
+        const uint32_t relocationCount = reader.read32();
+        const uint32_t stringSize = reader.read32();
+        reader.read32();
+
+        ObjectFile object;
+        object.memory.text.resize(textCount);
+        for (TextSection &section : object.memory.text) {
+            section.base = reader.read32();
+            const uint32_t count = reader.read32();
+            if (count > reader.remaining() / INSTRUCTION_SIZE) fail("Truncated object");
+            section.words.reserve(count);
+            for (uint32_t i = 0; i < count; ++i) section.push(reader.read32());
+        }
+        object.memory.data.resize(dataCount);
+        for (DataSection &section : object.memory.data) {
+            section.base = reader.read32();
+            const uint32_t count = reader.read32();
+            const uint8_t* data = reader.take((static_cast<size_t>(count) + 3) & ~static_cast<size_t>(3));
+            section.bytes.assign(data, data + count);
+        }
+
+        struct NameRef { uint32_t offset, length; };
+        std::vector<NameRef> names(symbolCount);
+        object.symbols.resize(symbolCount);
+        for (uint32_t i = 0; i < symbolCount; ++i) {
+            names[i].offset = reader.read32();
+            names[i].length = reader.read32();
+            object.symbols[i].offset = reader.read32();
+            const uint32_t flags = reader.read32();
+            if ((flags & 0xFF) > static_cast<uint32_t>(SymbolKind::DATA) || (flags >> 8) > static_cast<uint32_t>(SymbolBinding::GLOBAL)) {
+                fail("Invalid symbol flags");
+            }
+            object.symbols[i].kind = static_cast<SymbolKind>(flags & 0xFF);
+            object.symbols[i].binding = static_cast<SymbolBinding>(flags >> 8);
+        }
+        object.relocations.resize(relocationCount);
+        for (Relocation &relocation : object.relocations) {
+            relocation.offset = reader.read32();
+            relocation.symbol = reader.read32();
+            const uint32_t type = reader.read32();
+            relocation.addend = static_cast<int32_t>(reader.read32());
+            if (relocation.symbol >= symbolCount || type > static_cast<uint32_t>(RelocationType::ABSOLUTE_LO)) {
+                fail("Invalid relocation");
+            }
+            relocation.type = static_cast<RelocationType>(type);
+        }
+        const char* strings = reinterpret_cast<const char*>(reader.take(stringSize));
+        for (uint32_t i = 0; i < symbolCount; ++i) {
+            if (names[i].offset > stringSize || names[i].length > stringSize - names[i].offset) {
+                fail("Symbol name out of bounds");
+            }
+            object.symbols[i].name.assign(strings + names[i].offset, names[i].length);
+        }
+        return object;
+    }
+}
+
+#endif
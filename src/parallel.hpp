@@ -0,0 +1,377 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "symbols.hpp"
+#include "assembler.hpp"
+#include "image.hpp"
+#include "relax.hpp"
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define RISCV_NO_THREADS 1
+#endif
+
+using namespace riscv;
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threadCount) : jobCount(0), nextIndex(0), finished(0), generation(0), stopping(false) {
+#ifndef RISCV_NO_THREADS
+        for (size_t i = 1; i < threadCount; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+#endif
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    size_t size() const { return workers.size() + 1; }
+
+    inline void parallelFor(size_t count, const std::function<void(size_t)> &task);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)> *job = nullptr;
+    std::vector<std::exception_ptr> errors;
+    size_t jobCount;
+    size_t nextIndex;
+    size_t finished;
+    uint64_t generation;
+    bool stopping;
+
+    inline void runTasks(std::unique_lock<std::mutex> &lock);
+    inline void workerLoop();
+};
+
+inline void ThreadPool::runTasks(std::unique_lock<std::mutex> &lock) {
+    while (nextIndex < jobCount) {
+        size_t index = nextIndex++;
+        lock.unlock();
+        try {
+            (*job)(index);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+        lock.lock();
+        if (++finished == jobCount) {
+            done.notify_all();
+        }
+    }
+}
+
+inline void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+        runTasks(lock);
+    }
+}
+
+inline void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &task) {
+    if (count == 0) return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    job = &task;
+    errors.assign(count, nullptr);
+    jobCount = count;
+    nextIndex = 0;
+    finished = 0;
+    ++generation;
+    wake.notify_all();
+
+    runTasks(lock);
+    done.wait(lock, [&] { return finished == jobCount; });
+    job = nullptr;
+
+    for (const std::exception_ptr &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+class ParallelAssembler {
+public:
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+    static constexpr size_t MIN_CHUNK_SIZE = 1 << 16;
+
+    explicit ParallelAssembler(size_t threadCount)
+        : pool(std::max<size_t>(threadCount, 1)), lineCount(0), instructionCount(0) {}
+
+    inline bool assemble(std::shared_ptr<const SourceBuffer> source);
+
+    inline const MemoryImage& getImage() const { return image; }
+    inline const SymbolTable& getSymbolTable() const { return symbolTable; }
+    inline void collectLines(ProgramImage &program) const {
+        program.addLines(instructions);
+    }
+    inline size_t getLineCount() const { return lineCount; }
+    inline size_t getInstructionCount() const { return instructionCount; }
+    inline size_t getChunkCount() const { return chunks.size(); }
+    inline size_t getThreadCount() const { return pool.size(); }
+
+private:
+    struct Chunk {
+        std::string_view text;
+        int firstLine = 1;
+        size_t newlines = 0;
+        TokenArena tokens;
+        bool hasSection = false;
+        bool endsInText = true;
+        bool hasOption = false;
+        bool endsCompressing = false;
+        // Bytes before the first section directive, counted for both
+        // sections since the chunk's starting section is not known yet.
+        uint32_t leadingText = 0;
+        uint32_t leadingData = 0;
+        uint32_t textBytes = 0;
+        uint32_t dataBytes = 0;
+    };
+
+    struct Group {
+        size_t firstChunk;
+        size_t lastChunk;
+        uint32_t textStart;
+        uint32_t dataStart;
+        bool compressing;
+        Parser parser;
+    };
+
+    ThreadPool pool;
+    std::vector<Chunk> chunks;
+    std::vector<std::unique_ptr<Group>> groups;
+    SymbolTable symbolTable;
+    std::vector<ParsedInstruction> instructions;
+    std::vector<uint32_t> code;
+    MemoryImage image;
+    size_t lineCount;
+    size_t instructionCount;
+
+    inline void splitChunks(std::string_view text);
+    inline void summarizeChunk(Chunk &chunk) const;
+    inline void planGroups();
+    inline void mergeSymbols();
+};
+
+inline void ParallelAssembler::splitChunks(std::string_view text) {
+    chunks.clear();
+    const size_t target = std::max<size_t>(1, std::min(pool.size() * CHUNKS_PER_THREAD, text.size() / MIN_CHUNK_SIZE));
+    const char* const begin = text.data();
+    const char* const end = begin + text.size();
+    const char* cursor = begin;
+
+    for (size_t i = 1; i <= target && cursor < end; ++i) {
+        const char* limit = (i == target) ? end : begin + text.size() * i / target;
+        if (limit < cursor) limit = cursor;
+        const char* lineEnd = (limit < end) ? scanByte(limit, end, '\n') : end;
+        const char* chunkEnd = (lineEnd < end) ? lineEnd + 1 : end;
+        Chunk chunk;
+        chunk.text = std::string_view(cursor, chunkEnd - cursor);
+        chunks.push_back(std::move(chunk));
+        cursor = chunkEnd;
+    }
+}
+
+inline void ParallelAssembler::summarizeChunk(Chunk &chunk) const {
+    for (const TokenLine line : chunk.tokens) {
+        if (line[0].type == TokenType::DIRECTIVE && (line[0].value == ".text" || line[0].value == ".data")) {
+            chunk.hasSection = true;
+            chunk.endsInText = line[0].value == ".text";
+            continue;
+        }
+        if (line[0].type == TokenType::DIRECTIVE && line[0].value == ".option" && line.size() == 2) {
+            chunk.hasOption = true;
+            chunk.endsCompressing = line[1].value == "rvc";
+            continue;
+        }
+        uint32_t text = 0;
+        for (size_t i = 0; i < line.size(); ++i) {
+            if (line[i].type != TokenType::OPCODE) continue;
+            size_t end = i + 1;
+            while (end < line.size() && line[end].type != TokenType::DIRECTIVE && line[end].type != TokenType::LABEL) ++end;
+            text += Parser::instructionBytes(line.subLine(i, end));
+            i = end - 1;
+        }
+        const uint32_t data = Parser::dataBytes(line);
+        if (!chunk.hasSection) {
+            chunk.leadingText += text;
+            chunk.leadingData += data;
+        } else if (chunk.endsInText) {
+            chunk.textBytes += text;
+        } else {
+            chunk.dataBytes += data;
+        }
+    }
+}
+
+inline void ParallelAssembler::planGroups() {
+    groups.clear();
+    bool inText = true;
+    bool compressing = false;
+    uint32_t textAddress = TEXT_SEGMENT_START;
+    uint32_t dataAddress = DATA_SEGMENT_START;
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const Chunk &chunk = chunks[i];
+        if (inText || groups.empty()) {
+            auto group = std::make_unique<Group>();
+            group->firstChunk = i;
+            group->lastChunk = i;
+            group->textStart = textAddress;
+            group->dataStart = dataAddress;
+            group->compressing = compressing;
+            groups.push_back(std::move(group));
+        } else {
+            groups.back()->lastChunk = i;
+        }
+
+        if (inText) {
+            textAddress += chunk.leadingText;
+        } else {
+            dataAddress += chunk.leadingData;
+        }
+        textAddress += chunk.textBytes;
+        dataAddress += chunk.dataBytes;
+        if (chunk.hasSection) inText = chunk.endsInText;
+        if (chunk.hasOption) compressing = chunk.endsCompressing;
+    }
+}
+
+inline void ParallelAssembler::mergeSymbols() {
+    symbolTable.clear();
+    for (const auto &group : groups) {
+        const SymbolTable &local = group->parser.getSymbolTable();
+        for (SymbolId id = 0; id < local.size(); ++id) {
+            const Symbol &symbol = local[id];
+            if (!symbol.isDefined()) continue;
+            const SymbolId global = symbolTable.intern(local.name(id));
+            if (symbolTable[global].isDefined() && symbol.kind == SymbolKind::TEXT) {
+                throw std::runtime_error(std::string(RED) + "Parser Error: Duplicate label '" + std::string(local.name(id)) + "'" + RESET);
+            }
+            symbolTable.import(global, local, symbol);
+        }
+    }
+}
+
+inline bool ParallelAssembler::assemble(std::shared_ptr<const SourceBuffer> source) {
+    if (!source || source->empty()) {
+        throw std::runtime_error(std::string(RED) + "Lexer Error on Line 0: Empty input provided" + RESET);
+    }
+
+    splitChunks(source->view());
+
+    pool.parallelFor(chunks.size(), [&](size_t index) {
+        Chunk &chunk = chunks[index];
+        chunk.newlines = static_cast<size_t>(std::count(chunk.text.begin(), chunk.text.end(), '\n'));
+    });
+
+    int firstLine = 1;
+    for (Chunk &chunk : chunks) {
+        chunk.firstLine = firstLine;
+        firstLine += static_cast<int>(chunk.newlines);
+    }
+
+    pool.parallelFor(chunks.size(), [&](size_t index) {
+        Chunk &chunk = chunks[index];
+        chunk.tokens = Lexer::tokenizeRange(source, chunk.text, chunk.firstLine);
+        summarizeChunk(chunk);
+    });
+
+    lineCount = 0;
+    for (const Chunk &chunk : chunks) {
+        lineCount += chunk.tokens.size();
+    }
+    if (lineCount == 0) {
+        throw std::runtime_error(std::string(RED) + "Parser Error: No tokens provided for parsing" + RESET);
+    }
+
+    planGroups();
+
+    pool.parallelFor(groups.size(), [&](size_t index) {
+        Group &group = *groups[index];
+        group.parser.beginStream(group.textStart, group.dataStart, false, true);
+        group.parser.setCompression(group.compressing);
+        for (size_t i = group.firstChunk; i <= group.lastChunk; ++i) {
+            for (const TokenLine line : chunks[i].tokens) {
+                group.parser.parseLine(line);
+            }
+        }
+    });
+
+    mergeSymbols();
+
+    pool.parallelFor(groups.size(), [&](size_t index) {
+        if (!groups[index]->parser.linkSymbols(symbolTable)) {
+            throw std::runtime_error(std::string(RED) + "Parser Error: Label resolution failed" + RESET);
+        }
+    });
+
+    // Relaxation moves labels across group boundaries, so it runs once over
+    // the whole program, exactly as Parser::parse does for serial assembly.
+    instructions.clear();
+    for (const auto &group : groups) {
+        std::vector<ParsedInstruction> parsed = group->parser.takeParsedInstructions();
+        instructions.insert(instructions.end(), parsed.begin(), parsed.end());
+    }
+    Relaxer relaxer;
+    relaxer.relax(instructions, symbolTable);
+
+    const Assembler encoder;
+    const size_t slices = std::max<size_t>(1, std::min(instructions.size(), pool.size() * CHUNKS_PER_THREAD));
+    code.assign(instructions.size(), 0);
+    pool.parallelFor(slices, [&](size_t index) {
+        const size_t end = instructions.size() * (index + 1) / slices;
+        for (size_t i = instructions.size() * index / slices; i < end; ++i) {
+            code[i] = encoder.encode(instructions[i]);
+        }
+    });
+
+    Assembler dataAssembler(symbolTable);
+    if (!dataAssembler.assemble()) {
+        return false;
+    }
+
+    image.clear();
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        image.appendText(instructions[i].address, code[i]);
+    }
+    instructionCount = instructions.size();
+    image.data = dataAssembler.takeImage().data;
+    image.finalize();
+    return true;
+}
+
+#endif
@@ -5,205 +5,424 @@
 #include <unordered_map>
 #include <stdexcept>
 #include <algorithm>
-#include <optional>
 #include <cstdint>
+#include <initializer_list>
+#include <cstdlib>
+#include <cstring>
 #include "types.hpp"
+#include "symbols.hpp"
+#include "relax.hpp"
 
 using namespace riscv;
 
 class Parser {
 public:
-    explicit Parser(const std::vector<std::vector<Token>>& tokenizedLines) 
-        : tokens(tokenizedLines), errorCount(0), currentAddress(0), 
-        inTextSection(false), inDataSection(false) {}
+    Parser() 
+        : tokens(nullptr), errorCount(0), currentAddress(0), 
+        inTextSection(false), inDataSection(false), firstUnheld(0) {}
+
+    explicit Parser(const TokenArena& tokenizedLines) 
+        : tokens(&tokenizedLines), errorCount(0), currentAddress(0), 
+        inTextSection(false), inDataSection(false), firstUnheld(0) {}
     
     inline bool parse();
 
-    inline const std::unordered_map<std::string, SymbolEntry>& getSymbolTable() const { return symbolTable; }
+    inline void beginStream(uint32_t textStart = TEXT_SEGMENT_START, uint32_t dataStart = DATA_SEGMENT_START, bool dataSection = false, bool relaxLater = false);
+    inline void parseLine(TokenLine line) { processLine(line); }
+    inline bool finishStream() { return resolveFixups(); }
+    inline bool linkSymbols(const SymbolTable &globalSymbols);
+
+    static inline uint32_t instructionBytes(TokenLine instruction);
+    static inline uint32_t dataBytes(TokenLine line);
+
+    inline void setRelaxation(bool enabled) { relaxation = enabled; }
+    inline void setCompression(bool enabled) { compression = enabled; }
+    inline bool isCompressing() const { return compression; }
+
+    template <typename Sink>
+    inline size_t drainResolved(Sink &&sink);
+    template <typename Sink>
+    inline size_t drainData(Sink &&sink);
+
+    inline const SymbolTable& getSymbolTable() const { return symbolTable; }
+    inline const std::vector<SymbolId>& getGlobals() const { return globals; }
     inline const std::vector<ParsedInstruction>& getParsedInstructions() const { return parsedInstructions; }
+    inline std::vector<ParsedInstruction> takeParsedInstructions() { return std::move(parsedInstructions); }
 
     inline size_t getErrorCount() const { return errorCount; }
+    inline size_t getPendingFixupCount() const { return pendingFixupCount; }
+    inline uint32_t getCurrentAddress() const { return currentAddress; }
+    inline uint32_t getTextAddress() const { return inDataSection ? textAddress : currentAddress; }
+    inline uint32_t getDataAddress() const { return inDataSection ? currentAddress : dataAddress; }
+    inline bool isInDataSection() const { return inDataSection; }
 
 private:
-    const std::vector<std::vector<Token>> &tokens;
+    const TokenArena *tokens;
 
-    std::unordered_map<std::string, SymbolEntry> symbolTable;
+    SymbolTable symbolTable;
 
     std::vector<ParsedInstruction> parsedInstructions;
+    std::vector<SymbolId> globals;
 
     mutable size_t errorCount;
 
     uint32_t currentAddress;
+    // Location counter of the section that is not current; .text and .data
+    // resume where that section last stopped.
+    uint32_t textAddress = TEXT_SEGMENT_START;
+    uint32_t dataAddress = DATA_SEGMENT_START;
 
     bool inTextSection;
     bool inDataSection;
 
-    inline bool processFirstPass();
-    inline bool processSecondPass();
-    inline bool handleInstruction(const std::vector<Token>& line);
+    // The text address parsing started at, and where the last
+    // `auipc rd, %pcrel_hi(sym)` ended with the symbol it named.
+    uint32_t streamStart = TEXT_SEGMENT_START;
+    uint32_t pcrelHiEnd = 0;
+    std::string_view pcrelHiSymbol;
+
+    // parse() relaxes the whole program afterwards, so branch and jump ranges
+    // are checked there rather than against the parsed layout.
+    bool relaxation = true;
+    bool deferRangeChecks = false;
+    // Set by `.option rvc`: instructions are marked compressible and
+    // relaxation compresses those that fit.
+    bool compression = false;
+
+    struct Fixup {
+        size_t instruction;
+        size_t operand;
+    };
+
+    std::unordered_map<SymbolId, std::vector<Fixup>> pendingFixups;
+    size_t pendingFixupCount = 0;
+    // Fixups name instructions by their position in the whole program.
+    // drainResolved keeps only the instructions that still wait on a label at
+    // the front of parsedInstructions, with their positions in heldPositions;
+    // the instructions after them are numbered on from firstUnheld.
+    std::vector<size_t> heldPositions;
+    size_t firstUnheld;
+    bool heldResolved = false;
+    // Data symbols defined since the last drainData. Data values never name a
+    // label, so every entry is complete once its directive has been read.
+    std::vector<SymbolId> definedData;
+
+    inline size_t nextPosition() const { return firstUnheld + parsedInstructions.size() - heldPositions.size(); }
+    inline ParsedInstruction& fixupTarget(size_t position);
 
-    inline std::optional<uint32_t> resolveLabel(const std::string &label) const;
+    inline void reset();
+    inline void processLine(TokenLine line);
+    inline void resolvePending(SymbolId id);
+    inline bool resolveFixups();
+    inline bool handleInstruction(TokenLine line, Instructions base = Instructions::INVALID);
+    inline bool handleFixedInstruction(const InstructionDescriptor &descriptor, TokenLine line);
+    inline bool handleCsrInstruction(const InstructionDescriptor &descriptor, TokenLine line);
+    inline bool handleVectorInstruction(const InstructionDescriptor &descriptor, TokenLine line);
+    inline void handleCompressedInstruction(const CompressedDescriptor &form, TokenLine line);
+    inline void expandPseudoInstruction(const PseudoDescriptor &pseudo, TokenLine line);
+    inline void emit(Instructions instruction, std::initializer_list<Operand> operands, int lineNumber, bool compressed = false);
+    inline Operand registerArgument(const TokenView &token) const;
+    inline Operand floatRegisterArgument(const TokenView &token) const;
+    inline Operand csrArgument(const TokenView &token) const;
+    inline Operand targetArgument(const TokenView &token, OperandModifier modifier = OperandModifier::NONE) const;
+    inline bool checkRelocationOperator(const InstructionDescriptor &descriptor, OperandModifier modifier, std::string_view symbol, int lineNumber) const;
+    inline bool resolveLabelOperand(Operand &operand, SymbolId id, const InstructionDescriptor &descriptor, uint32_t address, int lineNumber) const;
 
-    inline void addLabel(const std::string &label);
-    inline void handleDirective(const std::vector<Token> &line);
+    static inline size_t dataEntryEnd(TokenLine line, size_t start);
+    static inline uint32_t dataEntryBytes(TokenLine entry);
+
+    inline void addLabel(std::string_view label);
+    inline void handleDirective(TokenLine line);
     inline void reportError(const std::string &message, int lineNumber = 0) const;
-    inline void handleSectionDirective(const std::string& directive);
+    inline void handleSectionDirective(std::string_view directive);
+    inline void handleOptionDirective(TokenLine line);
+    inline void declareGlobals(TokenLine line);
 };
 
-inline void Parser::handleSectionDirective(const std::string& directive) {
+inline void Parser::declareGlobals(TokenLine line) {
+    if (line.size() < 2) {
+        reportError("Missing symbol name for " + std::string(line[0].value) + " directive", line[0].lineNumber);
+    }
+    for (size_t i = 1; i < line.size(); ++i) {
+        if (line[i].type != TokenType::UNKNOWN) {
+            reportError("Invalid symbol name in " + std::string(line[0].value) + " directive: " + std::string(line[i].value), line[0].lineNumber);
+        }
+        globals.push_back(symbolTable.intern(line[i].value));
+    }
+}
+
+inline void Parser::handleSectionDirective(std::string_view directive) {
     if (directive == ".data") {
+        if (!inDataSection) {
+            textAddress = currentAddress;
+            currentAddress = dataAddress;
+        }
         inDataSection = true;
         inTextSection = false;
-        currentAddress = DATA_SEGMENT_START;
     } else if (directive == ".text") {
+        if (!inTextSection) {
+            dataAddress = currentAddress;
+            currentAddress = textAddress;
+        }
         inTextSection = true;
         inDataSection = false;
-        currentAddress = TEXT_SEGMENT_START;
     } else {
-        reportError("Unknown section directive: " + directive);
+        reportError("Unknown section directive: " + std::string(directive));
     }
 }
 
+inline void Parser::handleOptionDirective(TokenLine line) {
+    const std::string_view option = line.size() == 2 ? line[1].value : std::string_view();
+    if (option == "rvc") {
+        compression = true;
+    } else if (option == "norvc") {
+        compression = false;
+    } else {
+        reportError("Unsupported .option '" + std::string(option) + "' (expected rvc or norvc)", line[0].lineNumber);
+    }
+}
+
+inline void Parser::reset() {
+    compression = false;
+    currentAddress = TEXT_SEGMENT_START;
+    textAddress = TEXT_SEGMENT_START;
+    dataAddress = DATA_SEGMENT_START;
+    streamStart = TEXT_SEGMENT_START;
+    pcrelHiEnd = 0;
+    pcrelHiSymbol = {};
+    inTextSection = true;
+    inDataSection = false;
+    symbolTable.clear();
+    parsedInstructions.clear();
+    globals.clear();
+    pendingFixups.clear();
+    pendingFixupCount = 0;
+    heldPositions.clear();
+    firstUnheld = 0;
+    heldResolved = false;
+    definedData.clear();
+}
+
 inline bool Parser::parse() {
-    if (tokens.empty()) {
+    if (tokens == nullptr || tokens->empty()) {
         reportError("No tokens provided for parsing");
         return false;
     }
     
-    parsedInstructions.clear();
-    bool firstPassResult = processFirstPass();
-    if (!firstPassResult) {
-        reportError("First pass failed with " + std::to_string(errorCount) + " errors");
-        return false;
+    reset();
+    deferRangeChecks = relaxation;
+    for (const TokenLine line : *tokens) {
+        processLine(line);
     }
-    
-    bool secondPassResult = processSecondPass();
-    if (!secondPassResult) {
-        reportError("Second pass failed with " + std::to_string(errorCount) + " errors");
+
+    if (!resolveFixups()) {
+        reportError("Label resolution failed with " + std::to_string(errorCount) + " errors");
         return false;
     }
+    if (relaxation) {
+        Relaxer relaxer;
+        relaxer.relax(parsedInstructions, symbolTable);
+    }
     return errorCount == 0;
 }
 
-inline bool Parser::processFirstPass() {
-    currentAddress = TEXT_SEGMENT_START;
-    inTextSection = true;
-    inDataSection = false;
-    symbolTable.clear();
-
-    for (const auto &line : tokens) {
-        if (line.empty()) continue;
+inline void Parser::beginStream(uint32_t textStart, uint32_t dataStart, bool dataSection, bool relaxLater) {
+    tokens = nullptr;
+    reset();
+    deferRangeChecks = relaxLater;
+    textAddress = textStart;
+    dataAddress = dataStart;
+    streamStart = textStart;
+    currentAddress = dataSection ? dataStart : textStart;
+    inTextSection = !dataSection;
+    inDataSection = dataSection;
+}
 
-        size_t tokenIndex = 0;
+inline bool Parser::linkSymbols(const SymbolTable &globalSymbols) {
+    std::vector<SymbolId> resolved;
+    resolved.reserve(pendingFixups.size());
+    for (const auto &pending : pendingFixups) {
+        const Symbol* global = globalSymbols.lookup(symbolTable.name(pending.first));
+        if (global != nullptr) {
+            symbolTable[pending.first].address = global->address;
+            symbolTable[pending.first].kind = global->kind;
+            resolved.push_back(pending.first);
+        }
+    }
+    for (SymbolId id : resolved) {
+        resolvePending(id);
+    }
+    return resolveFixups();
+}
 
-        if (line[0].type == TokenType::DIRECTIVE) {
-            handleSectionDirective(line[0].value);
+template <typename Sink>
+inline size_t Parser::drainResolved(Sink &&sink) {
+    const size_t heldCount = heldPositions.size();
+    const size_t next = nextPosition();
+    size_t kept = heldResolved ? 0 : heldCount;
+    size_t ready = 0;
+    for (size_t i = kept; i < parsedInstructions.size(); ++i) {
+        ParsedInstruction &inst = parsedInstructions[i];
+        bool resolved = true;
+        for (size_t j = 0; j < inst.size(); ++j) {
+            resolved = resolved && inst[j].resolved;
+        }
+        if (resolved) {
+            sink(inst);
+            ++ready;
             continue;
         }
+        const size_t position = i < heldCount ? heldPositions[i] : firstUnheld + i - heldCount;
+        if (kept < heldPositions.size()) {
+            heldPositions[kept] = position;
+        } else {
+            heldPositions.push_back(position);
+        }
+        if (kept != i) parsedInstructions[kept] = std::move(inst);
+        ++kept;
+    }
+    firstUnheld = next;
+    heldResolved = false;
+    heldPositions.resize(kept);
+    parsedInstructions.resize(kept, ParsedInstruction(Instructions::INVALID, 0, 0));
+    return ready;
+}
 
-        while (tokenIndex < line.size()) {
-            const Token &currentToken = line[tokenIndex];
-
-            if (currentToken.type == TokenType::LABEL) {
-                if (inDataSection) {
-                    std::vector<Token> dataPathTokens;
-                    dataPathTokens.push_back(currentToken);
-                    tokenIndex++;
-
-                    while (tokenIndex < line.size() && (line[tokenIndex].type == TokenType::DIRECTIVE || line[tokenIndex].type == TokenType::IMMEDIATE || line[tokenIndex].type == TokenType::STRING)) {
-                        dataPathTokens.push_back(line[tokenIndex]);
-                        tokenIndex++;
-                    }
-                    handleDirective(dataPathTokens);
-                }
-                else if (inTextSection) {
-                    addLabel(currentToken.value);
-                    tokenIndex++;
-                    if (tokenIndex < line.size() && line[tokenIndex].type == TokenType::OPCODE) {
-                        currentAddress += INSTRUCTION_SIZE;
-                    }
-                }
-            }
-            else if (currentToken.type == TokenType::OPCODE) {
-                currentAddress += INSTRUCTION_SIZE;
-                tokenIndex++;
-            }
-            else {
-                tokenIndex++;
-            }
+// Hands every data entry defined since the last call to the sink and releases
+// its bytes; the symbols keep their addresses for later references.
+template <typename Sink>
+inline size_t Parser::drainData(Sink &&sink) {
+    const size_t count = definedData.size();
+    for (SymbolId id : definedData) {
+        Symbol &symbol = symbolTable[id];
+        if (symbol.address >= DATA_SEGMENT_START && symbol.payloadSize > 0) {
+            sink(symbol.address, symbolTable.payload(symbol), symbol.payloadSize);
         }
+        symbol.payloadSize = 0;
     }
-    return errorCount == 0;
+    definedData.clear();
+    symbolTable.discardPayload(0);
+    return count;
 }
 
-inline bool Parser::processSecondPass() {
-    currentAddress = TEXT_SEGMENT_START;
-    inTextSection = true;
-    inDataSection = false;
-    parsedInstructions.clear();
+inline ParsedInstruction& Parser::fixupTarget(size_t position) {
+    if (position >= firstUnheld) {
+        return parsedInstructions[heldPositions.size() + position - firstUnheld];
+    }
+    const auto held = std::lower_bound(heldPositions.begin(), heldPositions.end(), position);
+    return parsedInstructions[held - heldPositions.begin()];
+}
 
-    for (const auto &line : tokens) {
-        if (line.empty()) continue;
+inline void Parser::processLine(TokenLine line) {
+    if (line.empty()) return;
 
-        if (line[0].type == TokenType::DIRECTIVE) {
+    if (line[0].type == TokenType::DIRECTIVE) {
+        if (line[0].value == ".globl" || line[0].value == ".global") {
+            declareGlobals(line);
+        } else if (line[0].value == ".option") {
+            handleOptionDirective(line);
+        } else {
             handleSectionDirective(line[0].value);
-            continue;
         }
+        return;
+    }
 
-        size_t tokenIndex = 0;
-        while (tokenIndex < line.size()) {
-            const Token &currentToken = line[tokenIndex];
+    size_t tokenIndex = 0;
+    while (tokenIndex < line.size()) {
+        const TokenView &currentToken = line[tokenIndex];
 
-            if (currentToken.type == TokenType::LABEL && inTextSection) {
+        if (currentToken.type == TokenType::LABEL && inDataSection) {
+            size_t dataStart = tokenIndex;
+            tokenIndex = dataEntryEnd(line, dataStart);
+            handleDirective(line.subLine(dataStart, tokenIndex));
+        }
+        else if (currentToken.type == TokenType::LABEL && inTextSection) {
+            addLabel(currentToken.value);
+            tokenIndex++;
+        }
+        else if (currentToken.type == TokenType::OPCODE) {
+            size_t instructionStart = tokenIndex;
+            while (tokenIndex < line.size() && line[tokenIndex].type != TokenType::DIRECTIVE && 
+                  line[tokenIndex].type != TokenType::LABEL) {
                 tokenIndex++;
-
-                if (tokenIndex < line.size() && line[tokenIndex].type == TokenType::OPCODE) {
-                    std::vector<Token> instructionTokens;
-                    while (tokenIndex < line.size() && line[tokenIndex].type != TokenType::DIRECTIVE && 
-                          line[tokenIndex].type != TokenType::LABEL) {
-                        instructionTokens.push_back(line[tokenIndex]);
-                        tokenIndex++;
-                    }
-
-                    if (!handleInstruction(instructionTokens)) {
-                        reportError("Invalid instruction following label '" + currentToken.value + "'", line[0].lineNumber);
-                    }
-                    else {
-                        currentAddress += INSTRUCTION_SIZE;
-                    }
-                }
             }
-            else if (currentToken.type == TokenType::OPCODE) {
-                std::vector<Token> instructionTokens;
-                while (tokenIndex < line.size() && line[tokenIndex].type != TokenType::DIRECTIVE && 
-                      line[tokenIndex].type != TokenType::LABEL) {
-                    instructionTokens.push_back(line[tokenIndex]);
-                    tokenIndex++;
-                }
 
-                if (!handleInstruction(instructionTokens)) {
-                    reportError("Invalid instruction", line[0].lineNumber);
-                }
-                else {
-                    currentAddress += INSTRUCTION_SIZE;
-                }
+            const TokenLine instruction = line.subLine(instructionStart, tokenIndex);
+            if (const PseudoDescriptor* pseudo = findPseudoInstruction(instruction[0].value, instruction.size() - 1)) {
+                expandPseudoInstruction(*pseudo, instruction);
+            }
+            else if (const CompressedDescriptor* form = findCompressedForm(instruction[0].value)) {
+                handleCompressedInstruction(*form, instruction);
+            }
+            else if (!handleInstruction(instruction)) {
+                reportError("Invalid instruction", line[0].lineNumber);
             }
             else {
-                tokenIndex++;
+                currentAddress += INSTRUCTION_SIZE;
             }
         }
+        else {
+            tokenIndex++;
+        }
     }
-    return errorCount == 0;
 }
 
-inline void Parser::handleDirective(const std::vector<Token> &line) {
+inline void Parser::resolvePending(SymbolId id) {
+    auto pending = pendingFixups.find(id);
+    if (pending == pendingFixups.end()) return;
+
+    for (const Fixup &fixup : pending->second) {
+        heldResolved = heldResolved || fixup.instruction < firstUnheld;
+        ParsedInstruction &inst = fixupTarget(fixup.instruction);
+        resolveLabelOperand(inst.operands[fixup.operand], id, describe(inst.instruction), inst.address, inst.lineNumber);
+    }
+    pendingFixupCount -= pending->second.size();
+    pendingFixups.erase(pending);
+}
+
+inline bool Parser::resolveFixups() {
+    if (pendingFixups.empty()) {
+        return errorCount == 0;
+    }
+
+    SymbolId undefined = INVALID_SYMBOL;
+    int undefinedLine = 0;
+    for (const auto &[id, waiting] : pendingFixups) {
+        for (const Fixup &fixup : waiting) {
+            int lineNumber = fixupTarget(fixup.instruction).lineNumber;
+            if (undefined == INVALID_SYMBOL || lineNumber < undefinedLine) {
+                undefined = id;
+                undefinedLine = lineNumber;
+            }
+        }
+    }
+    reportError("Undefined label '" + std::string(symbolTable.name(undefined)) + "'", undefinedLine);
+    return false;
+}
+
+inline bool Parser::resolveLabelOperand(Operand &operand, SymbolId id, const InstructionDescriptor &descriptor, uint32_t address, int lineNumber) const {
+    if (!symbolTable[id].isDefined()) {
+        reportError("Undefined label '" + std::string(symbolTable.name(id)) + "'", lineNumber);
+        return false;
+    }
+    operand.symbol = symbolTable.name(id);
+    operand.value = labelOperandValue(descriptor, operand.modifier, symbolTable[id].address, address);
+    if (!deferRangeChecks && isRelativeLabel(descriptor, operand.modifier) && !fitsOffset(descriptor, operand.value)) {
+        reportError(std::string(descriptor.isBranch() ? "Branch" : "Jump") + " target out of range or misaligned: " + std::string(operand.symbol), lineNumber);
+        return false;
+    }
+    operand.resolved = true;
+    return true;
+}
+
+inline void Parser::handleDirective(TokenLine line) {
     if (line.empty()) {
         reportError("Empty directive encountered");
         return;
     }
 
     size_t tokenIndex = 0;
-    std::string label = "";
+    std::string_view label;
 
     if (line[0].type == TokenType::LABEL) {
         label = line[0].value;
@@ -215,31 +434,29 @@ inline void Parser::handleDirective(const std::vector<Token> &line) {
         return;
     }
 
-    const std::string &directive = line[tokenIndex].value;
+    const std::string directive(line[tokenIndex].value);
     tokenIndex++;
 
-    auto it = directives.find(directive);
-    if (it == directives.end()) {
+    const Keyword* keyword = findKeyword(directive);
+    if (keyword == nullptr || keyword->kind != KeywordKind::DIRECTIVE) {
         reportError("Unsupported data directive '" + directive + "'");
         return;
     }
 
-    uint32_t size = it->second;
-    SymbolEntry entry;
-    entry.address = currentAddress;
-    entry.directive = directive;
+    uint32_t size = keyword->value;
+    const uint32_t address = currentAddress;
+    const uint32_t payload = symbolTable.payloadMark();
 
     if (directive == ".asciz" || directive == ".ascii" || directive == ".asciiz") {
         if (tokenIndex >= line.size() || line[tokenIndex].type != TokenType::STRING) {
             reportError("Invalid or missing string literal for " + directive + " directive");
             return;
         }
-        entry.stringValue = line[tokenIndex].value;
-        entry.isString = true;
-        uint32_t stringSize = entry.stringValue.length();
-        bool addNullTerminator = (directive == ".asciz" || directive == ".asciiz");
-        uint32_t wordsNeeded = (stringSize + (addNullTerminator ? 1 : 0) + 3) / 4;
-        currentAddress += wordsNeeded * 4;
+        std::string_view stringValue = line[tokenIndex].value;
+        symbolTable.appendPayload(stringValue);
+        if (stringValue.empty() || stringValue.back() != '\0') {
+            symbolTable.appendPayload(0, 1);
+        }
     }
     else {
         if (tokenIndex >= line.size()) {
@@ -247,37 +464,47 @@ inline void Parser::handleDirective(const std::vector<Token> &line) {
             return;
         }
 
-        entry.isString = false;
-
         while (tokenIndex < line.size()) {
-            if (line[tokenIndex].type == TokenType::IMMEDIATE) {
+            if (directive == ".float") {
+                const std::string text(line[tokenIndex].value);
+                char *end = nullptr;
+                const float value = std::strtof(text.c_str(), &end);
+                if (line[tokenIndex].type == TokenType::STRING || end == text.c_str() || *end != '\0') {
+                    reportError("Invalid floating-point value in .float directive: " + text);
+                    return;
+                }
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                symbolTable.appendPayload(bits, size);
+            }
+            else if (line[tokenIndex].type == TokenType::IMMEDIATE) {
                 try {
                     int64_t signedValue = parseImmediate(line[tokenIndex].value);
                     uint64_t value = static_cast<uint64_t>(signedValue);
                     if (directive == ".byte") {
                         if (signedValue < -128 || signedValue > 127) {
-                            reportError("Value out of range for .byte directive: " + line[tokenIndex].value);
+                            reportError("Value out of range for .byte directive: " + std::string(line[tokenIndex].value));
                             return;
                         }
                     } else if (directive == ".half") {
                         if (signedValue < -32768 || signedValue > 32767) {
-                            reportError("Value out of range for .half directive: " + line[tokenIndex].value);
+                            reportError("Value out of range for .half directive: " + std::string(line[tokenIndex].value));
                             return;
                         }
                     } else if (directive == ".word") {
                         if (signedValue < -2147483648LL || signedValue > 2147483647LL) {
-                            reportError("Value out of range for .word directive: " + line[tokenIndex].value);
+                            reportError("Value out of range for .word directive: " + std::string(line[tokenIndex].value));
                             return;
                         }
                     }
-                    entry.numericValues.push_back(value);
+                    symbolTable.appendPayload(value, size);
                 } catch (const std::exception& e) {
                     reportError("Invalid numeric value in " + directive + " directive: " + e.what());
                     return;
                 }
             }
             else if (line[tokenIndex].type == TokenType::STRING) {
-                std::string strValue = line[tokenIndex].value;
+                std::string_view strValue = line[tokenIndex].value;
                 uint64_t packedValue = 0;
                 size_t maxChars = 0;
 
@@ -295,7 +522,7 @@ inline void Parser::handleDirective(const std::vector<Token> &line) {
                 for (size_t i = 0; i < strValue.length(); ++i) {
                     packedValue |= (static_cast<uint64_t>(strValue[i]) << (8 * i));
                 }
-                entry.numericValues.push_back(packedValue);
+                symbolTable.appendPayload(packedValue, size);
             }
             else {
                 reportError("Invalid value in " + directive + " directive");
@@ -303,22 +530,28 @@ inline void Parser::handleDirective(const std::vector<Token> &line) {
             }
             tokenIndex++;
         }
-        currentAddress += size * entry.numericValues.size();
     }
+    currentAddress += dataEntryBytes(line);
 
-    if (!label.empty()) {
-        symbolTable[label] = entry;
+    if (label.empty()) {
+        symbolTable.discardPayload(payload);
+        return;
     }
+    const SymbolId id = symbolTable.intern(label);
+    symbolTable.defineData(id, address, payload);
+    definedData.push_back(id);
+    resolvePending(id);
 }
 
-inline void Parser::addLabel(const std::string &label) {
-    auto [it, inserted] = symbolTable.emplace(label, SymbolEntry{currentAddress, false, {}, "", ""});
-    if (!inserted) {
-        reportError("Duplicate label '" + label + "'");
+inline void Parser::addLabel(std::string_view label) {
+    const SymbolId id = symbolTable.intern(label);
+    if (!symbolTable.defineLabel(id, currentAddress)) {
+        reportError("Duplicate label '" + std::string(label) + "'");
     }
+    resolvePending(id);
 }
 
-inline bool Parser::handleInstruction(const std::vector<Token>& line) {
+inline bool Parser::handleInstruction(TokenLine line, Instructions base) {
     if (line.empty()) {
         reportError("Empty instruction encountered");
         return false;
@@ -329,109 +562,102 @@ inline bool Parser::handleInstruction(const std::vector<Token>& line) {
         return false;
     }
 
-    std::string opcode = line[0].value;
-    std::vector<std::string> operands;
+    const int lineNumber = line[0].lineNumber;
+    const std::string opcode(line[0].value);
+    const Instructions instruction = base != Instructions::INVALID ? base : lookupInstruction(opcode);
 
-    if (riscv::opcodes.count(opcode) == 0) {
-        reportError("Unknown opcode '" + opcode + "'");
+    if (instruction == Instructions::INVALID) {
+        reportError("Unknown opcode '" + opcode + "'", lineNumber);
         return false;
     }
 
-    size_t expectedOperands = 0;
-    bool isMemoryOp = false;
-    bool isStore = false;
-    bool isImm = false;
-    bool isBranch = false;
-    bool isUType = false;
-    bool isUJType = false;
-    
-    const auto& iTypeEncoding = riscv::ITypeInstructions::getEncoding();
-    if (iTypeEncoding.opcodeMap.count(opcode) && 
-        iTypeEncoding.func3Map.count(opcode) &&
-        (iTypeEncoding.func3Map.at(opcode) == 0b001 || 
-         (iTypeEncoding.func3Map.at(opcode) == 0b101 && iTypeEncoding.func7Map.count(opcode)))) {
-        expectedOperands = 3;
-        isImm = true;
-    }
-    else if (riscv::RTypeInstructions::getEncoding().opcodeMap.count(opcode)) {
-        expectedOperands = 3;
-    }
-    else if (riscv::ITypeInstructions::getEncoding().opcodeMap.count(opcode)) {
-        expectedOperands = 3;
-        isImm = true;
-        if (opcode == "lb" || opcode == "lh" || opcode == "lw" || opcode == "lbu" || opcode == "lhu" || opcode == "ld") {
-            isMemoryOp = true;
-        }
+    const InstructionDescriptor& descriptor = describe(instruction);
+    if (descriptor.operands == OperandFormat::NONE || descriptor.operands == OperandFormat::FENCE) {
+        return handleFixedInstruction(descriptor, line);
     }
-    else if (riscv::STypeInstructions::getEncoding().opcodeMap.count(opcode)) {
-        expectedOperands = 3;
-        isMemoryOp = true;
-        isStore = true;
+    if (descriptor.operands == OperandFormat::CSR || descriptor.operands == OperandFormat::CSR_IMM) {
+        return handleCsrInstruction(descriptor, line);
     }
-    else if (riscv::SBTypeInstructions::getEncoding().opcodeMap.count(opcode)) {
-        expectedOperands = 3;
-        isBranch = true;
+    if (descriptor.isVector()) {
+        return handleVectorInstruction(descriptor, line);
     }
-    else if (riscv::UTypeInstructions::getEncoding().opcodeMap.count(opcode)) {
-        expectedOperands = 2;
-        isImm = true;
-        isUType = true;
-    }
-    else if (riscv::UJTypeInstructions::getEncoding().opcodeMap.count(opcode)) {
-        expectedOperands = 2;
-        isImm = true;
-        isUJType = true;
+
+    // A trailing rounding mode (fadd.s fa0, fa1, fa2, rtz) fills the rm field
+    // rather than an operand.
+    uint8_t roundingMode = ROUND_DYNAMIC;
+    if (descriptor.hasRounding() && line.size() > 1 && line.back().type == TokenType::UNKNOWN && getRoundingMode(line.back().value) >= 0) {
+        roundingMode = static_cast<uint8_t>(getRoundingMode(line.back().value));
+        line = line.subLine(0, line.size() - 1);
     }
 
-    size_t i = 1;
+    const size_t expectedOperands = operandCountOf(descriptor.operands);
+    const bool isMemoryOp = descriptor.isMemory();
+    const bool isStore = descriptor.isStore();
+    const bool isBranch = descriptor.isBranch();
+    const bool isUType = descriptor.format == InstructionType::U;
+    const bool isUJType = descriptor.format == InstructionType::UJ;
+    const bool isImm = descriptor.format == InstructionType::I || isUType || isUJType;
+
     bool foundMemoryFormat = false;
     
     if (line.size() <= 1) {
-        reportError("Missing operands for instruction '" + opcode + "'");
+        reportError("Missing operands for instruction '" + opcode + "'", lineNumber);
         return false;
     }
-    
-    while (i < line.size()) {
-        const Token& token = line[i];
+
+    ParsedInstruction parsed(instruction, currentAddress, lineNumber);
+    size_t operandCount = 0;
+    auto push = [&](const Operand &operand) {
+        if (operandCount < MAX_OPERANDS) {
+            parsed.operands[operandCount] = operand;
+        }
+        ++operandCount;
+    };
+
+    // jalr rd, imm(rs1) reaches the parser as rd, imm, rs1, the way loads do;
+    // its operands are read in rd, rs1, imm order.
+    const bool jalrMemoryForm = instruction == Instructions::JALR && line.size() == 4 &&
+                                line[2].type != TokenType::REGISTER && line[3].type == TokenType::REGISTER;
+
+    for (size_t i = 1; i < line.size(); ++i) {
+        const TokenView& token = line[jalrMemoryForm && i > 1 ? 5 - i : i];
         
         if (token.value.empty()) {
-            reportError("Empty token value in instruction");
-            i++;
+            reportError("Empty token value in instruction", lineNumber);
             continue;
         }
         
         if (isStore && i == 1) {
-            if (!isRegister(token.value)) {
-                reportError("First operand of store instruction must be a register");
+            int32_t regNum = descriptor.isFloatOperand(0) ? getFloatRegisterNumber(token.value) : getRegisterNumber(token.value);
+            if (regNum < 0) {
+                reportError(std::string("First operand of store instruction must be ") + (descriptor.isFloatOperand(0) ? "a floating-point register" : "a register"), lineNumber);
                 return false;
             }
-            operands.push_back(token.value);
-            i++;
+            push(Operand::makeRegister(static_cast<uint8_t>(regNum)));
             continue;
         }
 
-        if (isMemoryOp && ((isStore && i == 2) || (!isStore && i == 2))) {
-            std::string offset, reg;
+        if (isMemoryOp && i == 2) {
+            std::string_view offset, reg;
             if (isMemory(token.value, offset, reg)) {
                 foundMemoryFormat = true;
                 try {
                     int32_t regNum = getRegisterNumber(reg);
                     if (regNum < 0) {
-                        reportError("Invalid register in memory operand: " + reg);
+                        reportError("Invalid register in memory operand: " + std::string(reg), lineNumber);
                         return false;
                     }
                     int32_t imm = parseImmediate(offset);
-                    if (imm < -2048 || imm > 2047) {
-                        reportError("Memory offset out of range (-2048 to 2047): " + offset);
+                    if (imm < descriptor.immMin || imm > descriptor.immMax) {
+                        reportError("Memory offset out of range (-2048 to 2047): " + std::string(offset), lineNumber);
                         return false;
                     }
                     
-                    operands.push_back(offset);
-                    operands.push_back(reg);
-                    i++;
+                    push(Operand::makeImmediate(imm));
+                    push(Operand::makeRegister(static_cast<uint8_t>(regNum)));
                     continue;
                 } catch (const std::exception& e) {
-                    reportError("Invalid memory offset: " + offset + " - " + e.what());
+                    reportError("Invalid memory offset: " + std::string(offset) + " - " + e.what(), lineNumber);
                     return false;
                 }
             }
@@ -439,146 +665,610 @@ inline bool Parser::handleInstruction(const std::vector<Token>& line) {
 
         switch (token.type) {
             case TokenType::REGISTER: {
-                int32_t regNum = getRegisterNumber(token.value);
+                const bool isFloat = descriptor.isFloatOperand(operandCount);
+                int32_t regNum = isFloat ? getFloatRegisterNumber(token.value) : getRegisterNumber(token.value);
                 if (regNum < 0) {
-                    reportError("Invalid register: " + token.value);
+                    reportError(std::string(isFloat ? "Expected a floating-point register" : "Expected an integer register") + " but found '" + std::string(token.value) + "'", lineNumber);
                     return false;
                 }
-                operands.push_back(token.value);
+                push(Operand::makeRegister(static_cast<uint8_t>(regNum)));
                 break;
             }
             case TokenType::IMMEDIATE: {
+                int32_t imm = 0;
                 try {
-                    int32_t imm = parseImmediate(token.value);
-                    
-                    if (isMemoryOp && !foundMemoryFormat) {
-                        if (imm < -2048 || imm > 2047) {
-                            reportError("Memory offset out of range (-2048 to 2047): " + token.value);
-                            return false;
-                        }
-                    }
-                    else if (isBranch) {
-                        if (imm < -4096 || imm > 4095 || (imm & 1)) {
-                            reportError("Branch offset must be even and in range (-4096 to 4095): " + token.value);
-                            return false;
-                        }
-                    }
-                    else if (isUType) {
-                        if (imm < 0 || imm > 0xFFFFF) {
-                            reportError("Immediate value out of range for U-type instruction (0 to 0xFFFFF): " + token.value);
-                            return false;
-                        }
+                    imm = parseImmediate(token.value);
+                } catch (const std::exception& e) {
+                    int32_t regNum = getRegisterNumber(token.value);
+                    if (isMemoryOp && !foundMemoryFormat && regNum >= 0) {
+                        push(Operand::makeRegister(static_cast<uint8_t>(regNum)));
+                        break;
                     }
-                    else if (isUJType) {
-                        if (imm < -524288 || imm > 524287 || (imm & 1)) {
-                            reportError("Jump immediate must be even and in range (-524288 to 524287): " + token.value);
-                            return false;
-                        }
+                    reportError("Invalid immediate value: " + std::string(token.value) + " - " + e.what(), lineNumber);
+                    return false;
+                }
+
+                if (isMemoryOp && !foundMemoryFormat) {
+                    if (imm < descriptor.immMin || imm > descriptor.immMax) {
+                        reportError("Memory offset out of range (-2048 to 2047): " + std::string(token.value), lineNumber);
+                        return false;
                     }
-                    else if (isImm) {
-                        if (imm < -2048 || imm > 2047) {
-                            reportError("Immediate value out of range (-2048 to 2047): " + token.value);
-                            return false;
-                        }
+                }
+                else if (isBranch) {
+                    if (imm < descriptor.immMin || imm > descriptor.immMax || (imm & 1)) {
+                        reportError("Branch offset must be even and in range (-4096 to 4095): " + std::string(token.value), lineNumber);
+                        return false;
                     }
-                    operands.push_back(token.value);
-                } catch (const std::exception& e) {
-                    if (isMemoryOp && !foundMemoryFormat && isRegister(token.value)) {
-                        operands.push_back(token.value);
-                    } else {
-                        reportError("Invalid immediate value: " + token.value + " - " + e.what());
+                }
+                else if (isUType) {
+                    if (imm < descriptor.immMin || imm > descriptor.immMax) {
+                        reportError("Immediate value out of range for U-type instruction (0 to 0xFFFFF): " + std::string(token.value), lineNumber);
                         return false;
                     }
                 }
-                break;
-            }
-            case TokenType::LABEL: {
-                auto labelAddress = resolveLabel(token.value);
-                if (labelAddress == static_cast<uint32_t>(-1)) return false;
-                
-                if (isBranch || isUJType || opcode == "j") {
-                    int32_t offset = static_cast<int32_t>(*labelAddress - currentAddress);
-                    if (isBranch && (offset < -4096 || offset > 4095 || (offset & 1))) {
-                        reportError("Branch target out of range or misaligned: " + token.value);
+                else if (isUJType) {
+                    if (imm < -524288 || imm > 524287 || (imm & 1)) {
+                        reportError("Jump immediate must be even and in range (-524288 to 524287): " + std::string(token.value), lineNumber);
                         return false;
-                    } else if ((isUJType || opcode == "j") && (offset < -1048576 || offset > 1048575 || (offset & 1))) {
-                        reportError("Jump target out of range or misaligned: " + token.value);
+                    }
+                }
+                else if (isImm) {
+                    if (imm < descriptor.immMin || imm > descriptor.immMax) {
+                        reportError("Immediate value out of range (" + std::to_string(descriptor.immMin) + " to " + std::to_string(descriptor.immMax) + "): " + std::string(token.value), lineNumber);
                         return false;
                     }
-                    operands.push_back(std::to_string(offset));
-                } else {
-                    operands.push_back(std::to_string(*labelAddress));
                 }
+                push(Operand::makeImmediate(imm));
                 break;
             }
+            case TokenType::LABEL:
             case TokenType::UNKNOWN: {
-                if (symbolTable.find(token.value) != symbolTable.end()) {
-                    auto labelAddress = resolveLabel(token.value);
-                    if (labelAddress == static_cast<uint32_t>(-1)) return false;
-                    
-                    if (isBranch || isUJType || opcode == "j") {
-                        int32_t offset = static_cast<int32_t>(*labelAddress - currentAddress);
-                        if (isBranch && (offset < -4096 || offset > 4095 || (offset & 1))) {
-                            reportError("Branch target out of range or misaligned: " + token.value);
-                            return false;
-                        } else if ((isUJType || opcode == "j") && (offset < -1048576 || offset > 1048575 || (offset & 1))) {
-                            reportError("Jump target out of range or misaligned: " + token.value);
-                            return false;
-                        }
-                        operands.push_back(std::to_string(offset));
-                    } else {
-                        operands.push_back(std::to_string(*labelAddress));
-                    }
-                } else if (isRegister(token.value)) {
-                    operands.push_back(token.value);
-                } else {
-                    reportError("Invalid operand or undefined label '" + token.value + "' in instruction");
+                OperandModifier modifier = OperandModifier::NONE;
+                std::string_view name = token.value;
+                if (token.type == TokenType::UNKNOWN && parseRelocationOperator(token.value, modifier, name) &&
+                    !checkRelocationOperator(descriptor, modifier, name, lineNumber)) {
                     return false;
                 }
+                SymbolId id = symbolTable.find(name);
+                const bool isDefined = id != INVALID_SYMBOL && symbolTable[id].isDefined();
+                if (token.type == TokenType::UNKNOWN && !isDefined && modifier == OperandModifier::NONE) {
+                    int32_t regNum = getRegisterNumber(token.value);
+                    if (regNum >= 0) {
+                        push(Operand::makeRegister(static_cast<uint8_t>(regNum)));
+                        break;
+                    }
+                }
+
+                if (id == INVALID_SYMBOL) {
+                    id = symbolTable.intern(name);
+                }
+                Operand operand = Operand::makeLabel(symbolTable.name(id), modifier);
+                if (isDefined) {
+                    if (!resolveLabelOperand(operand, id, descriptor, currentAddress, lineNumber)) return false;
+                } else if (operandCount < MAX_OPERANDS) {
+                    pendingFixups[id].push_back({nextPosition(), operandCount});
+                    ++pendingFixupCount;
+                }
+                push(operand);
                 break;
             }
             default:
                 reportError("Invalid token type '" + getTokenTypeName(token.type) + "' with value '" + 
-                           (token.value.empty() ? "empty" : token.value) + "' in instruction");
+                           (token.value.empty() ? std::string("empty") : std::string(token.value)) + "' in instruction", lineNumber);
                 return false;
         }
-        i++;
     }
 
-    if (isMemoryOp && !foundMemoryFormat && operands.size() == expectedOperands) {
-        if (operands.empty() || operands.back().empty()) {
-            reportError("Missing base register in memory operation");
-            return false;
-        }
-        if (!isRegister(operands.back())) {
-            reportError("Invalid base register in memory operation: " + operands.back());
-            return false;
-        }
+    if (isMemoryOp && !foundMemoryFormat && operandCount == expectedOperands && !parsed.operands[expectedOperands - 1].isRegister()) {
+        reportError("Invalid base register in memory operation", lineNumber);
+        return false;
     }
     
-    if (operands.size() != expectedOperands) {
+    if (operandCount != expectedOperands) {
         reportError("Incorrect number of operands for '" + opcode + "' (expected " + std::to_string(expectedOperands) + 
-                   ", got " + std::to_string(operands.size()) + ")");
+                   ", got " + std::to_string(operandCount) + ")", lineNumber);
         return false;
     }
     
-    parsedInstructions.emplace_back(opcode, operands, currentAddress);
+    parsed.operandCount = static_cast<uint8_t>(operandCount);
+    parsed.compressible = compression;
+    parsed.roundingMode = roundingMode;
+    if (instruction == Instructions::AUIPC && parsed[1].modifier == OperandModifier::PCREL_HI) {
+        pcrelHiEnd = currentAddress + INSTRUCTION_SIZE;
+        pcrelHiSymbol = parsed[1].symbol;
+    }
+    parsedInstructions.push_back(parsed);
     return true;
 }
 
-inline std::optional<uint32_t> Parser::resolveLabel(const std::string &label) const {
-    if (label.empty()) {
-        reportError("Empty label encountered");
-        return std::nullopt;
+// %hi and %pcrel_hi belong on lui and auipc, %lo and %pcrel_lo on the
+// immediate of an I- or S-type instruction. %pcrel_lo(sym) takes the offset
+// from the instruction before it, which must be `auipc rd, %pcrel_hi(sym)`;
+// that instruction is unknown only when parsing starts right here.
+inline bool Parser::checkRelocationOperator(const InstructionDescriptor &descriptor, OperandModifier modifier, std::string_view symbol, int lineNumber) const {
+    const std::string name(symbol);
+    switch (modifier) {
+        case OperandModifier::HI:
+            if (descriptor.instruction == Instructions::LUI) return true;
+            reportError("%hi(" + name + ") is only valid as the immediate of lui", lineNumber);
+            return false;
+        case OperandModifier::PCREL_HI:
+            if (descriptor.instruction == Instructions::AUIPC) return true;
+            reportError("%pcrel_hi(" + name + ") is only valid as the immediate of auipc", lineNumber);
+            return false;
+        case OperandModifier::LO:
+        case OperandModifier::PCREL_LO:
+            if (descriptor.format != InstructionType::I && descriptor.format != InstructionType::S) {
+                reportError(std::string(modifier == OperandModifier::LO ? "%lo(" : "%pcrel_lo(") + name + ") is only valid as the immediate of an I- or S-type instruction", lineNumber);
+                return false;
+            }
+            if (modifier == OperandModifier::PCREL_LO && currentAddress != streamStart && (pcrelHiEnd != currentAddress || pcrelHiSymbol != symbol)) {
+                reportError("%pcrel_lo(" + name + ") must directly follow auipc with %pcrel_hi(" + name + ")", lineNumber);
+                return false;
+            }
+            return true;
+        case OperandModifier::NONE:
+            break;
     }
-    
-    auto it = symbolTable.find(label);
-    if (it != symbolTable.end()) {
-        return it->second.address;
+    return true;
+}
+
+// ecall and ebreak take no operands; fence takes none (all of iorw) or a
+// predecessor and a successor set. Both are stored as x0, x0 and the immediate
+// so they encode like any other I-type instruction.
+inline bool Parser::handleFixedInstruction(const InstructionDescriptor &descriptor, TokenLine line) {
+    const int lineNumber = line[0].lineNumber;
+    int32_t imm = 0;
+    if (descriptor.operands == OperandFormat::FENCE && line.size() == 3) {
+        const int32_t predecessor = parseFenceSet(line[1].value);
+        const int32_t successor = parseFenceSet(line[2].value);
+        if (predecessor < 0 || successor < 0) {
+            reportError("Invalid fence set in '" + std::string(line[1].value) + ", " + std::string(line[2].value) + "' (expected a subset of iorw)", lineNumber);
+            return false;
+        }
+        imm = (predecessor << 4) | successor;
+    } else if (descriptor.operands == OperandFormat::FENCE && line.size() == 1) {
+        imm = descriptor.immMax;
+    } else if (line.size() != 1) {
+        reportError("Incorrect number of operands for '" + std::string(descriptor.mnemonic) + "' (expected " +
+                   (descriptor.operands == OperandFormat::FENCE ? "0 or 2" : "0") + ", got " + std::to_string(line.size() - 1) + ")", lineNumber);
+        return false;
+    }
+
+    ParsedInstruction parsed(descriptor.instruction, currentAddress, lineNumber);
+    parsed.operands[0] = Operand::makeRegister(0);
+    parsed.operands[1] = Operand::makeRegister(0);
+    parsed.operands[2] = Operand::makeImmediate(imm);
+    parsed.operandCount = 3;
+    parsed.compressible = compression;
+    parsedInstructions.push_back(parsed);
+    return true;
+}
+
+// csrrw rd, csr, rs1 and csrrwi rd, csr, uimm. The CSR is stored as an
+// immediate between rd and the source so it encodes like an I-type immediate.
+inline bool Parser::handleCsrInstruction(const InstructionDescriptor &descriptor, TokenLine line) {
+    const int lineNumber = line[0].lineNumber;
+    if (line.size() != 4) {
+        reportError("Incorrect number of operands for '" + std::string(descriptor.mnemonic) + "' (expected 3, got " + std::to_string(line.size() - 1) + ")", lineNumber);
+        return false;
+    }
+
+    ParsedInstruction parsed(descriptor.instruction, currentAddress, lineNumber);
+    parsed.operands[0] = registerArgument(line[1]);
+    parsed.operands[1] = csrArgument(line[2]);
+    if (descriptor.operands == OperandFormat::CSR_IMM) {
+        const int32_t value = line[3].type == TokenType::IMMEDIATE ? parseImmediate(line[3].value) : -1;
+        if (value < 0 || value > 31) {
+            reportError("CSR immediate must be in range (0 to 31): " + std::string(line[3].value), lineNumber);
+            return false;
+        }
+        parsed.operands[2] = Operand::makeImmediate(value);
+    } else {
+        parsed.operands[2] = registerArgument(line[3]);
+    }
+    parsed.operandCount = 3;
+    parsedInstructions.push_back(parsed);
+    return true;
+}
+
+// V instructions keep their operands by encoding field rather than in source
+// order: rd, rs1, rs2 and the vm bit. rs1 holds the immediate of the .vi forms
+// and the AVL of vsetivli, rs2 the vtype of vsetvli and vsetivli. A trailing
+// v0.t masks the instruction; vmerge always names v0 as its selector.
+inline bool Parser::handleVectorInstruction(const InstructionDescriptor &descriptor, TokenLine line) {
+    const int lineNumber = line[0].lineNumber;
+    const std::string mnemonic(descriptor.mnemonic);
+    TokenLine operands = line.subLine(1, line.size());
+
+    int32_t vm = 1;
+    if (descriptor.operands == OperandFormat::VECTOR_MERGE) {
+        if (operands.empty() || operands.back().value != "v0") {
+            reportError("'" + mnemonic + "' takes v0 as its last operand", lineNumber);
+        }
+        operands = operands.subLine(0, operands.size() - 1);
+        vm = 0;
+    } else if (!operands.empty() && operands.back().value == "v0.t") {
+        if (descriptor.mask & VECTOR_VM_FIELD) {
+            reportError("'" + mnemonic + "' cannot be masked", lineNumber);
+        }
+        operands = operands.subLine(0, operands.size() - 1);
+        vm = 0;
+    }
+
+    size_t next = 0;
+    auto take = [&]() -> const TokenView& {
+        if (next == operands.size()) {
+            reportError("Missing operands for instruction '" + mnemonic + "'", lineNumber);
+        }
+        return operands[next++];
+    };
+    auto vectorRegister = [&]() {
+        const TokenView &token = take();
+        const int32_t regNum = getVectorRegisterNumber(token.value);
+        if (regNum < 0) {
+            reportError("Expected a vector register but found '" + std::string(token.value) + "'", lineNumber);
+        }
+        return Operand::makeRegister(static_cast<uint8_t>(regNum));
+    };
+    auto scalarRegister = [&]() { return registerArgument(take()); };
+    auto immediate = [&](int32_t min, int32_t max) {
+        const TokenView &token = take();
+        const int32_t value = token.type == TokenType::IMMEDIATE ? parseImmediate(token.value) : min - 1;
+        if (value < min || value > max) {
+            reportError("Immediate value out of range (" + std::to_string(min) + " to " + std::to_string(max) + "): " + std::string(token.value), lineNumber);
+        }
+        return Operand::makeImmediate(value);
+    };
+    auto source1 = [&]() {
+        if (descriptor.vectorRegisters & VECTOR_VS1) return vectorRegister();
+        if (descriptor.vectorRegisters & SCALAR_RS1) return scalarRegister();
+        return immediate(descriptor.immMin, descriptor.immMax);
+    };
+    // e32, m2, ta, ma in any order; SEW is required, LMUL defaults to m1 and
+    // the policies to tu, mu. A plain number is taken as the vtype itself.
+    auto vectorType = [&]() {
+        if (next + 1 == operands.size() && operands[next].type == TokenType::IMMEDIATE) {
+            return immediate(0, descriptor.immMax);
+        }
+        int32_t vtype = 0, fields = 0;
+        while (next < operands.size()) {
+            const TokenView &token = take();
+            const int32_t field = getVectorTypeField(token.value);
+            if (field < 0) {
+                reportError("Invalid vtype setting '" + std::string(token.value) + "'", lineNumber);
+            }
+            if (fields & (field >> 8)) {
+                reportError("vtype setting '" + std::string(token.value) + "' conflicts with an earlier one", lineNumber);
+            }
+            fields |= field >> 8;
+            vtype |= field & 0xFF;
+        }
+        if (!(fields & 0x38)) {
+            reportError("'" + mnemonic + "' needs an element width (e8, e16, e32 or e64)", lineNumber);
+        }
+        return Operand::makeImmediate(vtype);
+    };
+
+    const Operand zero = Operand::makeRegister(0);
+    Operand rd = zero, rs1 = zero, rs2 = zero;
+    switch (descriptor.operands) {
+        case OperandFormat::VECTOR_CONFIG:
+        case OperandFormat::VECTOR_CONFIG_IMM:
+            rd = scalarRegister();
+            rs1 = descriptor.operands == OperandFormat::VECTOR_CONFIG ? scalarRegister() : immediate(0, 31);
+            rs2 = vectorType();
+            break;
+        case OperandFormat::REG_REG_REG:
+            rd = scalarRegister();
+            rs1 = scalarRegister();
+            rs2 = scalarRegister();
+            break;
+        case OperandFormat::VECTOR_MEMORY:
+        case OperandFormat::VECTOR_STRIDED: {
+            rd = vectorRegister();
+            // (a0) lexes as a zero offset and the base register.
+            if (next < operands.size() && operands[next].type == TokenType::IMMEDIATE && parseImmediate(take().value) != 0) {
+                reportError("Vector loads and stores take no offset", lineNumber);
+            }
+            rs1 = scalarRegister();
+            if (descriptor.operands == OperandFormat::VECTOR_STRIDED) rs2 = scalarRegister();
+            break;
+        }
+        case OperandFormat::VECTOR_MULTIPLY_ADD:
+            rd = vectorRegister();
+            rs1 = source1();
+            rs2 = vectorRegister();
+            break;
+        case OperandFormat::VECTOR_TO_SCALAR:
+            rd = scalarRegister();
+            rs2 = vectorRegister();
+            break;
+        case OperandFormat::VECTOR_INDEX:
+            rd = vectorRegister();
+            break;
+        case OperandFormat::VECTOR_UNARY:
+            rd = vectorRegister();
+            rs1 = source1();
+            break;
+        default:
+            rd = vectorRegister();
+            rs2 = vectorRegister();
+            rs1 = source1();
+            break;
+    }
+    if (next != operands.size()) {
+        reportError("Too many operands for '" + mnemonic + "'", lineNumber);
+    }
+    // The vsetvl family and forms with a fixed vm bit take it from the match.
+    if ((descriptor.mask & VECTOR_VM_FIELD) || (descriptor.opcode == OP_V && descriptor.funct3 == OPCFG)) {
+        vm = (descriptor.match & VECTOR_VM_FIELD) ? 1 : 0;
+    }
+
+    ParsedInstruction parsed(descriptor.instruction, currentAddress, lineNumber);
+    parsed.operands[0] = rd;
+    parsed.operands[1] = rs1;
+    parsed.operands[2] = rs2;
+    parsed.operands[3] = Operand::makeImmediate(vm);
+    parsed.operandCount = 4;
+    parsedInstructions.push_back(parsed);
+    return true;
+}
+
+// A compressed form parses as the base instruction it aliases, marked to be
+// assembled as a 16-bit parcel. Operands no parcel can hold (registers outside
+// x8-x15 where the form needs them, wide immediates, far targets) are
+// rejected when the instruction is encoded.
+inline void Parser::handleCompressedInstruction(const CompressedDescriptor &form, TokenLine line) {
+    const int lineNumber = line[0].lineNumber;
+    if (!inTextSection) {
+        reportError("Instruction outside of .text section", lineNumber);
+    }
+    if (form.shape == CompressedShape::BASE) {
+        if (!handleInstruction(line, form.base)) {
+            reportError("Invalid instruction", lineNumber);
+        }
+        parsedInstructions.back().compressed = true;
+        currentAddress += COMPRESSED_INSTRUCTION_SIZE;
+        return;
+    }
+
+    static constexpr size_t operandCounts[] = {0, 1, 2, 2, 2, 0, 2, 1};
+    const size_t expected = operandCounts[static_cast<size_t>(form.shape)];
+    if (line.size() - 1 != expected) {
+        reportError("Incorrect number of operands for '" + std::string(form.mnemonic) + "' (expected " + std::to_string(expected) +
+                   ", got " + std::to_string(line.size() - 1) + ")", lineNumber);
+    }
+
+    const InstructionDescriptor &descriptor = describe(form.base);
+    const Operand zero = Operand::makeRegister(0);
+    const Operand implied = Operand::makeRegister(form.implied);
+    auto reg = [&](size_t index) { return registerArgument(line[index]); };
+    auto imm = [&](size_t index) {
+        if (line[index].type != TokenType::IMMEDIATE) {
+            reportError("Expected an immediate but found '" + std::string(line[index].value) + "'", lineNumber);
+        }
+        const int32_t value = parseImmediate(line[index].value);
+        if (value < descriptor.immMin || value > descriptor.immMax) {
+            reportError("Immediate value out of range (" + std::to_string(descriptor.immMin) + " to " + std::to_string(descriptor.immMax) + "): " + std::string(line[index].value), lineNumber);
+        }
+        return Operand::makeImmediate(value);
+    };
+
+    switch (form.shape) {
+        case CompressedShape::NONE: emit(form.base, {zero, zero, Operand::makeImmediate(0)}, lineNumber, true); break;
+        case CompressedShape::JUMP_REG: emit(form.base, {implied, reg(1), Operand::makeImmediate(0)}, lineNumber, true); break;
+        case CompressedShape::REG_REG: emit(form.base, {reg(1), form.implied == SAME_AS_RD ? reg(1) : implied, reg(2)}, lineNumber, true); break;
+        case CompressedShape::REG_IMM: emit(form.base, {reg(1), form.implied == SAME_AS_RD ? reg(1) : implied, imm(2)}, lineNumber, true); break;
+        case CompressedShape::UPPER: emit(form.base, {reg(1), imm(2)}, lineNumber, true); break;
+        case CompressedShape::BRANCH: emit(form.base, {reg(1), zero, targetArgument(line[2])}, lineNumber, true); break;
+        case CompressedShape::JUMP: emit(form.base, {implied, targetArgument(line[1])}, lineNumber, true); break;
+        case CompressedShape::BASE: break;
+    }
+}
+
+// A data entry is a label followed by its directive and values; .float
+// values that do not lex as immediates stay part of the entry.
+inline size_t Parser::dataEntryEnd(TokenLine line, size_t start) {
+    size_t end = start + 1;
+    while (end < line.size() && (line[end].type == TokenType::DIRECTIVE || line[end].type == TokenType::IMMEDIATE || line[end].type == TokenType::STRING ||
+                                 (line[end].type == TokenType::UNKNOWN && start + 1 < line.size() && line[start + 1].value == ".float"))) {
+        ++end;
+    }
+    return end;
+}
+
+inline uint32_t Parser::dataEntryBytes(TokenLine entry) {
+    const size_t index = (!entry.empty() && entry[0].type == TokenType::LABEL) ? 1 : 0;
+    if (index >= entry.size()) return 0;
+    const std::string_view directive = entry[index].value;
+    const Keyword* keyword = findKeyword(directive);
+    if (keyword == nullptr || keyword->kind != KeywordKind::DIRECTIVE) return 0;
+
+    if (directive == ".asciz" || directive == ".ascii" || directive == ".asciiz") {
+        if (index + 1 >= entry.size()) return 0;
+        const uint32_t terminator = (directive == ".ascii") ? 0 : 1;
+        return (static_cast<uint32_t>(entry[index + 1].value.length()) + terminator + 3) / 4 * 4;
+    }
+    return keyword->value * static_cast<uint32_t>(entry.size() - index - 1);
+}
+
+// Bytes a line adds to the data section when it is parsed there.
+inline uint32_t Parser::dataBytes(TokenLine line) {
+    uint32_t bytes = 0;
+    size_t index = 0;
+    while (index < line.size()) {
+        if (line[index].type != TokenType::LABEL) {
+            ++index;
+            continue;
+        }
+        const size_t end = dataEntryEnd(line, index);
+        bytes += dataEntryBytes(line.subLine(index, end));
+        index = end;
+    }
+    return bytes;
+}
+
+inline uint32_t Parser::instructionBytes(TokenLine instruction) {
+    if (findCompressedForm(instruction[0].value) != nullptr) return COMPRESSED_INSTRUCTION_SIZE;
+    const PseudoDescriptor* pseudo = findPseudoInstruction(instruction[0].value, instruction.size() - 1);
+    if (pseudo == nullptr) return INSTRUCTION_SIZE;
+    if (pseudo->length != 0) return pseudo->length * INSTRUCTION_SIZE;
+    try {
+        return loadImmediateLength(parseImmediate(instruction.back().value)) * INSTRUCTION_SIZE;
+    } catch (const std::exception&) {
+        return INSTRUCTION_SIZE;
+    }
+}
+
+inline Operand Parser::registerArgument(const TokenView &token) const {
+    const int32_t regNum = getRegisterNumber(token.value);
+    if (regNum < 0) {
+        reportError("Expected a register but found '" + std::string(token.value) + "'", token.lineNumber);
+    }
+    return Operand::makeRegister(static_cast<uint8_t>(regNum));
+}
+
+inline Operand Parser::floatRegisterArgument(const TokenView &token) const {
+    const int32_t regNum = getFloatRegisterNumber(token.value);
+    if (regNum < 0) {
+        reportError("Expected a floating-point register but found '" + std::string(token.value) + "'", token.lineNumber);
+    }
+    return Operand::makeRegister(static_cast<uint8_t>(regNum));
+}
+
+// A CSR by name (fflags, frm, fcsr) or by its 12-bit number.
+inline Operand Parser::csrArgument(const TokenView &token) const {
+    int32_t csr = getCsrNumber(token.value);
+    if (csr < 0 && token.type == TokenType::IMMEDIATE) {
+        csr = parseImmediate(token.value);
+    }
+    if (csr < 0 || csr > 0xFFF) {
+        reportError("Expected a CSR but found '" + std::string(token.value) + "'", token.lineNumber);
+    }
+    return Operand::makeImmediate(csr);
+}
+
+inline Operand Parser::targetArgument(const TokenView &token, OperandModifier modifier) const {
+    if (token.type == TokenType::IMMEDIATE && modifier == OperandModifier::NONE) {
+        return Operand::makeImmediate(parseImmediate(token.value));
+    }
+    if ((token.type != TokenType::UNKNOWN && token.type != TokenType::LABEL) || getRegisterNumber(token.value) >= 0) {
+        reportError("Expected a label but found '" + std::string(token.value) + "'", token.lineNumber);
+    }
+    return Operand::makeLabel(token.value, modifier);
+}
+
+inline void Parser::emit(Instructions instruction, std::initializer_list<Operand> operands, int lineNumber, bool compressed) {
+    ParsedInstruction parsed(instruction, currentAddress, lineNumber);
+    parsed.compressed = compressed;
+    parsed.compressible = compression;
+    for (Operand operand : operands) {
+        if (operand.kind == OperandKind::LABEL) {
+            const SymbolId id = symbolTable.intern(operand.symbol);
+            operand.symbol = symbolTable.name(id);
+            if (symbolTable[id].isDefined()) {
+                resolveLabelOperand(operand, id, describe(instruction), currentAddress, lineNumber);
+            } else {
+                pendingFixups[id].push_back({nextPosition(), parsed.operandCount});
+                ++pendingFixupCount;
+            }
+        }
+        parsed.operands[parsed.operandCount++] = operand;
+    }
+    parsedInstructions.push_back(parsed);
+    currentAddress += compressed ? COMPRESSED_INSTRUCTION_SIZE : INSTRUCTION_SIZE;
+}
+
+// Expands to the shortest base sequence. Only li depends on its operand, so
+// the length of every expansion is known from the tokens alone and the first
+// pass (and the parallel assembler's address plan) stays exact.
+inline void Parser::expandPseudoInstruction(const PseudoDescriptor &pseudo, TokenLine line) {
+    const int lineNumber = line[0].lineNumber;
+    if (!inTextSection) {
+        reportError("Instruction outside of .text section", lineNumber);
+    }
+    if (line.size() - 1 != pseudo.operands) {
+        reportError("Incorrect number of operands for '" + std::string(pseudo.mnemonic) + "' (expected " + std::to_string(pseudo.operands) +
+                   ", got " + std::to_string(line.size() - 1) + ")", lineNumber);
+    }
+
+    const Operand zero = Operand::makeRegister(0);
+    const Operand ra = Operand::makeRegister(1);
+    auto reg = [&](size_t index) { return registerArgument(line[index]); };
+    auto freg = [&](size_t index) { return floatRegisterArgument(line[index]); };
+    auto imm = [](int32_t value) { return Operand::makeImmediate(value); };
+
+    switch (pseudo.pseudo) {
+        case PseudoInstructions::NOP:
+            emit(Instructions::ADDI, {zero, zero, imm(0)}, lineNumber);
+            break;
+        case PseudoInstructions::LI: {
+            const Operand rd = reg(1);
+            if (line[2].type != TokenType::IMMEDIATE) {
+                reportError("Expected an immediate but found '" + std::string(line[2].value) + "'", lineNumber);
+            }
+            const int32_t value = parseImmediate(line[2].value);
+            const int32_t lower = lowerImmediate(value);
+            if (lower == value) {
+                emit(Instructions::ADDI, {rd, zero, imm(value)}, lineNumber);
+                break;
+            }
+            emit(Instructions::LUI, {rd, imm(upperImmediate(value))}, lineNumber);
+            if (lower != 0) emit(Instructions::ADDI, {rd, rd, imm(lower)}, lineNumber);
+            break;
+        }
+        case PseudoInstructions::LA: {
+            const Operand rd = reg(1);
+            emit(Instructions::AUIPC, {rd, targetArgument(line[2], OperandModifier::PCREL_HI)}, lineNumber);
+            emit(Instructions::ADDI, {rd, rd, targetArgument(line[2], OperandModifier::PCREL_LO)}, lineNumber);
+            break;
+        }
+        case PseudoInstructions::MV: emit(Instructions::ADDI, {reg(1), reg(2), imm(0)}, lineNumber); break;
+        case PseudoInstructions::NOT: emit(Instructions::XORI, {reg(1), reg(2), imm(-1)}, lineNumber); break;
+        case PseudoInstructions::NEG: emit(Instructions::SUB, {reg(1), zero, reg(2)}, lineNumber); break;
+        case PseudoInstructions::SGTZ: emit(Instructions::SLT, {reg(1), zero, reg(2)}, lineNumber); break;
+        case PseudoInstructions::SLTZ: emit(Instructions::SLT, {reg(1), reg(2), zero}, lineNumber); break;
+        case PseudoInstructions::SEQZ: emit(Instructions::SLTIU, {reg(1), reg(2), imm(1)}, lineNumber); break;
+        case PseudoInstructions::SNEZ: emit(Instructions::SLTU, {reg(1), zero, reg(2)}, lineNumber); break;
+        case PseudoInstructions::J: emit(Instructions::JAL, {zero, targetArgument(line[1])}, lineNumber); break;
+        case PseudoInstructions::JAL: emit(Instructions::JAL, {ra, targetArgument(line[1])}, lineNumber); break;
+        case PseudoInstructions::JR: emit(Instructions::JALR, {zero, reg(1), imm(0)}, lineNumber); break;
+        case PseudoInstructions::JALR: emit(Instructions::JALR, {ra, reg(1), imm(0)}, lineNumber); break;
+        case PseudoInstructions::RET: emit(Instructions::JALR, {zero, ra, imm(0)}, lineNumber); break;
+        case PseudoInstructions::CALL:
+            emit(Instructions::AUIPC, {ra, targetArgument(line[1], OperandModifier::PCREL_HI)}, lineNumber);
+            emit(Instructions::JALR, {ra, ra, targetArgument(line[1], OperandModifier::PCREL_LO)}, lineNumber);
+            break;
+        case PseudoInstructions::TAIL: {
+            const Operand t1 = Operand::makeRegister(6);
+            emit(Instructions::AUIPC, {t1, targetArgument(line[1], OperandModifier::PCREL_HI)}, lineNumber);
+            emit(Instructions::JALR, {zero, t1, targetArgument(line[1], OperandModifier::PCREL_LO)}, lineNumber);
+            break;
+        }
+        case PseudoInstructions::BEQZ: emit(Instructions::BEQ, {reg(1), zero, targetArgument(line[2])}, lineNumber); break;
+        case PseudoInstructions::BNEZ: emit(Instructions::BNE, {reg(1), zero, targetArgument(line[2])}, lineNumber); break;
+        case PseudoInstructions::BLEZ: emit(Instructions::BGE, {zero, reg(1), targetArgument(line[2])}, lineNumber); break;
+        case PseudoInstructions::BGEZ: emit(Instructions::BGE, {reg(1), zero, targetArgument(line[2])}, lineNumber); break;
+        case PseudoInstructions::BLTZ: emit(Instructions::BLT, {reg(1), zero, targetArgument(line[2])}, lineNumber); break;
+        case PseudoInstructions::BGTZ: emit(Instructions::BLT, {zero, reg(1), targetArgument(line[2])}, lineNumber); break;
+        case PseudoInstructions::BGT: emit(Instructions::BLT, {reg(2), reg(1), targetArgument(line[3])}, lineNumber); break;
+        case PseudoInstructions::BLE: emit(Instructions::BGE, {reg(2), reg(1), targetArgument(line[3])}, lineNumber); break;
+        case PseudoInstructions::BGTU: emit(Instructions::BLTU, {reg(2), reg(1), targetArgument(line[3])}, lineNumber); break;
+        case PseudoInstructions::BLEU: emit(Instructions::BGEU, {reg(2), reg(1), targetArgument(line[3])}, lineNumber); break;
+        case PseudoInstructions::CSRR: emit(Instructions::CSRRS, {reg(1), csrArgument(line[2]), zero}, lineNumber); break;
+        case PseudoInstructions::CSRW: emit(Instructions::CSRRW, {zero, csrArgument(line[1]), reg(2)}, lineNumber); break;
+        case PseudoInstructions::FRCSR: emit(Instructions::CSRRS, {reg(1), imm(CSR_FCSR), zero}, lineNumber); break;
+        case PseudoInstructions::FSCSR: emit(Instructions::CSRRW, {zero, imm(CSR_FCSR), reg(1)}, lineNumber); break;
+        case PseudoInstructions::FRRM: emit(Instructions::CSRRS, {reg(1), imm(CSR_FRM), zero}, lineNumber); break;
+        case PseudoInstructions::FSRM: emit(Instructions::CSRRW, {zero, imm(CSR_FRM), reg(1)}, lineNumber); break;
+        case PseudoInstructions::FRFLAGS: emit(Instructions::CSRRS, {reg(1), imm(CSR_FFLAGS), zero}, lineNumber); break;
+        case PseudoInstructions::FSFLAGS: emit(Instructions::CSRRW, {zero, imm(CSR_FFLAGS), reg(1)}, lineNumber); break;
+        case PseudoInstructions::FMV_S: emit(Instructions::FSGNJ_S, {freg(1), freg(2), freg(2)}, lineNumber); break;
+        case PseudoInstructions::FABS_S: emit(Instructions::FSGNJX_S, {freg(1), freg(2), freg(2)}, lineNumber); break;
+        case PseudoInstructions::FNEG_S: emit(Instructions::FSGNJN_S, {freg(1), freg(2), freg(2)}, lineNumber); break;
+        case PseudoInstructions::INVALID: break;
     }
-    
-    reportError("Undefined label '" + label + "'");
-    return std::nullopt;
 }
 
 inline void Parser::reportError(const std::string &message, int lineNumber) const {
@@ -0,0 +1,297 @@
+#ifndef RELAX_HPP
+#define RELAX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "types.hpp"
+#include "symbols.hpp"
+#include "assembler.hpp"
+#include "compressed.hpp"
+
+using namespace riscv;
+
+// Picks the shortest form of every branch and call in a whole program. Calls
+// (the auipc+jalr pairs call and tail expand to) start as a single jal and
+// branches in their own form; any that cannot reach its target is grown to
+// auipc+jalr or to an inverted branch over a jal, and the layout is repeated
+// until nothing grows. Forms only ever grow, so this reaches a fixed point.
+//
+// Instructions written under `.option rvc` start out compressed where a
+// parcel can hold them: operands without labels are checked once, while
+// beqz/bnez, j/jal and call/tail start as c.beqz/c.bnez, c.j and c.jal and
+// grow to the full-size forms like any other.
+//
+// Text must be one contiguous run of instructions for labels to move with
+// them; otherwise the program keeps its parsed layout and only the ranges
+// are checked. Text labels past the end of the run move with its end, so a
+// run can be relaxed ahead of code that is already laid out after it.
+class Relaxer {
+public:
+    inline void relax(std::vector<ParsedInstruction> &instructions, SymbolTable &symbols);
+
+    inline size_t getIterations() const { return iterations; }
+    inline size_t getLongBranchCount() const { return longBranches; }
+    inline size_t getShortCallCount() const { return shortCalls; }
+    inline size_t getCompressedCount() const { return compressed; }
+    // Input positions of the branches and calls that grew past the form they
+    // started in, and the label each one targets.
+    inline const std::vector<size_t>& getGrown() const { return grown; }
+    inline SymbolId getTarget(size_t index) const { return targets[index]; }
+
+private:
+    enum class Form : uint8_t { FIXED, COMPRESSED, COMPRESSED_BRANCH, SHORT_BRANCH, LONG_BRANCH, COMPRESSED_JUMP, COMPRESSED_CALL, SHORT_CALL, LONG_CALL, CALL_SECOND };
+
+    std::vector<Form> forms;
+    std::vector<SymbolId> targets;
+    std::vector<size_t> candidates;
+    std::vector<Form> startingForms;
+    std::vector<size_t> grown;
+    std::vector<uint32_t> positions;
+    std::vector<uint32_t> labelIndex;
+    uint64_t programEnd = 0;
+    size_t iterations = 0;
+    size_t longBranches = 0;
+    size_t shortCalls = 0;
+    size_t compressed = 0;
+
+    static constexpr uint32_t NO_INDEX = UINT32_MAX;
+
+    static inline bool isCallPair(const std::vector<ParsedInstruction> &instructions, size_t index);
+    static inline Instructions invertBranch(Instructions instruction);
+    static inline uint32_t formSize(Form form);
+    static inline bool isCompressedForm(Form form);
+    static inline bool fitsCompressed(int32_t offset, int width) { return (offset & 1) == 0 && rvc::fitsSigned(offset, width); }
+
+    inline void classify(const std::vector<ParsedInstruction> &instructions, const SymbolTable &symbols);
+    inline uint32_t targetAddress(const SymbolTable &symbols, SymbolId id) const;
+    inline bool layout(const SymbolTable &symbols);
+    inline void rewrite(std::vector<ParsedInstruction> &instructions, SymbolTable &symbols) const;
+    inline void resolve(std::vector<ParsedInstruction> &instructions, const SymbolTable &symbols) const;
+};
+
+inline bool Relaxer::isCallPair(const std::vector<ParsedInstruction> &instructions, size_t index) {
+    if (index + 1 >= instructions.size()) return false;
+    const ParsedInstruction &auipc = instructions[index];
+    const ParsedInstruction &jalr = instructions[index + 1];
+    return auipc.instruction == Instructions::AUIPC && jalr.instruction == Instructions::JALR && auipc.lineNumber == jalr.lineNumber &&
+           auipc[1].kind == OperandKind::LABEL && auipc[1].modifier == OperandModifier::PCREL_HI &&
+           jalr[2].kind == OperandKind::LABEL && jalr[2].modifier == OperandModifier::PCREL_LO &&
+           jalr[1].reg == auipc[0].reg && jalr[2].symbol == auipc[1].symbol;
+}
+
+inline Instructions Relaxer::invertBranch(Instructions instruction) {
+    switch (instruction) {
+        case Instructions::BEQ: return Instructions::BNE;
+        case Instructions::BNE: return Instructions::BEQ;
+        case Instructions::BLT: return Instructions::BGE;
+        case Instructions::BGE: return Instructions::BLT;
+        case Instructions::BLTU: return Instructions::BGEU;
+        case Instructions::BGEU: return Instructions::BLTU;
+        default: return Instructions::INVALID;
+    }
+}
+
+inline uint32_t Relaxer::formSize(Form form) {
+    switch (form) {
+        case Form::LONG_BRANCH:
+        case Form::LONG_CALL: return 2 * INSTRUCTION_SIZE;
+        case Form::CALL_SECOND: return 0;
+        default: return isCompressedForm(form) ? COMPRESSED_INSTRUCTION_SIZE : INSTRUCTION_SIZE;
+    }
+}
+
+inline bool Relaxer::isCompressedForm(Form form) {
+    return form == Form::COMPRESSED || form == Form::COMPRESSED_BRANCH || form == Form::COMPRESSED_JUMP || form == Form::COMPRESSED_CALL;
+}
+
+inline void Relaxer::classify(const std::vector<ParsedInstruction> &instructions, const SymbolTable &symbols) {
+    forms.assign(instructions.size(), Form::FIXED);
+    targets.assign(instructions.size(), INVALID_SYMBOL);
+    candidates.clear();
+    const Assembler encoder;
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        const ParsedInstruction &inst = instructions[i];
+        const bool hasLabel = std::any_of(inst.operands.begin(), inst.operands.begin() + inst.size(),
+                                          [](const Operand &operand) { return operand.kind == OperandKind::LABEL; });
+        if (inst.compressed) {
+            forms[i] = Form::COMPRESSED;
+        } else if (isCallPair(instructions, i)) {
+            forms[i] = inst.compressible && instructions[i + 1][0].reg <= 1 ? Form::COMPRESSED_CALL : Form::SHORT_CALL;
+            forms[i + 1] = Form::CALL_SECOND;
+            targets[i] = symbols.find(inst[1].symbol);
+            candidates.push_back(i++);
+        } else if (describe(inst.instruction).isBranch() && inst.size() == 3 && inst[2].kind == OperandKind::LABEL &&
+                   invertBranch(inst.instruction) != Instructions::INVALID) {
+            const bool compressible = inst.compressible && (inst.instruction == Instructions::BEQ || inst.instruction == Instructions::BNE) &&
+                                      inst[1].reg == 0 && rvc::isPrime(inst[0].reg);
+            forms[i] = compressible ? Form::COMPRESSED_BRANCH : Form::SHORT_BRANCH;
+            targets[i] = symbols.find(inst[2].symbol);
+            candidates.push_back(i);
+        } else if (inst.compressible && inst.instruction == Instructions::JAL && inst[1].kind == OperandKind::LABEL &&
+                   inst[1].modifier == OperandModifier::NONE && inst[0].reg <= 1) {
+            forms[i] = Form::COMPRESSED_JUMP;
+            targets[i] = symbols.find(inst[1].symbol);
+            candidates.push_back(i);
+        } else if (inst.compressible && !hasLabel && compressInstruction(encoder.encode(inst)) != 0) {
+            forms[i] = Form::COMPRESSED;
+        }
+    }
+
+    labelIndex.assign(symbols.size(), NO_INDEX);
+    const uint32_t base = instructions.front().address;
+    programEnd = static_cast<uint64_t>(instructions.back().address) + (instructions.back().compressed ? COMPRESSED_INSTRUCTION_SIZE : INSTRUCTION_SIZE);
+    for (SymbolId id = 0; id < symbols.size(); ++id) {
+        const Symbol &symbol = symbols[id];
+        if (symbol.kind != SymbolKind::TEXT || symbol.address < base || symbol.address > programEnd) continue;
+        auto at = std::lower_bound(instructions.begin(), instructions.end(), symbol.address,
+                                   [](const ParsedInstruction &inst, uint32_t address) { return inst.address < address; });
+        labelIndex[id] = static_cast<uint32_t>(at - instructions.begin());
+    }
+}
+
+inline uint32_t Relaxer::targetAddress(const SymbolTable &symbols, SymbolId id) const {
+    if (labelIndex[id] != NO_INDEX) return positions[labelIndex[id]];
+    const Symbol &symbol = symbols[id];
+    return symbol.kind == SymbolKind::TEXT && symbol.address > programEnd ? positions.back() + static_cast<uint32_t>(symbol.address - programEnd) : symbol.address;
+}
+
+inline bool Relaxer::layout(const SymbolTable &symbols) {
+    const InstructionDescriptor &jal = describe(Instructions::JAL);
+    bool grew = false;
+    for (size_t i = 0; i < forms.size(); ++i) {
+        positions[i + 1] = positions[i] + formSize(forms[i]);
+    }
+    for (size_t i : candidates) {
+        const int32_t offset = static_cast<int32_t>(targetAddress(symbols, targets[i]) - positions[i]);
+        Form grown = forms[i];
+        switch (forms[i]) {
+            case Form::COMPRESSED_BRANCH: if (!fitsCompressed(offset, 9)) grown = Form::SHORT_BRANCH; break;
+            case Form::SHORT_BRANCH: if (!fitsOffset(describe(Instructions::BEQ), offset)) grown = Form::LONG_BRANCH; break;
+            case Form::COMPRESSED_JUMP: if (!fitsCompressed(offset, 12)) grown = Form::FIXED; break;
+            case Form::COMPRESSED_CALL: if (!fitsCompressed(offset, 12)) grown = Form::SHORT_CALL; break;
+            case Form::SHORT_CALL: if (!fitsOffset(jal, offset)) grown = Form::LONG_CALL; break;
+            default: break;
+        }
+        grew = grew || grown != forms[i];
+        forms[i] = grown;
+    }
+    return grew;
+}
+
+inline void Relaxer::rewrite(std::vector<ParsedInstruction> &instructions, SymbolTable &symbols) const {
+    std::vector<ParsedInstruction> relaxed;
+    relaxed.reserve(instructions.size() + longBranches);
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        const ParsedInstruction &inst = instructions[i];
+        switch (forms[i]) {
+            case Form::SHORT_BRANCH:
+            case Form::FIXED:
+            case Form::CALL_SECOND:
+            case Form::COMPRESSED:
+            case Form::COMPRESSED_BRANCH:
+            case Form::COMPRESSED_JUMP:
+                relaxed.push_back(inst);
+                relaxed.back().address = positions[i];
+                relaxed.back().compressed = isCompressedForm(forms[i]);
+                break;
+            case Form::LONG_CALL:
+                relaxed.push_back(inst);
+                relaxed.back().address = positions[i];
+                relaxed.push_back(instructions[i + 1]);
+                relaxed.back().address = positions[i] + INSTRUCTION_SIZE;
+                ++i;
+                break;
+            case Form::SHORT_CALL:
+            case Form::COMPRESSED_CALL: {
+                ParsedInstruction jal(Instructions::JAL, positions[i], inst.lineNumber);
+                jal.operands[0] = Operand::makeRegister(instructions[i + 1][0].reg);
+                jal.operands[1] = Operand::makeLabel(inst[1].symbol);
+                jal.operandCount = 2;
+                jal.compressed = forms[i] == Form::COMPRESSED_CALL;
+                relaxed.push_back(jal);
+                ++i;
+                break;
+            }
+            case Form::LONG_BRANCH: {
+                ParsedInstruction skip = inst;
+                skip.instruction = invertBranch(inst.instruction);
+                skip.address = positions[i];
+                skip.operands[2] = Operand::makeImmediate(2 * INSTRUCTION_SIZE);
+                relaxed.push_back(skip);
+
+                ParsedInstruction jump(Instructions::JAL, positions[i] + INSTRUCTION_SIZE, inst.lineNumber);
+                jump.operands[0] = Operand::makeRegister(0);
+                jump.operands[1] = Operand::makeLabel(inst[2].symbol);
+                jump.operandCount = 2;
+                relaxed.push_back(jump);
+                break;
+            }
+        }
+    }
+    instructions.swap(relaxed);
+
+    for (SymbolId id = 0; id < symbols.size(); ++id) {
+        symbols[id].address = targetAddress(symbols, id);
+    }
+}
+
+inline void Relaxer::resolve(std::vector<ParsedInstruction> &instructions, const SymbolTable &symbols) const {
+    for (ParsedInstruction &inst : instructions) {
+        const InstructionDescriptor &descriptor = describe(inst.instruction);
+        for (size_t i = 0; i < inst.size(); ++i) {
+            Operand &operand = inst.operands[i];
+            if (operand.kind != OperandKind::LABEL) continue;
+            const SymbolId id = symbols.find(operand.symbol);
+            operand.value = labelOperandValue(descriptor, operand.modifier, symbols[id].address, inst.address);
+            operand.resolved = true;
+            if (isRelativeLabel(descriptor, operand.modifier) && !fitsOffset(descriptor, operand.value)) {
+                throw std::runtime_error(std::string(RED) + "Relaxation Error on Line " + std::to_string(inst.lineNumber) + ": " +
+                                         (descriptor.isBranch() ? "Branch" : "Jump") + " target out of range or misaligned: " + std::string(operand.symbol) + RESET);
+            }
+        }
+    }
+}
+
+inline void Relaxer::relax(std::vector<ParsedInstruction> &instructions, SymbolTable &symbols) {
+    iterations = 0;
+    grown.clear();
+    longBranches = 0;
+    shortCalls = 0;
+    compressed = 0;
+    if (instructions.empty()) return;
+
+    bool contiguous = true;
+    for (size_t i = 1; i < instructions.size() && contiguous; ++i) {
+        const ParsedInstruction &previous = instructions[i - 1];
+        contiguous = instructions[i].address == previous.address + (previous.compressed ? COMPRESSED_INSTRUCTION_SIZE : INSTRUCTION_SIZE);
+    }
+    if (contiguous) {
+        classify(instructions, symbols);
+        startingForms.clear();
+        for (size_t i : candidates) startingForms.push_back(forms[i]);
+        positions.assign(instructions.size() + 1, instructions.front().address);
+        do {
+            ++iterations;
+        } while (layout(symbols));
+
+        for (size_t k = 0; k < candidates.size(); ++k) {
+            if (forms[candidates[k]] != startingForms[k]) grown.push_back(candidates[k]);
+        }
+        for (size_t i : candidates) {
+            if (forms[i] == Form::LONG_BRANCH) ++longBranches;
+            if (forms[i] == Form::SHORT_CALL || forms[i] == Form::COMPRESSED_CALL) ++shortCalls;
+        }
+        for (size_t i = 0; i < forms.size(); ++i) {
+            if (isCompressedForm(forms[i]) && !instructions[i].compressed) ++compressed;
+        }
+        if (longBranches > 0 || shortCalls > 0 || compressed > 0) {
+            rewrite(instructions, symbols);
+        }
+    }
+    resolve(instructions, symbols);
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include <iomanip>
 #include <signal.h>
 #include "types.hpp"
+#include "source.hpp"
 #include "simulator.hpp"
 
 using namespace riscv;
@@ -24,6 +25,22 @@ void printDetails(bool reg, bool normalIR , bool follow) {
         for (int i = 0; i < NUM_REGISTERS; i++) {
             std::cout << ORANGE << "x" << i << ": " << std::hex << registers[i] << RESET << std::endl;
         }
+        for (int i = 0; i < NUM_FLOAT_REGISTERS; i++) {
+            std::cout << ORANGE << "f" << i << ": " << std::hex << registers[FLOAT_REGISTER_BASE + i] << RESET << std::endl;
+        }
+        std::cout << ORANGE << "fcsr: " << std::hex << globalSimulatorPtr->getFcsr() << RESET << std::endl;
+        if (globalSimulatorPtr->getStats().vectorInstructions > 0) {
+            const vector::State& vectorState = globalSimulatorPtr->getVectorState();
+            std::cout << ORANGE << "vl: " << std::dec << vectorState.vl << RESET << std::endl;
+            std::cout << ORANGE << "vtype: " << std::hex << vectorState.vtype << RESET << std::endl;
+            for (uint32_t i = 0; i < 32; i++) {
+                std::cout << ORANGE << "v" << std::dec << i << ": " << std::hex << std::setfill('0');
+                for (uint32_t byte = vectorState.vlenb(); byte-- > 0;) {
+                    std::cout << std::setw(2) << static_cast<uint32_t>(vectorState.reg(i)[byte]);
+                }
+                std::cout << std::setfill(' ') << RESET << std::endl;
+            }
+        }
     }
 
     if(normalIR) {
@@ -40,7 +57,8 @@ void printDetails(bool reg, bool normalIR , bool follow) {
     if(follow) {
         followedRegisters = globalSimulatorPtr->getFollowedInstructionRegisters();
         uint32_t followedPC = globalSimulatorPtr->getFollowedPC();
-        std::string instrStr = globalSimulatorPtr->getTextMap()[followedPC].second;
+        auto followed = globalSimulatorPtr->getTextMap().find(followedPC);
+        std::string instrStr = followed != globalSimulatorPtr->getTextMap().end() ? followed->second.disassembly : "";
         
         std::cout << GREEN << "Summary for followed instruction at PC=0x" << std::hex << followedPC << std::dec << " (" << instrStr << ")" << RESET << std::endl;
         std::cout << GREEN << "Last update in cycle: " << globalSimulatorPtr->getCycles() << RESET << std::endl;
@@ -70,19 +88,16 @@ void printUsage() {
     std::cout << YELLOW << "  -b, --branch-predict       Enable branch prediction" << RESET << std::endl;
     std::cout << YELLOW << "  -a, --auto                 Run simulation automatically (non-interactive)" << RESET << std::endl;
     std::cout << YELLOW << "  -f, --follow [n|p]=NUM     Track specific instruction by number (n=NUM) or PC (p=NUM), supports decimal or hex (0x prefix)" << RESET << std::endl;
-    std::cout << YELLOW << "  -i, --input FILE           Specify input assembly file (default: input.asm)" << RESET << std::endl;
+    std::cout << YELLOW << "  -i, --input FILE           Specify input assembly, .mc listing, .rvi image or RV32 ELF executable (default: input.asm)" << RESET << std::endl;
+    std::cout << YELLOW << "  -c, --cache-dir DIR        Keep assembled programs in DIR and reuse them on later runs" << RESET << std::endl;
+    std::cout << YELLOW << "  -L, --latency U=N,...      Cycles in EXECUTE per unit: imul, idiv (M) and add, mul, fma, div, sqrt, cvt, misc (F)" << RESET << std::endl;
+    std::cout << YELLOW << "  -V, --vlen BITS            Vector register length (power of two, 32 to 65536; default 128)" << RESET << std::endl;
+    std::cout << YELLOW << "  -C, --chaining             Let vector instructions chain on partial results" << RESET << std::endl;
     std::cout << YELLOW << "  -h, --help                 Display this help message" << RESET << std::endl;
 }
 
-std::string readFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Could not open file: " + filename);
-    }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
-    return buffer.str();
+std::shared_ptr<const riscv::SourceBuffer> readFile(const std::string& filename) {
+    return riscv::SourceBuffer::fromFile(filename);
 }
 
 bool fileExists(const std::string& filename) {
@@ -105,6 +120,7 @@ int main(int argc, char* argv[]) {
     bool autoRun = false;
     std::string inputFile = "input.asm";
     std::string followArg;
+    vector::Config vectorConfig;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--pipeline") == 0) {
@@ -176,6 +192,58 @@ int main(int argc, char* argv[]) {
                     return 1;
                 }
             }
+        } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--cache-dir") == 0) {
+            if (i + 1 < argc) {
+                sim.setCacheDirectory(argv[++i]);
+            } else {
+                std::cerr << "Error: Missing cache directory" << std::endl;
+                printUsage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-L") == 0 || strcmp(argv[i], "--latency") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: Missing execution latencies" << std::endl;
+                printUsage();
+                return 1;
+            }
+            ExecuteLatencies latencies;
+            std::string list = argv[++i];
+            size_t start = 0;
+            while (start <= list.size()) {
+                size_t end = list.find(',', start);
+                if (end == std::string::npos) end = list.size();
+                const std::string entry = list.substr(start, end - start);
+                const size_t equalPos = entry.find('=');
+                uint32_t cycles = 0;
+                try {
+                    cycles = equalPos == std::string::npos ? 0 : std::stoul(entry.substr(equalPos + 1));
+                } catch (const std::exception&) {
+                    cycles = 0;
+                }
+                if (cycles == 0 || !latencies.set(entry.substr(0, equalPos), cycles)) {
+                    std::cerr << "Error: Invalid execution latency '" << entry << "'. Use UNIT=CYCLES with a unit of imul, idiv, add, mul, fma, div, sqrt, cvt or misc" << std::endl;
+                    printUsage();
+                    return 1;
+                }
+                start = end + 1;
+            }
+            sim.setExecuteLatencies(latencies);
+        } else if (strcmp(argv[i], "-V") == 0 || strcmp(argv[i], "--vlen") == 0) {
+            uint32_t vlen = 0;
+            try {
+                vlen = i + 1 < argc ? std::stoul(argv[++i]) : 0;
+            } catch (const std::exception&) {
+                vlen = 0;
+            }
+            if (!vector::isValidVlen(vlen)) {
+                std::cerr << "Error: Invalid VLEN. Use a power of two from 32 to 65536" << std::endl;
+                printUsage();
+                return 1;
+            }
+            vectorConfig.vlen = vlen;
+        } else if (strcmp(argv[i], "-C") == 0 || strcmp(argv[i], "--chaining") == 0) {
+            vectorConfig.chaining = true;
+            std::cout << "Vector chaining: ENABLED" << std::endl;
         } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
             printUsage();
             return 0;
@@ -186,9 +254,10 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    sim.setVectorConfig(vectorConfig);
+
     try {
-        std::string program = readFile(inputFile);
-        if (!sim.loadProgram(program)) {
+        if (!sim.loadProgram(readFile(inputFile))) {
             std::cerr << "Failed to load program!\n";
             return 1;
         }
@@ -197,11 +266,13 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    size_t length = sim.getTextMap().size();
-    if(length == 0) {
+    const TextMap& textMap = sim.getTextMap();
+    if(textMap.empty()) {
         std::cerr << "Error: No text segment found in the program." << std::endl;
         return 1;
     } else {
+        uint32_t length = 0;
+        for (const auto& [address, entry] : textMap) length += entry.length;
         std::cout << "Text segment size: " << length << " bytes" << std::endl;
     }
     
@@ -209,16 +280,16 @@ int main(int argc, char* argv[]) {
         bool isValid = true;
         std::string errorMsg;
         if (followArg.find("p=") != std::string::npos) {
-            if (followInstrNum >= static_cast<uint32_t>(length) || (followInstrNum % 4) != 0) {
+            if (textMap.count(followInstrNum) == 0) {
                 isValid = false;
-                errorMsg = "PC is outside text segment or not 4-byte aligned";
+                errorMsg = "PC is outside text segment or not at an instruction";
             }
         } else {
-            if (followInstrNum == 0 || followInstrNum > static_cast<uint32_t>(length / 4)) {
+            if (followInstrNum == 0 || followInstrNum > textMap.size()) {
                 isValid = false;
                 errorMsg = "Instruction number is out of range";
             } else {
-                followInstrNum = (followInstrNum - 1) * 4;
+                followInstrNum = std::next(textMap.begin(), followInstrNum - 1)->first;
             }
         }
 
@@ -283,6 +354,17 @@ int main(int argc, char* argv[]) {
         statsFile << "Control Hazard Stalls: " << stats.controlHazardStalls << "\n";
         statsFile << "Pipeline Flushes: " << stats.pipelineFlushes << "\n";
         statsFile << "Branch Mispredictions: " << stats.branchMispredictions << "\n";
+        statsFile << "Compressed Instructions Fetched: " << stats.compressedInstructions << "\n";
+        statsFile << "Fetch Block Reads: " << stats.fetchBlockReads << "\n";
+        statsFile << "Straddling Fetches: " << stats.straddlingFetches << "\n";
+        statsFile << "Floating-Point Instructions: " << stats.floatInstructions << "\n";
+        statsFile << "Structural Hazard Stalls: " << stats.structuralHazardStalls << "\n";
+        statsFile << "Vector Instructions: " << stats.vectorInstructions << "\n";
+        statsFile << "Vector Beats: " << stats.vectorBeats << "\n";
+        statsFile << "Vector Issue Stalls: " << stats.vectorStalls << "\n";
+        statsFile << "Bit-Manipulation Instructions: " << stats.bitManipulationInstructions << "\n";
+        statsFile << "Custom Instructions: " << stats.customInstructions << "\n";
+        statsFile << "Custom Unit Stalls: " << stats.customStalls << "\n";
 
         statsFile.close();
         std::cout << "Simulation stats written to stats.txt" << std::endl;
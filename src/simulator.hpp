@@ -10,20 +10,30 @@
 #include <cstring>
 #include <iomanip>
 #include "types.hpp"
+#include "source.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "assembler.hpp"
+#include "image.hpp"
+#include "elf.hpp"
 #include "execution.hpp"
+#include "cache.hpp"
 
 using namespace riscv;
 
 class Simulator {
 private:
     uint32_t PC;
-    uint32_t registers[NUM_REGISTERS];
+    uint32_t registers[REGISTER_FILE_SIZE];
+    uint32_t fcsr;
+    ExecuteLatencies executeLatencies;
+    vector::Config vectorConfig;
+    vector::State vectorState;
+    vector::Pipeline vectorPipeline;
+    custom::Units customUnits;
 
-    std::unordered_map<uint32_t, uint8_t> dataMap;
-    std::map<uint32_t, std::pair<uint32_t, std::string>> textMap;
+    GuestMemory memory;
+    std::shared_ptr<const LoadedProgram> program;
 
     std::map<Stage, InstructionNode*> pipeline;
     InstructionRegisters instructionRegisters;
@@ -40,6 +50,7 @@ private:
     SimulationStats stats;
     std::unordered_map<uint32_t, RegisterDependency> registerDependencies;
     BranchPredictor branchPredictor;
+    FetchBuffer fetchBuffer;
 
     uint32_t instructionCount;
     uint32_t nextInstructionId;
@@ -52,16 +63,31 @@ private:
     bool checkLoadUseHazard(const InstructionNode& node, const std::unordered_map<uint32_t, RegisterDependency>& depsSnapshot, bool isStore = false);
     bool isPipelineEmpty() const;
     void reset();
+    std::shared_ptr<const LoadedProgram> buildProgram(std::shared_ptr<const SourceBuffer> source);
+
+    bool hasInstruction(uint32_t address) const { return program->textMap.count(address) != 0; }
+    const std::string& disassemblyAt(uint32_t address) const {
+        static const std::string unknown;
+        auto it = program->textMap.find(address);
+        return it != program->textMap.end() ? it->second.disassembly : unknown;
+    }
     
     public:
     Simulator();
     bool loadProgram(const std::string &input);
+    bool loadProgram(std::shared_ptr<const SourceBuffer> source);
+    void setCacheDirectory(const std::string &path) { ProgramCache::shared().setDirectory(path); }
     bool step();
     void run();
     void setEnvironment(bool pipeline, bool dataForwarding, bool branchPrediction, uint32_t instruction);
+    void setExecuteLatencies(const ExecuteLatencies &latencies) { executeLatencies = latencies; }
+    void setVectorConfig(const vector::Config &config) { vectorConfig = config; vectorState.reset(config.vlen); }
+    const vector::State& getVectorState() const { return vectorState; }
     const uint32_t *getRegisters() const;
+    uint32_t getFcsr() const { return fcsr; }
     uint32_t getFollowedPC() const;
-    std::map<uint32_t, std::pair<uint32_t, std::string>> getTextMap() const;
+    const TextMap& getTextMap() const;
+    const std::vector<ImageSymbol>& getSymbols() const { return program->symbols; }
     uint32_t getCycles() const;
     SimulationStats getStats();
     InstructionRegisters getInstructionRegisters() const;
@@ -69,6 +95,8 @@ private:
 };
 
 Simulator::Simulator() : PC(TEXT_SEGMENT_START),
+                         fcsr(0),
+                         program(LoadedProgram::empty()),
                          instructionRegisters(InstructionRegisters()),
                          forwardingStatus(ForwardingStatus()),
                          running(false),
@@ -90,6 +118,10 @@ Simulator::Simulator() : PC(TEXT_SEGMENT_START),
 }
 
 bool Simulator::loadProgram(const std::string &input) {
+    return loadProgram(SourceBuffer::fromString(input));
+}
+
+bool Simulator::loadProgram(std::shared_ptr<const SourceBuffer> source) {
     try {
         bool wasPipeline = isPipeline;
         bool wasDataForwarding = isDataForwarding;
@@ -104,36 +136,19 @@ bool Simulator::loadProgram(const std::string &input) {
         isFollowing = wasFollowing;
         running = true;
 
-        std::vector<std::vector<Token>> tokenizedLines = Lexer::tokenize(input);
-        if (tokenizedLines.empty()) {
-            std::cerr << RED << "Error: No tokens generated from input" << RESET << std::endl;
-            return false;
-        }
-
-        Parser parser(tokenizedLines);
-        if (!parser.parse()) {
-            throw std::runtime_error("Parsing failed with " + std::to_string(parser.getErrorCount()) + " errors");
-            return false;
-        }
-
-        std::unordered_map<std::string, SymbolEntry> symbolTable = parser.getSymbolTable();
-        std::vector<ParsedInstruction> parsedInstructions = parser.getParsedInstructions();
-
-        Assembler assembler(symbolTable, parsedInstructions);
-        if (!assembler.assemble()) {
-            throw std::runtime_error("Assembly failed with " + std::to_string(assembler.getErrorCount()) + " errors");
-            return false;
-        }
-
-        for (const auto &[address, value] : assembler.getMachineCode()) {
-            if (address >= DATA_SEGMENT_START) {
-                dataMap[address] = static_cast<uint8_t>(value);
-            } else {
-                textMap[address] = std::make_pair(value, parseInstructions(value));
+        const ProgramKey key = ProgramKey::of(source->view());
+        std::shared_ptr<const LoadedProgram> loaded = ProgramCache::shared().find(key);
+        if (loaded == nullptr) {
+            loaded = buildProgram(std::move(source));
+            if (loaded == nullptr) {
+                return false;
             }
+            ProgramCache::shared().insert(key, loaded);
         }
+        program = std::move(loaded);
+        memory.load(program->image);
         
-        PC = TEXT_SEGMENT_START;
+        PC = program->image.entry;
         instructionCount = 0;
         nextInstructionId = 0;
         std::cout << GREEN << "Program loaded successfully" << RESET << std::endl;
@@ -148,6 +163,35 @@ bool Simulator::loadProgram(const std::string &input) {
     }
 }
 
+std::shared_ptr<const LoadedProgram> Simulator::buildProgram(std::shared_ptr<const SourceBuffer> source) {
+    if (isElfImage(source->view())) {
+        return LoadedProgram::predecode(loadElf(source->view()));
+    }
+    if (isBinaryImage(source->view())) {
+        return LoadedProgram::predecode(loadProgramImage(source->view()));
+    }
+    if (isListing(source->view())) {
+        return LoadedProgram::predecode(loadListing(source->view()).memory);
+    }
+
+    TokenArena tokenizedLines = Lexer::tokenizeArena(std::move(source));
+    if (tokenizedLines.empty()) {
+        std::cerr << RED << "Error: No tokens generated from input" << RESET << std::endl;
+        return nullptr;
+    }
+
+    Parser parser(tokenizedLines);
+    if (!parser.parse()) {
+        throw std::runtime_error("Parsing failed with " + std::to_string(parser.getErrorCount()) + " errors");
+    }
+
+    Assembler assembler(parser.getSymbolTable(), parser.getParsedInstructions());
+    if (!assembler.assemble()) {
+        throw std::runtime_error("Assembly failed with " + std::to_string(assembler.getErrorCount()) + " errors");
+    }
+    return LoadedProgram::predecode(assembler.takeImage());
+}
+
 void Simulator::reset() {
     for (auto& [stage, node] : pipeline) {
         if (node != nullptr) {
@@ -158,13 +202,18 @@ void Simulator::reset() {
     
     instructionRegisters = InstructionRegisters();
     initialiseRegisters(registers);
+    fcsr = 0;
+    vectorState.reset(vectorConfig.vlen);
+    vectorPipeline.reset();
+    customUnits.reset();
     registerDependencies.clear();
-    dataMap.clear();
-    textMap.clear();
+    memory.clear();
+    program = LoadedProgram::empty();
     
     PC = TEXT_SEGMENT_START;
     running = false;
     stats = SimulationStats();
+    fetchBuffer = FetchBuffer();
     forwardingStatus = ForwardingStatus();
     branchPredictor.reset();
     instructionCount = 0;
@@ -174,6 +223,11 @@ void Simulator::applyDataForwarding(InstructionNode& node, const std::unordered_
     if (!isPipeline || !isDataForwarding) return;
 
     forwardingStatus = ForwardingStatus();
+    // Stores and branches carry rs2 in RM; an R4 instruction uses RM for rs3.
+    auto forwardedRs2 = [this](const InstructionNode& target) {
+        const bool inRm = target.instructionType == InstructionType::S || target.instructionType == InstructionType::SB;
+        return inRm ? forwardingStatus.rmForwarded : forwardingStatus.rbForwarded;
+    };
 
     if (node.stage == Stage::MEMORY) {
         for (const auto& [uniqueId, dep] : depsSnapshot) {
@@ -182,22 +236,29 @@ void Simulator::applyDataForwarding(InstructionNode& node, const std::unordered_
                     instructionRegisters.RA = dep.value;
                     forwardingStatus.raForwarded = true;
                     std::cout << YELLOW << "\nData Forwarding: MEM->MEM for rs1 (reg " << node.rs1
-                              << ") of instruction at PC=" << node.PC << " (" << textMap[node.PC].second << ")"
-                              << (dep.isLoad ? " [Load]" : "") << " from instruction (" << textMap[dep.pc].second << ")" << RESET << std::endl;
+                              << ") of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ")"
+                              << (dep.isLoad ? " [Load]" : "") << " from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
                 }
-                if (node.rs2 != 0 && node.rs2 == dep.reg && !forwardingStatus.rbForwarded && !forwardingStatus.rmForwarded) {
+                if (readsRs3(node) && node.rs3 == dep.reg && !forwardingStatus.rmForwarded) {
+                    instructionRegisters.RM = dep.value;
+                    forwardingStatus.rmForwarded = true;
+                    std::cout << YELLOW << "\nData Forwarding: MEM->MEM for rs3 (reg " << node.rs3
+                              << ") to RM of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ")"
+                              << (dep.isLoad ? " [Load]" : "") << " from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
+                }
+                if (node.rs2 != 0 && node.rs2 == dep.reg && !forwardedRs2(node)) {
                     if (node.instructionType == InstructionType::S || node.instructionType == InstructionType::SB) {
                         instructionRegisters.RM = dep.value;
                         forwardingStatus.rmForwarded = true;
                         std::cout << YELLOW << "\nData Forwarding: MEM->MEM for rs2 (reg " << node.rs2
-                                  << ") to RM of instruction at PC=" << node.PC << " (" << textMap[node.PC].second << ")"
-                                  << (dep.isLoad ? " [Load]" : "") << " from instruction (" << textMap[dep.pc].second << ")" << RESET << std::endl;
+                                  << ") to RM of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ")"
+                                  << (dep.isLoad ? " [Load]" : "") << " from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
                     } else {
                         instructionRegisters.RB = dep.value;
                         forwardingStatus.rbForwarded = true;
                         std::cout << YELLOW << "\nData Forwarding: MEM->MEM for rs2 (reg " << node.rs2
-                                  << ") of instruction at PC=" << node.PC << " (" << textMap[node.PC].second << ")"
-                                  << (dep.isLoad ? " [Load]" : "") << " from instruction (" << textMap[dep.pc].second << ")" << RESET << std::endl;
+                                  << ") of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ")"
+                                  << (dep.isLoad ? " [Load]" : "") << " from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
                     }
                 }
             }
@@ -212,23 +273,29 @@ void Simulator::applyDataForwarding(InstructionNode& node, const std::unordered_
                     instructionRegisters.RA = dep.value;
                     forwardingStatus.raForwarded = true;
 
-                    std::cout << YELLOW << "\nData Forwarding: EX->EX for rs1 (reg " << node.rs1 << ") of instruction at PC=" << node.PC << " (" << textMap[node.PC].second << ") from instruction (" << textMap[dep.pc].second << ")" << RESET << std::endl;
+                    std::cout << YELLOW << "\nData Forwarding: EX->EX for rs1 (reg " << node.rs1 << ") of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ") from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
+                }
+                if (readsRs3(node) && node.rs3 == dep.reg) {
+                    instructionRegisters.RM = dep.value;
+                    forwardingStatus.rmForwarded = true;
+
+                    std::cout << YELLOW << "\nData Forwarding: EX->EX for rs3 (reg " << node.rs3 << ") to RM of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ") from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
                 }
-                if ((node.instructionType == InstructionType::R || node.instructionType == InstructionType::S || node.instructionType == InstructionType::SB) && node.rs2 != 0 && node.rs2 == dep.reg) {
+                if (readsRs2(node) && node.rs2 != 0 && node.rs2 == dep.reg) {
                     if (node.instructionType == InstructionType::S || node.instructionType == InstructionType::SB) {
                         instructionRegisters.RM = dep.value;
                         forwardingStatus.rmForwarded = true;
 
                         std::cout << YELLOW << "Data Forwarding: EX->EX for rs2 (reg " << node.rs2
-                        << ") to RM of instruction at PC=" << node.PC << " (" << textMap[node.PC].second
-                        << ") from instruction (" << textMap[dep.pc].second << ")" << RESET << std::endl;
+                        << ") to RM of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC)
+                        << ") from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
                     } else {
                         instructionRegisters.RB = dep.value;
                         forwardingStatus.rbForwarded = true;
 
                         std::cout << YELLOW << "\nData Forwarding: EX->EX for rs2 (reg " << node.rs2
-                        << ") of instruction at PC=" << node.PC << " (" << textMap[node.PC].second
-                        << ") from instruction (" << textMap[dep.pc].second << ")" << RESET << std::endl;
+                        << ") of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC)
+                        << ") from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
                     }
                 }
             }
@@ -242,27 +309,34 @@ void Simulator::applyDataForwarding(InstructionNode& node, const std::unordered_
                 forwardingStatus.raForwarded = true;
 
                 std::cout << YELLOW << "\nData Forwarding: MEM->EX for rs1 (reg " << node.rs1
-                << ") of instruction at PC=" << node.PC << " (" << textMap[node.PC].second << ")"
-                << (dep.isLoad ? " [Load]" : "") << " from instruction (" << textMap[dep.pc].second << ")" << RESET << std::endl;
+                << ") of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ")"
+                << (dep.isLoad ? " [Load]" : "") << " from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
+            }
+
+            if (readsRs3(node) && node.rs3 == dep.reg && !forwardingStatus.rmForwarded) {
+                instructionRegisters.RM = dep.value;
+                forwardingStatus.rmForwarded = true;
+
+                std::cout << YELLOW << "\nData Forwarding: MEM->EX for rs3 (reg " << node.rs3
+                << ") to RM of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ")"
+                << (dep.isLoad ? " [Load]" : "") << " from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
             }
 
-            if ((node.instructionType == InstructionType::R || node.instructionType == InstructionType::S ||
-                 node.instructionType == InstructionType::SB) && node.rs2 != 0 && node.rs2 == dep.reg &&
-                !forwardingStatus.rbForwarded && !forwardingStatus.rmForwarded) {
+            if (readsRs2(node) && node.rs2 != 0 && node.rs2 == dep.reg && !forwardedRs2(node)) {
                 if (node.instructionType == InstructionType::S || node.instructionType == InstructionType::SB) {
                     instructionRegisters.RM = dep.value;
                     forwardingStatus.rmForwarded = true;
 
                     std::cout << YELLOW << "\nData Forwarding: MEM->EX for rs2 (reg " << node.rs2
-                    << ") to RM of instruction at PC=" << node.PC << " (" << textMap[node.PC].second << ")"
-                    << (dep.isLoad ? " [Load]" : "") << " from instruction (" << textMap[dep.pc].second << ")" << RESET << std::endl;
+                    << ") to RM of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ")"
+                    << (dep.isLoad ? " [Load]" : "") << " from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
                 } else {
                     instructionRegisters.RB = dep.value;
                     forwardingStatus.rbForwarded = true;
 
                     std::cout << YELLOW << "\nData Forwarding: MEM->EX for rs2 (reg " << node.rs2
-                    << ") of instruction at PC=" << node.PC << " (" << textMap[node.PC].second << ")"
-                    << (dep.isLoad ? " [Load]" : "") << " from instruction (" << textMap[dep.pc].second << ")" << RESET << std::endl;
+                    << ") of instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ")"
+                    << (dep.isLoad ? " [Load]" : "") << " from instruction (" << disassemblyAt(dep.pc) << ")" << RESET << std::endl;
                 }
             }
         }
@@ -280,7 +354,7 @@ bool Simulator::checkDependencies(const InstructionNode& node, const std::unorde
             if (node.rs1 != 0 && node.rs1 == dep.reg) {
                 std::cout << YELLOW << "Data Hazard: Instruction at PC=" + std::to_string(node.PC) + " (" + parseInstructions(node.instruction) + ") depends on reg " + std::to_string(dep.reg) + " in " + stageToString(dep.stage) << RESET << std::endl;
                 return true;
-            } else if ((node.instructionType == InstructionType::R || node.instructionType == InstructionType::S || node.instructionType == InstructionType::SB) && node.rs2 != 0 && node.rs2 == dep.reg) {
+            } else if ((readsRs2(node) && node.rs2 != 0 && node.rs2 == dep.reg) || (readsRs3(node) && node.rs3 == dep.reg)) {
                 std::cout << YELLOW << "Data Hazard: Instruction at PC=" + std::to_string(node.PC) + " (" + parseInstructions(node.instruction) + ") depends on reg " + std::to_string(dep.reg) + " in " + stageToString(dep.stage) << RESET << std::endl;
                 return true;
             }
@@ -296,12 +370,12 @@ bool Simulator::checkLoadUseHazard(const InstructionNode& node, const std::unord
 
     uint32_t rs1 = node.rs1;
     uint32_t rs2 = node.rs2;
-    bool hasRS2 = (node.instructionType == InstructionType::R || node.instructionType == InstructionType::S || node.instructionType == InstructionType::SB);
+    bool hasRS2 = readsRs2(node);
 
     for (const auto& [uniqueId, dep] : depsSnapshot) {
         if (uniqueId != node.uniqueId && dep.stage == Stage::EXECUTE && dep.isLoad && !isStore) {
-            if ((rs1 != 0 && rs1 == dep.reg) || (hasRS2 && rs2 != 0 && rs2 == dep.reg)) {
-                std::cout << GREEN << "Load-Use Hazard: Instruction at PC=" << node.PC << " (" << textMap[node.PC].second << ") depends on load at PC=" << dep.pc << " (rd=" << dep.reg << ")" << RESET << std::endl;
+            if ((rs1 != 0 && rs1 == dep.reg) || (hasRS2 && rs2 != 0 && rs2 == dep.reg) || (readsRs3(node) && node.rs3 == dep.reg)) {
+                std::cout << GREEN << "Load-Use Hazard: Instruction at PC=" << node.PC << " (" << disassemblyAt(node.PC) << ") depends on load at PC=" << dep.pc << " (rd=" << dep.reg << ")" << RESET << std::endl;
                 stats.stallBubbles++;
                 stats.dataHazardStalls++;
                 return true;
@@ -400,7 +474,7 @@ void Simulator::advancePipeline() {
         }
 
         if (isFollowing && node->PC == followedInstruction) {
-            std::cout << GREEN << "Cycle " << stats.totalCycles << ": Followed instruction at PC=0x" << std::hex << node->PC << std::dec << " (" << textMap[node->PC].second << ") completes " << stageToString(node->stage) << RESET << std::endl;
+            std::cout << GREEN << "Cycle " << stats.totalCycles << ": Followed instruction at PC=0x" << std::hex << node->PC << std::dec << " (" << disassemblyAt(node->PC) << ") completes " << stageToString(node->stage) << RESET << std::endl;
         }
 
         switch (node->stage) {
@@ -414,8 +488,14 @@ void Simulator::advancePipeline() {
                         continue;
                     }
                     instructionCount++;
-                    fetchInstruction(node, PC, running, textMap);
+                    fetchInstruction(node, PC, running, program->textMap);
                     if (running && node->instruction != 0) {
+                        stats.fetchBlockReads += fetchBuffer.fetch(node->PC, node->length);
+                        if (node->length == COMPRESSED_INSTRUCTION_SIZE) {
+                            stats.compressedInstructions++;
+                        } else if (node->PC % FetchBuffer::BLOCK_SIZE != 0) {
+                            stats.straddlingFetches++;
+                        }
                         if (isPipeline && isBranchPrediction) {
                             bool predictedTaken = branchPredictor.predict(node->PC);
                             std::cout << YELLOW << (node->isBranch ? "Branch" : "Jump") + std::string(" predicted ") + (predictedTaken ? "taken" : "not taken") + " at PC=" + std::to_string(node->PC) + " (" + parseInstructions(node->instruction) + ")" << RESET << std::endl;
@@ -459,11 +539,22 @@ void Simulator::advancePipeline() {
                     }
 
                     uint32_t opcode = node->opcode & 0x7F;
-                    if (node->instructionType == InstructionType::I && opcode == 0x03) {
-                        stats.dataTransferInstructions++;
-                    } else if (node->instructionType == InstructionType::S) {
+                    if (describe(node->instructionName).isFloat()) {
+                        stats.floatInstructions++;
+                    }
+                    if (node->instructionType == InstructionType::V) {
+                        stats.vectorInstructions++;
+                    }
+                    if (describe(node->instructionName).isBitManipulation()) {
+                        stats.bitManipulationInstructions++;
+                    }
+                    if (isCustomInstruction(node->instructionName)) {
+                        stats.customInstructions++;
+                    }
+                    if (node->isLoad || node->isStore) {
                         stats.dataTransferInstructions++;
-                    } else if (node->instructionType == InstructionType::R || (node->instructionType == InstructionType::I && opcode == 0x13) || node->instructionType == InstructionType::U) {
+                    } else if (node->instructionType == InstructionType::R || node->instructionType == InstructionType::R4 || node->instructionType == InstructionType::V ||
+                               (node->instructionType == InstructionType::I && (opcode == 0x13 || isCustomInstruction(node->instructionName))) || node->instructionType == InstructionType::U) {
                         stats.aluInstructions++;
                     } else if (node->instructionType == InstructionType::SB || node->instructionType == InstructionType::UJ || (node->instructionType == InstructionType::I && opcode == 0x67)) {
                         stats.controlInstructions++;
@@ -484,7 +575,29 @@ void Simulator::advancePipeline() {
                 
             case Stage::EXECUTE:
                 {
-                    loadUseHazard = checkLoadUseHazard(*node, depsSnapshot, node->isStore);
+                    // A multi-cycle operation has already produced its
+                    // result; it holds EXECUTE until its latency has passed.
+                    if (node->busyCycles > 0) {
+                        if (--node->busyCycles > 0) {
+                            newPipeline[Stage::EXECUTE] = node;
+                            pipeline[stage] = nullptr;
+                            instructionProcessed = true;
+                            stalled = true;
+                            if (isPipeline) {
+                                stats.stallBubbles++;
+                                stats.structuralHazardStalls++;
+                            }
+                            continue;
+                        }
+                        node->stage = Stage::MEMORY;
+                        newPipeline[Stage::MEMORY] = node;
+                        pipeline[stage] = nullptr;
+                        instructionProcessed = true;
+                        break;
+                    }
+
+                    // A vector store reads its base register here, so it waits for a load like any other use.
+                    loadUseHazard = checkLoadUseHazard(*node, depsSnapshot, node->isStore && node->instructionType != InstructionType::V);
                     if (loadUseHazard) {
                         node->stalled = true;
                         newPipeline[Stage::EXECUTE] = new InstructionNode(*node);
@@ -496,8 +609,21 @@ void Simulator::advancePipeline() {
 
                     bool taken = false;
                     uint32_t oldPC = PC;
-                    executeInstruction(node, instructionRegisters, registers, PC, taken, forwardingStatus);
+                    vector::Issue vectorIssue;
+                    if (node->instructionType == InstructionType::V) {
+                        vectorIssue = executeVectorInstruction(node, instructionRegisters, vectorState, memory);
+                    } else {
+                        executeInstruction(node, instructionRegisters, registers, PC, taken, forwardingStatus, fcsr);
+                    }
                     updateDependencies(*node, Stage::EXECUTE);
+
+                    if (haltsExecution(node)) {
+                        running = false;
+                        flushPipeline("Program halted");
+                        newPipeline[Stage::FETCH] = nullptr;
+                        newPipeline[Stage::DECODE] = nullptr;
+                        std::cout << GREEN << "\nProgram halted by " << describe(node->instructionName).mnemonic << " at PC=" << node->PC << RESET << std::endl;
+                    }
                     
                     if (isPipeline && (node->isBranch || node->isJump)) {
                         bool predictedTaken = branchPredictor.getPHT(node->PC);
@@ -540,6 +666,28 @@ void Simulator::advancePipeline() {
                         followedInstructionRegisters.RY = instructionRegisters.RY;
                         followedInstructionRegisters.RM = instructionRegisters.RM;
                     }
+
+                    // Waiting for a custom unit's result comes first; the
+                    // instruction's own latency follows it.
+                    node->busyCycles = customUnits.schedule(node->instructionName, node->rd,
+                                                            {node->rs1, readsRs2(*node) ? node->rs2 : 0, readsRs3(*node) ? node->rs3 : 0},
+                                                            stats.totalCycles, stats);
+                    if (node->instructionType == InstructionType::V) {
+                        node->busyCycles += vectorPipeline.schedule(vectorIssue, vectorConfig, stats.totalCycles + node->busyCycles, stats);
+                    } else if (!isCustomInstruction(node->instructionName)) {
+                        node->busyCycles += executeLatency(node->instructionName, executeLatencies) - 1;
+                    }
+                    if (node->busyCycles > 0) {
+                        newPipeline[Stage::EXECUTE] = node;
+                        pipeline[stage] = nullptr;
+                        instructionProcessed = true;
+                        stalled = true;
+                        if (isPipeline) {
+                            stats.stallBubbles++;
+                            stats.structuralHazardStalls++;
+                        }
+                        continue;
+                    }
                     
                     node->stage = Stage::MEMORY;
                     newPipeline[Stage::MEMORY] = node;
@@ -551,7 +699,7 @@ void Simulator::advancePipeline() {
             case Stage::MEMORY:
                 {
                     applyDataForwarding(*node, depsSnapshot);
-                    memoryAccess(node, instructionRegisters, registers, dataMap);
+                    memoryAccess(node, instructionRegisters, registers, memory);
                     updateDependencies(*node, Stage::MEMORY);
 
                     if (isFollowing && node->PC == followedInstruction) {
@@ -578,7 +726,7 @@ void Simulator::advancePipeline() {
                     delete node;
                     pipeline[Stage::WRITEBACK] = nullptr;
                     
-                    if (!isPipeline && running && textMap.find(PC) != textMap.end()) {
+                    if (!isPipeline && running && hasInstruction(PC)) {
                         bool pipelineEmpty = true;
                         for (const auto& [_, node] : newPipeline) {
                             if (node != nullptr) {
@@ -596,7 +744,7 @@ void Simulator::advancePipeline() {
         }
     }
 
-    if (isPipeline && !stalled && newPipeline[Stage::FETCH] == nullptr && running && textMap.find(PC) != textMap.end()) {
+    if (isPipeline && !stalled && newPipeline[Stage::FETCH] == nullptr && running && hasInstruction(PC)) {
         InstructionNode* newNode = new InstructionNode(PC);
         newNode->uniqueId = nextInstructionId++;
         newPipeline[Stage::FETCH] = newNode;
@@ -611,7 +759,7 @@ void Simulator::advancePipeline() {
     pipeline = newPipeline;
 
     bool isEmpty = isPipelineEmpty();
-    if (isEmpty && !textMap.empty() && textMap.find(PC) == textMap.end()) {
+    if (isEmpty && !program->textMap.empty() && !hasInstruction(PC)) {
         running = false;
     }
 
@@ -629,6 +777,12 @@ bool Simulator::step() {
         stats.instructionsExecuted = instructionCount;
         bool pipelineEmpty = isPipelineEmpty();
         if (!running && pipelineEmpty) {
+            // Vector and custom-unit work still in flight finishes before the program does.
+            const uint32_t drain = std::max(vectorPipeline.drain(stats.totalCycles), customUnits.drain(stats.totalCycles));
+            if (drain > 0) {
+                stats.totalCycles += drain;
+                stats.cyclesPerInstruction = static_cast<double>(stats.totalCycles) / instructionCount;
+            }
             std::cout << GREEN << "Program execution completed" << RESET << std::endl;
             return false;
         }
@@ -662,8 +816,8 @@ void Simulator::setEnvironment(bool pipeline, bool dataForwarding, bool branchPr
     }
 }
 
-std::map<uint32_t, std::pair<uint32_t, std::string>> Simulator::getTextMap() const {
-    return textMap;
+const TextMap& Simulator::getTextMap() const {
+    return program->textMap;
 }
 
 uint32_t Simulator::getCycles() const {
@@ -0,0 +1,184 @@
+#ifndef SOURCE_HPP
+#define SOURCE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RISCV_HAS_MMAP 1
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace riscv {
+    class SourceBuffer {
+    public:
+        SourceBuffer(const SourceBuffer&) = delete;
+        SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+        ~SourceBuffer() {
+#ifdef RISCV_HAS_MMAP
+            if (mapped != nullptr) {
+                munmap(mapped, mappedSize);
+            }
+#endif
+        }
+
+        static std::shared_ptr<const SourceBuffer> fromString(std::string text) {
+            std::shared_ptr<SourceBuffer> buffer(new SourceBuffer());
+            buffer->owned = std::move(text);
+            buffer->text = buffer->owned;
+            return buffer;
+        }
+
+        static std::shared_ptr<const SourceBuffer> fromFile(const std::string& filename) {
+#ifdef RISCV_HAS_MMAP
+            int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Could not open file: " + filename);
+            }
+            struct stat info;
+            if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+                ::close(fd);
+                return fromStream(filename);
+            }
+            std::shared_ptr<SourceBuffer> buffer(new SourceBuffer());
+            if (info.st_size > 0) {
+                void* address = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address == MAP_FAILED) {
+                    ::close(fd);
+                    return fromStream(filename);
+                }
+#ifdef MADV_SEQUENTIAL
+                ::madvise(address, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+#endif
+                buffer->mapped = address;
+                buffer->mappedSize = static_cast<size_t>(info.st_size);
+                buffer->text = std::string_view(static_cast<const char*>(address), buffer->mappedSize);
+            }
+            ::close(fd);
+            return buffer;
+#else
+            return fromStream(filename);
+#endif
+        }
+
+        std::string_view view() const { return text; }
+        size_t size() const { return text.size(); }
+        bool empty() const { return text.empty(); }
+        bool isMapped() const { return mapped != nullptr; }
+
+    private:
+        SourceBuffer() : mapped(nullptr), mappedSize(0) {}
+
+        static std::shared_ptr<const SourceBuffer> fromStream(const std::string& filename) {
+            std::ifstream file(filename, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Could not open file: " + filename);
+            }
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            return fromString(buffer.str());
+        }
+
+        std::string owned;
+        std::string_view text;
+        void* mapped;
+        size_t mappedSize;
+    };
+
+    struct DelimiterTable {
+        bool isDelimiter[256];
+
+        constexpr DelimiterTable() : isDelimiter() {
+            for (int c = 0; c <= 0x20; ++c) isDelimiter[c] = true;
+            isDelimiter[static_cast<unsigned char>(',')] = true;
+            isDelimiter[static_cast<unsigned char>('#')] = true;
+            isDelimiter[static_cast<unsigned char>('/')] = true;
+            isDelimiter[static_cast<unsigned char>('"')] = true;
+            isDelimiter[static_cast<unsigned char>('(')] = true;
+            isDelimiter[static_cast<unsigned char>(')')] = true;
+        }
+    };
+
+    inline constexpr DelimiterTable delimiterTable{};
+
+    inline const char* scanDelimiterScalar(const char* cursor, const char* end) {
+        while (cursor < end && !delimiterTable.isDelimiter[static_cast<unsigned char>(*cursor)]) {
+            ++cursor;
+        }
+        return cursor;
+    }
+
+    inline const char* scanDelimiter(const char* cursor, const char* end) {
+#if defined(__AVX2__)
+        const __m256i space = _mm256_set1_epi8(0x20);
+        const __m256i comma = _mm256_set1_epi8(',');
+        const __m256i hash = _mm256_set1_epi8('#');
+        const __m256i slash = _mm256_set1_epi8('/');
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i open = _mm256_set1_epi8('(');
+        const __m256i close = _mm256_set1_epi8(')');
+        while (end - cursor >= 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cursor));
+            __m256i hits = _mm256_cmpeq_epi8(_mm256_min_epu8(block, space), block);
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, comma));
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, hash));
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, slash));
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, quote));
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, open));
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, close));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+            if (mask != 0) {
+                return cursor + __builtin_ctz(mask);
+            }
+            cursor += 32;
+        }
+#elif defined(__SSE2__)
+        const __m128i space = _mm_set1_epi8(0x20);
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i hash = _mm_set1_epi8('#');
+        const __m128i slash = _mm_set1_epi8('/');
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i open = _mm_set1_epi8('(');
+        const __m128i close = _mm_set1_epi8(')');
+        while (end - cursor >= 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor));
+            __m128i hits = _mm_cmpeq_epi8(_mm_min_epu8(block, space), block);
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, comma));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, hash));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, slash));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, quote));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, open));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, close));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+            if (mask != 0) {
+                return cursor + __builtin_ctz(mask);
+            }
+            cursor += 16;
+        }
+#endif
+        return scanDelimiterScalar(cursor, end);
+    }
+
+    inline const char* scanByte(const char* cursor, const char* end, char value) {
+        const void* found = std::memchr(cursor, value, static_cast<size_t>(end - cursor));
+        return found ? static_cast<const char*>(found) : end;
+    }
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "assembler.hpp"
+
+using namespace riscv;
+
+class StreamingAssembler {
+public:
+    static constexpr size_t CHUNK_SIZE = 1 << 16;
+
+    // Text is handed to emitText(address, code) and labelled data to
+    // emitData(address, bytes, size) as soon as it is resolved. Data arrives
+    // in address order, but only after the text around it is flushed.
+    template <typename TextSink, typename DataSink>
+    inline bool assemble(std::istream &input, TextSink &&emitText, DataSink &&emitData);
+
+    inline size_t getInstructionCount() const { return instructionCount; }
+    inline size_t getDataByteCount() const { return dataByteCount; }
+    inline size_t getLineCount() const { return static_cast<size_t>(lineNumber); }
+    inline size_t getPeakPendingFixups() const { return peakPendingFixups; }
+
+private:
+    Parser parser;
+    TokenArena lineTokens;
+    size_t instructionCount = 0;
+    size_t dataByteCount = 0;
+    size_t peakPendingFixups = 0;
+    int lineNumber = 0;
+
+    inline void feedLine(std::string_view line);
+};
+
+inline void StreamingAssembler::feedLine(std::string_view line) {
+    lineTokens.clear();
+    Lexer::appendLine(line, ++lineNumber, lineTokens);
+    if (!lineTokens.empty()) {
+        parser.parseLine(lineTokens[0]);
+        peakPendingFixups = std::max(peakPendingFixups, parser.getPendingFixupCount());
+    }
+}
+
+template <typename TextSink, typename DataSink>
+inline bool StreamingAssembler::assemble(std::istream &input, TextSink &&emitText, DataSink &&emitData) {
+    const Assembler encoder;
+    auto emit = [&](const ParsedInstruction &inst) {
+        emitText(inst.address, encoder.encode(inst));
+        ++instructionCount;
+    };
+    auto emitEntry = [&](uint32_t address, const uint8_t *bytes, size_t size) {
+        emitData(address, bytes, size);
+        dataByteCount += size;
+    };
+
+    parser.beginStream();
+    instructionCount = 0;
+    dataByteCount = 0;
+    peakPendingFixups = 0;
+    lineNumber = 0;
+
+    std::vector<char> chunk(CHUNK_SIZE);
+    std::string pending;
+    size_t bytesRead = 0;
+
+    while (input.read(chunk.data(), static_cast<std::streamsize>(chunk.size())) || input.gcount() > 0) {
+        const size_t count = static_cast<size_t>(input.gcount());
+        bytesRead += count;
+        pending.append(chunk.data(), count);
+
+        const char* const begin = pending.data();
+        const char* const end = begin + pending.size();
+        const char* cursor = begin;
+        for (const char* lineEnd = scanByte(cursor, end, '\n'); lineEnd < end; lineEnd = scanByte(cursor, end, '\n')) {
+            feedLine(std::string_view(cursor, lineEnd - cursor));
+            cursor = lineEnd + 1;
+        }
+        pending.erase(0, cursor - begin);
+
+        parser.drainResolved(emit);
+        parser.drainData(emitEntry);
+    }
+
+    if (bytesRead == 0) {
+        throw std::runtime_error(std::string(RED) + "Empty input provided" + RESET);
+    }
+    if (!pending.empty()) {
+        feedLine(pending);
+    }
+
+    if (!parser.finishStream()) {
+        return false;
+    }
+    parser.drainResolved(emit);
+    parser.drainData(emitEntry);
+    return parser.getErrorCount() == 0;
+}
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef SYMBOLS_HPP
+#define SYMBOLS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace riscv {
+    using SymbolId = uint32_t;
+    inline constexpr SymbolId INVALID_SYMBOL = UINT32_MAX;
+
+    enum class SymbolKind : uint8_t { UNDEFINED, TEXT, DATA };
+
+    struct Symbol {
+        uint32_t address = 0;
+        SymbolKind kind = SymbolKind::UNDEFINED;
+        uint32_t payloadOffset = 0;
+        uint32_t payloadSize = 0;
+
+        bool isDefined() const { return kind != SymbolKind::UNDEFINED; }
+    };
+
+    // Labels are interned once and referred to by dense ids; data payloads live
+    // little-endian in a single byte arena shared by every symbol of the table.
+    class SymbolTable {
+    public:
+        void clear() {
+            names.clear();
+            index.clear();
+            symbols.clear();
+            payloads.clear();
+        }
+
+        SymbolId intern(std::string_view name) {
+            auto it = index.find(name);
+            if (it != index.end()) return it->second;
+            const SymbolId id = static_cast<SymbolId>(symbols.size());
+            names.emplace_back(name);
+            index.emplace(names.back(), id);
+            symbols.emplace_back();
+            return id;
+        }
+
+        SymbolId find(std::string_view name) const {
+            auto it = index.find(name);
+            return it == index.end() ? INVALID_SYMBOL : it->second;
+        }
+
+        const Symbol* lookup(std::string_view name) const {
+            const SymbolId id = find(name);
+            return (id != INVALID_SYMBOL && symbols[id].isDefined()) ? &symbols[id] : nullptr;
+        }
+
+        Symbol& operator[](SymbolId id) { return symbols[id]; }
+        const Symbol& operator[](SymbolId id) const { return symbols[id]; }
+        std::string_view name(SymbolId id) const { return names[id]; }
+        size_t size() const { return symbols.size(); }
+
+        bool defineLabel(SymbolId id, uint32_t address) {
+            Symbol &symbol = symbols[id];
+            if (symbol.isDefined()) return false;
+            symbol.address = address;
+            symbol.kind = SymbolKind::TEXT;
+            return true;
+        }
+
+        // Forgets every definition but keeps the interned names, so ids stay
+        // valid across a rebuild of the table.
+        void resetDefinitions() {
+            std::fill(symbols.begin(), symbols.end(), Symbol{});
+            payloads.clear();
+        }
+
+        uint32_t payloadMark() const { return static_cast<uint32_t>(payloads.size()); }
+        void discardPayload(uint32_t mark) { payloads.resize(mark); }
+
+        void appendPayload(uint64_t value, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                payloads.push_back(static_cast<uint8_t>(value >> (i * 8)));
+            }
+        }
+
+        void appendPayload(std::string_view bytes) {
+            payloads.insert(payloads.end(), bytes.begin(), bytes.end());
+        }
+
+        void defineData(SymbolId id, uint32_t address, uint32_t mark) {
+            Symbol &symbol = symbols[id];
+            symbol.address = address;
+            symbol.kind = SymbolKind::DATA;
+            symbol.payloadOffset = mark;
+            symbol.payloadSize = payloadMark() - mark;
+        }
+
+        void import(SymbolId id, const SymbolTable &source, const Symbol &symbol) {
+            const uint32_t mark = payloadMark();
+            const uint8_t* bytes = source.payload(symbol);
+            payloads.insert(payloads.end(), bytes, bytes + symbol.payloadSize);
+            symbols[id] = symbol;
+            symbols[id].payloadOffset = mark;
+        }
+
+        const uint8_t* payload(const Symbol &symbol) const { return payloads.data() + symbol.payloadOffset; }
+
+    private:
+        std::deque<std::string> names;
+        std::unordered_map<std::string_view, SymbolId> index;
+        std::vector<Symbol> symbols;
+        std::vector<uint8_t> payloads;
+    };
+}
+
+#endif
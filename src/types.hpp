@@ -1,14 +1,18 @@
 #ifndef TYPES_HPP
 #define TYPES_HPP
 
-#include <unordered_set>
 #include <unordered_map>
 #include <stdexcept>
 #include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <deque>
+#include <array>
 #include <iostream>
+#include "hash.hpp"
 
 #define RESET   "\033[0m"
 #define RED     "\033[31m"
@@ -21,9 +25,20 @@ namespace riscv {
     inline constexpr uint32_t DATA_SEGMENT_START = 0x10000000;
     inline constexpr uint32_t STACK_SEGMENT_START = 0x7FFFFDC;
     inline constexpr uint32_t INSTRUCTION_SIZE = 4;
+    inline constexpr uint32_t COMPRESSED_INSTRUCTION_SIZE = 2;
     inline constexpr uint32_t MEMORY_SIZE = 0x80000000;
 
+    // Text holds 32-bit words and 16-bit RVC parcels; the low two bits of an
+    // instruction's first halfword tell them apart.
+    inline constexpr bool isCompressedParcel(uint32_t value) { return (value & 0x3) != 0x3; }
+    inline constexpr uint32_t encodedLength(uint32_t value) { return isCompressedParcel(value) ? COMPRESSED_INSTRUCTION_SIZE : INSTRUCTION_SIZE; }
+
     inline constexpr int NUM_REGISTERS = 32;
+    inline constexpr int NUM_FLOAT_REGISTERS = 32;
+    // The simulator keeps one register file: x0-x31 followed by f0-f31, so a
+    // register number alone says which file an operand is in.
+    inline constexpr uint32_t FLOAT_REGISTER_BASE = NUM_REGISTERS;
+    inline constexpr int REGISTER_FILE_SIZE = NUM_REGISTERS + NUM_FLOAT_REGISTERS;
     inline constexpr int MAX_STEPS = 100000;
 
     enum class Stage { FETCH, DECODE, EXECUTE, MEMORY, WRITEBACK };
@@ -51,7 +66,7 @@ namespace riscv {
         ForwardingStatus() : raForwarded(false), rbForwarded(false), rmForwarded(false) {}
     };
     
-    enum class InstructionType { R, I, S, SB, U, UJ };
+    enum class InstructionType { R, R4, I, S, SB, U, UJ, V };
 
     enum TokenType {
         OPCODE,
@@ -66,55 +81,1000 @@ namespace riscv {
     };
 
     enum class Instructions {
-        ADD, SUB, MUL, DIV, REM, AND, OR, XOR, SLL, SLT, SRA, SRL,
-        ADDI, ANDI, ORI, LB, LH, LW, JALR,
+        ADD, SUB, MUL, MULH, MULHSU, MULHU, DIV, DIVU, REM, REMU, AND, OR, XOR, SLL, SLT, SLTU, SRA, SRL,
+        ADDI, ANDI, ORI, XORI, SLTI, SLTIU, SLLI, SRLI, SRAI, LB, LH, LW, LBU, LHU, JALR,
+        FENCE, ECALL, EBREAK,
         SB, SH, SW,
-        BEQ, BNE, BGE, BLT,
+        BEQ, BNE, BGE, BLT, BLTU, BGEU,
         AUIPC, LUI, JAL,
+        SH1ADD, SH2ADD, SH3ADD, ANDN, ORN, XNOR, CLZ, CTZ, CPOP, MIN, MINU, MAX, MAXU, SEXT_B, SEXT_H, ZEXT_H,
+        ROL, ROR, RORI, REV8, ORC_B, BCLR, BCLRI, BEXT, BEXTI, BINV, BINVI, BSET, BSETI,
+        CSRRW, CSRRS, CSRRC, CSRRWI, CSRRSI, CSRRCI,
+        FLW, FSW,
+        FADD_S, FSUB_S, FMUL_S, FDIV_S, FSQRT_S, FSGNJ_S, FSGNJN_S, FSGNJX_S, FMIN_S, FMAX_S,
+        FCVT_W_S, FCVT_WU_S, FMV_X_W, FEQ_S, FLT_S, FLE_S, FCLASS_S, FCVT_S_W, FCVT_S_WU, FMV_W_X,
+        FMADD_S, FMSUB_S, FNMSUB_S, FNMADD_S,
+        VSETVLI, VSETIVLI, VSETVL,
+        VLE8_V, VLE16_V, VLE32_V, VSE8_V, VSE16_V, VSE32_V, VLSE8_V, VLSE16_V, VLSE32_V, VSSE8_V, VSSE16_V, VSSE32_V,
+        VADD_VV, VADD_VX, VADD_VI, VSUB_VV, VSUB_VX, VRSUB_VX, VRSUB_VI,
+        VMINU_VV, VMINU_VX, VMIN_VV, VMIN_VX, VMAXU_VV, VMAXU_VX, VMAX_VV, VMAX_VX,
+        VAND_VV, VAND_VX, VAND_VI, VOR_VV, VOR_VX, VOR_VI, VXOR_VV, VXOR_VX, VXOR_VI,
+        VSLL_VV, VSLL_VX, VSLL_VI, VSRL_VV, VSRL_VX, VSRL_VI, VSRA_VV, VSRA_VX, VSRA_VI,
+        VMSEQ_VV, VMSEQ_VX, VMSEQ_VI, VMSNE_VV, VMSNE_VX, VMSNE_VI, VMSLTU_VV, VMSLTU_VX, VMSLT_VV, VMSLT_VX,
+        VMSLEU_VV, VMSLEU_VX, VMSLEU_VI, VMSLE_VV, VMSLE_VX, VMSLE_VI, VMSGTU_VX, VMSGTU_VI, VMSGT_VX, VMSGT_VI,
+        VMERGE_VVM, VMERGE_VXM, VMERGE_VIM, VMV_V_V, VMV_V_X, VMV_V_I,
+        VMUL_VV, VMUL_VX, VMULH_VV, VMULH_VX, VMULHU_VV, VMULHU_VX, VMACC_VV, VMACC_VX,
+        VREDSUM_VS, VREDAND_VS, VREDOR_VS, VREDXOR_VS, VREDMINU_VS, VREDMIN_VS, VREDMAXU_VS, VREDMAX_VS,
+        VMANDN_MM, VMAND_MM, VMOR_MM, VMXOR_MM, VMORN_MM, VMNAND_MM, VMNOR_MM, VMXNOR_MM,
+        VMV_X_S, VMV_S_X, VCPOP_M, VFIRST_M, VID_V,
         INVALID
     };
 
-    inline const std::unordered_map<std::string, Instructions> stringToInstruction = {
-        {"add", Instructions::ADD},   {"sub", Instructions::SUB},   {"mul", Instructions::MUL},
-        {"div", Instructions::DIV},   {"rem", Instructions::REM},   {"and", Instructions::AND},
-        {"or", Instructions::OR},     {"xor", Instructions::XOR},   {"sll", Instructions::SLL},
-        {"slt", Instructions::SLT},   {"sra", Instructions::SRA},   {"srl", Instructions::SRL},
-        {"addi", Instructions::ADDI}, {"andi", Instructions::ANDI}, {"ori", Instructions::ORI},
-        {"lb", Instructions::LB},     {"lh", Instructions::LH},     {"lw", Instructions::LW},
-        {"jalr", Instructions::JALR},
-        {"sb", Instructions::SB},     {"sh", Instructions::SH},     {"sw", Instructions::SW},
-        {"beq", Instructions::BEQ},   {"bne", Instructions::BNE},   {"bge", Instructions::BGE},
-        {"blt", Instructions::BLT},
-        {"auipc", Instructions::AUIPC}, {"lui", Instructions::LUI}, {"jal", Instructions::JAL}
+    enum class OperandFormat : uint8_t {
+        REG_REG_REG,
+        REG_REG_IMM,
+        REG_MEM,
+        STORE_MEM,
+        BRANCH,
+        REG_UIMM,
+        JUMP,
+        FENCE,
+        NONE,
+        REG_REG,
+        REG_REG_REG_REG,
+        CSR,
+        CSR_IMM,
+        VECTOR_BINARY,
+        VECTOR_MULTIPLY_ADD,
+        VECTOR_MERGE,
+        VECTOR_UNARY,
+        VECTOR_TO_SCALAR,
+        VECTOR_INDEX,
+        VECTOR_MEMORY,
+        VECTOR_STRIDED,
+        VECTOR_CONFIG,
+        VECTOR_CONFIG_IMM
+    };
+
+    inline constexpr size_t operandCountOf(OperandFormat operands) {
+        switch (operands) {
+            case OperandFormat::REG_UIMM:
+            case OperandFormat::JUMP:
+            case OperandFormat::REG_REG: return 2;
+            case OperandFormat::REG_REG_REG_REG: return 4;
+            case OperandFormat::FENCE:
+            case OperandFormat::NONE: return 0;
+            default: return 3;
+        }
+    }
+
+    // Register fields that name f registers rather than x registers.
+    enum FloatRegisterFields : uint8_t {
+        FLOAT_RD = 1 << 0,
+        FLOAT_RS1 = 1 << 1,
+        FLOAT_RS2 = 1 << 2,
+        FLOAT_RS3 = 1 << 3
+    };
+
+    // Register fields of a V instruction (InstructionType::V) that name v
+    // registers, and those that name x registers. Fields in neither hold an
+    // immediate, the vtype or a fixed selector.
+    enum VectorRegisterFields : uint8_t {
+        VECTOR_VD = 1 << 0,
+        VECTOR_VS1 = 1 << 1,
+        VECTOR_VS2 = 1 << 2,
+        SCALAR_RD = 1 << 4,
+        SCALAR_RS1 = 1 << 5,
+        SCALAR_RS2 = 1 << 6
+    };
+
+    // The register field an operand in source order fills; 0 for operands
+    // that are not registers.
+    inline constexpr uint8_t operandRegisterField(OperandFormat operands, size_t index) {
+        switch (operands) {
+            case OperandFormat::STORE_MEM: return index == 0 ? FLOAT_RS2 : index == 2 ? FLOAT_RS1 : 0;
+            case OperandFormat::REG_MEM: return index == 0 ? FLOAT_RD : index == 2 ? FLOAT_RS1 : 0;
+            case OperandFormat::BRANCH: return index == 0 ? FLOAT_RS1 : index == 1 ? FLOAT_RS2 : 0;
+            case OperandFormat::CSR: return index == 0 ? FLOAT_RD : index == 2 ? FLOAT_RS1 : 0;
+            default: {
+                constexpr uint8_t fields[] = {FLOAT_RD, FLOAT_RS1, FLOAT_RS2, FLOAT_RS3};
+                return index < operandCountOf(operands) && index < 4 ? fields[index] : 0;
+            }
+        }
+    }
+
+    // Execution units with their own latency; see ExecuteLatencies.
+    enum class FloatUnit : uint8_t { NONE, ADD, MULTIPLY, FUSED, DIVIDE, SQUARE_ROOT, CONVERT, OTHER };
+
+    // Rounding-mode field values; DYNAMIC takes the mode from frm.
+    enum RoundingMode : uint8_t { ROUND_NEAREST_EVEN = 0, ROUND_TOWARD_ZERO = 1, ROUND_DOWN = 2, ROUND_UP = 3, ROUND_NEAREST_MAX = 4, ROUND_DYNAMIC = 7 };
+
+    inline constexpr std::string_view roundingModeNames[] = {"rne", "rtz", "rdn", "rup", "rmm", "", "", "dyn"};
+
+    inline constexpr uint32_t CSR_FFLAGS = 0x001;
+    inline constexpr uint32_t CSR_FRM = 0x002;
+    inline constexpr uint32_t CSR_FCSR = 0x003;
+
+    enum InstructionFlags : uint8_t {
+        FLAG_NONE = 0,
+        FLAG_LOAD = 1 << 0,
+        FLAG_STORE = 1 << 1,
+        FLAG_BRANCH = 1 << 2,
+        FLAG_JUMP = 1 << 3,
+        FLAG_ROUNDING = 1 << 4,
+        FLAG_BITMANIP = 1 << 5
+    };
+
+    struct InstructionDescriptor {
+        Instructions instruction;
+        std::string_view mnemonic;
+        InstructionType format;
+        OperandFormat operands;
+        uint8_t opcode;
+        uint8_t funct3;
+        uint8_t funct7;
+        int32_t immMin;
+        int32_t immMax;
+        uint8_t flags;
+        uint32_t match;
+        uint32_t mask;
+        uint8_t floatRegisters = 0;
+        FloatUnit unit = FloatUnit::NONE;
+        uint8_t vectorRegisters = 0;
+
+        constexpr bool isLoad() const { return flags & FLAG_LOAD; }
+        constexpr bool isStore() const { return flags & FLAG_STORE; }
+        constexpr bool isBranch() const { return flags & FLAG_BRANCH; }
+        constexpr bool isJump() const { return flags & FLAG_JUMP; }
+        constexpr bool isMemory() const { return flags & (FLAG_LOAD | FLAG_STORE); }
+        constexpr bool hasRounding() const { return flags & FLAG_ROUNDING; }
+        constexpr bool isBitManipulation() const { return flags & FLAG_BITMANIP; }
+        constexpr bool isFloat() const { return unit != FloatUnit::NONE; }
+        constexpr bool isVector() const { return format == InstructionType::V; }
+        constexpr bool isFloatOperand(size_t index) const { return floatRegisters & operandRegisterField(operands, index); }
+    };
+
+    inline constexpr InstructionDescriptor describeR(Instructions instruction, std::string_view mnemonic, uint8_t funct3, uint8_t funct7) {
+        return {instruction, mnemonic, InstructionType::R, OperandFormat::REG_REG_REG, 0b0110011, funct3, funct7, 0, 0, FLAG_NONE,
+                0b0110011u | (uint32_t(funct3) << 12) | (uint32_t(funct7) << 25), 0xFE00707Fu};
+    }
+
+    inline constexpr InstructionDescriptor describeI(Instructions instruction, std::string_view mnemonic, uint8_t opcode, uint8_t funct3, OperandFormat operands, uint8_t flags = FLAG_NONE) {
+        return {instruction, mnemonic, InstructionType::I, operands, opcode, funct3, 0, -2048, 2047, flags,
+                opcode | (uint32_t(funct3) << 12), 0x707Fu};
+    }
+
+    // Shift amounts take the low five bits of the I immediate; funct7 sits
+    // above them and is part of the match.
+    inline constexpr InstructionDescriptor describeShift(Instructions instruction, std::string_view mnemonic, uint8_t funct3, uint8_t funct7) {
+        return {instruction, mnemonic, InstructionType::I, OperandFormat::REG_REG_IMM, 0b0010011, funct3, funct7, 0, 31, FLAG_NONE,
+                0b0010011u | (uint32_t(funct3) << 12) | (uint32_t(funct7) << 25), 0xFE00707Fu};
+    }
+
+    // Zba/Zbb/Zbs. The register and shift-immediate forms reuse the R and
+    // shift layouts; the unary ones (clz, rev8, zext.h, ...) fix rs2 as a
+    // selector like the unary F instructions.
+    inline constexpr InstructionDescriptor bitManipulation(InstructionDescriptor descriptor) {
+        descriptor.flags |= FLAG_BITMANIP;
+        return descriptor;
+    }
+
+    inline constexpr InstructionDescriptor describeBitUnary(Instructions instruction, std::string_view mnemonic, uint8_t opcode, uint8_t funct3, uint8_t funct7, uint8_t rs2) {
+        return {instruction, mnemonic, InstructionType::R, OperandFormat::REG_REG, opcode, funct3, funct7, 0, 0, FLAG_BITMANIP,
+                opcode | (uint32_t(funct3) << 12) | (uint32_t(rs2) << 20) | (uint32_t(funct7) << 25), 0xFFF0707Fu};
+    }
+
+    // fence keeps its predecessor and successor sets in the immediate; ecall
+    // and ebreak are fixed words told apart by funct12.
+    inline constexpr InstructionDescriptor describeFence(Instructions instruction, std::string_view mnemonic) {
+        return {instruction, mnemonic, InstructionType::I, OperandFormat::FENCE, 0b0001111, 0b000, 0, 0, 0xFF, FLAG_NONE,
+                0b0001111u, 0x707Fu};
+    }
+
+    inline constexpr InstructionDescriptor describeSystem(Instructions instruction, std::string_view mnemonic, uint16_t funct12) {
+        return {instruction, mnemonic, InstructionType::I, OperandFormat::NONE, 0b1110011, 0b000, 0, 0, 0, FLAG_NONE,
+                0b1110011u | (uint32_t(funct12) << 20), 0xFFFFFFFFu};
+    }
+
+    inline constexpr InstructionDescriptor describeS(Instructions instruction, std::string_view mnemonic, uint8_t funct3, uint8_t opcode = 0b0100011) {
+        return {instruction, mnemonic, InstructionType::S, OperandFormat::STORE_MEM, opcode, funct3, 0, -2048, 2047, FLAG_STORE,
+                opcode | (uint32_t(funct3) << 12), 0x707Fu};
+    }
+
+    inline constexpr InstructionDescriptor describeSB(Instructions instruction, std::string_view mnemonic, uint8_t funct3) {
+        return {instruction, mnemonic, InstructionType::SB, OperandFormat::BRANCH, 0b1100011, funct3, 0, -4096, 4095, FLAG_BRANCH,
+                0b1100011u | (uint32_t(funct3) << 12), 0x707Fu};
+    }
+
+    inline constexpr InstructionDescriptor describeU(Instructions instruction, std::string_view mnemonic, uint8_t opcode) {
+        return {instruction, mnemonic, InstructionType::U, OperandFormat::REG_UIMM, opcode, 0, 0, 0, 0xFFFFF, FLAG_NONE, opcode, 0x7Fu};
+    }
+
+    inline constexpr InstructionDescriptor describeUJ(Instructions instruction, std::string_view mnemonic, uint8_t opcode) {
+        return {instruction, mnemonic, InstructionType::UJ, OperandFormat::JUMP, opcode, 0, 0, -1048576, 1048575, FLAG_JUMP, opcode, 0x7Fu};
+    }
+
+    // Zicsr: the CSR number is the I-type immediate, and the *i forms put a
+    // 5-bit unsigned immediate where rs1 would be.
+    inline constexpr InstructionDescriptor describeCsr(Instructions instruction, std::string_view mnemonic, uint8_t funct3) {
+        return {instruction, mnemonic, InstructionType::I, (funct3 & 0b100) ? OperandFormat::CSR_IMM : OperandFormat::CSR, 0b1110011, funct3, 0, 0, 0xFFF, FLAG_NONE,
+                0b1110011u | (uint32_t(funct3) << 12), 0x707Fu};
+    }
+
+    inline constexpr InstructionDescriptor inFloatFile(InstructionDescriptor descriptor, uint8_t floatRegisters) {
+        descriptor.floatRegisters = floatRegisters;
+        descriptor.unit = FloatUnit::OTHER;
+        return descriptor;
+    }
+
+    // OP-FP instructions. With FLAG_ROUNDING funct3 holds the rounding mode
+    // and is left out of the match; the unary forms fix rs2 as a selector.
+    inline constexpr InstructionDescriptor describeFloat(Instructions instruction, std::string_view mnemonic, uint8_t funct7, OperandFormat operands,
+                                                         uint8_t floatRegisters, FloatUnit unit, uint8_t flags, uint8_t funct3 = 0, uint8_t rs2 = 0) {
+        const bool rounding = flags & FLAG_ROUNDING;
+        const bool unary = operands == OperandFormat::REG_REG;
+        return {instruction, mnemonic, InstructionType::R, operands, 0b1010011, rounding ? uint8_t(0) : funct3, funct7, 0, 0, flags,
+                0b1010011u | (rounding ? 0u : uint32_t(funct3) << 12) | (uint32_t(rs2) << 20) | (uint32_t(funct7) << 25),
+                0xFE00007Fu | (rounding ? 0u : 0x7000u) | (unary ? 0x01F00000u : 0u), floatRegisters, unit};
+    }
+
+    inline constexpr InstructionDescriptor describeFused(Instructions instruction, std::string_view mnemonic, uint8_t opcode) {
+        return {instruction, mnemonic, InstructionType::R4, OperandFormat::REG_REG_REG_REG, opcode, 0, 0, 0, 0, FLAG_ROUNDING,
+                opcode, 0x0600007Fu, FLOAT_RD | FLOAT_RS1 | FLOAT_RS2 | FLOAT_RS3, FloatUnit::FUSED};
+    }
+
+    // OP-V funct3 values: the operand category of an arithmetic instruction,
+    // or the vsetvl family.
+    enum VectorCategory : uint8_t { OPIVV = 0b000, OPMVV = 0b010, OPIVI = 0b011, OPIVX = 0b100, OPMVX = 0b110, OPCFG = 0b111 };
+
+    inline constexpr uint8_t OP_V = 0b1010111;
+    inline constexpr uint32_t VECTOR_VM_FIELD = 1u << 25;
+    inline constexpr uint32_t VECTOR_VS2_FIELD = 0x1Fu << 20;
+    inline constexpr uint32_t VECTOR_VS1_FIELD = 0x1Fu << 15;
+
+    // OP-V arithmetic. funct6 is kept in funct7's place, and the category in
+    // funct3 says whether bits 19:15 hold vs1, rs1 or a 5-bit immediate. Forms
+    // that use vm, vs2 or vs1 as a fixed selector pass its value in `fixed`
+    // and its field in `fixedMask`.
+    inline constexpr InstructionDescriptor describeVector(Instructions instruction, std::string_view mnemonic, uint8_t funct6, uint8_t funct3, OperandFormat operands,
+                                                          uint32_t fixed = 0, uint32_t fixedMask = 0, int32_t immMin = -16, int32_t immMax = 15) {
+        uint8_t fields = operands == OperandFormat::VECTOR_TO_SCALAR ? SCALAR_RD : VECTOR_VD;
+        if (!(fixedMask & VECTOR_VS2_FIELD)) fields |= VECTOR_VS2;
+        if (!(fixedMask & VECTOR_VS1_FIELD)) {
+            if (funct3 == OPIVV || funct3 == OPMVV) fields |= VECTOR_VS1;
+            else if (funct3 == OPIVX || funct3 == OPMVX) fields |= SCALAR_RS1;
+        }
+        InstructionDescriptor descriptor = {instruction, mnemonic, InstructionType::V, operands, OP_V, funct3, funct6, immMin, immMax, FLAG_NONE,
+                                            OP_V | (uint32_t(funct3) << 12) | (uint32_t(funct6) << 26) | fixed, 0xFC00707Fu | fixedMask};
+        descriptor.vectorRegisters = fields;
+        return descriptor;
+    }
+
+    // Vector loads and stores share LOAD-FP and STORE-FP with flw and fsw.
+    // funct3 is the element width (000, 101 and 110 for 8, 16 and 32 bits) and
+    // mop in bits 27:26 is 00 for unit-stride and 10 for strided; nf and mew
+    // stay zero.
+    inline constexpr InstructionDescriptor describeVectorMemory(Instructions instruction, std::string_view mnemonic, uint8_t opcode, uint8_t width, bool strided) {
+        const uint8_t mop = strided ? 0b000010 : 0;
+        InstructionDescriptor descriptor = {instruction, mnemonic, InstructionType::V, strided ? OperandFormat::VECTOR_STRIDED : OperandFormat::VECTOR_MEMORY, opcode, width, mop, 0, 0,
+                                            opcode == 0b0000111 ? FLAG_LOAD : FLAG_STORE, opcode | (uint32_t(width) << 12) | (uint32_t(mop) << 26),
+                                            0xFC00707Fu | (strided ? 0u : VECTOR_VS2_FIELD)};
+        descriptor.vectorRegisters = VECTOR_VD | SCALAR_RS1 | (strided ? SCALAR_RS2 : 0);
+        return descriptor;
+    }
+
+    // vsetvli keeps an 11-bit vtype in bits 30:20, vsetivli a 10-bit vtype
+    // above a 5-bit AVL in the rs1 field, and vsetvl reads both from x
+    // registers.
+    inline constexpr InstructionDescriptor describeVectorConfig(Instructions instruction, std::string_view mnemonic) {
+        const uint32_t match = OP_V | (uint32_t(OPCFG) << 12);
+        InstructionDescriptor descriptor = {instruction, mnemonic, InstructionType::V, OperandFormat::VECTOR_CONFIG, OP_V, OPCFG, 0, 0, 0x7FF, FLAG_NONE, match, 0x8000707Fu};
+        descriptor.vectorRegisters = SCALAR_RD | SCALAR_RS1;
+        if (instruction == Instructions::VSETIVLI) {
+            descriptor.operands = OperandFormat::VECTOR_CONFIG_IMM;
+            descriptor.immMax = 0x3FF;
+            descriptor.match = match | 0xC0000000u;
+            descriptor.mask = 0xC000707Fu;
+            descriptor.vectorRegisters = SCALAR_RD;
+        } else if (instruction == Instructions::VSETVL) {
+            descriptor.operands = OperandFormat::REG_REG_REG;
+            descriptor.match = match | 0x80000000u;
+            descriptor.mask = 0xFE00707Fu;
+            descriptor.vectorRegisters = SCALAR_RD | SCALAR_RS1 | SCALAR_RS2;
+        }
+        return descriptor;
+    }
+
+    inline constexpr uint8_t FLOAT_ALL = FLOAT_RD | FLOAT_RS1 | FLOAT_RS2;
+    inline constexpr uint32_t VECTOR_UNMASKED = VECTOR_VM_FIELD;
+    inline constexpr uint32_t VECTOR_MOVE_FIELDS = VECTOR_VM_FIELD | VECTOR_VS2_FIELD;
+
+    inline constexpr InstructionDescriptor instructionTable[] = {
+        describeR(Instructions::ADD, "add", 0b000, 0b0000000),
+        describeR(Instructions::SUB, "sub", 0b000, 0b0100000),
+        describeR(Instructions::MUL, "mul", 0b000, 0b0000001),
+        describeR(Instructions::MULH, "mulh", 0b001, 0b0000001),
+        describeR(Instructions::MULHSU, "mulhsu", 0b010, 0b0000001),
+        describeR(Instructions::MULHU, "mulhu", 0b011, 0b0000001),
+        describeR(Instructions::DIV, "div", 0b100, 0b0000001),
+        describeR(Instructions::DIVU, "divu", 0b101, 0b0000001),
+        describeR(Instructions::REM, "rem", 0b110, 0b0000001),
+        describeR(Instructions::REMU, "remu", 0b111, 0b0000001),
+        describeR(Instructions::AND, "and", 0b111, 0b0000000),
+        describeR(Instructions::OR, "or", 0b110, 0b0000000),
+        describeR(Instructions::XOR, "xor", 0b100, 0b0000000),
+        describeR(Instructions::SLL, "sll", 0b001, 0b0000000),
+        describeR(Instructions::SLT, "slt", 0b010, 0b0000000),
+        describeR(Instructions::SLTU, "sltu", 0b011, 0b0000000),
+        describeR(Instructions::SRA, "sra", 0b101, 0b0100000),
+        describeR(Instructions::SRL, "srl", 0b101, 0b0000000),
+        describeI(Instructions::ADDI, "addi", 0b0010011, 0b000, OperandFormat::REG_REG_IMM),
+        describeI(Instructions::ANDI, "andi", 0b0010011, 0b111, OperandFormat::REG_REG_IMM),
+        describeI(Instructions::ORI, "ori", 0b0010011, 0b110, OperandFormat::REG_REG_IMM),
+        describeI(Instructions::XORI, "xori", 0b0010011, 0b100, OperandFormat::REG_REG_IMM),
+        describeI(Instructions::SLTI, "slti", 0b0010011, 0b010, OperandFormat::REG_REG_IMM),
+        describeI(Instructions::SLTIU, "sltiu", 0b0010011, 0b011, OperandFormat::REG_REG_IMM),
+        describeShift(Instructions::SLLI, "slli", 0b001, 0b0000000),
+        describeShift(Instructions::SRLI, "srli", 0b101, 0b0000000),
+        describeShift(Instructions::SRAI, "srai", 0b101, 0b0100000),
+        describeI(Instructions::LB, "lb", 0b0000011, 0b000, OperandFormat::REG_MEM, FLAG_LOAD),
+        describeI(Instructions::LH, "lh", 0b0000011, 0b001, OperandFormat::REG_MEM, FLAG_LOAD),
+        describeI(Instructions::LW, "lw", 0b0000011, 0b010, OperandFormat::REG_MEM, FLAG_LOAD),
+        describeI(Instructions::LBU, "lbu", 0b0000011, 0b100, OperandFormat::REG_MEM, FLAG_LOAD),
+        describeI(Instructions::LHU, "lhu", 0b0000011, 0b101, OperandFormat::REG_MEM, FLAG_LOAD),
+        describeI(Instructions::JALR, "jalr", 0b1100111, 0b000, OperandFormat::REG_REG_IMM, FLAG_JUMP),
+        describeFence(Instructions::FENCE, "fence"),
+        describeSystem(Instructions::ECALL, "ecall", 0x000),
+        describeSystem(Instructions::EBREAK, "ebreak", 0x001),
+        describeS(Instructions::SB, "sb", 0b000),
+        describeS(Instructions::SH, "sh", 0b001),
+        describeS(Instructions::SW, "sw", 0b010),
+        describeSB(Instructions::BEQ, "beq", 0b000),
+        describeSB(Instructions::BNE, "bne", 0b001),
+        describeSB(Instructions::BGE, "bge", 0b101),
+        describeSB(Instructions::BLT, "blt", 0b100),
+        describeSB(Instructions::BLTU, "bltu", 0b110),
+        describeSB(Instructions::BGEU, "bgeu", 0b111),
+        describeU(Instructions::AUIPC, "auipc", 0b0010111),
+        describeU(Instructions::LUI, "lui", 0b0110111),
+        describeUJ(Instructions::JAL, "jal", 0b1101111),
+        bitManipulation(describeR(Instructions::SH1ADD, "sh1add", 0b010, 0b0010000)),
+        bitManipulation(describeR(Instructions::SH2ADD, "sh2add", 0b100, 0b0010000)),
+        bitManipulation(describeR(Instructions::SH3ADD, "sh3add", 0b110, 0b0010000)),
+        bitManipulation(describeR(Instructions::ANDN, "andn", 0b111, 0b0100000)),
+        bitManipulation(describeR(Instructions::ORN, "orn", 0b110, 0b0100000)),
+        bitManipulation(describeR(Instructions::XNOR, "xnor", 0b100, 0b0100000)),
+        describeBitUnary(Instructions::CLZ, "clz", 0b0010011, 0b001, 0b0110000, 0b00000),
+        describeBitUnary(Instructions::CTZ, "ctz", 0b0010011, 0b001, 0b0110000, 0b00001),
+        describeBitUnary(Instructions::CPOP, "cpop", 0b0010011, 0b001, 0b0110000, 0b00010),
+        bitManipulation(describeR(Instructions::MIN, "min", 0b100, 0b0000101)),
+        bitManipulation(describeR(Instructions::MINU, "minu", 0b101, 0b0000101)),
+        bitManipulation(describeR(Instructions::MAX, "max", 0b110, 0b0000101)),
+        bitManipulation(describeR(Instructions::MAXU, "maxu", 0b111, 0b0000101)),
+        describeBitUnary(Instructions::SEXT_B, "sext.b", 0b0010011, 0b001, 0b0110000, 0b00100),
+        describeBitUnary(Instructions::SEXT_H, "sext.h", 0b0010011, 0b001, 0b0110000, 0b00101),
+        describeBitUnary(Instructions::ZEXT_H, "zext.h", 0b0110011, 0b100, 0b0000100, 0b00000),
+        bitManipulation(describeR(Instructions::ROL, "rol", 0b001, 0b0110000)),
+        bitManipulation(describeR(Instructions::ROR, "ror", 0b101, 0b0110000)),
+        bitManipulation(describeShift(Instructions::RORI, "rori", 0b101, 0b0110000)),
+        describeBitUnary(Instructions::REV8, "rev8", 0b0010011, 0b101, 0b0110100, 0b11000),
+        describeBitUnary(Instructions::ORC_B, "orc.b", 0b0010011, 0b101, 0b0010100, 0b00111),
+        bitManipulation(describeR(Instructions::BCLR, "bclr", 0b001, 0b0100100)),
+        bitManipulation(describeShift(Instructions::BCLRI, "bclri", 0b001, 0b0100100)),
+        bitManipulation(describeR(Instructions::BEXT, "bext", 0b101, 0b0100100)),
+        bitManipulation(describeShift(Instructions::BEXTI, "bexti", 0b101, 0b0100100)),
+        bitManipulation(describeR(Instructions::BINV, "binv", 0b001, 0b0110100)),
+        bitManipulation(describeShift(Instructions::BINVI, "binvi", 0b001, 0b0110100)),
+        bitManipulation(describeR(Instructions::BSET, "bset", 0b001, 0b0010100)),
+        bitManipulation(describeShift(Instructions::BSETI, "bseti", 0b001, 0b0010100)),
+        describeCsr(Instructions::CSRRW, "csrrw", 0b001),
+        describeCsr(Instructions::CSRRS, "csrrs", 0b010),
+        describeCsr(Instructions::CSRRC, "csrrc", 0b011),
+        describeCsr(Instructions::CSRRWI, "csrrwi", 0b101),
+        describeCsr(Instructions::CSRRSI, "csrrsi", 0b110),
+        describeCsr(Instructions::CSRRCI, "csrrci", 0b111),
+        inFloatFile(describeI(Instructions::FLW, "flw", 0b0000111, 0b010, OperandFormat::REG_MEM, FLAG_LOAD), FLOAT_RD),
+        inFloatFile(describeS(Instructions::FSW, "fsw", 0b010, 0b0100111), FLOAT_RS2),
+        describeFloat(Instructions::FADD_S, "fadd.s", 0b0000000, OperandFormat::REG_REG_REG, FLOAT_ALL, FloatUnit::ADD, FLAG_ROUNDING),
+        describeFloat(Instructions::FSUB_S, "fsub.s", 0b0000100, OperandFormat::REG_REG_REG, FLOAT_ALL, FloatUnit::ADD, FLAG_ROUNDING),
+        describeFloat(Instructions::FMUL_S, "fmul.s", 0b0001000, OperandFormat::REG_REG_REG, FLOAT_ALL, FloatUnit::MULTIPLY, FLAG_ROUNDING),
+        describeFloat(Instructions::FDIV_S, "fdiv.s", 0b0001100, OperandFormat::REG_REG_REG, FLOAT_ALL, FloatUnit::DIVIDE, FLAG_ROUNDING),
+        describeFloat(Instructions::FSQRT_S, "fsqrt.s", 0b0101100, OperandFormat::REG_REG, FLOAT_RD | FLOAT_RS1, FloatUnit::SQUARE_ROOT, FLAG_ROUNDING),
+        describeFloat(Instructions::FSGNJ_S, "fsgnj.s", 0b0010000, OperandFormat::REG_REG_REG, FLOAT_ALL, FloatUnit::OTHER, FLAG_NONE, 0b000),
+        describeFloat(Instructions::FSGNJN_S, "fsgnjn.s", 0b0010000, OperandFormat::REG_REG_REG, FLOAT_ALL, FloatUnit::OTHER, FLAG_NONE, 0b001),
+        describeFloat(Instructions::FSGNJX_S, "fsgnjx.s", 0b0010000, OperandFormat::REG_REG_REG, FLOAT_ALL, FloatUnit::OTHER, FLAG_NONE, 0b010),
+        describeFloat(Instructions::FMIN_S, "fmin.s", 0b0010100, OperandFormat::REG_REG_REG, FLOAT_ALL, FloatUnit::OTHER, FLAG_NONE, 0b000),
+        describeFloat(Instructions::FMAX_S, "fmax.s", 0b0010100, OperandFormat::REG_REG_REG, FLOAT_ALL, FloatUnit::OTHER, FLAG_NONE, 0b001),
+        describeFloat(Instructions::FCVT_W_S, "fcvt.w.s", 0b1100000, OperandFormat::REG_REG, FLOAT_RS1, FloatUnit::CONVERT, FLAG_ROUNDING, 0, 0),
+        describeFloat(Instructions::FCVT_WU_S, "fcvt.wu.s", 0b1100000, OperandFormat::REG_REG, FLOAT_RS1, FloatUnit::CONVERT, FLAG_ROUNDING, 0, 1),
+        describeFloat(Instructions::FMV_X_W, "fmv.x.w", 0b1110000, OperandFormat::REG_REG, FLOAT_RS1, FloatUnit::OTHER, FLAG_NONE, 0b000),
+        describeFloat(Instructions::FEQ_S, "feq.s", 0b1010000, OperandFormat::REG_REG_REG, FLOAT_RS1 | FLOAT_RS2, FloatUnit::OTHER, FLAG_NONE, 0b010),
+        describeFloat(Instructions::FLT_S, "flt.s", 0b1010000, OperandFormat::REG_REG_REG, FLOAT_RS1 | FLOAT_RS2, FloatUnit::OTHER, FLAG_NONE, 0b001),
+        describeFloat(Instructions::FLE_S, "fle.s", 0b1010000, OperandFormat::REG_REG_REG, FLOAT_RS1 | FLOAT_RS2, FloatUnit::OTHER, FLAG_NONE, 0b000),
+        describeFloat(Instructions::FCLASS_S, "fclass.s", 0b1110000, OperandFormat::REG_REG, FLOAT_RS1, FloatUnit::OTHER, FLAG_NONE, 0b001),
+        describeFloat(Instructions::FCVT_S_W, "fcvt.s.w", 0b1101000, OperandFormat::REG_REG, FLOAT_RD, FloatUnit::CONVERT, FLAG_ROUNDING, 0, 0),
+        describeFloat(Instructions::FCVT_S_WU, "fcvt.s.wu", 0b1101000, OperandFormat::REG_REG, FLOAT_RD, FloatUnit::CONVERT, FLAG_ROUNDING, 0, 1),
+        describeFloat(Instructions::FMV_W_X, "fmv.w.x", 0b1111000, OperandFormat::REG_REG, FLOAT_RD, FloatUnit::OTHER, FLAG_NONE, 0b000),
+        describeFused(Instructions::FMADD_S, "fmadd.s", 0b1000011),
+        describeFused(Instructions::FMSUB_S, "fmsub.s", 0b1000111),
+        describeFused(Instructions::FNMSUB_S, "fnmsub.s", 0b1001011),
+        describeFused(Instructions::FNMADD_S, "fnmadd.s", 0b1001111),
+        describeVectorConfig(Instructions::VSETVLI, "vsetvli"),
+        describeVectorConfig(Instructions::VSETIVLI, "vsetivli"),
+        describeVectorConfig(Instructions::VSETVL, "vsetvl"),
+        describeVectorMemory(Instructions::VLE8_V, "vle8.v", 0b0000111, 0b000, false),
+        describeVectorMemory(Instructions::VLE16_V, "vle16.v", 0b0000111, 0b101, false),
+        describeVectorMemory(Instructions::VLE32_V, "vle32.v", 0b0000111, 0b110, false),
+        describeVectorMemory(Instructions::VSE8_V, "vse8.v", 0b0100111, 0b000, false),
+        describeVectorMemory(Instructions::VSE16_V, "vse16.v", 0b0100111, 0b101, false),
+        describeVectorMemory(Instructions::VSE32_V, "vse32.v", 0b0100111, 0b110, false),
+        describeVectorMemory(Instructions::VLSE8_V, "vlse8.v", 0b0000111, 0b000, true),
+        describeVectorMemory(Instructions::VLSE16_V, "vlse16.v", 0b0000111, 0b101, true),
+        describeVectorMemory(Instructions::VLSE32_V, "vlse32.v", 0b0000111, 0b110, true),
+        describeVectorMemory(Instructions::VSSE8_V, "vsse8.v", 0b0100111, 0b000, true),
+        describeVectorMemory(Instructions::VSSE16_V, "vsse16.v", 0b0100111, 0b101, true),
+        describeVectorMemory(Instructions::VSSE32_V, "vsse32.v", 0b0100111, 0b110, true),
+        describeVector(Instructions::VADD_VV, "vadd.vv", 0b000000, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VADD_VX, "vadd.vx", 0b000000, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VADD_VI, "vadd.vi", 0b000000, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VSUB_VV, "vsub.vv", 0b000010, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VSUB_VX, "vsub.vx", 0b000010, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VRSUB_VX, "vrsub.vx", 0b000011, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VRSUB_VI, "vrsub.vi", 0b000011, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMINU_VV, "vminu.vv", 0b000100, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMINU_VX, "vminu.vx", 0b000100, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMIN_VV, "vmin.vv", 0b000101, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMIN_VX, "vmin.vx", 0b000101, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMAXU_VV, "vmaxu.vv", 0b000110, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMAXU_VX, "vmaxu.vx", 0b000110, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMAX_VV, "vmax.vv", 0b000111, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMAX_VX, "vmax.vx", 0b000111, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VAND_VV, "vand.vv", 0b001001, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VAND_VX, "vand.vx", 0b001001, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VAND_VI, "vand.vi", 0b001001, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VOR_VV, "vor.vv", 0b001010, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VOR_VX, "vor.vx", 0b001010, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VOR_VI, "vor.vi", 0b001010, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VXOR_VV, "vxor.vv", 0b001011, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VXOR_VX, "vxor.vx", 0b001011, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VXOR_VI, "vxor.vi", 0b001011, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VSLL_VV, "vsll.vv", 0b100101, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VSLL_VX, "vsll.vx", 0b100101, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VSLL_VI, "vsll.vi", 0b100101, OPIVI, OperandFormat::VECTOR_BINARY, 0, 0, 0, 31),
+        describeVector(Instructions::VSRL_VV, "vsrl.vv", 0b101000, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VSRL_VX, "vsrl.vx", 0b101000, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VSRL_VI, "vsrl.vi", 0b101000, OPIVI, OperandFormat::VECTOR_BINARY, 0, 0, 0, 31),
+        describeVector(Instructions::VSRA_VV, "vsra.vv", 0b101001, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VSRA_VX, "vsra.vx", 0b101001, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VSRA_VI, "vsra.vi", 0b101001, OPIVI, OperandFormat::VECTOR_BINARY, 0, 0, 0, 31),
+        describeVector(Instructions::VMSEQ_VV, "vmseq.vv", 0b011000, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSEQ_VX, "vmseq.vx", 0b011000, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSEQ_VI, "vmseq.vi", 0b011000, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSNE_VV, "vmsne.vv", 0b011001, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSNE_VX, "vmsne.vx", 0b011001, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSNE_VI, "vmsne.vi", 0b011001, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSLTU_VV, "vmsltu.vv", 0b011010, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSLTU_VX, "vmsltu.vx", 0b011010, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSLT_VV, "vmslt.vv", 0b011011, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSLT_VX, "vmslt.vx", 0b011011, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSLEU_VV, "vmsleu.vv", 0b011100, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSLEU_VX, "vmsleu.vx", 0b011100, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSLEU_VI, "vmsleu.vi", 0b011100, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSLE_VV, "vmsle.vv", 0b011101, OPIVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSLE_VX, "vmsle.vx", 0b011101, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSLE_VI, "vmsle.vi", 0b011101, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSGTU_VX, "vmsgtu.vx", 0b011110, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSGTU_VI, "vmsgtu.vi", 0b011110, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSGT_VX, "vmsgt.vx", 0b011111, OPIVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMSGT_VI, "vmsgt.vi", 0b011111, OPIVI, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMERGE_VVM, "vmerge.vvm", 0b010111, OPIVV, OperandFormat::VECTOR_MERGE, 0, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMERGE_VXM, "vmerge.vxm", 0b010111, OPIVX, OperandFormat::VECTOR_MERGE, 0, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMERGE_VIM, "vmerge.vim", 0b010111, OPIVI, OperandFormat::VECTOR_MERGE, 0, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMV_V_V, "vmv.v.v", 0b010111, OPIVV, OperandFormat::VECTOR_UNARY, VECTOR_UNMASKED, VECTOR_MOVE_FIELDS),
+        describeVector(Instructions::VMV_V_X, "vmv.v.x", 0b010111, OPIVX, OperandFormat::VECTOR_UNARY, VECTOR_UNMASKED, VECTOR_MOVE_FIELDS),
+        describeVector(Instructions::VMV_V_I, "vmv.v.i", 0b010111, OPIVI, OperandFormat::VECTOR_UNARY, VECTOR_UNMASKED, VECTOR_MOVE_FIELDS),
+        describeVector(Instructions::VMUL_VV, "vmul.vv", 0b100101, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMUL_VX, "vmul.vx", 0b100101, OPMVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMULH_VV, "vmulh.vv", 0b100111, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMULH_VX, "vmulh.vx", 0b100111, OPMVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMULHU_VV, "vmulhu.vv", 0b100100, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMULHU_VX, "vmulhu.vx", 0b100100, OPMVX, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMACC_VV, "vmacc.vv", 0b101101, OPMVV, OperandFormat::VECTOR_MULTIPLY_ADD),
+        describeVector(Instructions::VMACC_VX, "vmacc.vx", 0b101101, OPMVX, OperandFormat::VECTOR_MULTIPLY_ADD),
+        describeVector(Instructions::VREDSUM_VS, "vredsum.vs", 0b000000, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VREDAND_VS, "vredand.vs", 0b000001, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VREDOR_VS, "vredor.vs", 0b000010, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VREDXOR_VS, "vredxor.vs", 0b000011, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VREDMINU_VS, "vredminu.vs", 0b000100, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VREDMIN_VS, "vredmin.vs", 0b000101, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VREDMAXU_VS, "vredmaxu.vs", 0b000110, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VREDMAX_VS, "vredmax.vs", 0b000111, OPMVV, OperandFormat::VECTOR_BINARY),
+        describeVector(Instructions::VMANDN_MM, "vmandn.mm", 0b011000, OPMVV, OperandFormat::VECTOR_BINARY, VECTOR_UNMASKED, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMAND_MM, "vmand.mm", 0b011001, OPMVV, OperandFormat::VECTOR_BINARY, VECTOR_UNMASKED, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMOR_MM, "vmor.mm", 0b011010, OPMVV, OperandFormat::VECTOR_BINARY, VECTOR_UNMASKED, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMXOR_MM, "vmxor.mm", 0b011011, OPMVV, OperandFormat::VECTOR_BINARY, VECTOR_UNMASKED, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMORN_MM, "vmorn.mm", 0b011100, OPMVV, OperandFormat::VECTOR_BINARY, VECTOR_UNMASKED, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMNAND_MM, "vmnand.mm", 0b011101, OPMVV, OperandFormat::VECTOR_BINARY, VECTOR_UNMASKED, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMNOR_MM, "vmnor.mm", 0b011110, OPMVV, OperandFormat::VECTOR_BINARY, VECTOR_UNMASKED, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMXNOR_MM, "vmxnor.mm", 0b011111, OPMVV, OperandFormat::VECTOR_BINARY, VECTOR_UNMASKED, VECTOR_VM_FIELD),
+        describeVector(Instructions::VMV_X_S, "vmv.x.s", 0b010000, OPMVV, OperandFormat::VECTOR_TO_SCALAR, VECTOR_UNMASKED, VECTOR_VM_FIELD | VECTOR_VS1_FIELD),
+        describeVector(Instructions::VMV_S_X, "vmv.s.x", 0b010000, OPMVX, OperandFormat::VECTOR_UNARY, VECTOR_UNMASKED, VECTOR_MOVE_FIELDS),
+        describeVector(Instructions::VCPOP_M, "vcpop.m", 0b010000, OPMVV, OperandFormat::VECTOR_TO_SCALAR, 0b10000u << 15, VECTOR_VS1_FIELD),
+        describeVector(Instructions::VFIRST_M, "vfirst.m", 0b010000, OPMVV, OperandFormat::VECTOR_TO_SCALAR, 0b10001u << 15, VECTOR_VS1_FIELD),
+        describeVector(Instructions::VID_V, "vid.v", 0b010100, OPMVV, OperandFormat::VECTOR_INDEX, 0b10001u << 15, VECTOR_VS1_FIELD | VECTOR_VS2_FIELD)
+    };
+
+    inline constexpr size_t instructionCount = sizeof(instructionTable) / sizeof(instructionTable[0]);
+
+    inline constexpr bool instructionTableMatchesEnum() {
+        if (instructionCount != static_cast<size_t>(Instructions::INVALID)) return false;
+        for (size_t i = 0; i < instructionCount; ++i) {
+            if (static_cast<size_t>(instructionTable[i].instruction) != i) return false;
+        }
+        return true;
+    }
+
+    static_assert(instructionTableMatchesEnum(), "instructionTable must list every Instructions value in enum order");
+
+    // Instructions registered at start-up (custom.hpp) are numbered after
+    // INVALID and described here, outside the constexpr tables.
+    inline constexpr bool isCustomInstruction(Instructions instruction) {
+        return instruction > Instructions::INVALID;
+    }
+
+    inline constexpr size_t customIndexOf(Instructions instruction) {
+        return static_cast<size_t>(instruction) - static_cast<size_t>(Instructions::INVALID) - 1;
+    }
+
+    inline std::deque<InstructionDescriptor>& customInstructionTable() {
+        static std::deque<InstructionDescriptor> table;
+        return table;
+    }
+
+    inline Instructions lookupCustomInstruction(std::string_view mnemonic) {
+        for (const InstructionDescriptor& descriptor : customInstructionTable()) {
+            if (descriptor.mnemonic == mnemonic) return descriptor.instruction;
+        }
+        return Instructions::INVALID;
+    }
+
+    inline constexpr const InstructionDescriptor& describe(Instructions instruction) {
+        return isCustomInstruction(instruction) ? customInstructionTable()[customIndexOf(instruction)]
+                                                : instructionTable[static_cast<size_t>(instruction)];
+    }
+
+    inline constexpr size_t maxDecodeCandidates = 32;
+
+    struct DecodeTable {
+        std::array<uint8_t, 1024> count;
+        std::array<std::array<uint8_t, maxDecodeCandidates>, 1024> candidates;
+
+        static constexpr size_t slotOf(uint32_t word) { return (word & 0x7F) | (((word >> 12) & 0x7) << 7); }
+
+        constexpr DecodeTable() : count(), candidates() {
+            for (uint32_t slot = 0; slot < 1024; ++slot) {
+                uint32_t probe = (slot & 0x7F) | ((slot >> 7) << 12);
+                for (size_t i = 0; i < instructionCount; ++i) {
+                    if ((probe & instructionTable[i].mask & 0x707Fu) == (instructionTable[i].match & 0x707Fu)) {
+                        if (count[slot] == maxDecodeCandidates) throw "decode table slot overflow";
+                        candidates[slot][count[slot]++] = static_cast<uint8_t>(i);
+                    }
+                }
+            }
+        }
+    };
+
+    inline constexpr DecodeTable decodeTable{};
+
+    inline Instructions decodeCustomInstruction(uint32_t word) {
+        for (const InstructionDescriptor& descriptor : customInstructionTable()) {
+            if ((word & descriptor.mask) == descriptor.match) {
+                return descriptor.instruction;
+            }
+        }
+        return Instructions::INVALID;
+    }
+
+    inline constexpr Instructions decodeInstructionWord(uint32_t word) {
+        const size_t slot = DecodeTable::slotOf(word);
+        for (size_t i = 0; i < decodeTable.count[slot]; ++i) {
+            const InstructionDescriptor& descriptor = instructionTable[decodeTable.candidates[slot][i]];
+            if ((word & descriptor.mask) == descriptor.match) {
+                return descriptor.instruction;
+            }
+        }
+        return decodeCustomInstruction(word);
+    }
+
+    inline constexpr uint32_t encodeInstruction(const InstructionDescriptor& descriptor, uint32_t rd, uint32_t rs1, uint32_t rs2, int32_t imm, uint32_t rs3 = 0) {
+        const uint32_t immediate = static_cast<uint32_t>(imm);
+        switch (descriptor.format) {
+            case InstructionType::R:
+                return descriptor.match | (rs2 << 20) | (rs1 << 15) | (rd << 7);
+            case InstructionType::R4:
+                return descriptor.match | (rs3 << 27) | (rs2 << 20) | (rs1 << 15) | (rd << 7);
+            case InstructionType::I:
+                return descriptor.match | ((immediate & 0xFFF) << 20) | (rs1 << 15) | (rd << 7);
+            case InstructionType::S:
+                return descriptor.match | (((immediate >> 5) & 0x7F) << 25) | (rs2 << 20) | (rs1 << 15) | ((immediate & 0x1F) << 7);
+            case InstructionType::SB:
+                return descriptor.match | (((immediate >> 12) & 0x1) << 31) | (((immediate >> 5) & 0x3F) << 25) | (rs2 << 20) |
+                       (rs1 << 15) | (((immediate >> 1) & 0xF) << 8) | (((immediate >> 11) & 0x1) << 7);
+            case InstructionType::U:
+                return descriptor.match | ((immediate & 0xFFFFF) << 12) | (rd << 7);
+            case InstructionType::UJ:
+                return descriptor.match | (((immediate >> 20) & 0x1) << 31) | (((immediate >> 1) & 0x3FF) << 21) |
+                       (((immediate >> 11) & 0x1) << 20) | (((immediate >> 12) & 0xFF) << 12) | (rd << 7);
+            case InstructionType::V:
+                // imm is the vm bit; rs2 carries vtypei for vsetvli and vsetivli.
+                return descriptor.match | ((immediate & 0x1) << 25) | (rs2 << 20) | ((rs1 & 0x1F) << 15) | (rd << 7);
+        }
+        return 0;
+    }
+
+    inline constexpr int32_t decodeImmediate(InstructionType format, uint32_t word) {
+        switch (format) {
+            case InstructionType::I:
+                return static_cast<int32_t>(word) >> 20;
+            case InstructionType::S:
+                return (static_cast<int32_t>(word & 0xFE000000) >> 20) | static_cast<int32_t>((word >> 7) & 0x1F);
+            case InstructionType::SB:
+                return (static_cast<int32_t>(word & 0x80000000) >> 19) | static_cast<int32_t>(((word >> 7) & 0x1) << 11) |
+                       static_cast<int32_t>(((word >> 25) & 0x3F) << 5) | static_cast<int32_t>(((word >> 8) & 0xF) << 1);
+            case InstructionType::U:
+                return static_cast<int32_t>(word & 0xFFFFF000);
+            case InstructionType::UJ:
+                return (static_cast<int32_t>(word & 0x80000000) >> 11) | static_cast<int32_t>(((word >> 12) & 0xFF) << 12) |
+                       static_cast<int32_t>(((word >> 20) & 0x1) << 11) | static_cast<int32_t>(((word >> 21) & 0x3FF) << 1);
+            default:
+                return 0;
+        }
+    }
+
+    // The operands of a V instruction in assembler order, for disassembly.
+    // MASK is a trailing v0.t and CARRY the v0 selector of vmerge.
+    enum class VectorOperandKind : uint8_t { VECTOR, SCALAR, IMMEDIATE, TYPE, BASE, MASK, CARRY };
+
+    struct VectorOperand {
+        VectorOperandKind kind;
+        uint32_t value;
+    };
+
+    inline constexpr size_t vectorOperandsOf(const InstructionDescriptor& descriptor, uint32_t word, std::array<VectorOperand, 5>& operands) {
+        const uint32_t rd = (word >> 7) & 0x1F, rs1 = (word >> 15) & 0x1F, rs2 = (word >> 20) & 0x1F;
+        size_t count = 0;
+        auto push = [&](VectorOperandKind kind, uint32_t value) { operands[count++] = {kind, value}; };
+        auto pushSource1 = [&]() {
+            if (descriptor.vectorRegisters & VECTOR_VS1) push(VectorOperandKind::VECTOR, rs1);
+            else if (descriptor.vectorRegisters & SCALAR_RS1) push(VectorOperandKind::SCALAR, rs1);
+            else push(VectorOperandKind::IMMEDIATE, descriptor.immMin < 0 ? static_cast<uint32_t>(static_cast<int32_t>(word << 12) >> 27) : rs1);
+        };
+
+        switch (descriptor.operands) {
+            case OperandFormat::VECTOR_CONFIG:
+            case OperandFormat::VECTOR_CONFIG_IMM:
+                push(VectorOperandKind::SCALAR, rd);
+                push(descriptor.operands == OperandFormat::VECTOR_CONFIG ? VectorOperandKind::SCALAR : VectorOperandKind::IMMEDIATE, rs1);
+                push(VectorOperandKind::TYPE, (word >> 20) & static_cast<uint32_t>(descriptor.immMax));
+                return count;
+            case OperandFormat::REG_REG_REG:
+                push(VectorOperandKind::SCALAR, rd);
+                push(VectorOperandKind::SCALAR, rs1);
+                push(VectorOperandKind::SCALAR, rs2);
+                return count;
+            case OperandFormat::VECTOR_MEMORY:
+            case OperandFormat::VECTOR_STRIDED:
+                push(VectorOperandKind::VECTOR, rd);
+                push(VectorOperandKind::BASE, rs1);
+                if (descriptor.operands == OperandFormat::VECTOR_STRIDED) push(VectorOperandKind::SCALAR, rs2);
+                break;
+            case OperandFormat::VECTOR_MULTIPLY_ADD:
+                push(VectorOperandKind::VECTOR, rd);
+                pushSource1();
+                push(VectorOperandKind::VECTOR, rs2);
+                break;
+            case OperandFormat::VECTOR_TO_SCALAR:
+                push(VectorOperandKind::SCALAR, rd);
+                push(VectorOperandKind::VECTOR, rs2);
+                break;
+            case OperandFormat::VECTOR_INDEX:
+                push(VectorOperandKind::VECTOR, rd);
+                break;
+            case OperandFormat::VECTOR_UNARY:
+                push(VectorOperandKind::VECTOR, rd);
+                pushSource1();
+                break;
+            default:
+                push(VectorOperandKind::VECTOR, rd);
+                push(VectorOperandKind::VECTOR, rs2);
+                pushSource1();
+                if (descriptor.operands == OperandFormat::VECTOR_MERGE) push(VectorOperandKind::CARRY, 0);
+                break;
+        }
+        if (!(descriptor.mask & VECTOR_VM_FIELD) && !(word & VECTOR_VM_FIELD)) push(VectorOperandKind::MASK, 0);
+        return count;
+    }
+
+    // fence predecessor and successor sets are written as a subset of "iorw"
+    // in that order and encoded as four bits each, i being the highest.
+    inline constexpr std::string_view fenceSetLetters = "iorw";
+
+    inline constexpr int32_t parseFenceSet(std::string_view set) {
+        int32_t bits = 0;
+        size_t next = 0;
+        for (char c : set) {
+            while (next < fenceSetLetters.size() && fenceSetLetters[next] != c) ++next;
+            if (next == fenceSetLetters.size()) return -1;
+            bits |= 0x8 >> next++;
+        }
+        return set.empty() ? -1 : bits;
+    }
+
+    enum class PseudoInstructions : uint8_t {
+        NOP, LI, LA, MV, NOT, NEG, SGTZ, SLTZ, SEQZ, SNEZ,
+        J, JAL, JR, JALR, RET, CALL, TAIL,
+        BEQZ, BNEZ, BLEZ, BGEZ, BLTZ, BGTZ, BGT, BLE, BGTU, BLEU,
+        CSRR, CSRW, FRCSR, FSCSR, FRRM, FSRM, FRFLAGS, FSFLAGS, FMV_S, FABS_S, FNEG_S,
+        INVALID
+    };
+
+    // A pseudo-instruction expands in the parser to `length` base instructions;
+    // a length of 0 means it depends on the operands (li). Entries that share a
+    // base mnemonic (jal, jalr) are told apart by their operand count.
+    struct PseudoDescriptor {
+        PseudoInstructions pseudo;
+        std::string_view mnemonic;
+        uint8_t operands;
+        uint8_t length;
+    };
+
+    inline constexpr PseudoDescriptor pseudoTable[] = {
+        {PseudoInstructions::NOP, "nop", 0, 1}, {PseudoInstructions::LI, "li", 2, 0}, {PseudoInstructions::LA, "la", 2, 2},
+        {PseudoInstructions::MV, "mv", 2, 1}, {PseudoInstructions::NOT, "not", 2, 1}, {PseudoInstructions::NEG, "neg", 2, 1},
+        {PseudoInstructions::SGTZ, "sgtz", 2, 1}, {PseudoInstructions::SLTZ, "sltz", 2, 1}, {PseudoInstructions::SEQZ, "seqz", 2, 1},
+        {PseudoInstructions::SNEZ, "snez", 2, 1}, {PseudoInstructions::J, "j", 1, 1}, {PseudoInstructions::JAL, "jal", 1, 1},
+        {PseudoInstructions::JR, "jr", 1, 1}, {PseudoInstructions::JALR, "jalr", 1, 1}, {PseudoInstructions::RET, "ret", 0, 1},
+        {PseudoInstructions::CALL, "call", 1, 2}, {PseudoInstructions::TAIL, "tail", 1, 2}, {PseudoInstructions::BEQZ, "beqz", 2, 1},
+        {PseudoInstructions::BNEZ, "bnez", 2, 1}, {PseudoInstructions::BLEZ, "blez", 2, 1}, {PseudoInstructions::BGEZ, "bgez", 2, 1},
+        {PseudoInstructions::BLTZ, "bltz", 2, 1}, {PseudoInstructions::BGTZ, "bgtz", 2, 1}, {PseudoInstructions::BGT, "bgt", 3, 1},
+        {PseudoInstructions::BLE, "ble", 3, 1}, {PseudoInstructions::BGTU, "bgtu", 3, 1}, {PseudoInstructions::BLEU, "bleu", 3, 1},
+        {PseudoInstructions::CSRR, "csrr", 2, 1}, {PseudoInstructions::CSRW, "csrw", 2, 1}, {PseudoInstructions::FRCSR, "frcsr", 1, 1},
+        {PseudoInstructions::FSCSR, "fscsr", 1, 1}, {PseudoInstructions::FRRM, "frrm", 1, 1}, {PseudoInstructions::FSRM, "fsrm", 1, 1},
+        {PseudoInstructions::FRFLAGS, "frflags", 1, 1}, {PseudoInstructions::FSFLAGS, "fsflags", 1, 1}, {PseudoInstructions::FMV_S, "fmv.s", 2, 1},
+        {PseudoInstructions::FABS_S, "fabs.s", 2, 1}, {PseudoInstructions::FNEG_S, "fneg.s", 2, 1}
+    };
+
+    inline constexpr size_t pseudoCount = sizeof(pseudoTable) / sizeof(pseudoTable[0]);
+
+    inline constexpr bool pseudoTableMatchesEnum() {
+        if (pseudoCount != static_cast<size_t>(PseudoInstructions::INVALID)) return false;
+        for (size_t i = 0; i < pseudoCount; ++i) {
+            if (static_cast<size_t>(pseudoTable[i].pseudo) != i) return false;
+        }
+        return true;
+    }
+
+    static_assert(pseudoTableMatchesEnum(), "pseudoTable must list every PseudoInstructions value in enum order");
+
+    inline constexpr bool isBaseMnemonic(std::string_view mnemonic) {
+        for (const InstructionDescriptor& descriptor : instructionTable) {
+            if (descriptor.mnemonic == mnemonic) return true;
+        }
+        return false;
+    }
+
+    inline constexpr size_t pseudoKeywordCount = [] {
+        size_t count = 0;
+        for (const PseudoDescriptor& pseudo : pseudoTable) {
+            if (!isBaseMnemonic(pseudo.mnemonic)) ++count;
+        }
+        return count;
+    }();
+
+    // Splits a 32-bit value into the lui/auipc upper immediate and the signed
+    // 12-bit remainder added after it; the upper part is rounded so that the
+    // sign-extended remainder carries back to the exact value.
+    inline constexpr int32_t upperImmediate(int32_t value) {
+        return static_cast<int32_t>(((static_cast<uint32_t>(value) + 0x800) >> 12) & 0xFFFFF);
+    }
+
+    inline constexpr int32_t lowerImmediate(int32_t value) {
+        return static_cast<int32_t>(static_cast<uint32_t>(value) << 20) >> 20;
+    }
+
+    inline constexpr uint32_t loadImmediateLength(int32_t value) {
+        return (lowerImmediate(value) == value || lowerImmediate(value) == 0) ? 1 : 2;
+    }
+
+    // Compressed forms are written with the operands of the base instruction
+    // they alias, minus those the form implies: `implied` is the register the
+    // form fills in, or SAME_AS_RD where it repeats the destination.
+    enum class CompressedShape : uint8_t { NONE, JUMP_REG, REG_REG, REG_IMM, UPPER, BASE, BRANCH, JUMP };
+
+    inline constexpr uint8_t SAME_AS_RD = 0xFF;
+
+    struct CompressedDescriptor {
+        std::string_view mnemonic;
+        Instructions base;
+        CompressedShape shape;
+        uint8_t implied;
+    };
+
+    inline constexpr CompressedDescriptor compressedTable[] = {
+        {"c.nop", Instructions::ADDI, CompressedShape::NONE, 0}, {"c.ebreak", Instructions::EBREAK, CompressedShape::NONE, 0},
+        {"c.jr", Instructions::JALR, CompressedShape::JUMP_REG, 0}, {"c.jalr", Instructions::JALR, CompressedShape::JUMP_REG, 1},
+        {"c.mv", Instructions::ADD, CompressedShape::REG_REG, 0}, {"c.add", Instructions::ADD, CompressedShape::REG_REG, SAME_AS_RD},
+        {"c.sub", Instructions::SUB, CompressedShape::REG_REG, SAME_AS_RD}, {"c.xor", Instructions::XOR, CompressedShape::REG_REG, SAME_AS_RD},
+        {"c.or", Instructions::OR, CompressedShape::REG_REG, SAME_AS_RD}, {"c.and", Instructions::AND, CompressedShape::REG_REG, SAME_AS_RD},
+        {"c.li", Instructions::ADDI, CompressedShape::REG_IMM, 0}, {"c.addi", Instructions::ADDI, CompressedShape::REG_IMM, SAME_AS_RD},
+        {"c.addi16sp", Instructions::ADDI, CompressedShape::REG_IMM, SAME_AS_RD}, {"c.andi", Instructions::ANDI, CompressedShape::REG_IMM, SAME_AS_RD},
+        {"c.slli", Instructions::SLLI, CompressedShape::REG_IMM, SAME_AS_RD}, {"c.srli", Instructions::SRLI, CompressedShape::REG_IMM, SAME_AS_RD},
+        {"c.srai", Instructions::SRAI, CompressedShape::REG_IMM, SAME_AS_RD}, {"c.lui", Instructions::LUI, CompressedShape::UPPER, 0},
+        {"c.addi4spn", Instructions::ADDI, CompressedShape::BASE, 0}, {"c.lw", Instructions::LW, CompressedShape::BASE, 0},
+        {"c.lwsp", Instructions::LW, CompressedShape::BASE, 0}, {"c.sw", Instructions::SW, CompressedShape::BASE, 0},
+        {"c.swsp", Instructions::SW, CompressedShape::BASE, 0}, {"c.flw", Instructions::FLW, CompressedShape::BASE, 0},
+        {"c.flwsp", Instructions::FLW, CompressedShape::BASE, 0}, {"c.fsw", Instructions::FSW, CompressedShape::BASE, 0},
+        {"c.fswsp", Instructions::FSW, CompressedShape::BASE, 0}, {"c.beqz", Instructions::BEQ, CompressedShape::BRANCH, 0},
+        {"c.bnez", Instructions::BNE, CompressedShape::BRANCH, 0}, {"c.j", Instructions::JAL, CompressedShape::JUMP, 0},
+        {"c.jal", Instructions::JAL, CompressedShape::JUMP, 1}
+    };
+
+    inline constexpr size_t compressedCount = sizeof(compressedTable) / sizeof(compressedTable[0]);
+
+    enum class KeywordKind : uint8_t { OPCODE, REGISTER, DIRECTIVE, PSEUDO, COMPRESSED, FLOAT_REGISTER, CSR, ROUNDING_MODE, VECTOR_REGISTER, VECTOR_TYPE };
+
+    struct Keyword {
+        std::string_view name;
+        KeywordKind kind;
+        int32_t value;
+    };
+
+    inline constexpr Keyword directiveKeywords[] = {
+        {".text", KeywordKind::DIRECTIVE, 0}, {".data", KeywordKind::DIRECTIVE, 0}, {".word", KeywordKind::DIRECTIVE, 4},
+        {".byte", KeywordKind::DIRECTIVE, 1}, {".half", KeywordKind::DIRECTIVE, 2}, {".dword", KeywordKind::DIRECTIVE, 8},
+        {".asciz", KeywordKind::DIRECTIVE, 1}, {".asciiz", KeywordKind::DIRECTIVE, 1}, {".ascii", KeywordKind::DIRECTIVE, 1},
+        {".globl", KeywordKind::DIRECTIVE, 0}, {".global", KeywordKind::DIRECTIVE, 0}, {".option", KeywordKind::DIRECTIVE, 0},
+        {".float", KeywordKind::DIRECTIVE, 4}
     };
 
-    inline const std::unordered_set<std::string> opcodes = {
-        "add", "sub", "mul", "div", "rem", "and", "or", "xor", "sll", "slt", "sra", "srl",
-        "addi", "andi", "ori", "lb", "lh", "lw", "jalr",
-        "sb", "sh", "sw",
-        "beq", "bne", "bge", "blt",
-        "auipc", "lui", "jal"
+    inline constexpr Keyword registerKeywords[] = {
+        {"zero", KeywordKind::REGISTER, 0}, {"x0", KeywordKind::REGISTER, 0}, {"ra", KeywordKind::REGISTER, 1}, {"x1", KeywordKind::REGISTER, 1},
+        {"sp", KeywordKind::REGISTER, 2}, {"x2", KeywordKind::REGISTER, 2}, {"gp", KeywordKind::REGISTER, 3}, {"x3", KeywordKind::REGISTER, 3},
+        {"tp", KeywordKind::REGISTER, 4}, {"x4", KeywordKind::REGISTER, 4}, {"t0", KeywordKind::REGISTER, 5}, {"x5", KeywordKind::REGISTER, 5},
+        {"t1", KeywordKind::REGISTER, 6}, {"x6", KeywordKind::REGISTER, 6}, {"t2", KeywordKind::REGISTER, 7}, {"x7", KeywordKind::REGISTER, 7},
+        {"s0", KeywordKind::REGISTER, 8}, {"fp", KeywordKind::REGISTER, 8}, {"x8", KeywordKind::REGISTER, 8}, {"s1", KeywordKind::REGISTER, 9},
+        {"x9", KeywordKind::REGISTER, 9}, {"a0", KeywordKind::REGISTER, 10}, {"x10", KeywordKind::REGISTER, 10}, {"a1", KeywordKind::REGISTER, 11},
+        {"x11", KeywordKind::REGISTER, 11}, {"a2", KeywordKind::REGISTER, 12}, {"x12", KeywordKind::REGISTER, 12}, {"a3", KeywordKind::REGISTER, 13},
+        {"x13", KeywordKind::REGISTER, 13}, {"a4", KeywordKind::REGISTER, 14}, {"x14", KeywordKind::REGISTER, 14}, {"a5", KeywordKind::REGISTER, 15},
+        {"x15", KeywordKind::REGISTER, 15}, {"a6", KeywordKind::REGISTER, 16}, {"x16", KeywordKind::REGISTER, 16}, {"a7", KeywordKind::REGISTER, 17},
+        {"x17", KeywordKind::REGISTER, 17}, {"s2", KeywordKind::REGISTER, 18}, {"x18", KeywordKind::REGISTER, 18}, {"s3", KeywordKind::REGISTER, 19},
+        {"x19", KeywordKind::REGISTER, 19}, {"s4", KeywordKind::REGISTER, 20}, {"x20", KeywordKind::REGISTER, 20}, {"s5", KeywordKind::REGISTER, 21},
+        {"x21", KeywordKind::REGISTER, 21}, {"s6", KeywordKind::REGISTER, 22}, {"x22", KeywordKind::REGISTER, 22}, {"s7", KeywordKind::REGISTER, 23},
+        {"x23", KeywordKind::REGISTER, 23}, {"s8", KeywordKind::REGISTER, 24}, {"x24", KeywordKind::REGISTER, 24}, {"s9", KeywordKind::REGISTER, 25},
+        {"x25", KeywordKind::REGISTER, 25}, {"s10", KeywordKind::REGISTER, 26}, {"x26", KeywordKind::REGISTER, 26}, {"s11", KeywordKind::REGISTER, 27},
+        {"x27", KeywordKind::REGISTER, 27}, {"t3", KeywordKind::REGISTER, 28}, {"x28", KeywordKind::REGISTER, 28}, {"t4", KeywordKind::REGISTER, 29},
+        {"x29", KeywordKind::REGISTER, 29}, {"t5", KeywordKind::REGISTER, 30}, {"x30", KeywordKind::REGISTER, 30}, {"t6", KeywordKind::REGISTER, 31},
+        {"x31", KeywordKind::REGISTER, 31}
     };
 
-    inline const std::unordered_map<std::string, int> directives = {
-        {".text", 0}, {".data", 0}, {".word", 4}, {".byte", 1},
-        {".half", 2}, {".dword", 8}, {".asciz", 1}, {".asciiz", 1}, {".ascii", 1}
+    inline constexpr Keyword floatRegisterKeywords[] = {
+        {"f0", KeywordKind::FLOAT_REGISTER, 0}, {"ft0", KeywordKind::FLOAT_REGISTER, 0}, {"f1", KeywordKind::FLOAT_REGISTER, 1}, {"ft1", KeywordKind::FLOAT_REGISTER, 1},
+        {"f2", KeywordKind::FLOAT_REGISTER, 2}, {"ft2", KeywordKind::FLOAT_REGISTER, 2}, {"f3", KeywordKind::FLOAT_REGISTER, 3}, {"ft3", KeywordKind::FLOAT_REGISTER, 3},
+        {"f4", KeywordKind::FLOAT_REGISTER, 4}, {"ft4", KeywordKind::FLOAT_REGISTER, 4}, {"f5", KeywordKind::FLOAT_REGISTER, 5}, {"ft5", KeywordKind::FLOAT_REGISTER, 5},
+        {"f6", KeywordKind::FLOAT_REGISTER, 6}, {"ft6", KeywordKind::FLOAT_REGISTER, 6}, {"f7", KeywordKind::FLOAT_REGISTER, 7}, {"ft7", KeywordKind::FLOAT_REGISTER, 7},
+        {"f8", KeywordKind::FLOAT_REGISTER, 8}, {"fs0", KeywordKind::FLOAT_REGISTER, 8}, {"f9", KeywordKind::FLOAT_REGISTER, 9}, {"fs1", KeywordKind::FLOAT_REGISTER, 9},
+        {"f10", KeywordKind::FLOAT_REGISTER, 10}, {"fa0", KeywordKind::FLOAT_REGISTER, 10}, {"f11", KeywordKind::FLOAT_REGISTER, 11}, {"fa1", KeywordKind::FLOAT_REGISTER, 11},
+        {"f12", KeywordKind::FLOAT_REGISTER, 12}, {"fa2", KeywordKind::FLOAT_REGISTER, 12}, {"f13", KeywordKind::FLOAT_REGISTER, 13}, {"fa3", KeywordKind::FLOAT_REGISTER, 13},
+        {"f14", KeywordKind::FLOAT_REGISTER, 14}, {"fa4", KeywordKind::FLOAT_REGISTER, 14}, {"f15", KeywordKind::FLOAT_REGISTER, 15}, {"fa5", KeywordKind::FLOAT_REGISTER, 15},
+        {"f16", KeywordKind::FLOAT_REGISTER, 16}, {"fa6", KeywordKind::FLOAT_REGISTER, 16}, {"f17", KeywordKind::FLOAT_REGISTER, 17}, {"fa7", KeywordKind::FLOAT_REGISTER, 17},
+        {"f18", KeywordKind::FLOAT_REGISTER, 18}, {"fs2", KeywordKind::FLOAT_REGISTER, 18}, {"f19", KeywordKind::FLOAT_REGISTER, 19}, {"fs3", KeywordKind::FLOAT_REGISTER, 19},
+        {"f20", KeywordKind::FLOAT_REGISTER, 20}, {"fs4", KeywordKind::FLOAT_REGISTER, 20}, {"f21", KeywordKind::FLOAT_REGISTER, 21}, {"fs5", KeywordKind::FLOAT_REGISTER, 21},
+        {"f22", KeywordKind::FLOAT_REGISTER, 22}, {"fs6", KeywordKind::FLOAT_REGISTER, 22}, {"f23", KeywordKind::FLOAT_REGISTER, 23}, {"fs7", KeywordKind::FLOAT_REGISTER, 23},
+        {"f24", KeywordKind::FLOAT_REGISTER, 24}, {"fs8", KeywordKind::FLOAT_REGISTER, 24}, {"f25", KeywordKind::FLOAT_REGISTER, 25}, {"fs9", KeywordKind::FLOAT_REGISTER, 25},
+        {"f26", KeywordKind::FLOAT_REGISTER, 26}, {"fs10", KeywordKind::FLOAT_REGISTER, 26}, {"f27", KeywordKind::FLOAT_REGISTER, 27}, {"fs11", KeywordKind::FLOAT_REGISTER, 27},
+        {"f28", KeywordKind::FLOAT_REGISTER, 28}, {"ft8", KeywordKind::FLOAT_REGISTER, 28}, {"f29", KeywordKind::FLOAT_REGISTER, 29}, {"ft9", KeywordKind::FLOAT_REGISTER, 29},
+        {"f30", KeywordKind::FLOAT_REGISTER, 30}, {"ft10", KeywordKind::FLOAT_REGISTER, 30}, {"f31", KeywordKind::FLOAT_REGISTER, 31}, {"ft11", KeywordKind::FLOAT_REGISTER, 31}
     };
 
-    inline const std::unordered_map<std::string, int> validRegisters = {
-        {"zero", 0}, {"x0", 0}, {"ra", 1}, {"x1", 1}, {"sp", 2}, {"x2", 2},
-        {"gp", 3}, {"x3", 3}, {"tp", 4}, {"x4", 4}, {"t0", 5}, {"x5", 5},
-        {"t1", 6}, {"x6", 6}, {"t2", 7}, {"x7", 7}, {"s0", 8}, {"fp", 8}, {"x8", 8},
-        {"s1", 9}, {"x9", 9}, {"a0", 10}, {"x10", 10}, {"a1", 11}, {"x11", 11},
-        {"a2", 12}, {"x12", 12}, {"a3", 13}, {"x13", 13}, {"a4", 14}, {"x14", 14},
-        {"a5", 15}, {"x15", 15}, {"a6", 16}, {"x16", 16}, {"a7", 17}, {"x17", 17},
-        {"s2", 18}, {"x18", 18}, {"s3", 19}, {"x19", 19}, {"s4", 20}, {"x20", 20},
-        {"s5", 21}, {"x21", 21}, {"s6", 22}, {"x22", 22}, {"s7", 23}, {"x23", 23},
-        {"s8", 24}, {"x24", 24}, {"s9", 25}, {"x25", 25}, {"s10", 26}, {"x26", 26},
-        {"s11", 27}, {"x27", 27}, {"t3", 28}, {"x28", 28}, {"t4", 29}, {"x29", 29},
-        {"t5", 30}, {"x30", 30}, {"t6", 31}, {"x31", 31}
+    inline constexpr Keyword vectorRegisterKeywords[] = {
+        {"v0", KeywordKind::VECTOR_REGISTER, 0}, {"v1", KeywordKind::VECTOR_REGISTER, 1}, {"v2", KeywordKind::VECTOR_REGISTER, 2}, {"v3", KeywordKind::VECTOR_REGISTER, 3}, {"v4", KeywordKind::VECTOR_REGISTER, 4}, {"v5", KeywordKind::VECTOR_REGISTER, 5}, {"v6", KeywordKind::VECTOR_REGISTER, 6}, {"v7", KeywordKind::VECTOR_REGISTER, 7},
+        {"v8", KeywordKind::VECTOR_REGISTER, 8}, {"v9", KeywordKind::VECTOR_REGISTER, 9}, {"v10", KeywordKind::VECTOR_REGISTER, 10}, {"v11", KeywordKind::VECTOR_REGISTER, 11}, {"v12", KeywordKind::VECTOR_REGISTER, 12}, {"v13", KeywordKind::VECTOR_REGISTER, 13}, {"v14", KeywordKind::VECTOR_REGISTER, 14}, {"v15", KeywordKind::VECTOR_REGISTER, 15},
+        {"v16", KeywordKind::VECTOR_REGISTER, 16}, {"v17", KeywordKind::VECTOR_REGISTER, 17}, {"v18", KeywordKind::VECTOR_REGISTER, 18}, {"v19", KeywordKind::VECTOR_REGISTER, 19}, {"v20", KeywordKind::VECTOR_REGISTER, 20}, {"v21", KeywordKind::VECTOR_REGISTER, 21}, {"v22", KeywordKind::VECTOR_REGISTER, 22}, {"v23", KeywordKind::VECTOR_REGISTER, 23},
+        {"v24", KeywordKind::VECTOR_REGISTER, 24}, {"v25", KeywordKind::VECTOR_REGISTER, 25}, {"v26", KeywordKind::VECTOR_REGISTER, 26}, {"v27", KeywordKind::VECTOR_REGISTER, 27}, {"v28", KeywordKind::VECTOR_REGISTER, 28}, {"v29", KeywordKind::VECTOR_REGISTER, 29}, {"v30", KeywordKind::VECTOR_REGISTER, 30}, {"v31", KeywordKind::VECTOR_REGISTER, 31}
     };
 
+    // CSR, rounding-mode and vtype names are operands rather than registers:
+    // they lex as plain identifiers and the parser looks them up where
+    // expected. A vtype name's value is the vtype field mask in bits 15:8
+    // over the field value in bits 7:0.
+    inline constexpr Keyword operandNameKeywords[] = {
+        {"fflags", KeywordKind::CSR, CSR_FFLAGS}, {"frm", KeywordKind::CSR, CSR_FRM}, {"fcsr", KeywordKind::CSR, CSR_FCSR},
+        {"rne", KeywordKind::ROUNDING_MODE, ROUND_NEAREST_EVEN}, {"rtz", KeywordKind::ROUNDING_MODE, ROUND_TOWARD_ZERO},
+        {"rdn", KeywordKind::ROUNDING_MODE, ROUND_DOWN}, {"rup", KeywordKind::ROUNDING_MODE, ROUND_UP},
+        {"rmm", KeywordKind::ROUNDING_MODE, ROUND_NEAREST_MAX}, {"dyn", KeywordKind::ROUNDING_MODE, ROUND_DYNAMIC},
+        {"e8", KeywordKind::VECTOR_TYPE, 0x3800}, {"e16", KeywordKind::VECTOR_TYPE, 0x3808}, {"e32", KeywordKind::VECTOR_TYPE, 0x3810},
+        {"e64", KeywordKind::VECTOR_TYPE, 0x3818}, {"m1", KeywordKind::VECTOR_TYPE, 0x0700}, {"m2", KeywordKind::VECTOR_TYPE, 0x0701},
+        {"m4", KeywordKind::VECTOR_TYPE, 0x0702}, {"m8", KeywordKind::VECTOR_TYPE, 0x0703}, {"mf8", KeywordKind::VECTOR_TYPE, 0x0705},
+        {"mf4", KeywordKind::VECTOR_TYPE, 0x0706}, {"mf2", KeywordKind::VECTOR_TYPE, 0x0707}, {"tu", KeywordKind::VECTOR_TYPE, 0x4000},
+        {"ta", KeywordKind::VECTOR_TYPE, 0x4040}, {"mu", KeywordKind::VECTOR_TYPE, 0x8000}, {"ma", KeywordKind::VECTOR_TYPE, 0x8080}
+    };
+
+    // vsew and vlmul names, indexed by field value.
+    inline constexpr std::string_view vectorSewNames[] = {"e8", "e16", "e32", "e64"};
+    inline constexpr std::string_view vectorLmulNames[] = {"m1", "m2", "m4", "m8", "", "mf8", "mf4", "mf2"};
+
+    // A vtype as vsetvli takes it (e32, m1, ta, mu), or its number when it
+    // has no spelling.
+    inline std::string vectorTypeName(uint32_t vtype, std::string_view separator) {
+        if ((vtype & ~0xFFu) != 0 || (vtype & 0x7) == 4 || ((vtype >> 3) & 0x7) > 3) return std::to_string(vtype);
+        std::string name(vectorSewNames[(vtype >> 3) & 0x7]);
+        name.append(separator).append(vectorLmulNames[vtype & 0x7]);
+        name.append(separator).append(vtype & 0x40 ? "ta" : "tu");
+        name.append(separator).append(vtype & 0x80 ? "ma" : "mu");
+        return name;
+    }
+
+    inline constexpr size_t keywordCount = instructionCount + pseudoKeywordCount + compressedCount + sizeof(directiveKeywords) / sizeof(Keyword) + sizeof(registerKeywords) / sizeof(Keyword) +
+                                            sizeof(floatRegisterKeywords) / sizeof(Keyword) + sizeof(vectorRegisterKeywords) / sizeof(Keyword) +
+                                            sizeof(operandNameKeywords) / sizeof(Keyword);
+
+    inline constexpr std::array<Keyword, keywordCount> buildKeywordList() {
+        std::array<Keyword, keywordCount> keywords{};
+        size_t next = 0;
+        for (const InstructionDescriptor& descriptor : instructionTable) {
+            keywords[next++] = {descriptor.mnemonic, KeywordKind::OPCODE, static_cast<int32_t>(descriptor.instruction)};
+        }
+        for (const PseudoDescriptor& pseudo : pseudoTable) {
+            if (!isBaseMnemonic(pseudo.mnemonic)) keywords[next++] = {pseudo.mnemonic, KeywordKind::PSEUDO, static_cast<int32_t>(pseudo.pseudo)};
+        }
+        for (size_t i = 0; i < compressedCount; ++i) {
+            keywords[next++] = {compressedTable[i].mnemonic, KeywordKind::COMPRESSED, static_cast<int32_t>(i)};
+        }
+        for (const Keyword& keyword : directiveKeywords) keywords[next++] = keyword;
+        for (const Keyword& keyword : registerKeywords) keywords[next++] = keyword;
+        for (const Keyword& keyword : floatRegisterKeywords) keywords[next++] = keyword;
+        for (const Keyword& keyword : vectorRegisterKeywords) keywords[next++] = keyword;
+        for (const Keyword& keyword : operandNameKeywords) keywords[next++] = keyword;
+        return keywords;
+    }
+
+    inline constexpr std::array<Keyword, keywordCount> keywordList = buildKeywordList();
+
+    inline constexpr auto keywordIndex = buildPerfectHash<nextPowerOfTwo(keywordCount / 2), nextPowerOfTwo(keywordCount * 2)>(keywordList);
+
+    inline constexpr const Keyword* findKeyword(std::string_view token) {
+        int entry = keywordIndex.find(token);
+        if (entry < 0 || keywordList[entry].name != token) return nullptr;
+        return &keywordList[entry];
+    }
+
+    inline constexpr bool isKeyword(std::string_view token, KeywordKind kind) {
+        const Keyword* keyword = findKeyword(token);
+        return keyword != nullptr && keyword->kind == kind;
+    }
+
+    inline constexpr Instructions lookupInstruction(std::string_view mnemonic) {
+        const Keyword* keyword = findKeyword(mnemonic);
+        if (keyword == nullptr) return lookupCustomInstruction(mnemonic);
+        return keyword->kind == KeywordKind::OPCODE ? static_cast<Instructions>(keyword->value) : Instructions::INVALID;
+    }
+
+    inline constexpr const PseudoDescriptor* findPseudoInstruction(std::string_view mnemonic, size_t operandCount) {
+        const Keyword* keyword = findKeyword(mnemonic);
+        if (keyword == nullptr) return nullptr;
+        if (keyword->kind == KeywordKind::PSEUDO) return &pseudoTable[keyword->value];
+        if (keyword->kind != KeywordKind::OPCODE) return nullptr;
+        for (const PseudoDescriptor& pseudo : pseudoTable) {
+            if (pseudo.mnemonic == mnemonic && pseudo.operands == operandCount) return &pseudo;
+        }
+        return nullptr;
+    }
+
+    inline constexpr const CompressedDescriptor* findCompressedForm(std::string_view mnemonic) {
+        const Keyword* keyword = findKeyword(mnemonic);
+        return (keyword != nullptr && keyword->kind == KeywordKind::COMPRESSED) ? &compressedTable[keyword->value] : nullptr;
+    }
+
     struct BranchPredictor {
         struct BTBEntry {
             uint32_t targetAddress;
@@ -179,25 +1139,167 @@ namespace riscv {
         Token(TokenType t, const std::string& v, int ln) : type(t), value(v), lineNumber(ln) {}
     };
 
-    struct SymbolEntry {
-        uint32_t address;
-        bool isString;
-        std::vector<uint64_t> numericValues;
-        std::string stringValue;
-        std::string directive;
+    struct TokenView {
+        TokenType type;
+        std::string_view value;
+        int lineNumber;
     };
-    
+
+    class TokenLine {
+    public:
+        TokenLine() : first(nullptr), count(0) {}
+        TokenLine(const TokenView* begin, size_t size) : first(begin), count(size) {}
+
+        const TokenView* begin() const { return first; }
+        const TokenView* end() const { return first + count; }
+        const TokenView& operator[](size_t index) const { return first[index]; }
+        const TokenView& front() const { return first[0]; }
+        const TokenView& back() const { return first[count - 1]; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        TokenLine subLine(size_t from, size_t to) const { return TokenLine(first + from, to - from); }
+
+    private:
+        const TokenView* first;
+        size_t count;
+    };
+
+    class TokenArena {
+    public:
+        TokenArena() = default;
+        TokenArena(std::shared_ptr<const void> owner, std::string_view text) : source(std::move(owner)), text(text) {}
+
+        size_t size() const { return lines.size(); }
+        bool empty() const { return lines.empty(); }
+        size_t tokenCount() const { return tokens.size(); }
+        std::string_view getSource() const { return text; }
+
+        TokenLine operator[](size_t index) const {
+            return TokenLine(tokens.data() + lines[index].first, lines[index].second);
+        }
+
+        void reserve(size_t tokenCount, size_t lineCount) {
+            tokens.reserve(tokenCount);
+            lines.reserve(lineCount);
+        }
+
+        void push(TokenType type, std::string_view value, int lineNumber) {
+            tokens.push_back({type, value, lineNumber});
+        }
+
+        size_t mark() const { return tokens.size(); }
+
+        void renumber(int lineNumber) {
+            for (TokenView &token : tokens) token.lineNumber = lineNumber;
+        }
+
+        void clear() {
+            tokens.clear();
+            lines.clear();
+        }
+
+        void closeLine(size_t start) {
+            if (tokens.size() > start) {
+                lines.emplace_back(static_cast<uint32_t>(start), static_cast<uint32_t>(tokens.size() - start));
+            }
+        }
+
+        class const_iterator {
+        public:
+            const_iterator(const TokenArena* a, size_t i) : arena(a), index(i) {}
+            TokenLine operator*() const { return (*arena)[index]; }
+            const_iterator& operator++() { ++index; return *this; }
+            bool operator!=(const const_iterator& other) const { return index != other.index; }
+        private:
+            const TokenArena* arena;
+            size_t index;
+        };
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, lines.size()); }
+
+    private:
+        std::shared_ptr<const void> source;
+        std::string_view text;
+        std::vector<TokenView> tokens;
+        std::vector<std::pair<uint32_t, uint32_t>> lines;
+    };
+
+    enum class OperandKind : uint8_t { NONE, REGISTER, IMMEDIATE, LABEL };
+
+    // Label operands of auipc and of the instruction that follows it take the
+    // upper and lower part of the label's offset from the auipc, as %pcrel_hi
+    // and %pcrel_lo do in the GNU assembler. HI and LO are %hi and %lo: the
+    // parts of the label's absolute address for lui and the instruction after.
+    enum class OperandModifier : uint8_t { NONE, PCREL_HI, PCREL_LO, HI, LO };
+
+    struct Operand {
+        OperandKind kind;
+        bool resolved;
+        uint8_t reg;
+        int32_t value;
+        std::string_view symbol;
+        OperandModifier modifier = OperandModifier::NONE;
+
+        static constexpr Operand makeRegister(uint8_t reg) { return {OperandKind::REGISTER, true, reg, 0, {}}; }
+        static constexpr Operand makeImmediate(int32_t value) { return {OperandKind::IMMEDIATE, true, 0, value, {}}; }
+        static constexpr Operand makeLabel(std::string_view symbol, OperandModifier modifier = OperandModifier::NONE) { return {OperandKind::LABEL, false, 0, 0, symbol, modifier}; }
+
+        constexpr bool isRegister() const { return kind == OperandKind::REGISTER; }
+        constexpr bool hasValue() const { return kind == OperandKind::IMMEDIATE || kind == OperandKind::LABEL; }
+    };
+
+    inline constexpr size_t MAX_OPERANDS = 4;
+
+    inline constexpr bool isRelativeLabel(const InstructionDescriptor& descriptor, OperandModifier modifier) {
+        return modifier == OperandModifier::NONE && (descriptor.isBranch() || descriptor.format == InstructionType::UJ);
+    }
+
+    // The immediate a label operand encodes: the offset from the instruction
+    // for branches and jal, a part of the offset from the auipc for PCREL
+    // operands, and the absolute address otherwise.
+    inline constexpr int32_t labelOperandValue(const InstructionDescriptor& descriptor, OperandModifier modifier, uint32_t labelAddress, uint32_t address) {
+        switch (modifier) {
+            case OperandModifier::PCREL_HI: return upperImmediate(static_cast<int32_t>(labelAddress - address));
+            case OperandModifier::PCREL_LO: return lowerImmediate(static_cast<int32_t>(labelAddress - (address - INSTRUCTION_SIZE)));
+            case OperandModifier::HI: return upperImmediate(static_cast<int32_t>(labelAddress));
+            case OperandModifier::LO: return lowerImmediate(static_cast<int32_t>(labelAddress));
+            case OperandModifier::NONE: break;
+        }
+        return static_cast<int32_t>(isRelativeLabel(descriptor, modifier) ? labelAddress - address : labelAddress);
+    }
+
+    inline constexpr bool fitsOffset(const InstructionDescriptor& descriptor, int32_t offset) {
+        return offset >= descriptor.immMin && offset <= descriptor.immMax && (offset & 1) == 0;
+    }
+
     struct ParsedInstruction {
-        std::string opcode;
-        std::vector<std::string> operands;
+        Instructions instruction;
+        uint8_t operandCount;
+        std::array<Operand, MAX_OPERANDS> operands;
         uint32_t address;
-    
-        ParsedInstruction(std::string opc, std::vector<std::string> ops, uint32_t addr) 
-            : opcode(std::move(opc)), operands(std::move(ops)), address(addr) {}
+        int lineNumber;
+        // compressed: assembled as a 16-bit parcel. compressible: written
+        // under `.option rvc`, so relaxation may compress it when it fits.
+        bool compressed = false;
+        bool compressible = false;
+        // The rm field of instructions with FLAG_ROUNDING.
+        uint8_t roundingMode = ROUND_DYNAMIC;
+
+        ParsedInstruction(Instructions inst, uint32_t addr, int line)
+            : instruction(inst), operandCount(0), operands(), address(addr), lineNumber(line) {}
+
+        const Operand& operator[](size_t index) const { return operands[index]; }
+        size_t size() const { return operandCount; }
     };
 
     struct InstructionNode {
         uint32_t PC, opcode, rs1, rs2, rd, instruction, func3, func7;
+        uint32_t length = INSTRUCTION_SIZE;
+        uint32_t rs3 = 0;
+        // Cycles still to spend in EXECUTE after the first.
+        uint32_t busyCycles = 0;
         InstructionType instructionType;
         Stage stage;
         bool stalled, isBranch, isJump, isLoad, isStore;
@@ -209,7 +1311,7 @@ namespace riscv {
 
         InstructionNode(const InstructionNode& other)
             : PC(other.PC), opcode(other.opcode), rs1(other.rs1), rs2(other.rs2), rd(other.rd), 
-              instruction(other.instruction), func3(other.func3), func7(other.func7),
+              instruction(other.instruction), func3(other.func3), func7(other.func7), length(other.length), rs3(other.rs3), busyCycles(other.busyCycles),
               instructionType(other.instructionType), stage(other.stage), 
               stalled(other.stalled), isBranch(other.isBranch), isJump(other.isJump), isLoad(other.isLoad), isStore(other.isStore), 
               instructionName(other.instructionName), uniqueId(other.uniqueId) {}
@@ -244,18 +1346,94 @@ namespace riscv {
         uint32_t controlHazardStalls;
         uint32_t pipelineFlushes;
         uint32_t branchMispredictions;
+        uint32_t compressedInstructions;
+        uint32_t fetchBlockReads;
+        uint32_t straddlingFetches;
+        uint32_t floatInstructions;
+        uint32_t structuralHazardStalls;
+        uint32_t vectorInstructions;
+        uint32_t vectorBeats;
+        uint32_t vectorStalls;
+        uint32_t bitManipulationInstructions;
+        uint32_t customInstructions;
+        uint32_t customStalls;
 
         SimulationStats()
             : cyclesPerInstruction(0.0), totalCycles(0), instructionsExecuted(0),
               dataTransferInstructions(0), aluInstructions(0), controlInstructions(0),
               stallBubbles(0), dataHazards(0), controlHazards(0), dataHazardStalls(0),
-              controlHazardStalls(0), pipelineFlushes(0), branchMispredictions(0) {}
+              controlHazardStalls(0), pipelineFlushes(0), branchMispredictions(0),
+              compressedInstructions(0), fetchBlockReads(0), straddlingFetches(0),
+              floatInstructions(0), structuralHazardStalls(0), vectorInstructions(0),
+              vectorBeats(0), vectorStalls(0), bitManipulationInstructions(0),
+              customInstructions(0), customStalls(0) {}
     };
 
-    struct InstructionEncoding {
-        std::unordered_map<std::string, uint32_t> func7Map;
-        std::unordered_map<std::string, uint32_t> func3Map;
-        std::unordered_map<std::string, uint32_t> opcodeMap;
+    // Cycles a floating-point or M-extension instruction spends in EXECUTE;
+    // everything else takes one. EXECUTE holds one instruction at a time, so a
+    // long operation stalls the instructions behind it.
+    struct ExecuteLatencies {
+        uint32_t integerMultiply = 1;
+        uint32_t integerDivide = 1;
+        uint32_t add = 3;
+        uint32_t multiply = 4;
+        uint32_t fused = 5;
+        uint32_t divide = 10;
+        uint32_t squareRoot = 12;
+        uint32_t convert = 2;
+        uint32_t other = 1;
+
+        uint32_t of(FloatUnit unit) const {
+            switch (unit) {
+                case FloatUnit::ADD: return add;
+                case FloatUnit::MULTIPLY: return multiply;
+                case FloatUnit::FUSED: return fused;
+                case FloatUnit::DIVIDE: return divide;
+                case FloatUnit::SQUARE_ROOT: return squareRoot;
+                case FloatUnit::CONVERT: return convert;
+                case FloatUnit::OTHER: return other;
+                case FloatUnit::NONE: break;
+            }
+            return 1;
+        }
+
+        // Sets the latency of a unit named imul, idiv, add, mul, fma, div,
+        // sqrt, cvt or misc; false for any other name.
+        bool set(std::string_view unit, uint32_t cycles) {
+            if (unit == "imul") integerMultiply = cycles;
+            else if (unit == "idiv") integerDivide = cycles;
+            else if (unit == "add") add = cycles;
+            else if (unit == "mul") multiply = cycles;
+            else if (unit == "fma") fused = cycles;
+            else if (unit == "div") divide = cycles;
+            else if (unit == "sqrt") squareRoot = cycles;
+            else if (unit == "cvt") convert = cycles;
+            else if (unit == "misc") other = cycles;
+            else return false;
+            return true;
+        }
+    };
+
+    // Instruction fetch reads aligned 4-byte blocks into a one-block buffer.
+    // With compressed instructions a 32-bit instruction may start halfway
+    // through a block; it then needs the next block as well.
+    struct FetchBuffer {
+        static constexpr uint32_t BLOCK_SIZE = 4;
+        static constexpr uint32_t NO_BLOCK = UINT32_MAX;
+
+        uint32_t block = NO_BLOCK;
+
+        // Returns the number of blocks read to fetch `length` bytes at `pc`.
+        uint32_t fetch(uint32_t pc, uint32_t length) {
+            const uint32_t first = pc & ~(BLOCK_SIZE - 1);
+            const uint32_t last = (pc + length - 1) & ~(BLOCK_SIZE - 1);
+            uint32_t reads = first == block ? 0 : 1;
+            if (last != first) ++reads;
+            block = last;
+            return reads;
+        }
+
+        void invalidate() { block = NO_BLOCK; }
     };
 
     inline std::string getTokenTypeName(TokenType type) {
@@ -273,11 +1451,19 @@ namespace riscv {
         }
     }
 
-    inline bool isRegister(const std::string& token) {
-        return validRegisters.count(token) > 0;
+    inline bool isRegister(std::string_view token) {
+        return isKeyword(token, KeywordKind::REGISTER);
+    }
+
+    inline bool isFloatRegister(std::string_view token) {
+        return isKeyword(token, KeywordKind::FLOAT_REGISTER);
+    }
+
+    inline bool isVectorRegister(std::string_view token) {
+        return isKeyword(token, KeywordKind::VECTOR_REGISTER);
     }
 
-    inline bool isImmediate(const std::string& token) {
+    inline bool isImmediate(std::string_view token) {
         if (token.empty()) return false;
         
         size_t pos = 0;
@@ -303,6 +1489,13 @@ namespace riscv {
         return str.substr(first, last - first + 1);
     }
 
+    inline std::string_view trimView(std::string_view str) {
+        size_t first = str.find_first_not_of(" \t\r\n");
+        if (first == std::string_view::npos) return {};
+        size_t last = str.find_last_not_of(" \t\r\n");
+        return str.substr(first, last - first + 1);
+    }
+
     inline bool isMemory(const std::string& token, std::string& offset, std::string& reg) {
         size_t open = token.find('(');
         size_t close = token.find(')', open);
@@ -313,22 +1506,61 @@ namespace riscv {
         if (!isRegister(reg) || (!offset.empty() && !isImmediate(offset))) return false;
         if (close + 1 < token.length() && !trim(token.substr(close + 1)).empty()) return false;
         return true;
+    }
+
+    inline bool isMemory(std::string_view token, std::string_view& offset, std::string_view& reg) {
+        size_t open = token.find('(');
+        size_t close = token.find(')', open);
+        if (open == std::string_view::npos || close == std::string_view::npos || close <= open) return false;
+        offset = trimView(token.substr(0, open));
+        reg = trimView(token.substr(open + 1, close - open - 1));
+        if (offset.empty()) offset = "0";
+        if (!isRegister(reg) || !isImmediate(offset)) return false;
+        if (close + 1 < token.length() && !trimView(token.substr(close + 1)).empty()) return false;
+        return true;
     }    
 
-    inline uint32_t getDirectiveSize(const std::string& directive) {
-        auto it = directives.find(directive);
-        return (it != directives.end()) ? it->second : 0;
+    // %hi(sym), %lo(sym), %pcrel_hi(sym) or %pcrel_lo(sym).
+    inline bool parseRelocationOperator(std::string_view token, OperandModifier& modifier, std::string_view& symbol) {
+        if (token.size() < 2 || token[0] != '%' || token.back() != ')') return false;
+        const size_t open = token.find('(');
+        if (open == std::string_view::npos) return false;
+        const std::string_view name = token.substr(1, open - 1);
+        if (name == "hi") modifier = OperandModifier::HI;
+        else if (name == "lo") modifier = OperandModifier::LO;
+        else if (name == "pcrel_hi") modifier = OperandModifier::PCREL_HI;
+        else if (name == "pcrel_lo") modifier = OperandModifier::PCREL_LO;
+        else return false;
+        symbol = trimView(token.substr(open + 1, token.size() - open - 2));
+        return !symbol.empty() && symbol.find_first_of("()% \t") == std::string_view::npos;
     }
 
-    inline int32_t getRegisterNumber(const std::string& reg) {
-        auto it = validRegisters.find(reg);
-        if (it != validRegisters.end()) {
-            return it->second;
+    // A relocation operator used as the offset of a memory operand, as in
+    // %lo(sym)(x5).
+    inline bool isRelocatedMemory(std::string_view token, std::string_view& offset, std::string_view& reg) {
+        if (token.empty() || token.back() != ')') return false;
+        const size_t open = token.rfind('(');
+        offset = trimView(token.substr(0, open));
+        reg = trimView(token.substr(open + 1, token.size() - open - 2));
+        OperandModifier modifier;
+        std::string_view symbol;
+        return isRegister(reg) && parseRelocationOperator(offset, modifier, symbol);
+    }
+
+    inline uint32_t getDirectiveSize(std::string_view directive) {
+        const Keyword* keyword = findKeyword(directive);
+        return (keyword != nullptr && keyword->kind == KeywordKind::DIRECTIVE) ? keyword->value : 0;
+    }
+
+    inline int32_t getRegisterNumber(std::string_view reg) {
+        const Keyword* keyword = findKeyword(reg);
+        if (keyword != nullptr && keyword->kind == KeywordKind::REGISTER) {
+            return keyword->value;
         }
         
         if (reg.length() > 1 && reg[0] == 'x') {
             try {
-                int num = std::stoi(reg.substr(1));
+                int num = std::stoi(std::string(reg.substr(1)));
                 return (num >= 0 && num < 32) ? num : -1;
             } catch (...) {
                 return -1;
@@ -338,9 +1570,34 @@ namespace riscv {
         return -1;
     }
 
-    inline int32_t parseImmediate(const std::string& imm) {
+    inline int32_t getFloatRegisterNumber(std::string_view reg) {
+        const Keyword* keyword = findKeyword(reg);
+        return (keyword != nullptr && keyword->kind == KeywordKind::FLOAT_REGISTER) ? keyword->value : -1;
+    }
+
+    inline int32_t getVectorRegisterNumber(std::string_view reg) {
+        const Keyword* keyword = findKeyword(reg);
+        return (keyword != nullptr && keyword->kind == KeywordKind::VECTOR_REGISTER) ? keyword->value : -1;
+    }
+
+    inline int32_t getVectorTypeField(std::string_view name) {
+        const Keyword* keyword = findKeyword(name);
+        return (keyword != nullptr && keyword->kind == KeywordKind::VECTOR_TYPE) ? keyword->value : -1;
+    }
+
+    inline int32_t getCsrNumber(std::string_view name) {
+        const Keyword* keyword = findKeyword(name);
+        return (keyword != nullptr && keyword->kind == KeywordKind::CSR) ? keyword->value : -1;
+    }
+
+    inline int32_t getRoundingMode(std::string_view name) {
+        const Keyword* keyword = findKeyword(name);
+        return (keyword != nullptr && keyword->kind == KeywordKind::ROUNDING_MODE) ? keyword->value : -1;
+    }
+
+    inline int32_t parseImmediate(std::string_view imm) {
         try {
-            std::string cleanImm = trim(imm);
+            std::string cleanImm(trimView(imm));
             if (cleanImm.empty()) {
                 throw std::invalid_argument("Empty immediate value");
                 return 0;
@@ -375,80 +1632,6 @@ namespace riscv {
             throw std::runtime_error(errorMsg);
         }
     }
-    
-    struct RTypeInstructions {
-        static inline const InstructionEncoding& getEncoding() {
-            static const InstructionEncoding encoding = {
-                {{"add", 0b0000000}, {"sub", 0b0100000}, {"mul", 0b0000001}, {"div", 0b0000001}, 
-                 {"rem", 0b0000001}, {"and", 0b0000000}, {"or", 0b0000000}, {"xor", 0b0000000}, 
-                 {"sll", 0b0000000}, {"slt", 0b0000000}, {"sra", 0b0100000}, {"srl", 0b0000000}},
-                {{"add", 0b000}, {"sub", 0b000}, {"mul", 0b000}, {"div", 0b100}, {"rem", 0b110}, 
-                 {"and", 0b111}, {"or", 0b110}, {"xor", 0b100}, {"sll", 0b001}, {"slt", 0b010}, 
-                 {"sra", 0b101}, {"srl", 0b101}},
-                {{"add", 0b0110011}, {"sub", 0b0110011}, {"mul", 0b0110011}, {"div", 0b0110011}, 
-                 {"rem", 0b0110011}, {"and", 0b0110011}, {"or", 0b0110011}, {"xor", 0b0110011}, 
-                 {"sll", 0b0110011}, {"slt", 0b0110011}, {"sra", 0b0110011}, {"srl", 0b0110011}}
-            };
-            return encoding;
-        }
-    };
-
-    struct ITypeInstructions {
-        static inline const InstructionEncoding& getEncoding() {
-            static const InstructionEncoding encoding = {
-                {},
-                {{"addi", 0b000}, {"andi", 0b111}, {"ori", 0b110}, 
-                 {"lb", 0b000}, {"lh", 0b001}, {"lw", 0b010}, {"jalr", 0b000}},
-                {{"addi", 0b0010011}, {"andi", 0b0010011}, {"ori", 0b0010011}, 
-                 {"lb", 0b0000011}, {"lh", 0b0000011}, {"lw", 0b0000011}, {"jalr", 0b1100111}}
-            };
-            return encoding;
-        }
-    };
-
-    struct STypeInstructions {
-        static inline const InstructionEncoding& getEncoding() {
-            static const InstructionEncoding encoding = {
-                {},
-                {{"sb", 0b000}, {"sh", 0b001}, {"sw", 0b010}},
-                {{"sb", 0b0100011}, {"sh", 0b0100011}, {"sw", 0b0100011}}
-            };
-            return encoding;
-        }
-    };
-
-    struct SBTypeInstructions {
-        static inline const InstructionEncoding& getEncoding() {
-            static const InstructionEncoding encoding = {
-                {},
-                {{"beq", 0b000}, {"bne", 0b001}, {"bge", 0b101}, {"blt", 0b100}},
-                {{"beq", 0b1100011}, {"bne", 0b1100011}, {"bge", 0b1100011}, {"blt", 0b1100011}}
-            };
-            return encoding;
-        }
-    };
-
-    struct UTypeInstructions {
-        static inline const InstructionEncoding& getEncoding() {
-            static const InstructionEncoding encoding = {
-                {},
-                {},
-                {{"lui", 0b0110111}, {"auipc", 0b0010111}}
-            };
-            return encoding;
-        }
-    };
-
-    struct UJTypeInstructions {
-        static inline const InstructionEncoding& getEncoding() {
-            static const InstructionEncoding encoding = {
-                {},
-                {},
-                {{"jal", 0b1101111}}
-            };
-            return encoding;
-        }
-    };
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,327 @@
+#ifndef VECTOR_HPP
+#define VECTOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "types.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The V extension subset: a VLEN-bit register file with SEW up to ELEN = 32,
+// LMUL from 1/8 to 8, and element operations that run on host SIMD lanes
+// where the host has the operation. Tail and masked-off elements are always
+// left undisturbed, which is a legal choice under either policy.
+namespace riscv::vector {
+    inline constexpr uint32_t ELEN = 32;
+    inline constexpr uint32_t VTYPE_VILL = 0x80000000;
+
+    inline constexpr uint32_t ALU_LATENCY = 1;
+    inline constexpr uint32_t MULTIPLY_LATENCY = 3;
+    inline constexpr uint32_t MEMORY_LATENCY = 2;
+
+    // datapath is the bits the arithmetic and memory pipelines each handle
+    // per beat.
+    struct Config {
+        uint32_t vlen = 128;
+        uint32_t datapath = 64;
+        bool chaining = false;
+    };
+
+    inline bool isValidVlen(uint32_t vlen) {
+        return vlen >= ELEN && vlen <= 65536 && (vlen & (vlen - 1)) == 0;
+    }
+
+    inline uint32_t sewOf(uint32_t vtype) { return 8u << ((vtype >> 3) & 0x7); }
+
+    // LMUL in eighths, so fractional settings stay integral.
+    inline uint32_t lmulEighthsOf(uint32_t vtype) {
+        const uint32_t vlmul = vtype & 0x7;
+        return vlmul < 4 ? 8u << vlmul : 8u >> (8 - vlmul);
+    }
+
+    // Registers a group of LMUL (in eighths) spans.
+    inline uint32_t groupRegisters(uint32_t lmulEighths) { return std::max(1u, lmulEighths / 8); }
+
+    // VLMAX for a vtype, or 0 when the vtype is unsupported and sets vill.
+    inline uint32_t vlmaxOf(uint32_t vtype, uint32_t vlen) {
+        if ((vtype & ~0xFFu) != 0 || (vtype & 0x7) == 4 || ((vtype >> 3) & 0x7) > 2) return 0;
+        const uint32_t sew = sewOf(vtype);
+        const uint32_t lmulEighths = lmulEighthsOf(vtype);
+        if (lmulEighths < 8 && sew * 8 > lmulEighths * ELEN) return 0;
+        return vlen * lmulEighths / (8 * sew);
+    }
+
+    inline uint32_t signExtend(uint32_t value, uint32_t sew) {
+        return sew >= 32 ? value : static_cast<uint32_t>(static_cast<int32_t>(value << (32 - sew)) >> (32 - sew));
+    }
+
+    inline uint32_t truncate(uint32_t value, uint32_t sew) {
+        return sew >= 32 ? value : value & ((1u << sew) - 1);
+    }
+
+    inline uint32_t readElement(const uint8_t* base, uint32_t index, uint32_t sew) {
+        switch (sew) {
+            case 8: return base[index];
+            case 16: { uint16_t value; std::memcpy(&value, base + index * 2, 2); return value; }
+            default: { uint32_t value; std::memcpy(&value, base + index * 4, 4); return value; }
+        }
+    }
+
+    inline void writeElement(uint8_t* base, uint32_t index, uint32_t sew, uint32_t value) {
+        switch (sew) {
+            case 8: base[index] = static_cast<uint8_t>(value); break;
+            case 16: { const uint16_t half = static_cast<uint16_t>(value); std::memcpy(base + index * 2, &half, 2); break; }
+            default: std::memcpy(base + index * 4, &value, 4); break;
+        }
+    }
+
+    // The architectural state: vl, vtype and 32 registers of VLENB bytes
+    // laid out back to back, so a register group is one contiguous span.
+    class State {
+    public:
+        explicit State(uint32_t vlen = Config().vlen) { reset(vlen); }
+
+        void reset(uint32_t bits) {
+            vlen = bits;
+            vl = 0;
+            vtype = VTYPE_VILL;
+            file.assign(32 * vlenb(), 0);
+        }
+
+        uint32_t vlenb() const { return vlen / 8; }
+        uint8_t* reg(uint32_t number) { return file.data() + number * vlenb(); }
+        const uint8_t* reg(uint32_t number) const { return file.data() + number * vlenb(); }
+
+        bool maskBit(uint32_t number, uint32_t index) const { return (reg(number)[index >> 3] >> (index & 7)) & 1; }
+        void setMaskBit(uint32_t number, uint32_t index, bool value) {
+            uint8_t &byte = reg(number)[index >> 3];
+            byte = static_cast<uint8_t>(value ? byte | (1u << (index & 7)) : byte & ~(1u << (index & 7)));
+        }
+
+        // vsetvl semantics: an unsupported vtype sets vill and clears vl.
+        uint32_t configure(uint32_t type, uint32_t avl) {
+            const uint32_t vlmax = vlmaxOf(type, vlen);
+            vtype = vlmax == 0 ? VTYPE_VILL : type;
+            vl = std::min(avl, vlmax);
+            return vl;
+        }
+
+        uint32_t vlen;
+        uint32_t vl;
+        uint32_t vtype;
+
+    private:
+        std::vector<uint8_t> file;
+    };
+
+    enum class Operation : uint8_t { ADD, SUB, RSUB, MINU, MIN, MAXU, MAX, AND, OR, XOR, SLL, SRL, SRA, MUL, MULH, MULHU,
+                                     SEQ, SNE, SLTU, SLT, SLEU, SLE, SGTU, SGT };
+
+    // a is the vs2 element and b the vs1 element, x register or immediate,
+    // both as SEW-bit values. Comparisons return 0 or 1.
+    inline uint32_t apply(Operation op, uint32_t a, uint32_t b, uint32_t sew) {
+        const int32_t sa = static_cast<int32_t>(signExtend(a, sew)), sb = static_cast<int32_t>(signExtend(b, sew));
+        a = truncate(a, sew);
+        b = truncate(b, sew);
+        switch (op) {
+            case Operation::ADD: return a + b;
+            case Operation::SUB: return a - b;
+            case Operation::RSUB: return b - a;
+            case Operation::MINU: return std::min(a, b);
+            case Operation::MIN: return static_cast<uint32_t>(std::min(sa, sb));
+            case Operation::MAXU: return std::max(a, b);
+            case Operation::MAX: return static_cast<uint32_t>(std::max(sa, sb));
+            case Operation::AND: return a & b;
+            case Operation::OR: return a | b;
+            case Operation::XOR: return a ^ b;
+            case Operation::SLL: return a << (b & (sew - 1));
+            case Operation::SRL: return a >> (b & (sew - 1));
+            case Operation::SRA: return static_cast<uint32_t>(sa >> (b & (sew - 1)));
+            case Operation::MUL: return a * b;
+            case Operation::MULH: return static_cast<uint32_t>((static_cast<int64_t>(sa) * sb) >> sew);
+            case Operation::MULHU: return static_cast<uint32_t>((static_cast<uint64_t>(a) * b) >> sew);
+            case Operation::SEQ: return a == b;
+            case Operation::SNE: return a != b;
+            case Operation::SLTU: return a < b;
+            case Operation::SLT: return sa < sb;
+            case Operation::SLEU: return a <= b;
+            case Operation::SLE: return sa <= sb;
+            case Operation::SGTU: return a > b;
+            case Operation::SGT: return sa > sb;
+        }
+        return 0;
+    }
+
+#if defined(__AVX2__)
+    using Lanes = __m256i;
+    inline Lanes loadLanes(const uint8_t* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+    inline void storeLanes(uint8_t* data, Lanes lanes) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), lanes); }
+    inline Lanes broadcastLanes(uint32_t value, uint32_t sew) {
+        return sew == 8 ? _mm256_set1_epi8(static_cast<char>(value)) : sew == 16 ? _mm256_set1_epi16(static_cast<short>(value)) : _mm256_set1_epi32(static_cast<int>(value));
+    }
+
+    inline bool combineLanes(Operation op, uint32_t sew, Lanes a, Lanes b, Lanes &out) {
+        switch (op) {
+            case Operation::ADD: out = sew == 8 ? _mm256_add_epi8(a, b) : sew == 16 ? _mm256_add_epi16(a, b) : _mm256_add_epi32(a, b); return true;
+            case Operation::SUB: out = sew == 8 ? _mm256_sub_epi8(a, b) : sew == 16 ? _mm256_sub_epi16(a, b) : _mm256_sub_epi32(a, b); return true;
+            case Operation::RSUB: out = sew == 8 ? _mm256_sub_epi8(b, a) : sew == 16 ? _mm256_sub_epi16(b, a) : _mm256_sub_epi32(b, a); return true;
+            case Operation::AND: out = _mm256_and_si256(a, b); return true;
+            case Operation::OR: out = _mm256_or_si256(a, b); return true;
+            case Operation::XOR: out = _mm256_xor_si256(a, b); return true;
+            case Operation::MINU: out = sew == 8 ? _mm256_min_epu8(a, b) : sew == 16 ? _mm256_min_epu16(a, b) : _mm256_min_epu32(a, b); return true;
+            case Operation::MIN: out = sew == 8 ? _mm256_min_epi8(a, b) : sew == 16 ? _mm256_min_epi16(a, b) : _mm256_min_epi32(a, b); return true;
+            case Operation::MAXU: out = sew == 8 ? _mm256_max_epu8(a, b) : sew == 16 ? _mm256_max_epu16(a, b) : _mm256_max_epu32(a, b); return true;
+            case Operation::MAX: out = sew == 8 ? _mm256_max_epi8(a, b) : sew == 16 ? _mm256_max_epi16(a, b) : _mm256_max_epi32(a, b); return true;
+            case Operation::MUL:
+                if (sew == 8) return false;
+                out = sew == 16 ? _mm256_mullo_epi16(a, b) : _mm256_mullo_epi32(a, b);
+                return true;
+            default: return false;
+        }
+    }
+#elif defined(__SSE2__)
+    using Lanes = __m128i;
+    inline Lanes loadLanes(const uint8_t* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+    inline void storeLanes(uint8_t* data, Lanes lanes) { _mm_storeu_si128(reinterpret_cast<__m128i*>(data), lanes); }
+    inline Lanes broadcastLanes(uint32_t value, uint32_t sew) {
+        return sew == 8 ? _mm_set1_epi8(static_cast<char>(value)) : sew == 16 ? _mm_set1_epi16(static_cast<short>(value)) : _mm_set1_epi32(static_cast<int>(value));
+    }
+
+    // SSE2 only has unsigned byte and signed halfword minimum and maximum,
+    // and a halfword multiply.
+    inline bool combineLanes(Operation op, uint32_t sew, Lanes a, Lanes b, Lanes &out) {
+        switch (op) {
+            case Operation::ADD: out = sew == 8 ? _mm_add_epi8(a, b) : sew == 16 ? _mm_add_epi16(a, b) : _mm_add_epi32(a, b); return true;
+            case Operation::SUB: out = sew == 8 ? _mm_sub_epi8(a, b) : sew == 16 ? _mm_sub_epi16(a, b) : _mm_sub_epi32(a, b); return true;
+            case Operation::RSUB: out = sew == 8 ? _mm_sub_epi8(b, a) : sew == 16 ? _mm_sub_epi16(b, a) : _mm_sub_epi32(b, a); return true;
+            case Operation::AND: out = _mm_and_si128(a, b); return true;
+            case Operation::OR: out = _mm_or_si128(a, b); return true;
+            case Operation::XOR: out = _mm_xor_si128(a, b); return true;
+            case Operation::MINU: if (sew != 8) return false; out = _mm_min_epu8(a, b); return true;
+            case Operation::MAXU: if (sew != 8) return false; out = _mm_max_epu8(a, b); return true;
+            case Operation::MIN: if (sew != 16) return false; out = _mm_min_epi16(a, b); return true;
+            case Operation::MAX: if (sew != 16) return false; out = _mm_max_epi16(a, b); return true;
+            case Operation::MUL: if (sew != 16) return false; out = _mm_mullo_epi16(a, b); return true;
+            default: return false;
+        }
+    }
+#endif
+
+    // Runs the first elements of an unmasked element-wise operation on host
+    // SIMD lanes, reading the second operand from b or, when b is null,
+    // broadcasting `scalar`. Returns how many elements it did; the caller
+    // finishes the rest, or all of them when the host lacks the operation.
+    inline uint32_t hostKernel(Operation op, uint32_t sew, uint8_t* dst, const uint8_t* a, const uint8_t* b, uint32_t scalar, uint32_t count) {
+#if defined(__AVX2__) || defined(__SSE2__)
+        const uint32_t perLanes = static_cast<uint32_t>(sizeof(Lanes)) * 8 / sew;
+        const Lanes broadcast = broadcastLanes(scalar, sew);
+        uint32_t done = 0;
+        for (; done + perLanes <= count; done += perLanes) {
+            const size_t offset = static_cast<size_t>(done) * sew / 8;
+            Lanes result;
+            if (!combineLanes(op, sew, loadLanes(a + offset), b ? loadLanes(b + offset) : broadcast, result)) return done;
+            storeLanes(dst + offset, result);
+        }
+        return done;
+#else
+        (void)op; (void)sew; (void)dst; (void)a; (void)b; (void)scalar; (void)count;
+        return 0;
+#endif
+    }
+
+    // What a V instruction asks of the vector unit, for the timing model.
+    // sources and destinations are bitmaps of v registers.
+    struct Issue {
+        enum class Unit : uint8_t { NONE, ARITHMETIC, MEMORY };
+        Unit unit = Unit::NONE;
+        uint32_t latency = 0;
+        uint32_t elements = 0;
+        uint32_t width = 0;
+        bool strided = false;
+        uint32_t sources = 0;
+        uint32_t destinations = 0;
+        bool scalarResult = false;
+        bool reduction = false;
+    };
+
+    inline uint32_t groupMask(uint32_t first, uint32_t count) {
+        return static_cast<uint32_t>(((uint64_t(1) << count) - 1) << first);
+    }
+
+    // The vector unit sits behind EXECUTE as two in-order pipelines, one for
+    // arithmetic and one for loads and stores, each taking `datapath` bits of
+    // elements per beat (one element per beat for strided accesses). An
+    // instruction issues once its pipeline is free and its sources are
+    // ready; with chaining it may start on a source as soon as the
+    // producer's first beat is out, provided it cannot overtake the
+    // producer's last beat. The scalar pipeline only waits for the issue,
+    // or for the result when the instruction writes an x register.
+    class Pipeline {
+    public:
+        Pipeline() { reset(); }
+
+        void reset() {
+            ready.fill({0, 0});
+            claimed.fill(0);
+            free.fill(0);
+            complete = 0;
+        }
+
+        // Cycles the instruction holds EXECUTE beyond its first.
+        uint32_t schedule(const Issue &issue, const Config &config, uint32_t now, SimulationStats &stats) {
+            if (issue.unit == Issue::Unit::NONE) return 0;
+            const uint32_t beats = issue.strided ? std::max(1u, issue.elements)
+                                                 : std::max(1u, (issue.elements * issue.width + config.datapath - 1) / config.datapath);
+            uint32_t &unitFree = free[issue.unit == Issue::Unit::MEMORY ? 1 : 0];
+            uint32_t start = std::max(now, unitFree);
+            for (uint32_t reg = 0; reg < 32; ++reg) {
+                if (issue.sources & (1u << reg)) {
+                    const Ready &source = ready[reg];
+                    const uint32_t overlap = source.last + 1 > beats ? source.last + 1 - beats : 0;
+                    start = std::max(start, config.chaining ? std::max(source.first, overlap) : source.last);
+                }
+                if (issue.destinations & (1u << reg)) {
+                    const uint32_t written = ready[reg].last - std::min(ready[reg].last, issue.latency);
+                    start = std::max({start, claimed[reg], written});
+                }
+            }
+
+            const uint32_t last = start + beats - 1 + issue.latency;
+            const uint32_t first = issue.reduction ? last : start + issue.latency;
+            for (uint32_t reg = 0; reg < 32; ++reg) {
+                if (issue.destinations & (1u << reg)) ready[reg] = {first, last};
+                if ((issue.sources | issue.destinations) & (1u << reg)) claimed[reg] = std::max(claimed[reg], start + beats - 1);
+            }
+            unitFree = start + beats;
+            complete = std::max(complete, last);
+
+            stats.vectorBeats += beats;
+            stats.vectorStalls += start - now;
+            if (issue.scalarResult) return last - 1 - now;
+            return start - now;
+        }
+
+        // Cycles after `now` until the last vector result is written.
+        uint32_t drain(uint32_t now) const { return complete > now ? complete - now : 0; }
+
+    private:
+        struct Ready {
+            uint32_t first;
+            uint32_t last;
+        };
+
+        std::array<Ready, 32> ready;
+        std::array<uint32_t, 32> claimed;
+        std::array<uint32_t, 2> free;
+        uint32_t complete;
+    };
+}
+
+#endif
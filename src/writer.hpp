@@ -0,0 +1,373 @@
+#ifndef WRITER_HPP
+#define WRITER_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+#include "image.hpp"
+#include "compressed.hpp"
+
+using namespace riscv;
+
+enum class ListingLayout : uint8_t { REG_REG_REG, REG_REG_IMM, REG_REG_SHAMT, LOAD, STORE, BRANCH, UPPER, JUMP, FENCE, NONE,
+                                     REG_REG, REG_REG_REG_REG, CSR, CSR_IMM, VECTOR };
+
+struct ListingEntry {
+    std::string_view mnemonic;
+    ListingLayout layout;
+    uint8_t floatRegisters;
+    bool rounding;
+};
+
+inline constexpr ListingLayout listingLayoutOf(const InstructionDescriptor &descriptor) {
+    switch (descriptor.format) {
+        case InstructionType::R: return descriptor.operands == OperandFormat::REG_REG ? ListingLayout::REG_REG : ListingLayout::REG_REG_REG;
+        case InstructionType::R4: return ListingLayout::REG_REG_REG_REG;
+        case InstructionType::I:
+            if (descriptor.operands == OperandFormat::CSR) return ListingLayout::CSR;
+            if (descriptor.operands == OperandFormat::CSR_IMM) return ListingLayout::CSR_IMM;
+            if (descriptor.operands == OperandFormat::REG_MEM) return ListingLayout::LOAD;
+            if (descriptor.operands == OperandFormat::FENCE) return ListingLayout::FENCE;
+            if (descriptor.operands == OperandFormat::NONE) return ListingLayout::NONE;
+            if (descriptor.opcode == 0b0010011 && (descriptor.funct3 == 0b001 || descriptor.funct3 == 0b101)) return ListingLayout::REG_REG_SHAMT;
+            return ListingLayout::REG_REG_IMM;
+        case InstructionType::S: return ListingLayout::STORE;
+        case InstructionType::SB: return ListingLayout::BRANCH;
+        case InstructionType::U: return ListingLayout::UPPER;
+        case InstructionType::UJ: return ListingLayout::JUMP;
+        case InstructionType::V: return ListingLayout::VECTOR;
+    }
+    return ListingLayout::REG_REG_REG;
+}
+
+inline constexpr std::array<ListingEntry, instructionCount> buildListingTable() {
+    std::array<ListingEntry, instructionCount> table{};
+    for (size_t i = 0; i < instructionCount; ++i) {
+        table[i] = {instructionTable[i].mnemonic, listingLayoutOf(instructionTable[i]), instructionTable[i].floatRegisters, instructionTable[i].hasRounding()};
+    }
+    return table;
+}
+
+inline constexpr std::array<ListingEntry, instructionCount> listingTable = buildListingTable();
+
+inline ListingEntry listingEntryOf(Instructions instruction) {
+    if (isCustomInstruction(instruction)) {
+        const InstructionDescriptor &descriptor = describe(instruction);
+        return {descriptor.mnemonic, listingLayoutOf(descriptor), descriptor.floatRegisters, descriptor.hasRounding()};
+    }
+    return listingTable[static_cast<size_t>(instruction)];
+}
+
+class MachineCodeWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+    static constexpr size_t MAX_LINE = 96;
+
+    explicit MachineCodeWriter(std::ostream &stream) : out(stream), buffer(BUFFER_SIZE), cursor(buffer.data()) {}
+    ~MachineCodeWriter() { flush(); }
+
+    MachineCodeWriter(const MachineCodeWriter&) = delete;
+    MachineCodeWriter& operator=(const MachineCodeWriter&) = delete;
+
+    inline void writeTextHeader();
+    inline void writeText(uint32_t address, uint32_t code);
+    inline void writeDataHeader(size_t textInstructions, uint32_t textEnd);
+    inline void writeData(const DataSection &section);
+    inline void writeData(uint32_t base, const uint8_t *bytes, size_t size);
+    inline void flush();
+
+    static inline char* disassemble(uint32_t word, char* out);
+
+private:
+    std::ostream &out;
+    std::vector<char> buffer;
+    char* cursor;
+
+    inline void reserve(size_t bytes);
+    static inline char* put(char* out, std::string_view text);
+    static inline char* putHex(char* out, uint32_t value, int digits);
+    static inline char* putDecimal(char* out, uint32_t value);
+    static inline char* putSigned(char* out, int32_t value);
+    static inline char* putRegister(char* out, uint32_t reg, bool isFloat = false);
+    static inline char* putCsr(char* out, uint32_t csr);
+    static inline char* putOperands(const ListingEntry &entry, uint32_t word, char* out);
+    static inline char* putVectorOperands(uint32_t word, char* out);
+    static inline char* putCompressed(uint16_t parcel, char* out);
+    static inline char* putFenceSet(char* out, uint32_t bits);
+};
+
+inline void MachineCodeWriter::reserve(size_t bytes) {
+    if (static_cast<size_t>(buffer.data() + buffer.size() - cursor) < bytes) {
+        flush();
+    }
+}
+
+inline void MachineCodeWriter::flush() {
+    if (cursor != buffer.data()) {
+        out.write(buffer.data(), cursor - buffer.data());
+        cursor = buffer.data();
+    }
+}
+
+inline char* MachineCodeWriter::put(char* out, std::string_view text) {
+    std::memcpy(out, text.data(), text.size());
+    return out + text.size();
+}
+
+inline char* MachineCodeWriter::putHex(char* out, uint32_t value, int digits) {
+    static constexpr char hexDigits[] = "0123456789abcdef";
+    for (int i = digits - 1; i >= 0; --i) {
+        out[i] = hexDigits[value & 0xF];
+        value >>= 4;
+    }
+    return out + digits;
+}
+
+inline char* MachineCodeWriter::putDecimal(char* out, uint32_t value) {
+    char digits[10];
+    int count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+inline char* MachineCodeWriter::putSigned(char* out, int32_t value) {
+    if (value < 0) {
+        *out++ = '-';
+        return putDecimal(out, 0u - static_cast<uint32_t>(value));
+    }
+    return putDecimal(out, static_cast<uint32_t>(value));
+}
+
+inline char* MachineCodeWriter::putRegister(char* out, uint32_t reg, bool isFloat) {
+    *out++ = isFloat ? 'f' : 'x';
+    return putDecimal(out, reg);
+}
+
+inline char* MachineCodeWriter::putCsr(char* out, uint32_t csr) {
+    switch (csr) {
+        case CSR_FFLAGS: return put(out, "fflags");
+        case CSR_FRM: return put(out, "frm");
+        case CSR_FCSR: return put(out, "fcsr");
+    }
+    return putDecimal(out, csr);
+}
+
+inline char* MachineCodeWriter::putFenceSet(char* out, uint32_t bits) {
+    for (size_t i = 0; i < fenceSetLetters.size(); ++i) {
+        if (bits & (0x8 >> i)) *out++ = fenceSetLetters[i];
+    }
+    return out;
+}
+
+// Field values are printed the way the listing always has: I, S, SB and UJ
+// immediates as their raw unsigned bit fields, U immediates sign-extended.
+inline char* MachineCodeWriter::disassemble(uint32_t word, char* out) {
+    if (isCompressedParcel(word)) {
+        return putCompressed(static_cast<uint16_t>(word), out);
+    }
+    const Instructions instruction = decodeInstructionWord(word);
+    if (instruction == Instructions::INVALID) {
+        const uint32_t opcode = word & 0x7F;
+        out = put(out, "UNKNOWN");
+        switch (opcode) {
+            case 0b0110011: case 0b0010011: case 0b0000011: case 0b0100011:
+            case 0b1100011: case 0b0110111: case 0b0010111: case 0b1101111: case 0b1100111:
+            case 0b0001111: case 0b1110011: case 0b0000111: case 0b0100111: case 0b1010011:
+            case 0b1000011: case 0b1000111: case 0b1001011: case 0b1001111: case 0b1010111:
+                return out;
+            default:
+                return putHex(out, opcode, opcode > 0xF ? 2 : 1);
+        }
+    }
+
+    const ListingEntry entry = listingEntryOf(instruction);
+    out = put(out, entry.mnemonic);
+    if (entry.layout == ListingLayout::NONE) return out;
+    *out++ = ' ';
+    out = putOperands(entry, word, out);
+    const uint32_t roundingMode = (word >> 12) & 0x7;
+    if (!entry.rounding || roundingMode == ROUND_DYNAMIC) return out;
+    *out++ = ',';
+    return roundingModeNames[roundingMode].empty() ? putDecimal(out, roundingMode) : put(out, roundingModeNames[roundingMode]);
+}
+
+inline char* MachineCodeWriter::putOperands(const ListingEntry &entry, uint32_t word, char* out) {
+    const uint32_t rd = (word >> 7) & 0x1F;
+    const uint32_t rs1 = (word >> 15) & 0x1F;
+    const uint32_t rs2 = (word >> 20) & 0x1F;
+    const uint8_t floats = entry.floatRegisters;
+
+    switch (entry.layout) {
+        case ListingLayout::REG_REG_REG:
+            out = putRegister(out, rd, floats & FLOAT_RD); *out++ = ',';
+            out = putRegister(out, rs1, floats & FLOAT_RS1); *out++ = ',';
+            return putRegister(out, rs2, floats & FLOAT_RS2);
+        case ListingLayout::REG_REG:
+            out = putRegister(out, rd, floats & FLOAT_RD); *out++ = ',';
+            return putRegister(out, rs1, floats & FLOAT_RS1);
+        case ListingLayout::REG_REG_REG_REG:
+            out = putRegister(out, rd, floats & FLOAT_RD); *out++ = ',';
+            out = putRegister(out, rs1, floats & FLOAT_RS1); *out++ = ',';
+            out = putRegister(out, rs2, floats & FLOAT_RS2); *out++ = ',';
+            return putRegister(out, word >> 27, floats & FLOAT_RS3);
+        case ListingLayout::CSR:
+        case ListingLayout::CSR_IMM:
+            out = putRegister(out, rd); *out++ = ',';
+            out = putCsr(out, word >> 20); *out++ = ',';
+            return entry.layout == ListingLayout::CSR ? putRegister(out, rs1) : putDecimal(out, rs1);
+        case ListingLayout::REG_REG_IMM:
+        case ListingLayout::REG_REG_SHAMT:
+            out = putRegister(out, rd); *out++ = ',';
+            out = putRegister(out, rs1); *out++ = ',';
+            return putDecimal(out, entry.layout == ListingLayout::REG_REG_SHAMT ? (word >> 20) & 0x1F : word >> 20);
+        case ListingLayout::LOAD:
+            out = putRegister(out, rd, floats & FLOAT_RD); *out++ = ',';
+            out = putDecimal(out, word >> 20); *out++ = '(';
+            out = putRegister(out, rs1); *out++ = ')';
+            return out;
+        case ListingLayout::STORE:
+            out = putRegister(out, rs2, floats & FLOAT_RS2); *out++ = ',';
+            out = putDecimal(out, static_cast<uint32_t>(decodeImmediate(InstructionType::S, word)) & 0xFFF); *out++ = '(';
+            out = putRegister(out, rs1); *out++ = ')';
+            return out;
+        case ListingLayout::BRANCH:
+            out = putRegister(out, rs1); *out++ = ',';
+            out = putRegister(out, rs2); *out++ = ',';
+            return putDecimal(out, static_cast<uint32_t>(decodeImmediate(InstructionType::SB, word)) & 0x1FFF);
+        case ListingLayout::UPPER:
+            out = putRegister(out, rd); *out++ = ',';
+            return putSigned(out, static_cast<int32_t>(word & 0xFFFFF000) >> 12);
+        case ListingLayout::JUMP:
+            out = putRegister(out, rd); *out++ = ',';
+            return putDecimal(out, static_cast<uint32_t>(decodeImmediate(InstructionType::UJ, word)) & 0x1FFFFF);
+        case ListingLayout::FENCE:
+            out = putFenceSet(out, (word >> 24) & 0xF); *out++ = ',';
+            return putFenceSet(out, (word >> 20) & 0xF);
+        case ListingLayout::VECTOR:
+            return putVectorOperands(word, out);
+        case ListingLayout::NONE:
+            return out;
+    }
+    return out;
+}
+
+// A compressed parcel is listed the way it is written: its own mnemonic with
+// the operands of the instruction it expands to, minus those the form implies,
+// and immediates as values the form accepts, so the line assembles back to the
+// same parcel.
+inline char* MachineCodeWriter::putCompressed(uint16_t parcel, char* out) {
+    const uint32_t expanded = expandCompressed(parcel);
+    const CompressedDescriptor* form = findCompressedForm(compressedMnemonic(parcel));
+    if (expanded == 0 || form == nullptr) return put(out, "UNKNOWN");
+    out = put(out, form->mnemonic);
+    if (form->shape == CompressedShape::NONE) return out;
+    *out++ = ' ';
+
+    const uint32_t rd = (expanded >> 7) & 0x1F;
+    const uint32_t rs1 = (expanded >> 15) & 0x1F;
+    const uint32_t rs2 = (expanded >> 20) & 0x1F;
+    switch (form->shape) {
+        case CompressedShape::JUMP_REG:
+            return putRegister(out, rs1);
+        case CompressedShape::REG_REG:
+            out = putRegister(out, rd); *out++ = ',';
+            return putRegister(out, rs2);
+        case CompressedShape::REG_IMM:
+            out = putRegister(out, rd); *out++ = ',';
+            if (form->base == Instructions::SLLI || form->base == Instructions::SRLI || form->base == Instructions::SRAI) {
+                return putDecimal(out, rs2);
+            }
+            return putSigned(out, decodeImmediate(InstructionType::I, expanded));
+        case CompressedShape::UPPER:
+            out = putRegister(out, rd); *out++ = ',';
+            return putDecimal(out, expanded >> 12);
+        case CompressedShape::BASE:
+            return putOperands(listingEntryOf(decodeInstructionWord(expanded)), expanded, out);
+        case CompressedShape::BRANCH:
+            out = putRegister(out, rs1); *out++ = ',';
+            return putSigned(out, decodeImmediate(InstructionType::SB, expanded));
+        case CompressedShape::JUMP:
+            return putSigned(out, decodeImmediate(InstructionType::UJ, expanded));
+        case CompressedShape::NONE:
+            break;
+    }
+    return out;
+}
+
+inline char* MachineCodeWriter::putVectorOperands(uint32_t word, char* out) {
+    std::array<VectorOperand, 5> operands{};
+    const size_t count = vectorOperandsOf(describe(decodeInstructionWord(word)), word, operands);
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) *out++ = ',';
+        const uint32_t value = operands[i].value;
+        switch (operands[i].kind) {
+            case VectorOperandKind::VECTOR: *out++ = 'v'; out = putDecimal(out, value); break;
+            case VectorOperandKind::SCALAR: out = putRegister(out, value); break;
+            case VectorOperandKind::IMMEDIATE: out = putSigned(out, static_cast<int32_t>(value)); break;
+            case VectorOperandKind::TYPE: out = put(out, vectorTypeName(value, ",")); break;
+            case VectorOperandKind::BASE: *out++ = '('; out = putRegister(out, value); *out++ = ')'; break;
+            case VectorOperandKind::MASK: out = put(out, "v0.t"); break;
+            case VectorOperandKind::CARRY: out = put(out, "v0"); break;
+        }
+    }
+    return out;
+}
+
+inline void MachineCodeWriter::writeTextHeader() {
+    reserve(MAX_LINE);
+    cursor = put(cursor, "# ---------------- TEXT SEGMENT ---------------- #\n");
+}
+
+inline void MachineCodeWriter::writeText(uint32_t address, uint32_t code) {
+    reserve(MAX_LINE);
+    char* line = cursor;
+    *line++ = '0'; *line++ = 'x';
+    line = putHex(line, address, 8);
+    line = put(line, " 0x");
+    line = putHex(line, code, isCompressedParcel(code) ? 4 : 8);
+    line = put(line, " , ");
+    line = disassemble(code, line);
+    *line++ = '\n';
+    cursor = line;
+}
+
+inline void MachineCodeWriter::writeDataHeader(size_t textInstructions, uint32_t textEnd) {
+    reserve(2 * MAX_LINE);
+    cursor = put(cursor, "\n# ---------------- DATA SEGMENT ---------------- #\n");
+    if (textInstructions > 0) {
+        cursor = put(cursor, "0x");
+        cursor = putHex(cursor, textEnd, 8);
+        cursor = put(cursor, " 0x00000000 , <END_OF_TEXT>\n");
+    }
+}
+
+inline void MachineCodeWriter::writeData(const DataSection &section) {
+    writeData(section.base, section.bytes.data(), section.bytes.size());
+}
+
+inline void MachineCodeWriter::writeData(uint32_t base, const uint8_t *bytes, size_t size) {
+    static constexpr size_t DATA_LINE = 16;
+    uint32_t address = base;
+    for (const uint8_t *byte = bytes; byte != bytes + size; ++byte) {
+        reserve(DATA_LINE);
+        char* line = cursor;
+        *line++ = '0'; *line++ = 'x';
+        line = putHex(line, address++, 8);
+        line = put(line, " 0x");
+        line = putHex(line, *byte, 2);
+        *line++ = '\n';
+        cursor = line;
+    }
+}
+
+#endif
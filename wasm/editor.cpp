@@ -0,0 +1,85 @@
+#include <emscripten/bind.h>
+#include <emscripten/val.h>
+#include "../src/incremental.hpp"
+
+// The editor binding is built from src/ as its own module, since the
+// simulator headers in this directory define their own riscv types.
+
+using namespace emscripten;
+
+val lineEncodingsToVal(const std::vector<LineEncoding>& encodings) {
+    val result = val::array();
+    for (size_t i = 0; i < encodings.size(); i++) {
+        val encoding = val::object();
+        encoding.set("line", encodings[i].line);
+        encoding.set("address", encodings[i].address);
+        encoding.set("code", encodings[i].code);
+        result.set(i, encoding);
+    }
+    return result;
+}
+
+val diagnosticsToVal(const std::vector<Diagnostic>& diagnostics) {
+    val result = val::array();
+    for (size_t i = 0; i < diagnostics.size(); i++) {
+        val diagnostic = val::object();
+        diagnostic.set("line", diagnostics[i].line);
+        diagnostic.set("message", diagnostics[i].message);
+        result.set(i, diagnostic);
+    }
+    return result;
+}
+
+val editResultToVal(const EditResult& edit) {
+    val refreshed = val::array();
+    for (size_t i = 0; i < edit.refreshed.size(); i++) {
+        val range = val::object();
+        range.set("first", edit.refreshed[i].first);
+        range.set("count", edit.refreshed[i].count);
+        refreshed.set(i, range);
+    }
+
+    val result = val::object();
+    result.set("refreshed", refreshed);
+    result.set("updated", lineEncodingsToVal(edit.updated));
+    result.set("diagnostics", diagnosticsToVal(edit.diagnostics));
+    result.set("lexedLines", edit.lexedLines);
+    result.set("parsedLines", edit.parsedLines);
+    return result;
+}
+
+class IncrementalAssemblerWrapper {
+public:
+    IncrementalAssemblerWrapper() : assembler() {}
+
+    val setSource(const std::string& text) {
+        return editResultToVal(assembler.setSource(text));
+    }
+
+    // Returns null when the edit does not fit the current source, so the
+    // caller can fall back to setSource.
+    val applyEdit(size_t firstLine, size_t removedLines, val insertedLines) {
+        try {
+            return editResultToVal(assembler.applyEdit(firstLine, removedLines, vecFromJSArray<std::string>(insertedLines)));
+        } catch (const std::exception&) {
+            return val::null();
+        }
+    }
+
+    val getLineEncodings(int line) const { return lineEncodingsToVal(assembler.getLineEncodings(line)); }
+    val getDiagnostics() const { return diagnosticsToVal(assembler.getDiagnostics()); }
+    size_t getLineCount() const { return assembler.getLineCount(); }
+
+private:
+    IncrementalAssembler assembler;
+};
+
+EMSCRIPTEN_BINDINGS(assembler_module) {
+    class_<IncrementalAssemblerWrapper>("IncrementalAssembler")
+        .constructor<>()
+        .function("setSource", &IncrementalAssemblerWrapper::setSource)
+        .function("applyEdit", &IncrementalAssemblerWrapper::applyEdit)
+        .function("getLineEncodings", &IncrementalAssemblerWrapper::getLineEncodings)
+        .function("getDiagnostics", &IncrementalAssemblerWrapper::getDiagnostics)
+        .function("getLineCount", &IncrementalAssemblerWrapper::getLineCount);
+}
@@ -24,6 +24,13 @@ private:
     std::unordered_map<uint32_t, uint8_t> dataMap;
     std::map<uint32_t, std::pair<uint32_t, std::string>> textMap;
 
+    // The frontend reloads the same program on every reset, so the last
+    // successfully assembled program is kept and reused while its source is
+    // unchanged.
+    std::string loadedSource;
+    std::unordered_map<uint32_t, uint8_t> loadedDataMap;
+    std::map<uint32_t, std::pair<uint32_t, std::string>> loadedTextMap;
+
     std::map<Stage, InstructionNode*> pipeline;
     InstructionRegisters instructionRegisters;
     ForwardingStatus forwardingStatus;
@@ -48,6 +55,7 @@ private:
     void updateDependencies(InstructionNode& node, Stage stage);
     bool checkLoadUseHazard(const InstructionNode& node, const std::unordered_map<uint32_t, RegisterDependency>& depsSnapshot, bool isStore = false);
     bool isPipelineEmpty() const;
+    bool assembleProgram(const std::string &input);
 
 public:
     Simulator();
@@ -92,6 +100,42 @@ Simulator::Simulator() : PC(TEXT_SEGMENT_START),
     pipeline[Stage::WRITEBACK] = nullptr;
 }
 
+bool Simulator::assembleProgram(const std::string &input) {
+    std::vector<std::vector<Token>> tokenizedLines = Lexer::tokenize(input);
+    if (tokenizedLines.empty()) {
+        logs[300] = "Empty Code";
+        return false;
+    }
+
+    Parser parser(tokenizedLines);
+    if (!parser.parse()) {
+        logs[404] = "Parsing failed with " + std::to_string(parser.getErrorCount()) + " errors";
+        return false;
+    }
+
+    std::unordered_map<std::string, SymbolEntry> symbolTable = parser.getSymbolTable();
+    std::vector<ParsedInstruction> parsedInstructions = parser.getParsedInstructions();
+
+    Assembler assembler(symbolTable, parsedInstructions);
+    if (!assembler.assemble()) {
+        logs[404] = "Assembly failed with " + std::to_string(assembler.getErrorCount()) + " errors";
+        return false;
+    }
+
+    for (const auto &[address, value] : assembler.getMachineCode()) {
+        if (address >= DATA_SEGMENT_START) {
+            dataMap[address] = static_cast<uint8_t>(value);
+        } else {
+            textMap[address] = std::make_pair(value, parseInstructions(value));
+        }
+    }
+
+    loadedSource = input;
+    loadedDataMap = dataMap;
+    loadedTextMap = textMap;
+    return true;
+}
+
 bool Simulator::loadProgram(const std::string &input) {
     try {
         bool wasPipeline = isPipeline;
@@ -103,33 +147,13 @@ bool Simulator::loadProgram(const std::string &input) {
         isDataForwarding = wasDataForwarding;
         running = true;
 
-        std::vector<std::vector<Token>> tokenizedLines = Lexer::tokenize(input);
-        if (tokenizedLines.empty()) {
-            logs[300] = "Empty Code";
-            return false;
-        }
-
-        Parser parser(tokenizedLines);
-        if (!parser.parse()) {
-            logs[404] = "Parsing failed with " + std::to_string(parser.getErrorCount()) + " errors";
-            return false;
-        }
-
-        std::unordered_map<std::string, SymbolEntry> symbolTable = parser.getSymbolTable();
-        std::vector<ParsedInstruction> parsedInstructions = parser.getParsedInstructions();
-
-        Assembler assembler(symbolTable, parsedInstructions);
-        if (!assembler.assemble()) {
-            logs[404] = "Assembly failed with " + std::to_string(assembler.getErrorCount()) + " errors";
-            return false;
-        }
-
-        for (const auto &[address, value] : assembler.getMachineCode()) {
-            if (address >= DATA_SEGMENT_START) {
-                dataMap[address] = static_cast<uint8_t>(value);
-            } else {
-                textMap[address] = std::make_pair(value, parseInstructions(value));
+        if (input.empty() || input != loadedSource) {
+            if (!assembleProgram(input)) {
+                return false;
             }
+        } else {
+            dataMap = loadedDataMap;
+            textMap = loadedTextMap;
         }
         
         PC = TEXT_SEGMENT_START;